@@ -50,6 +50,8 @@
 #include <cmath>
 #include <algorithm>
 #include <locale>
+#include <thread>
+#include <chrono>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -151,6 +153,7 @@ public:
 
  private:
   void probeDevices( void ) override;
+  void copyDevices( RtApi *source ) override { deviceIds_ = static_cast<RtApiCore *>( source )->deviceIds_; }
   bool probeDeviceInfo( AudioDeviceID id, RtAudio::DeviceInfo &info );
   bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
@@ -258,6 +261,7 @@ public:
   std::vector<struct DsDevice> dsDevices_;
   
   void probeDevices( void ) override;
+  void copyDevices( RtApi *source ) override;
   bool probeDeviceInfo( RtAudio::DeviceInfo &info, DsDevice &dsDevice );
   bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
@@ -292,6 +296,7 @@ private:
   std::vector< std::pair< std::string, bool> > deviceIds_;
 
   void probeDevices( void ) override;
+  void copyDevices( RtApi *source ) override { deviceIds_ = static_cast<RtApiWasapi *>( source )->deviceIds_; }
   bool probeDeviceInfo( RtAudio::DeviceInfo &info, LPWSTR deviceId, bool isCaptureDevice );
   bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
                         unsigned int firstChannel, unsigned int sampleRate,
@@ -308,6 +313,8 @@ private:
 
 #if defined(__LINUX_ALSA__)
 
+#include <alsa/asoundlib.h>
+
 class RtApiAlsa: public RtApi
 {
 public:
@@ -328,13 +335,54 @@ public:
 
   private:
   std::vector<std::pair<std::string, unsigned int>> deviceIdPairs_;
-  
+
+  // Sound cards are watched through their control devices, so that only
+  // the cards added, removed or changed since the last probe are probed.
+  struct CardCache;
+  std::vector<CardCache *> cards_;
+  std::vector<std::pair<std::string, std::string>> pluginDevices_; // "default" and "pulse", if available.
+  std::vector<unsigned int> capabilitiesPending_; // IDs of devices not probed yet.
+  bool devicesCached_;
+  bool updateCards( std::vector<std::string> &changedDevices );
+  void clearCards( void );
+
+  // Cards are probed in parallel, one task per card.
+  static const unsigned int MAX_PROBE_THREADS = 8;
+  struct ProbeTask;
+  void runProbeTasks( std::vector<ProbeTask *> &tasks );
+  void reportProbeWarnings( ProbeTask &task );
+
   void probeDevices( void ) override;
+  void copyDevices( RtApi *source ) override;
+  void probeDeviceCapabilities( RtAudio::DeviceInfo &info ) override;
   bool probeDeviceInfo( RtAudio::DeviceInfo &info, std::string name );
   bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
                         RtAudio::StreamOptions *options ) override;
+  RtAudioErrorType requestStop( int request );
+  int finishStop( int request );
+  void readInput( void );
+  void readDriftInput( void );
+  bool waitForPeriod( int timeout );
+  void watchDevices( bool watch );
+  int processExternal( int timeout ) override;
+  bool deviceTimestamp( StreamMode mode, long long *time, snd_pcm_sframes_t *delay );
+  const snd_pcm_channel_area_t *mmapAreas( StreamMode mode );
+  char *mmapBegin( StreamMode mode );
+  bool usePlanes( StreamMode mode );
+  bool mmapPlanes( StreamMode mode );
+  void mmapCommit( StreamMode mode );
+
+  // Devices added with StreamOptions::aggregateOutputs and aggregateInputs.
+  struct AggregateDevice;
+  std::vector<AggregateDevice *> aggregate_;
+  bool openAggregate( StreamMode mode, const RtAudio::StreamParameters &parameters,
+                      unsigned int userChannel );
+  void closeAggregate( void );
+  void stopAggregate( void );
+  void readAggregate( void );
+  void writeAggregate( void );
 };
 
 #endif
@@ -353,11 +401,13 @@ public:
   RtAudioErrorType stopStream( void ) override;
   RtAudioErrorType abortStream( void ) override;
 
-  // This function is intended for internal use only.  It must be
-  // public because it is called by the internal callback handler,
-  // which is not a member of RtAudio.  External use of this function
+  // These functions are intended for internal use only.  They must be
+  // public because they are called by the PulseAudio stream callbacks,
+  // which are not members of RtAudio.  External use of these functions
   // will most likely produce highly undesirable results!
-  void callbackEvent( void );
+  void writeEvent( void );
+  void readEvent( void );
+  void drainEvent( int success );
 
   struct PaDeviceInfo {
     std::string sinkName;
@@ -367,7 +417,67 @@ public:
  private:
   std::vector< PaDeviceInfo > paDeviceList_;
 
+  void processPeriod( const char *input );
+  void wakeExternal( void );
+  int processExternal( int timeout ) override;
+  RtAudioErrorType requestStop( int request );
+  void beginStop( int request );
+  void finishStop( int result );
+  bool connectStream( StreamMode mode, const char *device, const pa_sample_spec *ss,
+                      RtAudio::StreamOptions *options );
+  void probeDevices( void ) override;
+  void copyDevices( RtApi *source ) override { paDeviceList_ = static_cast<RtApiPulse *>( source )->paDeviceList_; }
+  bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
+                        unsigned int firstChannel, unsigned int sampleRate,
+                        RtAudioFormat format, unsigned int *bufferSize,
+                        RtAudio::StreamOptions *options ) override;
+};
+
+#endif
+
+#if defined(__LINUX_PIPEWIRE__)
+
+#include <pipewire/pipewire.h>
+
+class RtApiPipeWire: public RtApi
+{
+public:
+  RtApiPipeWire();
+  ~RtApiPipeWire();
+  RtAudio::Api getCurrentApi() override { return RtAudio::LINUX_PIPEWIRE; }
+  void closeStream( void ) override;
+  RtAudioErrorType startStream( void ) override;
+  RtAudioErrorType stopStream( void ) override;
+  RtAudioErrorType abortStream( void ) override;
+
+  // These functions are intended for internal use only.  They must be
+  // public because they are called by the PipeWire stream callbacks,
+  // which are not members of RtAudio.  External use of these functions
+  // will most likely produce highly undesirable results!
+  void processOutput( void );
+  void processInput( void );
+  void drainEvent( void );
+  void stopEvent( void );
+  void quantumEvent( unsigned int frames );
+
+  struct PwDeviceInfo {
+    std::string nodeName;
+    uint32_t nodeId;
+  };
+
+ private:
+  std::vector< PwDeviceInfo > pwDeviceList_;
+  RingBuffer *quantumBuffer_[2]; // Adapts the graph quantum to the stream buffer size.
+
+  void processPeriod( const char *input, char *output,
+                      float * const *inputPlanes = NULL, float * const *outputPlanes = NULL );
+  bool mapPlanes( StreamMode mode, struct spa_buffer *buffer );
+  void noteQuantum( StreamMode mode );
+  RtAudioErrorType requestStop( int request );
+  void beginStop( void );
+  void finishStop( int result );
   void probeDevices( void ) override;
+  void copyDevices( RtApi *source ) override { pwDeviceList_ = static_cast<RtApiPipeWire *>( source )->pwDeviceList_; }
   bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
@@ -400,6 +510,17 @@ public:
 
   private:
 
+  RtAudioErrorType requestStop( int request );
+  int finishStop( int request );
+  void readDriftInput( void );
+  bool mapBuffer( StreamMode mode, int fd );
+  void unmapBuffer( StreamMode mode );
+  void startMmap( void );
+  bool waitMmap( int limit );
+  void readMmap( void );
+  bool waitForPeriod( int timeout );
+  void watchDevices( bool watch );
+  int processExternal( int timeout ) override;
   void probeDevices( void ) override;
   bool probeDeviceInfo( RtAudio::DeviceInfo &info, oss_audioinfo &ainfo );
   bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels, 
@@ -410,6 +531,63 @@ public:
 
 #endif
 
+#if defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__LINUX_OSS__)
+
+// Callback thread configuration (see RtApi::configureCallbackThread()).
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(HAVE_RTKIT) && defined(__linux__)
+#include <dbus/dbus.h>
+#endif
+
+#endif
+
+#if defined(__RTAUDIO_NULL__)
+
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cctype>
+
+class RtApiNull: public RtApi
+{
+public:
+
+  RtApiNull();
+  ~RtApiNull();
+  RtAudio::Api getCurrentApi( void ) override { return RtAudio::RTAUDIO_NULL; }
+  void closeStream( void ) override;
+  RtAudioErrorType startStream( void ) override;
+  RtAudioErrorType stopStream( void ) override;
+  RtAudioErrorType abortStream( void ) override;
+
+  // This function is intended for internal use only.  It must be
+  // public because it is called by the internal callback handler,
+  // which is not a member of RtAudio.  External use of this function
+  // will most likely produce highly undesirable results!
+  void callbackEvent( void );
+
+  private:
+
+  RtAudioErrorType requestStop( int request );
+  int finishStop( int request );
+  bool openFile( StreamMode mode, const std::string &path );
+  void closeFiles( void );
+  void probeDevices( void ) override;
+  bool probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels, 
+                        unsigned int firstChannel, unsigned int sampleRate,
+                        RtAudioFormat format, unsigned int *bufferSize,
+                        RtAudio::StreamOptions *options ) override;
+};
+
+#endif
+
 #if defined(__RTAUDIO_DUMMY__)
 
 class RtApiDummy: public RtApi
@@ -458,6 +636,8 @@ const char* rtaudio_api_names[][2] = {
   { "wasapi"      , "WASAPI" },
   { "ds"          , "DirectSound" },
   { "dummy"       , "Dummy" },
+  { "null"        , "Null" },
+  { "pipewire"    , "PipeWire" },
 };
 
 const unsigned int rtaudio_num_api_names = 
@@ -475,6 +655,9 @@ extern "C" const RtAudio::Api rtaudio_compiled_apis[] = {
 #if defined(__UNIX_JACK__)
   RtAudio::UNIX_JACK,
 #endif
+#if defined(__LINUX_PIPEWIRE__)
+  RtAudio::LINUX_PIPEWIRE,
+#endif
 #if defined(__LINUX_PULSE__)
   RtAudio::LINUX_PULSE,
 #endif
@@ -490,6 +673,9 @@ extern "C" const RtAudio::Api rtaudio_compiled_apis[] = {
 #if defined(__WINDOWS_DS__)
   RtAudio::WINDOWS_DS,
 #endif
+#if defined(__RTAUDIO_NULL__)
+  RtAudio::RTAUDIO_NULL,
+#endif
 #if defined(__RTAUDIO_DUMMY__)
   RtAudio::RTAUDIO_DUMMY,
 #endif
@@ -550,44 +736,56 @@ void RtAudio :: openRtApi( RtAudio::Api api )
 {
   if ( rtapi_ )
     delete rtapi_;
-  rtapi_ = 0;
+  rtapi_ = newRtApi( api );
+}
 
+RtApi *RtAudio :: newRtApi( RtAudio::Api api )
+{
 #if defined(__UNIX_JACK__)
   if ( api == UNIX_JACK )
-    rtapi_ = new RtApiJack();
+    return new RtApiJack();
 #endif
 #if defined(__LINUX_ALSA__)
   if ( api == LINUX_ALSA )
-    rtapi_ = new RtApiAlsa();
+    return new RtApiAlsa();
+#endif
+#if defined(__LINUX_PIPEWIRE__)
+  if ( api == LINUX_PIPEWIRE )
+    return new RtApiPipeWire();
 #endif
 #if defined(__LINUX_PULSE__)
   if ( api == LINUX_PULSE )
-    rtapi_ = new RtApiPulse();
+    return new RtApiPulse();
 #endif
 #if defined(__LINUX_OSS__)
   if ( api == LINUX_OSS )
-    rtapi_ = new RtApiOss();
+    return new RtApiOss();
 #endif
 #if defined(__WINDOWS_ASIO__)
   if ( api == WINDOWS_ASIO )
-    rtapi_ = new RtApiAsio();
+    return new RtApiAsio();
 #endif
 #if defined(__WINDOWS_WASAPI__)
   if ( api == WINDOWS_WASAPI )
-    rtapi_ = new RtApiWasapi();
+    return new RtApiWasapi();
 #endif
 #if defined(__WINDOWS_DS__)
   if ( api == WINDOWS_DS )
-    rtapi_ = new RtApiDs();
+    return new RtApiDs();
 #endif
 #if defined(__MACOSX_CORE__)
   if ( api == MACOSX_CORE )
-    rtapi_ = new RtApiCore();
+    return new RtApiCore();
+#endif
+#if defined(__RTAUDIO_NULL__)
+  if ( api == RTAUDIO_NULL )
+    return new RtApiNull();
 #endif
 #if defined(__RTAUDIO_DUMMY__)
   if ( api == RTAUDIO_DUMMY )
-    rtapi_ = new RtApiDummy();
+    return new RtApiDummy();
 #endif
+  return 0;
 }
 
 RtAudio :: RtAudio( RtAudio::Api api, RtAudioErrorCallback&& errorCallback )
@@ -642,6 +840,8 @@ RtAudio :: RtAudio( RtAudio::Api api, RtAudioErrorCallback&& errorCallback )
 
 RtAudio :: ~RtAudio()
 {
+  for ( unsigned int i=0; i<streams_.size(); i++ )
+    delete streams_[i];
   if ( rtapi_ )
     delete rtapi_;
 }
@@ -658,6 +858,88 @@ RtAudioErrorType RtAudio :: openStream( RtAudio::StreamParameters *outputParamet
                              userData, options );
 }
 
+RtAudioErrorType RtAudio :: openStream( RtAudio::StreamParameters *outputParameters,
+                                        RtAudio::StreamParameters *inputParameters,
+                                        unsigned int sampleRate, unsigned int *bufferFrames,
+                                        RtAudioPlanarCallback callback, void *userData,
+                                        RtAudio::StreamOptions *options )
+{
+  return rtapi_->openStream( outputParameters, inputParameters, sampleRate,
+                             bufferFrames, callback, userData, options );
+}
+
+RtAudioErrorType RtAudio :: openStream( unsigned int *streamId,
+                                        RtAudio::StreamParameters *outputParameters,
+                                        RtAudio::StreamParameters *inputParameters,
+                                        RtAudioFormat format, unsigned int sampleRate,
+                                        unsigned int *bufferFrames,
+                                        RtAudioCallback callback, void *userData,
+                                        RtAudio::StreamOptions *options )
+{
+  if ( streamId == NULL )
+    return rtapi_->reportError( RTAUDIO_INVALID_USE, "RtAudio::openStream: the streamId argument cannot be NULL." );
+
+  return newStreamApi( streamId )->openStream( outputParameters, inputParameters, format,
+                                               sampleRate, bufferFrames, callback,
+                                               userData, options );
+}
+
+RtAudioErrorType RtAudio :: openStream( unsigned int *streamId,
+                                        RtAudio::StreamParameters *outputParameters,
+                                        RtAudio::StreamParameters *inputParameters,
+                                        unsigned int sampleRate, unsigned int *bufferFrames,
+                                        RtAudioPlanarCallback callback, void *userData,
+                                        RtAudio::StreamOptions *options )
+{
+  if ( streamId == NULL )
+    return rtapi_->reportError( RTAUDIO_INVALID_USE, "RtAudio::openStream: the streamId argument cannot be NULL." );
+
+  return newStreamApi( streamId )->openStream( outputParameters, inputParameters, sampleRate,
+                                               bufferFrames, callback, userData, options );
+}
+
+RtApi *RtAudio :: newStreamApi( unsigned int *streamId )
+{
+  // Use the first stream that is not open, or else add one that
+  // shares the device list and error handling of the first.
+  unsigned int id = 0;
+  RtApi *api = rtapi_;
+  while ( api->isStreamOpen() && id < streams_.size() )
+    api = streams_[id++];
+  if ( api->isStreamOpen() ) {
+    api = newRtApi( rtapi_->getCurrentApi() );
+    streams_.push_back( api );
+    id = streams_.size();
+  }
+  if ( api != rtapi_ ) api->shareDevices( rtapi_ );
+
+  *streamId = id;
+  return api;
+}
+
+RtApi *RtAudio :: streamApi( unsigned int streamId )
+{
+  if ( streamId == 0 ) return rtapi_;
+  if ( streamId <= streams_.size() ) return streams_[streamId - 1];
+
+  rtapi_->reportError( RTAUDIO_INVALID_USE, "RtAudio: invalid stream ID." );
+  return 0;
+}
+
+void RtAudio :: setErrorCallback( RtAudioErrorCallback errorCallback )
+{
+  rtapi_->setErrorCallback( errorCallback );
+  for ( unsigned int i=0; i<streams_.size(); i++ )
+    streams_[i]->setErrorCallback( errorCallback );
+}
+
+void RtAudio :: showWarnings( bool value )
+{
+  rtapi_->showWarnings( value );
+  for ( unsigned int i=0; i<streams_.size(); i++ )
+    streams_[i]->showWarnings( value );
+}
+
 // *************************************************** //
 //
 // Public RtApi definitions (see end of file for
@@ -665,10 +947,352 @@ RtAudioErrorType RtAudio :: openStream( RtAudio::StreamParameters *outputParamet
 //
 // *************************************************** //
 
+// A lock-free single-producer/single-consumer ring buffer of sample
+// frames.  Only the producer advances the write position and only the
+// consumer advances the read position.  Positions run over twice the
+// capacity, so that a full buffer can be told apart from an empty one.
+class RtApi::RingBuffer
+{
+public:
+  RingBuffer( unsigned int frames, unsigned int frameBytes )
+    : data_( (size_t) frames * frameBytes ), frames_( frames ), frameBytes_( frameBytes ),
+      readPosition_( 0 ), writePosition_( 0 ) {}
+
+  unsigned int frameBytes( void ) const { return frameBytes_; }
+
+  // Empties the buffer.  Neither side may be in use.
+  void reset( void )
+  {
+    readPosition_.store( 0, std::memory_order_relaxed );
+    writePosition_.store( 0, std::memory_order_relaxed );
+  }
+
+  unsigned int readAvailable( void ) const
+  {
+    return used( writePosition_.load( std::memory_order_acquire ), readPosition_.load( std::memory_order_relaxed ) );
+  }
+
+  unsigned int writeAvailable( void ) const
+  {
+    return frames_ - used( writePosition_.load( std::memory_order_relaxed ), readPosition_.load( std::memory_order_acquire ) );
+  }
+
+  // Copies up to nFrames frames into the buffer and returns the number copied.
+  unsigned int write( const char *buffer, unsigned int nFrames )
+  {
+    unsigned int position = writePosition_.load( std::memory_order_relaxed );
+    nFrames = std::min( nFrames, writeAvailable() );
+    copy( &data_[0], index( position ), buffer, 0, nFrames, true );
+    writePosition_.store( advance( position, nFrames ), std::memory_order_release );
+    return nFrames;
+  }
+
+  // Copies up to nFrames frames out of the buffer and returns the number copied.
+  unsigned int read( char *buffer, unsigned int nFrames )
+  {
+    unsigned int position = readPosition_.load( std::memory_order_relaxed );
+    nFrames = std::min( nFrames, readAvailable() );
+    copy( buffer, 0, &data_[0], index( position ), nFrames, false );
+    readPosition_.store( advance( position, nFrames ), std::memory_order_release );
+    return nFrames;
+  }
+
+private:
+  unsigned int used( unsigned int write, unsigned int read ) const
+  {
+    return ( write >= read ) ? write - read : write + 2 * frames_ - read;
+  }
+
+  unsigned int advance( unsigned int position, unsigned int nFrames ) const
+  {
+    position += nFrames;
+    return ( position >= 2 * frames_ ) ? position - 2 * frames_ : position;
+  }
+
+  unsigned int index( unsigned int position ) const
+  {
+    return ( position >= frames_ ) ? position - frames_ : position;
+  }
+
+  // Copies nFrames frames, wrapping around the end of the ring (which
+  // is the destination when toRing is true, or else the source).
+  void copy( char *out, unsigned int outFrame, const char *in, unsigned int inFrame,
+             unsigned int nFrames, bool toRing )
+  {
+    unsigned int ringFrame = toRing ? outFrame : inFrame;
+    unsigned int first = std::min( nFrames, frames_ - ringFrame );
+    memcpy( out + (size_t) outFrame * frameBytes_, in + (size_t) inFrame * frameBytes_, (size_t) first * frameBytes_ );
+    if ( first < nFrames ) {
+      if ( toRing ) { out = &data_[0]; outFrame = 0; inFrame += first; }
+      else { in = &data_[0]; inFrame = 0; outFrame += first; }
+      memcpy( out + (size_t) outFrame * frameBytes_, in + (size_t) inFrame * frameBytes_, (size_t) ( nFrames - first ) * frameBytes_ );
+    }
+  }
+
+  std::vector<char> data_;
+  unsigned int frames_;
+  unsigned int frameBytes_;
+  std::atomic<unsigned int> readPosition_;
+  std::atomic<unsigned int> writePosition_;
+};
+
+// A resampler of interleaved FLOAT32 frames with a variable ratio of
+// output to input rates.  Each output frame is filtered from the input
+// with a Kaiser-windowed sinc, tabulated at PHASES fractional positions
+// and interpolated linearly between them, so that the ratio can follow
+// a drifting clock.  The filter is widened when the nominal ratio is
+// below one, to keep its cutoff under the output Nyquist frequency.
+// Input is written and output read by the same thread, and neither
+// allocates memory.
+class RtApi::Resampler
+{
+public:
+  static const unsigned int PHASES = 256;
+
+  Resampler( unsigned int channels, double ratio, unsigned int maxInputFrames )
+    : channels_( channels ), frames_( 0 ), position_( 0 )
+  {
+    double cutoff = 0.45 * std::min( ratio, 1.0 ); // Cycles per input sample.
+    taps_ = 32;
+    if ( ratio < 1.0 ) taps_ = ( (unsigned int) std::ceil( 32 / ratio ) + 3 ) & ~3u;
+    half_ = taps_ / 2;
+    filter_.resize( ( PHASES + 1 ) * taps_ );
+    coefficients_.resize( taps_ );
+    buffer_.resize( (size_t) ( maxInputFrames + taps_ ) * channels_ );
+    capacity_ = maxInputFrames + taps_;
+
+    const double pi = 3.14159265358979323846;
+    const double beta = 8.0;
+    for ( unsigned int p=0; p<=PHASES; p++ ) {
+      float *h = &filter_[ p * taps_ ];
+      double sum = 0.0;
+      for ( unsigned int j=0; j<taps_; j++ ) {
+        // Distance of the tap from the output position, in input samples.
+        double d = (double) j - ( half_ - 1 ) - (double) p / PHASES;
+        double x = 2.0 * pi * cutoff * d;
+        double sinc = ( d == 0.0 ) ? 1.0 : std::sin( x ) / x;
+        double w = d / half_;
+        w = ( w * w < 1.0 ) ? besselI0( beta * std::sqrt( 1.0 - w * w ) ) / besselI0( beta ) : 0.0;
+        h[j] = (float) ( sinc * w );
+        sum += h[j];
+      }
+      for ( unsigned int j=0; j<taps_; j++ ) h[j] = (float) ( h[j] / sum );
+    }
+
+    setRatio( ratio );
+    reset();
+  }
+
+  // Ratio of the output to the input sample rate.
+  void setRatio( double ratio ) { step_ = 1.0 / ratio; }
+
+  // Input frames by which the output is delayed.
+  unsigned int latency( void ) const { return half_; }
+
+  // Input frames written and not yet passed by the output position.
+  double bufferedFrames( void ) const { return frames_ - position_; }
+
+  unsigned int writeAvailable( void ) const { return capacity_ - frames_; }
+
+  // Drops up to nFrames of the buffered input.
+  void skip( double nFrames ) { position_ += std::min( nFrames, bufferedFrames() ); }
+
+  // Empties the buffer, leaving the silent history of the filter.
+  void reset( void )
+  {
+    frames_ = half_ - 1;
+    position_ = frames_;
+    std::fill( buffer_.begin(), buffer_.begin() + (size_t) frames_ * channels_, 0.0f );
+  }
+
+  // Appends up to nFrames input frames and returns the number taken.
+  unsigned int write( const float *buffer, unsigned int nFrames )
+  {
+    nFrames = std::min( nFrames, writeAvailable() );
+    memcpy( &buffer_[ (size_t) frames_ * channels_ ], buffer, (size_t) nFrames * channels_ * sizeof( float ) );
+    frames_ += nFrames;
+    return nFrames;
+  }
+
+  // Produces up to nFrames output frames from the buffered input and
+  // returns the number produced.
+  unsigned int read( float *buffer, unsigned int nFrames )
+  {
+    unsigned int produced;
+    if ( channels_ == 1 ) produced = filter<1>( buffer, nFrames );
+    else if ( channels_ == 2 ) produced = filter<2>( buffer, nFrames );
+    else produced = filter<0>( buffer, nFrames );
+
+    // Discard the input that the filter no longer reaches.
+    unsigned int used = (unsigned int) position_;
+    if ( used >= half_ ) {
+      used = std::min( used - ( half_ - 1 ), frames_ );
+      memmove( &buffer_[0], &buffer_[ (size_t) used * channels_ ], (size_t) ( frames_ - used ) * channels_ * sizeof( float ) );
+      frames_ -= used;
+      position_ -= used;
+    }
+    return produced;
+  }
+
+private:
+  // The channel loops are unrolled for mono and stereo.  The filter
+  // coefficients of each frame are interpolated first, so that both
+  // loops run over contiguous memory and can be vectorized.
+  template <unsigned int CHANNELS>
+  unsigned int filter( float *out, unsigned int nFrames )
+  {
+    const unsigned int channels = CHANNELS ? CHANNELS : channels_;
+    float *h = &coefficients_[0];
+    unsigned int produced = 0;
+    while ( produced < nFrames ) {
+      unsigned int base = (unsigned int) position_;
+      if ( base + half_ >= frames_ ) break;
+      double phase = ( position_ - base ) * PHASES;
+      unsigned int p = (unsigned int) phase;
+      float fraction = (float) ( phase - p );
+      const float *h0 = &filter_[ p * taps_ ];
+      const float *h1 = h0 + taps_;
+      for ( unsigned int j=0; j<taps_; j++ )
+        h[j] = h0[j] + fraction * ( h1[j] - h0[j] );
+
+      const float *in = &buffer_[ (size_t) ( base + 1 - half_ ) * channels ];
+      float *frame = out + (size_t) produced * channels;
+      for ( unsigned int c=0; c<channels; c++ ) frame[c] = 0.0f;
+      for ( unsigned int j=0; j<taps_; j++ ) {
+        const float *x = in + (size_t) j * channels;
+        for ( unsigned int c=0; c<channels; c++ )
+          frame[c] += h[j] * x[c];
+      }
+      position_ += step_;
+      produced++;
+    }
+    return produced;
+  }
+
+  static double besselI0( double x )
+  {
+    double sum = 1.0, term = 1.0;
+    for ( int k=1; k<32; k++ ) {
+      term *= ( x / ( 2 * k ) ) * ( x / ( 2 * k ) );
+      sum += term;
+    }
+    return sum;
+  }
+
+  unsigned int channels_;
+  unsigned int taps_, half_;
+  unsigned int capacity_, frames_;
+  double position_; // Output position, in input frames from the start of the buffer.
+  double step_;
+  std::vector<float> filter_;
+  std::vector<float> coefficients_;
+  std::vector<float> buffer_;
+};
+
+// A second-order delay-locked loop that steers the ratio of a
+// Resampler so that a buffer level, measured once per update, settles
+// on a target.  The level error is in frames of the buffer, through
+// which `frames` frames flow per update, and the returned correction
+// is relative to the nominal ratio.  The integrator holds the
+// correction needed in the steady state, which is the relative drift
+// between the two clocks.
+class RtApi::DriftLoop
+{
+public:
+  DriftLoop() : b_( 0 ), c_( 0 ), frames_( 1 ), integral_( 0 ) {}
+
+  // Sets the loop bandwidth, in Hz, for the given number of updates
+  // per second.
+  void setup( double frames, double updateRate, double bandwidth = 0.05 )
+  {
+    double omega = 2.0 * 3.14159265358979323846 * bandwidth / updateRate;
+    b_ = std::sqrt( 2.0 ) * omega;
+    c_ = omega * omega;
+    frames_ = frames;
+    integral_ = 0;
+  }
+
+  // Takes the difference between the measured and the target level and
+  // returns the ratio correction, which is negative when the buffer
+  // holds too much.
+  double update( double error )
+  {
+    integral_ = clamp( integral_ + c_ * error / frames_ );
+    return -clamp( b_ * error / frames_ + integral_ );
+  }
+
+  // Estimated relative drift, positive when the ratio had to be raised.
+  double drift( void ) const { return -integral_; }
+
+private:
+  // Corrections are limited to 0.5%, well beyond the tolerance of audio clocks.
+  static double clamp( double value ) { return std::max( -0.005, std::min( value, 0.005 ) ); }
+
+  double b_, c_;
+  double frames_;
+  double integral_;
+};
+
+// The input stage of a stream opened with RTAUDIO_DRIFT_COMPENSATION.
+// Periods read from the input device are converted to FLOAT32 in the
+// user channel layout and buffered in the resampler, from which each
+// callback takes one period, converted to the user format.
+struct RtApi::DriftCompensation {
+  ConvertInfo toFloat, fromFloat;
+  Resampler resampler;
+  DriftLoop loop;
+  std::vector<float> buffer[2]; // Resampler input and output periods.
+  double target;                // Buffered input level steered to, in frames.
+  unsigned int driftIndex;
+  bool running;                 // Primed with enough input.
+
+  DriftCompensation( unsigned int channels, unsigned int capacity )
+    : resampler( channels, 1.0, capacity ), target( 0 ), driftIndex( 0 ), running( false ) {}
+};
+
+// The sample rate conversion of a stream opened with
+// RTAUDIO_CONVERT_SAMPLE_RATE on a device running at another rate.  The
+// backend passes its periods to rateConversionCallback(), which
+// resamples them, as FLOAT32 frames in the user channel layout, to and
+// from periods of the requested size for the user callback.
+struct RtApi::RateConversion {
+  unsigned int sampleRate;        // Requested rate and period of the user callback.
+  unsigned int bufferFrames;
+  RtAudioCallback callback;
+  void *userData;
+  ConvertInfo toFloat[2], fromFloat[2];
+  Resampler *resampler[2];        // Playback and record, respectively.
+  std::vector<float> userFloat[2], deviceFloat[2];
+  std::vector<char> userBuffer[2];
+  unsigned int inputFrames;       // Input resampled for the next user callback.
+  RtAudioStreamStatus status;     // Collected for the next user callback.
+
+  RateConversion( unsigned int rate, unsigned int frames )
+    : sampleRate( rate ), bufferFrames( frames ), callback( 0 ), userData( 0 ), inputFrames( 0 ), status( 0 )
+  { resampler[0] = 0; resampler[1] = 0; }
+  ~RateConversion() { delete resampler[0]; delete resampler[1]; }
+};
+
+// The user callback of a stream opened with an RtAudioPlanarCallback.
+// The backend passes non-interleaved FLOAT32 periods to
+// planarCallback(), which points the channel arrays, sized when the
+// stream is opened, at the channels of each period.  Backends that
+// have a buffer per channel may fill the arrays with their own
+// buffers and invoke the user callback directly instead.
+struct RtApi::PlanarCallback {
+  RtAudioPlanarCallback callback;
+  void *userData;
+  std::vector<float *> channels[2]; // Playback and record, respectively.
+
+  PlanarCallback( RtAudioPlanarCallback function, void *data )
+    : callback( function ), userData( data ) {}
+};
+
 RtApi :: RtApi()
 {
   clearStreamInfo();
   MUTEX_INITIALIZE( &stream_.mutex );
+  MUTEX_INITIALIZE( &stream_.processMutex );
   errorCallback_ = 0;
   showWarnings_ = true;
   currentDeviceId_ = 129;
@@ -677,6 +1301,7 @@ RtApi :: RtApi()
 RtApi :: ~RtApi()
 {
   MUTEX_DESTROY( &stream_.mutex );
+  MUTEX_DESTROY( &stream_.processMutex );
 }
 
 RtAudioErrorType RtApi :: openStream( RtAudio::StreamParameters *oParams,
@@ -714,6 +1339,25 @@ RtAudioErrorType RtApi :: openStream( RtAudio::StreamParameters *oParams,
     return error( RTAUDIO_INVALID_PARAMETER );
   }
 
+  if ( callback == NULL && options && options->flags & RTAUDIO_NONINTERLEAVED ) {
+    errorText_ = "RtApi::openStream: the RTAUDIO_NONINTERLEAVED flag cannot be used without a callback function.";
+    return error( RTAUDIO_INVALID_PARAMETER );
+  }
+
+  if ( options && options->flags & RTAUDIO_SCHEDULE_REALTIME &&
+       options->schedulingPolicy == RtAudio::SCHEDULE_DEADLINE ) {
+    // The kernel refuses SCHED_DEADLINE for threads whose affinity
+    // does not span their whole root domain.
+    if ( !options->cpuAffinity.empty() ) {
+      errorText_ = "RtApi::openStream: deadline scheduling cannot be combined with a CPU affinity.";
+      return error( RTAUDIO_INVALID_PARAMETER );
+    }
+    if ( !( options->deadlineRuntime > 0.0 && options->deadlineRuntime <= 1.0 ) ) {
+      errorText_ = "RtApi::openStream: the deadline runtime must be a fraction of the buffer period between zero and one.";
+      return error( RTAUDIO_INVALID_PARAMETER );
+    }
+  }
+
   // Scan devices if none currently listed.
   if ( deviceList_.size() == 0 ) probeDevices();
   
@@ -754,20 +1398,103 @@ RtAudioErrorType RtApi :: openStream( RtAudio::StreamParameters *oParams,
 
   if ( iChannels > 0 ) {
 
+    // A converted output has already chosen the device rate.
+    unsigned int rate = stream_.rateConversion ? stream_.sampleRate : sampleRate;
     result = probeDeviceOpen( iParams->deviceId, INPUT, iChannels, iParams->firstChannel,
-                              sampleRate, format, bufferFrames, options );
+                              rate, format, bufferFrames, options );
     if ( result == false )
       return error( RTAUDIO_SYSTEM_ERROR );
   }
 
+  // The callback of a converted stream keeps the requested buffer size,
+  // or a period of the same duration as the device's.
+  unsigned int userFrames = stream_.bufferSize;
+  RateConversion *conversion = stream_.rateConversion;
+  if ( conversion ) {
+    if ( conversion->bufferFrames == 0 )
+      conversion->bufferFrames = std::max( 1u, (unsigned int) std::lround( (double) stream_.bufferSize * sampleRate / stream_.sampleRate ) );
+    userFrames = conversion->bufferFrames;
+  }
+
+  stream_.stats.enabled = ( options && options->flags & RTAUDIO_COLLECT_STATS );
+
+  // In duplex mode, the device buffer is shared by both directions.
+  ConvertInfo &outInfo = stream_.convertInfo[OUTPUT];
+  outInfo.clearOutput = ( stream_.mode == DUPLEX && stream_.doConvertBuffer[OUTPUT] &&
+                          outInfo.outJump > outInfo.inJump );
+
+  // Without a callback, the stream exchanges data with the
+  // writeFrames() and readFrames() functions through ring buffers.
+  if ( callback == NULL ) {
+    unsigned int ringFrames = 4 * userFrames;
+    if ( options && options->ringBufferFrames > 0 ) ringFrames = options->ringBufferFrames;
+    if ( ringFrames < userFrames ) ringFrames = userFrames;
+    for ( int i=0; i<2; i++ ) {
+      if ( stream_.nUserChannels[i] > 0 )
+        stream_.ringBuffer[i] = new RingBuffer( ringFrames, stream_.nUserChannels[i] * formatBytes( format ) );
+    }
+    if ( options ) options->ringBufferFrames = ringFrames;
+    callback = ringBufferCallback;
+    userData = this;
+  }
+
+  if ( conversion ) {
+    setupRateConversion( callback, userData );
+    *bufferFrames = userFrames;
+    callback = rateConversionCallback;
+    userData = this;
+  }
+
   stream_.callbackInfo.callback = (void *) callback;
   stream_.callbackInfo.userData = userData;
 
+  // Buffers are prefaulted once both directions are open, since the
+  // callback thread may start before the second one.
+  if ( options && options->lockMemory ) prefaultStreamBuffers();
+
+  // Streams driven by processOnce() run their callback on a thread of
+  // the application, which RtAudio does not configure.
+  if ( stream_.external && ( options->flags & RTAUDIO_SCHEDULE_REALTIME ||
+                             !options->cpuAffinity.empty() || options->lockMemory ) ) {
+    errorText_ = "RtApi::openStream: the realtime scheduling, CPU affinity and memory locking options are not applied to the thread calling processOnce().";
+    error( RTAUDIO_WARNING );
+  }
+
   if ( options ) options->numberOfBuffers = stream_.nBuffers;
   stream_.state = STREAM_STOPPED;
   return RTAUDIO_NO_ERROR;
 }
 
+RtAudioErrorType RtApi :: openStream( RtAudio::StreamParameters *oParams,
+                                      RtAudio::StreamParameters *iParams,
+                                      unsigned int sampleRate, unsigned int *bufferFrames,
+                                      RtAudioPlanarCallback callback, void *userData,
+                                      RtAudio::StreamOptions *options )
+{
+  if ( callback == NULL ) {
+    errorText_ = "RtApi::openStream: a planar callback function cannot be NULL.";
+    return error( RTAUDIO_INVALID_PARAMETER );
+  }
+
+  // Open a non-interleaved FLOAT32 stream with a callback that passes
+  // its channels on, and then return the options as updated.
+  RtAudio::StreamOptions planarOptions;
+  if ( options ) planarOptions = *options;
+  planarOptions.flags |= RTAUDIO_NONINTERLEAVED;
+  RtAudioErrorType result = openStream( oParams, iParams, RTAUDIO_FLOAT32, sampleRate,
+                                        bufferFrames, planarCallback, this, &planarOptions );
+  if ( options ) {
+    planarOptions.flags = options->flags;
+    *options = planarOptions;
+  }
+  if ( result != RTAUDIO_NO_ERROR ) return result;
+
+  stream_.planar = new PlanarCallback( callback, userData );
+  for ( int i=0; i<2; i++ )
+    stream_.planar->channels[i].resize( stream_.nUserChannels[i] );
+  return RTAUDIO_NO_ERROR;
+}
+
 void RtApi :: probeDevices( void )
 {
   // This function MUST be implemented in all subclasses! Within each
@@ -868,8 +1595,10 @@ RtAudio::DeviceInfo RtApi :: getDeviceInfo( unsigned int deviceId )
 {
   if ( deviceList_.size() == 0 ) probeDevices();
   for ( unsigned int m=0; m<deviceList_.size(); m++ ) {
-    if ( deviceList_[m].ID == deviceId )
+    if ( deviceList_[m].ID == deviceId ) {
+      probeDeviceCapabilities( deviceList_[m] );
       return deviceList_[m];
+    }
   }
 
   errorText_ = "RtApi::getDeviceInfo: deviceId argument not found.";
@@ -892,6 +1621,27 @@ bool RtApi :: probeDeviceOpen( unsigned int /*deviceId*/, StreamMode /*mode*/, u
   return FAILURE;
 }
 
+// Helpers for the statistics and the stream clock, which only the audio thread updates.
+static long long monotonicNanos( void )
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+template <typename Stats>
+static unsigned int beginStatsUpdate( Stats &stats )
+{
+  unsigned int sequence = stats.sequence.load( std::memory_order_relaxed );
+  stats.sequence.store( sequence + 1, std::memory_order_relaxed );
+  std::atomic_thread_fence( std::memory_order_release );
+  return sequence;
+}
+
+template <typename Stats>
+static void endStatsUpdate( Stats &stats, unsigned int sequence )
+{
+  stats.sequence.store( sequence + 2, std::memory_order_release );
+}
+
 void RtApi :: tickStreamTime( void )
 {
   // Subclasses that do not provide their own implementation of
@@ -899,6 +1649,7 @@ void RtApi :: tickStreamTime( void )
   // provide basic stream time support.
 
   stream_.streamTime += ( stream_.bufferSize * 1.0 / stream_.sampleRate );
+  stream_.framePosition += stream_.bufferSize;
 
   /*
 #if defined( HAVE_GETTIMEOFDAY )
@@ -915,6 +1666,10 @@ long RtApi :: getStreamLatency( void )
   if ( stream_.mode == INPUT || stream_.mode == DUPLEX )
     totalLatency += stream_.latency[1];
 
+  // Report frames at the rate of the callback.
+  if ( stream_.rateConversion )
+    totalLatency = (long) ( (double) totalLatency * stream_.rateConversion->sampleRate / stream_.sampleRate );
+
   return totalLatency;
 }
 
@@ -943,8 +1698,10 @@ double RtApi :: getStreamTime( void )
 
 void RtApi :: setStreamTime( double time )
 {
-  if ( time >= 0.0 )
+  if ( time >= 0.0 ) {
     stream_.streamTime = time;
+    stream_.framePosition = (unsigned long long) ( time * stream_.sampleRate + 0.5 );
+  }
   /*
 #if defined( HAVE_GETTIMEOFDAY )
   gettimeofday( &stream_.lastTickTimestamp, NULL );
@@ -954,18 +1711,289 @@ void RtApi :: setStreamTime( double time )
 
 unsigned int RtApi :: getStreamSampleRate( void )
 {
-  if ( isStreamOpen() ) return stream_.sampleRate;
-  else return 0;
+  if ( !isStreamOpen() ) return 0;
+  if ( stream_.rateConversion ) return stream_.rateConversion->sampleRate;
+  return stream_.sampleRate;
 }
 
+unsigned int RtApi :: writeFrames( const void *buffer, unsigned int frames, bool wait )
+{
+  RingBuffer *ring = stream_.ringBuffer[OUTPUT];
+  if ( ring == 0 ) {
+    errorText_ = "RtApi::writeFrames: no output stream was opened without a callback function!";
+    error( RTAUDIO_INVALID_USE );
+    return 0;
+  }
 
-// *************************************************** //
-//
-// OS/API-specific methods.
-//
-// *************************************************** //
+  const char *data = (const char *) buffer;
+  unsigned int written = ring->write( data, frames );
+  while ( wait && written < frames && stream_.state == STREAM_RUNNING ) {
+    waitForRingBuffer();
+    written += ring->write( data + (size_t) written * ring->frameBytes(), frames - written );
+  }
 
-#if defined(__MACOSX_CORE__)
+  return written;
+}
+
+unsigned int RtApi :: readFrames( void *buffer, unsigned int frames, bool wait )
+{
+  RingBuffer *ring = stream_.ringBuffer[INPUT];
+  if ( ring == 0 ) {
+    errorText_ = "RtApi::readFrames: no input stream was opened without a callback function!";
+    error( RTAUDIO_INVALID_USE );
+    return 0;
+  }
+
+  char *data = (char *) buffer;
+  unsigned int nRead = ring->read( data, frames );
+  while ( wait && nRead < frames && stream_.state == STREAM_RUNNING ) {
+    waitForRingBuffer();
+    nRead += ring->read( data + (size_t) nRead * ring->frameBytes(), frames - nRead );
+  }
+
+  return nRead;
+}
+
+unsigned int RtApi :: getWriteAvailable( void )
+{
+  if ( stream_.ringBuffer[OUTPUT] ) return stream_.ringBuffer[OUTPUT]->writeAvailable();
+  return 0;
+}
+
+unsigned int RtApi :: getReadAvailable( void )
+{
+  if ( stream_.ringBuffer[INPUT] ) return stream_.ringBuffer[INPUT]->readAvailable();
+  return 0;
+}
+
+RtAudioStreamStatus RtApi :: getStreamStatus( void )
+{
+  return stream_.ringStatus.exchange( 0 );
+}
+
+RtAudio::StreamStats RtApi :: getStreamStats( void )
+{
+  // Retry until a copy is taken while the audio thread isn't writing.
+  const StatsData &data = stream_.stats;
+  RtAudio::StreamStats stats;
+  unsigned long long callbackTime, wakeups, jitter, converts, convertTime;
+  unsigned int sequence;
+  do {
+    sequence = data.sequence.load( std::memory_order_acquire );
+    stats.callbacks = data.callbacks.load( std::memory_order_relaxed );
+    for ( unsigned int i=0; i<RtAudio::StreamStats::HISTOGRAM_BINS; i++ )
+      stats.durationHistogram[i] = data.histogram[i].load( std::memory_order_relaxed );
+    callbackTime = data.callbackTime.load( std::memory_order_relaxed );
+    stats.maxCallbackTime = data.maxCallbackTime.load( std::memory_order_relaxed ) * 1e-9;
+    wakeups = data.wakeups.load( std::memory_order_relaxed );
+    jitter = data.jitter.load( std::memory_order_relaxed );
+    stats.maxWakeupJitter = data.maxJitter.load( std::memory_order_relaxed ) * 1e-9;
+    converts = data.converts.load( std::memory_order_relaxed );
+    convertTime = data.convertTime.load( std::memory_order_relaxed );
+    stats.maxConvertTime = data.maxConvertTime.load( std::memory_order_relaxed ) * 1e-9;
+    stats.outputUnderflows = data.xruns[0].load( std::memory_order_relaxed );
+    stats.inputOverflows = data.xruns[1].load( std::memory_order_relaxed );
+    stats.mutexBlockedTime = data.mutexTime.load( std::memory_order_relaxed ) * 1e-9;
+    std::atomic_thread_fence( std::memory_order_acquire );
+  } while ( ( sequence & 1 ) || sequence != data.sequence.load( std::memory_order_relaxed ) );
+
+  if ( stats.callbacks ) stats.meanCallbackTime = callbackTime * 1e-9 / stats.callbacks;
+  if ( wakeups ) stats.meanWakeupJitter = jitter * 1e-9 / wakeups;
+  if ( converts ) stats.meanConvertTime = convertTime * 1e-9 / converts;
+
+  stats.driftDevices = data.nDrift;
+  for ( unsigned int i=0; i<data.nDrift; i++ )
+    stats.drift[i] = data.drift[i].load( std::memory_order_relaxed );
+  return stats;
+}
+
+void RtApi :: resetStreamStats( void )
+{
+  // A running stream clears its statistics at its next callback.
+  // Otherwise, the audio thread may still record the time it waits
+  // for the stream mutex, which it only does while holding the mutex.
+  if ( stream_.state == STREAM_RUNNING ) {
+    stream_.stats.resetRequested = true;
+    return;
+  }
+
+  MUTEX_LOCK( &stream_.mutex );
+  clearStreamStats();
+  MUTEX_UNLOCK( &stream_.mutex );
+}
+
+void RtApi :: publishStreamClock( void )
+{
+  // Times not given by the backend are estimated from the current
+  // time and the latency of the stream.  Those given update the device
+  // latency reported by getStreamLatency().
+  ClockData &clock = stream_.clock;
+  long long now = monotonicNanos();
+  double nanosPerFrame = 1e9 / stream_.sampleRate;
+  double userNanosPerFrame = 1e9 / getStreamSampleRate();
+  long long time[2] = { 0, 0 };
+  long long latency[2] = { 0, 0 };
+  bool timestamped[2] = { false, false };
+  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+    timestamped[0] = clock.pending[0] != 0;
+    if ( timestamped[0] ) {
+      time[0] = clock.pending[0];
+      stream_.latency[0] = (unsigned long) std::max( ( time[0] - now ) / nanosPerFrame, 0.0 );
+    }
+    else
+      time[0] = now + (long long) ( stream_.latency[0] * nanosPerFrame );
+
+    // The output of the callback follows that buffered for the device
+    // rate, and the output of writeFrames() that queued in the ring.
+    if ( stream_.rateConversion )
+      time[0] += (long long) ( stream_.rateConversion->resampler[OUTPUT]->bufferedFrames() * userNanosPerFrame );
+    latency[0] = time[0] - now;
+    if ( stream_.ringBuffer[OUTPUT] )
+      latency[0] += (long long) ( stream_.ringBuffer[OUTPUT]->readAvailable() * userNanosPerFrame );
+  }
+  if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+    timestamped[1] = clock.pending[1] != 0;
+    if ( timestamped[1] ) {
+      time[1] = clock.pending[1];
+      stream_.latency[1] = (unsigned long) std::max( ( now - time[1] ) / nanosPerFrame - stream_.bufferSize, 0.0 );
+    }
+    else {
+      double frames = stream_.bufferSize + stream_.latency[1];
+      if ( stream_.driftCompensation ) frames += stream_.driftCompensation->resampler.bufferedFrames();
+      time[1] = now - (long long) ( frames * nanosPerFrame );
+    }
+
+    // Likewise, the input of the callback is preceded by that buffered
+    // for the callback rate, and the input of readFrames() by that
+    // waiting in the ring.
+    if ( stream_.rateConversion )
+      time[1] -= (long long) ( stream_.rateConversion->resampler[INPUT]->bufferedFrames() * nanosPerFrame );
+    latency[1] = now - time[1];
+    if ( stream_.ringBuffer[INPUT] )
+      latency[1] += (long long) ( stream_.ringBuffer[INPUT]->readAvailable() * userNanosPerFrame );
+  }
+  clock.pending[0] = clock.pending[1] = 0;
+
+  // Count frames at the rate of the callback.
+  unsigned long long position = stream_.framePosition;
+  if ( stream_.rateConversion )
+    position = (unsigned long long) ( (double) position * stream_.rateConversion->sampleRate / stream_.sampleRate + 0.5 );
+
+  unsigned int sequence = beginStatsUpdate( clock );
+  clock.published.store( true, std::memory_order_relaxed );
+  clock.framePosition.store( position, std::memory_order_relaxed );
+  for ( int i=0; i<2; i++ ) {
+    clock.time[i].store( time[i], std::memory_order_relaxed );
+    clock.timestamped[i].store( timestamped[i], std::memory_order_relaxed );
+    clock.latency[i].store( latency[i], std::memory_order_relaxed );
+  }
+  endStatsUpdate( clock, sequence );
+}
+
+RtAudio::StreamLatency RtApi :: getStreamLatencies( void )
+{
+  RtAudio::StreamLatency latency;
+  if ( !isStreamOpen() ) return latency;
+
+  const ClockData &data = stream_.clock;
+  long long nanos[2];
+  bool published;
+  unsigned int sequence;
+  do {
+    sequence = data.sequence.load( std::memory_order_acquire );
+    published = data.published.load( std::memory_order_relaxed );
+    nanos[0] = data.latency[0].load( std::memory_order_relaxed );
+    nanos[1] = data.latency[1].load( std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_acquire );
+  } while ( ( sequence & 1 ) || sequence != data.sequence.load( std::memory_order_relaxed ) );
+
+  // Until the first period, estimate the latencies from the buffering
+  // reported by the backend.
+  if ( !published ) {
+    double nanosPerFrame = 1e9 / stream_.sampleRate;
+    if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX )
+      nanos[0] = (long long) ( stream_.latency[0] * nanosPerFrame );
+    if ( stream_.mode == INPUT || stream_.mode == DUPLEX )
+      nanos[1] = (long long) ( ( stream_.bufferSize + stream_.latency[1] ) * nanosPerFrame );
+  }
+
+  double framesPerNano = getStreamSampleRate() * 1e-9;
+  latency.outputNanos = nanos[0];
+  latency.inputNanos = nanos[1];
+  latency.roundTripNanos = nanos[0] + nanos[1];
+  latency.outputFrames = (unsigned long) ( std::max( nanos[0], 0LL ) * framesPerNano + 0.5 );
+  latency.inputFrames = (unsigned long) ( std::max( nanos[1], 0LL ) * framesPerNano + 0.5 );
+  latency.roundTripFrames = (unsigned long) ( std::max( nanos[0] + nanos[1], 0LL ) * framesPerNano + 0.5 );
+  return latency;
+}
+
+RtAudio::StreamClock RtApi :: getStreamClock( void )
+{
+  // Retry until a copy is taken while the audio thread isn't writing.
+  const ClockData &data = stream_.clock;
+  RtAudio::StreamClock clock;
+  unsigned int sequence;
+  do {
+    sequence = data.sequence.load( std::memory_order_acquire );
+    clock.framePosition = data.framePosition.load( std::memory_order_relaxed );
+    clock.outputTime = data.time[0].load( std::memory_order_relaxed );
+    clock.inputTime = data.time[1].load( std::memory_order_relaxed );
+    clock.outputTimestamped = data.timestamped[0].load( std::memory_order_relaxed );
+    clock.inputTimestamped = data.timestamped[1].load( std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_acquire );
+  } while ( ( sequence & 1 ) || sequence != data.sequence.load( std::memory_order_relaxed ) );
+  return clock;
+}
+
+int RtApi :: processOnce( int timeout )
+{
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApi::processOnce(): no open stream to process!";
+    error( RTAUDIO_WARNING );
+    return -1;
+  }
+  if ( !stream_.external ) {
+    errorText_ = "RtApi::processOnce(): the stream was not opened with the RTAUDIO_EXTERNAL_THREAD flag!";
+    error( RTAUDIO_INVALID_USE );
+    return -1;
+  }
+
+  // The mutex keeps stopStream() and closeStream() from another
+  // thread out until the period is done.
+  MUTEX_LOCK( &stream_.processMutex );
+  stream_.processThread.store( std::this_thread::get_id() );
+  int periods = processExternal( timeout );
+  stream_.processThread.store( std::thread::id() );
+  MUTEX_UNLOCK( &stream_.processMutex );
+  return periods;
+}
+
+void RtApi :: shareDevices( RtApi *source )
+{
+  // Streams of one RtAudio instance use the devices probed by the
+  // first, so that they agree on device IDs.
+  if ( source->deviceList_.size() == 0 ) source->probeDevices();
+  deviceList_ = source->deviceList_;
+  currentDeviceId_ = source->currentDeviceId_;
+  copyDevices( source );
+  errorCallback_ = source->errorCallback_;
+  showWarnings_ = source->showWarnings_;
+}
+
+RtAudioErrorType RtApi :: reportError( RtAudioErrorType type, const std::string &message )
+{
+  errorText_ = message;
+  return error( type );
+}
+
+
+// *************************************************** //
+//
+// OS/API-specific methods.
+//
+// *************************************************** //
+
+#if defined(__MACOSX_CORE__)
 
 #include <unistd.h>
 
@@ -2247,8 +3275,10 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
       handle->xrun[1] = false;
     }
 
+    beginCallback();
     int cbReturnValue = callback( stream_.userBuffer[0], stream_.userBuffer[1],
                                   stream_.bufferSize, streamTime, status, info->userData );
+    endCallback( status );
     if ( cbReturnValue == 2 ) {
       abortStream();
       return SUCCESS;
@@ -2847,7 +3877,7 @@ bool RtApiJack :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
 
   // Check the jack server sample rate.
   unsigned int jackRate = jack_get_sample_rate( client );
-  if ( sampleRate != jackRate ) {
+  if ( sampleRate != jackRate && !convertStreamRate( sampleRate, jackRate, bufferSize, options ) ) {
     jack_client_close( client );
     errorStream_ << "RtApiJack::probeDeviceOpen: the requested sample rate (" << sampleRate << ") is different than the JACK server rate (" << jackRate << ").";
     errorText_ = errorStream_.str();
@@ -3087,6 +4117,8 @@ RtAudioErrorType RtApiJack :: startStream( void )
     return error( RTAUDIO_WARNING );
   }
 
+  if ( stream_.rateConversion ) resetRateConversion();
+
   /*
   #if defined( HAVE_GETTIMEOFDAY )
   gettimeofday( &stream_.lastTickTimestamp, NULL );
@@ -3227,6 +4259,10 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
   CallbackInfo *info = (CallbackInfo *) &stream_.callbackInfo;
   JackHandle *handle = (JackHandle *) stream_.apiHandle;
 
+  // A planar callback is given the port buffers themselves, unless
+  // its periods are resampled.
+  PlanarCallback *planar = stream_.rateConversion ? NULL : stream_.planar;
+
   // Check if we were draining the stream and signal is finished.
   if ( handle->drainCounter > 3 ) {
     ThreadHandle threadId;
@@ -3252,8 +4288,47 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
       status |= RTAUDIO_INPUT_OVERFLOW;
       handle->xrun[1] = false;
     }
-    int cbReturnValue = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                                  stream_.bufferSize, streamTime, status, info->userData );
+
+    // Follow the latencies of the ports, which change with the graph.
+    for ( int i=0; i<2; i++ ) {
+      if ( handle->ports[i] == 0 || handle->ports[i][0] == 0 ) continue;
+      jack_latency_range_t range;
+      jack_port_get_latency_range( handle->ports[i][0], ( i == OUTPUT ) ? JackPlaybackLatency : JackCaptureLatency, &range );
+      stream_.latency[i] = range.min;
+    }
+
+    // Timestamp the period from the JACK cycle times.  Output is played
+    // from the start of the next cycle, and input was captured during
+    // the previous cycle (or the one before, for input that was copied
+    // to the user buffer then).  JACK times are converted to the
+    // monotonic clock.
+    jack_nframes_t cycleFrames;
+    jack_time_t currentTime, nextTime;
+    float periodTime;
+    if ( jack_get_cycle_times( handle->client, &cycleFrames, &currentTime, &nextTime, &periodTime ) == 0 ) {
+      long long offset = monotonicNanos() - (long long) jack_get_time() * 1000;
+      double nanosPerFrame = 1e9 / stream_.sampleRate;
+      if ( stream_.mode != INPUT )
+        setStreamClock( OUTPUT, offset + (long long) nextTime * 1000 + (long long) ( stream_.latency[0] * nanosPerFrame ) );
+      if ( stream_.mode != OUTPUT )
+        setStreamClock( INPUT, offset + (long long) currentTime * 1000 - (long long) ( ( planar ? 1 : 2 ) * periodTime * 1000 )
+                        - (long long) ( stream_.latency[1] * nanosPerFrame ) );
+    }
+
+    beginCallback();
+    int cbReturnValue;
+    if ( planar ) {
+      for ( int i=0; i<2; i++ ) {
+        std::vector<float *> &channels = planar->channels[i];
+        for ( unsigned int j=0; j<channels.size(); j++ )
+          channels[j] = (float *) jack_port_get_buffer( handle->ports[i][j], (jack_nframes_t) nframes );
+      }
+      cbReturnValue = invokePlanarCallback( stream_.bufferSize, streamTime, status );
+    }
+    else
+      cbReturnValue = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+                                stream_.bufferSize, streamTime, status, info->userData );
+    endCallback( status );
     if ( cbReturnValue == 2 ) {
       stream_.state = STREAM_STOPPING;
       handle->drainCounter = 2;
@@ -3288,6 +4363,9 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
         memcpy( jackbuffer, &stream_.deviceBuffer[i*bufferBytes], bufferBytes );
       }
     }
+    else if ( planar ) {
+      // The callback has written to the port buffers.
+    }
     else { // no buffer conversion
       for ( unsigned int i=0; i<stream_.nUserChannels[0]; i++ ) {
         jackbuffer = (jack_default_audio_sample_t *) jack_port_get_buffer( handle->ports[0][i], (jack_nframes_t) nframes );
@@ -3302,7 +4380,7 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
     goto unlock;
   }
 
-  if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+  if ( ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && !planar ) {
 
     if ( stream_.doConvertBuffer[1] ) {
       for ( unsigned int i=0; i<stream_.nDeviceChannels[1]; i++ ) {
@@ -4141,8 +5219,10 @@ bool RtApiAsio :: callbackEvent( long bufferIndex )
       status |= RTAUDIO_INPUT_OVERFLOW;
       asioXRun = false;
     }
+    beginCallback();
     int cbReturnValue = callback( stream_.userBuffer[0], stream_.userBuffer[1],
                                      stream_.bufferSize, streamTime, status, info->userData );
+    endCallback( status );
     if ( cbReturnValue == 2 ) {
       stream_.state = STREAM_STOPPING;
       handle->drainCounter = 2;
@@ -5982,12 +7062,14 @@ void RtApiWasapi::wasapiThread()
       // if callback has not requested the stream to stop
       if ( callbackPulled && !callbackStopped ) {
         // Execute user callback method
+        beginCallback();
         callbackResult = callback( stream_.userBuffer[OUTPUT],
                                    stream_.userBuffer[INPUT],
                                    stream_.bufferSize,
                                    getStreamTime(),
                                    captureFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY ? RTAUDIO_INPUT_OVERFLOW : 0,
                                    stream_.callbackInfo.userData );
+        endCallback( captureFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY ? RTAUDIO_INPUT_OVERFLOW : 0 );
 
         // tick stream time
         RtApi::tickStreamTime();
@@ -6326,6 +7408,11 @@ RtApiDs :: ~RtApiDs()
   if ( coInitialized_ ) CoUninitialize(); // balanced call.
 }
 
+void RtApiDs :: copyDevices( RtApi *source )
+{
+  dsDevices_ = static_cast<RtApiDs *>( source )->dsDevices_;
+}
+
 void RtApiDs :: probeDevices( void )
 {
   // See list of required functionality in RtApi::probeDevices().
@@ -7341,8 +8428,10 @@ void RtApiDs :: callbackEvent()
       status |= RTAUDIO_INPUT_OVERFLOW;
       handle->xrun[1] = false;
     }
+    beginCallback();
     int cbReturnValue = callback( stream_.userBuffer[0], stream_.userBuffer[1],
                                   stream_.bufferSize, streamTime, status, info->userData );
+    endCallback( status );
     if ( cbReturnValue == 2 ) {
       stream_.state = STREAM_STOPPING;
       handle->drainCounter = 2;
@@ -7368,7 +8457,7 @@ void RtApiDs :: callbackEvent()
   char *buffer;
   long bufferBytes;
 
-  MUTEX_LOCK( &stream_.mutex );
+  lockStreamMutex();
   if ( stream_.state == STREAM_STOPPED ) {
     MUTEX_UNLOCK( &stream_.mutex );
     return;
@@ -7845,6 +8934,8 @@ static const char* getErrorString( int code )
 
 #include <alsa/asoundlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
 
   // A structure to hold various information related to the ALSA API
   // implementation.
@@ -7854,138 +8945,374 @@ struct AlsaHandle {
   bool xrun[2];
   pthread_cond_t runnable_cv;
   bool runnable;
+  bool mmap[2];                    // Devices opened with mmap access.
+  snd_pcm_uframes_t mmapOffset[2]; // Offset of the currently mapped period.
+  bool usePoll;                    // Wait for periods with poll().
+  unsigned int nPollFds[2];
+  std::vector<struct pollfd> pollFds; // Playback then capture descriptors.
+  int stopRequest;                 // 1 = stop, 2 = abort, posted with STREAM_STOPPING.
+  int stopResult;
+  bool timestamps[2];              // Devices timestamping their status on the monotonic clock.
+  long long inputTime;             // Capture time of the period last read by readInput(), or 0.
 
   AlsaHandle()
 #if _cplusplus >= 201103L
-    :handles{nullptr, nullptr}, synchronized(false), runnable(false) { xrun[0] = false; xrun[1] = false; }
+    :handles{nullptr, nullptr}, synchronized(false), runnable(false), usePoll(false), stopRequest(0), stopResult(0), inputTime(0) { xrun[0] = false; xrun[1] = false; mmap[0] = false; mmap[1] = false; nPollFds[0] = 0; nPollFds[1] = 0; timestamps[0] = false; timestamps[1] = false; }
 #else 
-    : synchronized(false), runnable(false) { handles[0] = NULL; handles[1] = NULL; xrun[0] = false; xrun[1] = false; }
+    : synchronized(false), runnable(false), usePoll(false), stopRequest(0), stopResult(0), inputTime(0) { handles[0] = NULL; handles[1] = NULL; xrun[0] = false; xrun[1] = false; mmap[0] = false; mmap[1] = false; nPollFds[0] = 0; nPollFds[1] = 0; timestamps[0] = false; timestamps[1] = false; }
 #endif
 };
 
+// A device added to the stream with StreamOptions::aggregateOutputs or
+// aggregateInputs.  It is opened non-blocking and serviced by the
+// callback thread after (input) or before (output) the stream devices,
+// which set the pace.  Its samples pass through a Resampler as
+// FLOAT32, with the ratio steered by a DriftLoop on the level of the
+// device buffer (output) or of the resampler input (input).
+struct RtApiAlsa::AggregateDevice {
+  snd_pcm_t *handle;
+  StreamMode mode;
+  std::string name;
+  unsigned int channels;        // Stream channels carried by the device.
+  unsigned int deviceChannels;
+  RtAudioFormat deviceFormat;
+  bool doByteSwap;
+  snd_pcm_uframes_t bufferFrames; // Device buffer size.
+  unsigned int maxFrames;       // Largest transfer per period, in device frames.
+  double ratio;                 // Nominal resampling ratio.
+  double target;                // Level steered to, in device frames.
+  ConvertInfo toFloat;          // Stream (output) or device (input) samples to FLOAT32.
+  ConvertInfo fromFloat;        // FLOAT32 to device (output) or stream (input) samples.
+  std::vector<float> floatBuffer[2]; // Resampler input and output.
+  std::vector<char> deviceBuffer;
+  Resampler *resampler;
+  DriftLoop loop;
+  unsigned int driftIndex;
+  bool running;                 // Started, and primed with enough samples.
+
+  AggregateDevice() : handle(0), resampler(0), running(false) {}
+  ~AggregateDevice() { delete resampler; if ( handle ) snd_pcm_close( handle ); }
+};
+
+// The devices of a sound card, as last probed, and its control device,
+// which is kept open (non-blocking, subscribed to events) to notice
+// when the card is removed or its controls are added or removed.
+struct RtApiAlsa::CardCache {
+  struct Pcm {
+    std::string id;             // Device hw ID.
+    std::string name;           // Device "pretty name".
+    bool playback, capture;
+  };
+
+  int card;
+  snd_ctl_t *control;
+  std::vector<Pcm> devices;
+  std::string defaultName;      // Name of the first device of card 0.
+
+  CardCache() : card(-1), control(0) {}
+  ~CardCache() { if ( control ) snd_ctl_close( control ); }
+};
+
+// The enumeration of one card, which may run on a worker thread.  Warnings
+// are collected through the same members and error() method as in
+// RtApi, and reported by the calling thread once the task is done.
+// The global ALSA configuration is only freed after all tasks.
+struct RtApiAlsa::ProbeTask {
+  int card;
+  size_t slot;                  // Position of the card in cards_.
+  CardCache *cache;
+  std::ostringstream errorStream_;
+  std::string errorText_;
+  std::vector<std::string> warnings;
+
+  ProbeTask( int card = -1, size_t slot = 0 ) : card( card ), slot( slot ), cache( 0 ) {}
+  void probe( void );
+  bool probeDeviceInfo( RtAudio::DeviceInfo &info, std::string name );
+  RtAudioErrorType error( RtAudioErrorType type )
+  {
+    warnings.push_back( errorText_ );
+    errorStream_.str( "" );
+    return type;
+  }
+};
+
 static void *alsaCallbackHandler( void * ptr );
 
 RtApiAlsa :: RtApiAlsa()
+  : devicesCached_( false )
 {
-  // Nothing to do here.
+}
+
+void RtApiAlsa :: copyDevices( RtApi *source )
+{
+  RtApiAlsa *alsa = static_cast<RtApiAlsa *>( source );
+  deviceIdPairs_ = alsa->deviceIdPairs_;
+  capabilitiesPending_ = alsa->capabilitiesPending_;
 }
 
 RtApiAlsa :: ~RtApiAlsa()
 {
   if ( stream_.state != STREAM_CLOSED ) closeStream();
+  clearCards();
 }
 
-void RtApiAlsa :: probeDevices( void )
+void RtApiAlsa :: clearCards( void )
 {
-  // See list of required functionality in RtApi::probeDevices().
-  
-  int result, device, card;
+  for ( size_t i=0; i<cards_.size(); i++ ) delete cards_[i];
+  cards_.clear();
+  snd_config_update_free_global();
+}
+
+// Reads the pending events of a card control device and returns true
+// if the card is gone or controls were added or removed, as happens
+// when a (USB) device reconfigures itself.  Value changes, such as
+// volume adjustments, are ignored.
+static bool alsaCardChanged( snd_ctl_t *control )
+{
+  snd_ctl_event_t *event;
+  snd_ctl_event_alloca( &event );
+  bool changed = false;
+  int result;
+  while ( ( result = snd_ctl_read( control, event ) ) > 0 ) {
+    if ( snd_ctl_event_get_type( event ) != SND_CTL_EVENT_ELEM ) continue;
+    unsigned int mask = snd_ctl_event_elem_get_mask( event );
+    if ( mask == SND_CTL_EVENT_MASK_REMOVE || mask & SND_CTL_EVENT_MASK_ADD ) changed = true;
+  }
+  return changed || ( result < 0 && result != -EAGAIN );
+}
+
+// Enumerates the PCM devices of the card and their directions,
+// keeping the control device open for events.  The cache is left
+// without control device if the card could not be probed, so that it
+// is not retried until it reappears.
+void RtApiAlsa::ProbeTask :: probe( void )
+{
+  int result, device;
   char name[128];
   snd_ctl_t *handle = 0;
   snd_ctl_card_info_t *ctlinfo;
   snd_pcm_info_t *pcminfo;
   snd_ctl_card_info_alloca(&ctlinfo);
   snd_pcm_info_alloca(&pcminfo);
-  // First element isthe device hw ID, second is the device "pretty name"
-  std::vector<std::pair<std::string, std::string>> deviceID_prettyName;
   snd_pcm_stream_t stream;
-  std::string defaultDeviceName;
+  cache = new CardCache;
+  cache->card = card;
 
-  // Add the default interface if available.
-  result = snd_ctl_open( &handle, "default", 0 );
-  if (result == 0) {
-    deviceID_prettyName.push_back({"default", "Default ALSA Device"});
-    defaultDeviceName = deviceID_prettyName[0].second;
-    snd_ctl_close( handle );
-    snd_config_update_free_global();
+  sprintf( name, "hw:%d", card );
+  result = snd_ctl_open( &handle, name, SND_CTL_NONBLOCK );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::probeDevices: control open, card = " << card << ", " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    error( RTAUDIO_WARNING );
+    return;
   }
-
-  // Add the Pulse interface if available.
-  result = snd_ctl_open( &handle, "pulse", 0 );
-  if (result == 0) {
-    deviceID_prettyName.push_back({"pulse",  "PulseAudio Sound Server"});
+  result = snd_ctl_card_info( handle, ctlinfo );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::probeDevices: control info, card = " << card << ", " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    error( RTAUDIO_WARNING );
     snd_ctl_close( handle );
-    snd_config_update_free_global();
+    return;
   }
-  
-  // Count cards and devices and get ascii identifiers.
-  card = -1;
-  snd_card_next( &card );
-  while ( card >= 0 ) {
-    sprintf( name, "hw:%d", card );
-    result = snd_ctl_open( &handle, name, 0 );
+  device = -1;
+  while( 1 ) {
+    result = snd_ctl_pcm_next_device( handle, &device );
     if ( result < 0 ) {
-      handle = 0;
-      errorStream_ << "RtApiAlsa::probeDevices: control open, card = " << card << ", " << snd_strerror( result ) << ".";
+      errorStream_ << "RtApiAlsa::probeDevices: control next device, card = " << card << ", " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
       error( RTAUDIO_WARNING );
-      goto nextcard;
+      break;
     }
-    result = snd_ctl_card_info( handle, ctlinfo );
+    if ( device < 0 )
+      break;
+
+    snd_pcm_info_set_device( pcminfo, device );
+    snd_pcm_info_set_subdevice( pcminfo, 0 );
+    stream = SND_PCM_STREAM_PLAYBACK;
+    snd_pcm_info_set_stream( pcminfo, stream );
+    result = snd_ctl_pcm_info( handle, pcminfo );
+    bool playback = ( result == 0 );
     if ( result < 0 ) {
-      errorStream_ << "RtApiAlsa::probeDevices: control info, card = " << card << ", " << snd_strerror( result ) << ".";
-      errorText_ = errorStream_.str();
-      error( RTAUDIO_WARNING );
-      goto nextcard;
+      if ( result == -ENOENT ) { // try as input stream
+        stream = SND_PCM_STREAM_CAPTURE;
+        snd_pcm_info_set_stream( pcminfo, stream );
+        result = snd_ctl_pcm_info( handle, pcminfo );
+        if ( result < 0 ) {
+          errorStream_ << "RtApiAlsa::probeDevices: control pcm info, card = " << card << ", device = " << device << ", " << snd_strerror( result ) << ".";
+          errorText_ = errorStream_.str();
+          error( RTAUDIO_WARNING );
+          continue;
+        }
+      }
+      else continue;
     }
-    device = -1;
-    while( 1 ) {
-      result = snd_ctl_pcm_next_device( handle, &device );
-      if ( result < 0 ) {
-        errorStream_ << "RtApiAlsa::probeDevices: control next device, card = " << card << ", " << snd_strerror( result ) << ".";
-        errorText_ = errorStream_.str();
-        error( RTAUDIO_WARNING );
+    sprintf( name, "hw:%s,%d", snd_ctl_card_info_get_id(ctlinfo), device );
+    std::string id(name);
+    sprintf( name, "%s (%s)", snd_ctl_card_info_get_name(ctlinfo), snd_pcm_info_get_id(pcminfo) );
+    std::string prettyName(name);
+
+    // Check for capture too, without letting it change the name.
+    bool capture = !playback;
+    if ( playback ) {
+      snd_pcm_info_set_stream( pcminfo, SND_PCM_STREAM_CAPTURE );
+      capture = ( snd_ctl_pcm_info( handle, pcminfo ) == 0 );
+    }
+    CardCache::Pcm pcm = { id, prettyName, playback, capture };
+    cache->devices.push_back( pcm );
+    if ( card == 0 && device == 0 )
+      cache->defaultName = prettyName;
+  }
+
+  // A removed card is still noticed without events.
+  snd_ctl_subscribe_events( handle, 1 );
+  cache->control = handle;
+}
+
+// Runs the probe tasks on up to MAX_PROBE_THREADS threads, including
+// the calling one.  The threads mostly wait for device opens.
+void RtApiAlsa :: runProbeTasks( std::vector<ProbeTask *> &tasks )
+{
+  std::atomic<size_t> next( 0 );
+  auto work = [&tasks, &next]() {
+    size_t i;
+    while ( ( i = next.fetch_add( 1 ) ) < tasks.size() ) tasks[i]->probe();
+  };
+
+  std::vector<std::thread> threads;
+  size_t nThreads = std::min( tasks.size(), (size_t) MAX_PROBE_THREADS );
+  for ( size_t i=1; i<nThreads; i++ ) {
+    try { threads.push_back( std::thread( work ) ); }
+    catch ( const std::system_error & ) { break; } // The remaining threads do the work.
+  }
+  work();
+  for ( size_t i=0; i<threads.size(); i++ ) threads[i].join();
+}
+
+void RtApiAlsa :: reportProbeWarnings( ProbeTask &task )
+{
+  for ( size_t i=0; i<task.warnings.size(); i++ ) {
+    errorText_ = task.warnings[i];
+    error( RTAUDIO_WARNING );
+  }
+}
+
+// Drops the cards that are gone or changed and enumerates those that
+// are new, one task per card, and returns true if any card was
+// affected.  The devices of the enumerated cards are returned in
+// \c changedDevices.  The cards are kept in card order, whatever the
+// order in which the tasks finished, so that device IDs are assigned
+// deterministically.  Listing the present cards only checks for their
+// control device nodes.
+bool RtApiAlsa :: updateCards( std::vector<std::string> &changedDevices )
+{
+  bool changed = false;
+  std::vector<CardCache *> cards;
+  std::vector<ProbeTask *> tasks;
+  int card = -1;
+  snd_card_next( &card );
+  while ( card >= 0 ) {
+    CardCache *cache = 0;
+    for ( size_t i=0; i<cards_.size(); i++ ) {
+      if ( cards_[i] && cards_[i]->card == card ) {
+        cache = cards_[i];
+        cards_[i] = 0;
         break;
       }
-      if ( device < 0 )
-        break;
+    }
+    if ( cache && cache->control && alsaCardChanged( cache->control ) ) {
+      delete cache;
+      cache = 0;
+    }
+    if ( cache == 0 ) {
+      tasks.push_back( new ProbeTask( card, cards.size() ) );
+      changed = true;
+    }
+    cards.push_back( cache );
+    snd_card_next( &card );
+  }
 
-      snd_pcm_info_set_device( pcminfo, device );
-      snd_pcm_info_set_subdevice( pcminfo, 0 );
-      stream = SND_PCM_STREAM_PLAYBACK;
-      snd_pcm_info_set_stream( pcminfo, stream );
-      result = snd_ctl_pcm_info( handle, pcminfo );
-      if ( result < 0 ) {
-        if ( result == -ENOENT ) { // try as input stream
-          stream = SND_PCM_STREAM_CAPTURE;
-          snd_pcm_info_set_stream( pcminfo, stream );
-          result = snd_ctl_pcm_info( handle, pcminfo );
-          if ( result < 0 ) {
-            errorStream_ << "RtApiAlsa::probeDevices: control pcm info, card = " << card << ", device = " << device << ", " << snd_strerror( result ) << ".";
-            errorText_ = errorStream_.str();
-            error( RTAUDIO_WARNING );
-            continue;
-          }
-        }
-        else continue;
-      }
-      sprintf( name, "hw:%s,%d", snd_ctl_card_info_get_id(ctlinfo), device );
-      std::string id(name);
-      sprintf( name, "%s (%s)", snd_ctl_card_info_get_name(ctlinfo), snd_pcm_info_get_id(pcminfo) );
-      std::string prettyName(name);
-      deviceID_prettyName.push_back( {id, prettyName} );
-      if ( card == 0 && device == 0 && defaultDeviceName.empty() )
-        defaultDeviceName = name;
+  runProbeTasks( tasks );
+  for ( size_t i=0; i<tasks.size(); i++ ) {
+    cards[ tasks[i]->slot ] = tasks[i]->cache;
+    for ( auto& d : tasks[i]->cache->devices ) changedDevices.push_back( d.id );
+    reportProbeWarnings( *tasks[i] );
+    delete tasks[i];
+  }
+
+  // Cards still left were removed.
+  for ( size_t i=0; i<cards_.size(); i++ ) {
+    if ( cards_[i] ) {
+      delete cards_[i];
+      changed = true;
     }
-  nextcard:
-    if ( handle ) {
+  }
+  cards_.swap( cards );
+  if ( changed ) snd_config_update_free_global();
+  return changed;
+}
+
+void RtApiAlsa :: probeDevices( void )
+{
+  // See list of required functionality in RtApi::probeDevices().
+
+  // The device list is kept until a card changes, so repeated queries
+  // cost no more than a check of the card control devices.  Only names
+  // and directions are enumerated here, and the capabilities of each
+  // device are probed when its DeviceInfo is first requested (see
+  // probeDeviceCapabilities()).
+  std::vector<std::string> changedDevices;
+  bool changed = updateCards( changedDevices );
+  if ( devicesCached_ && !changed ) return;
+
+  int result;
+  snd_ctl_t *handle = 0;
+  if ( !devicesCached_ ) {
+    pluginDevices_.clear();
+
+    // Add the default interface if available.
+    result = snd_ctl_open( &handle, "default", 0 );
+    if (result == 0) {
+      pluginDevices_.push_back({"default", "Default ALSA Device"});
       snd_ctl_close( handle );
       snd_config_update_free_global();
     }
-    snd_card_next( &card );
+
+    // Add the Pulse interface if available.
+    result = snd_ctl_open( &handle, "pulse", 0 );
+    if (result == 0) {
+      pluginDevices_.push_back({"pulse",  "PulseAudio Sound Server"});
+      snd_ctl_close( handle );
+      snd_config_update_free_global();
+    }
+    devicesCached_ = true;
+  }
+
+  // The plugins are assumed to support both directions.
+  std::vector<CardCache::Pcm> pcms;
+  std::string defaultDeviceName;
+  for ( auto& p : pluginDevices_ ) {
+    CardCache::Pcm pcm = { p.first, p.second, true, true };
+    pcms.push_back( pcm );
+  }
+  if ( !pluginDevices_.empty() && pluginDevices_[0].first == "default" )
+    defaultDeviceName = pluginDevices_[0].second;
+  for ( size_t i=0; i<cards_.size(); i++ ) {
+    pcms.insert( pcms.end(), cards_[i]->devices.begin(), cards_[i]->devices.end() );
+    if ( defaultDeviceName.empty() ) defaultDeviceName = cards_[i]->defaultName;
   }
 
-  if ( deviceID_prettyName.size() == 0 ) {
+  if ( pcms.size() == 0 ) {
     deviceList_.clear();
     deviceIdPairs_.clear();
+    capabilitiesPending_.clear();
     return;
   }
 
   // Clean removed devices
   for ( auto it = deviceIdPairs_.begin(); it != deviceIdPairs_.end(); ) {
     bool found = false;
-    for ( auto& d: deviceID_prettyName ) {
-      if ( d.first == (*it).first ) {
+    for ( auto& d: pcms ) {
+      if ( d.id == (*it).first ) {
         found = true;
         break;
       }
@@ -7993,15 +9320,30 @@ void RtApiAlsa :: probeDevices( void )
 
     if ( found )
       ++it;
-    else
+    else {
+      capabilitiesPending_.erase( std::remove( capabilitiesPending_.begin(), capabilitiesPending_.end(), (*it).second ),
+                                  capabilitiesPending_.end() );
       it = deviceIdPairs_.erase(it);
+    }
+  }
+
+  // Devices of changed cards that we already have keep their IDs, but
+  // their capabilities are probed again.
+  for ( auto& id : changedDevices ) {
+    for ( auto& dID : deviceIdPairs_ ) {
+      if ( dID.first == id ) {
+        if ( std::find( capabilitiesPending_.begin(), capabilitiesPending_.end(), dID.second ) == capabilitiesPending_.end() )
+          capabilitiesPending_.push_back( dID.second );
+        break;
+      }
+    }
   }
 
   // Fill or update the deviceList_ and also save a corresponding list of Ids.
-  for ( auto& d : deviceID_prettyName ) {
+  for ( auto& d : pcms ) {
     bool found = false;
     for ( auto& dID : deviceIdPairs_ ) {
-      if ( d.first == dID.first ) {
+      if ( d.id == dID.first ) {
         found = true;
         break; // We already have this device.
       }
@@ -8012,17 +9354,15 @@ void RtApiAlsa :: probeDevices( void )
 
     // new device
     RtAudio::DeviceInfo info;
-    info.name = d.second;
-    if ( probeDeviceInfo( info, d.first ) == false ) continue; // ignore if probe fails
+    info.name = d.name;
     info.ID = currentDeviceId_++;  // arbitrary internal device ID
     if ( info.name == defaultDeviceName ) {
-      if ( info.outputChannels > 0 ) info.isDefaultOutput = true;
-      if ( info.inputChannels > 0 ) info.isDefaultInput = true;
+      if ( d.playback ) info.isDefaultOutput = true;
+      if ( d.capture ) info.isDefaultInput = true;
     }
     deviceList_.push_back( info );
-    deviceIdPairs_.push_back({d.first, info.ID});
-    // I don't see that ALSA provides property listeners to know if
-    // devices are removed or added.
+    deviceIdPairs_.push_back({d.id, info.ID});
+    capabilitiesPending_.push_back( info.ID );
   }
 
   // Remove any devices left in the list that are no longer available.
@@ -8045,7 +9385,42 @@ void RtApiAlsa :: probeDevices( void )
   }
 }
 
+// Probes the channels, sample rates and formats of a device the first
+// time that its DeviceInfo is requested, or after its card changed.  A
+// device that cannot be probed (because it is busy, for instance) is
+// tried again on the next request.
+void RtApiAlsa :: probeDeviceCapabilities( RtAudio::DeviceInfo &info )
+{
+  auto pending = std::find( capabilitiesPending_.begin(), capabilitiesPending_.end(), info.ID );
+  if ( pending == capabilitiesPending_.end() ) return;
+
+  for ( auto& dID : deviceIdPairs_ ) {
+    if ( dID.second != info.ID ) continue;
+    RtAudio::DeviceInfo probed;
+    probed.name = info.name;
+    if ( probeDeviceInfo( probed, dID.first ) ) {
+      probed.ID = info.ID;
+      probed.isDefaultOutput = info.isDefaultOutput;
+      probed.isDefaultInput = info.isDefaultInput;
+      info = probed;
+      capabilitiesPending_.erase( pending );
+    }
+    break;
+  }
+}
+
+// Probes a single device on the calling thread, as for the ALSA
+// plugin devices or a device that could not be probed before.
 bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
+{
+  ProbeTask task;
+  bool result = task.probeDeviceInfo( info, name );
+  snd_config_update_free_global();
+  reportProbeWarnings( task );
+  return result;
+}
+
+bool RtApiAlsa::ProbeTask :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
 {
   int result, openMode = SND_PCM_ASYNC;
   snd_pcm_stream_t stream;
@@ -8070,7 +9445,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   result = snd_pcm_hw_params_any( phandle, params );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    snd_config_update_free_global();
     errorStream_ << "RtApiAlsa::probeDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << ".";
     errorText_ = errorStream_.str();
     error( RTAUDIO_WARNING );
@@ -8082,7 +9456,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   result = snd_pcm_hw_params_get_channels_max( params, &value );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    snd_config_update_free_global();
     errorStream_ << "RtApiAlsa::probeDeviceInfo: error getting device (" << name << ") output channels, " << snd_strerror( result ) << ".";
     errorText_ = errorStream_.str();
     error( RTAUDIO_WARNING );
@@ -8090,7 +9463,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   }
   info.outputChannels = value;
   snd_pcm_close( phandle );
-  snd_config_update_free_global();
 
  captureProbe:
   stream = SND_PCM_STREAM_CAPTURE;
@@ -8109,7 +9481,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   result = snd_pcm_hw_params_any( phandle, params );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    snd_config_update_free_global();
     errorStream_ << "RtApiAlsa::probeDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << ".";
     errorText_ = errorStream_.str();
     error( RTAUDIO_WARNING );
@@ -8120,7 +9491,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   result = snd_pcm_hw_params_get_channels_max( params, &value );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    snd_config_update_free_global();
     errorStream_ << "RtApiAlsa::probeDeviceInfo: error getting device (" << name << ") input channels, " << snd_strerror( result ) << ".";
     errorText_ = errorStream_.str();
     error( RTAUDIO_WARNING );
@@ -8129,7 +9499,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   }
   info.inputChannels = value;
   snd_pcm_close( phandle );
-  snd_config_update_free_global();
 
   // If device opens for both playback and capture, we determine the channels.
   if ( info.outputChannels > 0 && info.inputChannels > 0 )
@@ -8159,7 +9528,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   result = snd_pcm_hw_params_any( phandle, params );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    snd_config_update_free_global();
     errorStream_ << "RtApiAlsa::probeDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << ".";
     errorText_ = errorStream_.str();
     error( RTAUDIO_WARNING );
@@ -8178,7 +9546,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   }
   if ( info.sampleRates.size() == 0 ) {
     snd_pcm_close( phandle );
-    snd_config_update_free_global();
     errorStream_ << "RtApiAlsa::probeDeviceInfo: no supported sample rates found for device (" << name << ").";
     errorText_ = errorStream_.str();
     error( RTAUDIO_WARNING );
@@ -8213,7 +9580,6 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
   // Check that we have at least one supported format
   if ( info.nativeFormats == 0 ) {
     snd_pcm_close( phandle );
-    snd_config_update_free_global();
     errorStream_ << "RtApiAlsa::probeDeviceInfo: pcm device (" << name << ") data format not supported by RtAudio.";
     errorText_ = errorStream_.str();
     error( RTAUDIO_WARNING );
@@ -8222,10 +9588,27 @@ bool RtApiAlsa :: probeDeviceInfo( RtAudio::DeviceInfo& info, std::string name )
 
   // Close the device and return
   snd_pcm_close( phandle );
-  snd_config_update_free_global();
   return true;
 }
 
+// Sets the access of a device with mmap or read/write transfers,
+// preferring the interleaving of the user buffer.  Returns the result
+// of snd_pcm_hw_params_set_access(), with the interleaving chosen in
+// deviceInterleaved.
+static int setAlsaAccess( snd_pcm_t *handle, snd_pcm_hw_params_t *params, bool mmap,
+                          bool interleaved, bool *deviceInterleaved )
+{
+  snd_pcm_access_t interleavedAccess = mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED;
+  snd_pcm_access_t nonInterleavedAccess = mmap ? SND_PCM_ACCESS_MMAP_NONINTERLEAVED : SND_PCM_ACCESS_RW_NONINTERLEAVED;
+  *deviceInterleaved = interleaved;
+  int result = snd_pcm_hw_params_set_access( handle, params, interleaved ? interleavedAccess : nonInterleavedAccess );
+  if ( result < 0 ) {
+    *deviceInterleaved = !interleaved;
+    result = snd_pcm_hw_params_set_access( handle, params, interleaved ? nonInterleavedAccess : interleavedAccess );
+  }
+  return result;
+}
+
 bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
                                    unsigned int firstChannel, unsigned int sampleRate,
                                    RtAudioFormat format, unsigned int *bufferSize,
@@ -8255,6 +9638,9 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
   else
     stream = SND_PCM_STREAM_CAPTURE;
 
+  // Streams driven by processOnce() always wait for periods with poll().
+  bool usePoll = options && ( options->flags & ( RTAUDIO_ALSA_USE_POLL | RTAUDIO_EXTERNAL_THREAD ) );
+
   snd_pcm_t *phandle;
   int openMode = SND_PCM_ASYNC;
   int result = snd_pcm_open( &phandle, name.c_str(), stream, openMode );
@@ -8284,27 +9670,20 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
   snd_pcm_hw_params_dump( hw_params, out );
 #endif
 
-  // Set access ... check user preference.
-  if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
-    stream_.userInterleaved = false;
-    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
-    if ( result < 0 ) {
-      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
-      stream_.deviceInterleaved[mode] =  true;
-    }
-    else
-      stream_.deviceInterleaved[mode] = false;
-  }
-  else {
-    stream_.userInterleaved = true;
-    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
-    if ( result < 0 ) {
-      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
-      stream_.deviceInterleaved[mode] =  false;
-    }
-    else
-      stream_.deviceInterleaved[mode] =  true;
+  // Set access ... check user preference.  Devices without mmap access
+  // fall back to read/write access.
+  bool useMmap = ( options && options->flags & RTAUDIO_ALSA_USE_MMAP );
+  bool deviceInterleaved;
+  stream_.userInterleaved = !( options && options->flags & RTAUDIO_NONINTERLEAVED );
+  result = setAlsaAccess( phandle, hw_params, useMmap, stream_.userInterleaved, &deviceInterleaved );
+  if ( result < 0 && useMmap ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: mmap access not supported by device (" << name << "), using read/write access.";
+    errorText_ = errorStream_.str();
+    error( RTAUDIO_WARNING );
+    useMmap = false;
+    result = setAlsaAccess( phandle, hw_params, useMmap, stream_.userInterleaved, &deviceInterleaved );
   }
+  stream_.deviceInterleaved[mode] = deviceInterleaved;
 
   if ( result < 0 ) {
     snd_pcm_close( phandle );
@@ -8406,6 +9785,7 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
   }
 
   // Set the sample rate.
+  unsigned int requestedRate = sampleRate;
   result = snd_pcm_hw_params_set_rate_near( phandle, hw_params, (unsigned int*) &sampleRate, 0 );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
@@ -8415,10 +9795,26 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
     return FAILURE;
   }
 
-  // Determine the number of channels for this device.  We support a possible
-  // minimum device channel number > than the value requested by the user.
-  stream_.nUserChannels[mode] = channels;
-  unsigned int value;
+  // Resample to the requested rate, if allowed, rather than run the
+  // stream at the nearest one.
+  if ( sampleRate != requestedRate && options && options->flags & RTAUDIO_CONVERT_SAMPLE_RATE &&
+       !convertStreamRate( requestedRate, sampleRate, bufferSize, options ) ) {
+    snd_pcm_close( phandle );
+    snd_config_update_free_global();
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: device (" << name << ") does not support the stream sample rate (" << requestedRate << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Determine the number of channels for this device.  We support a possible
+  // minimum device channel number > than the value requested by the user.
+  // The channels of any aggregate devices follow in the user buffer.
+  std::vector<RtAudio::StreamParameters> aggregates;
+  if ( options ) aggregates = ( mode == OUTPUT ) ? options->aggregateOutputs : options->aggregateInputs;
+  unsigned int aggregateChannels = 0;
+  for ( size_t i=0; i<aggregates.size(); i++ ) aggregateChannels += aggregates[i].nChannels;
+  stream_.nUserChannels[mode] = channels + aggregateChannels;
+  unsigned int value;
   result = snd_pcm_hw_params_get_channels_max( hw_params, &value );
   unsigned int deviceChannels = value;
   if ( result < 0 || deviceChannels < channels + firstChannel ) {
@@ -8517,12 +9913,23 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
   //snd_pcm_sw_params_set_avail_min( phandle, sw_params, *bufferSize );
   //snd_pcm_sw_params_set_xfer_align( phandle, sw_params, 1 );
 
+  // When polling, wake up exactly once per period.
+  if ( usePoll ) {
+    snd_pcm_sw_params_set_avail_min( phandle, sw_params, *bufferSize );
+    snd_pcm_sw_params_set_period_event( phandle, sw_params, 0 );
+  }
+
   // here are two options for a fix
   //snd_pcm_sw_params_set_silence_size( phandle, sw_params, ULONG_MAX );
   snd_pcm_uframes_t val;
   snd_pcm_sw_params_get_boundary( sw_params, &val );
   snd_pcm_sw_params_set_silence_size( phandle, sw_params, val );
 
+  // Timestamp the device status on the monotonic clock, for the stream
+  // clock.  Without it, the times of the periods are estimated.
+  bool timestamps = snd_pcm_sw_params_set_tstamp_mode( phandle, sw_params, SND_PCM_TSTAMP_ENABLE ) == 0 &&
+    snd_pcm_sw_params_set_tstamp_type( phandle, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC ) == 0;
+
   result = snd_pcm_sw_params( phandle, sw_params );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
@@ -8546,6 +9953,14 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
   if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
        stream_.nUserChannels[mode] > 1 )
     stream_.doConvertBuffer[mode] = true;
+  if ( aggregateChannels > 0 )
+    stream_.doConvertBuffer[mode] = true;
+
+  // Input resampled to the output clock is always converted first.
+  bool compensateDrift = ( mode == INPUT && stream_.mode == OUTPUT && stream_.deviceId[0] != deviceId &&
+                           options && options->flags & RTAUDIO_DRIFT_COMPENSATION );
+  if ( compensateDrift )
+    stream_.doConvertBuffer[mode] = true;
 
   // Allocate the ApiHandle if necessary and then save.
   AlsaHandle *apiInfo = 0;
@@ -8571,8 +9986,28 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
     apiInfo = (AlsaHandle *) stream_.apiHandle;
   }
   apiInfo->handles[mode] = phandle;
+  apiInfo->mmap[mode] = useMmap;
+  apiInfo->timestamps[mode] = timestamps;
   phandle = 0;
 
+  // Collect the poll descriptors of all open devices.
+  if ( usePoll ) {
+    int count = snd_pcm_poll_descriptors_count( apiInfo->handles[mode] );
+    if ( count <= 0 ) {
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: error getting poll descriptors for device (" << name << "), " << snd_strerror( count ) << ".";
+      errorText_ = errorStream_.str();
+      goto error;
+    }
+    apiInfo->usePoll = true;
+    apiInfo->nPollFds[mode] = count;
+    apiInfo->pollFds.resize( apiInfo->nPollFds[0] + apiInfo->nPollFds[1] );
+    for ( int i=0; i<2; i++ ) {
+      if ( apiInfo->handles[i] == 0 ) continue;
+      snd_pcm_poll_descriptors( apiInfo->handles[i], &apiInfo->pollFds[ i ? apiInfo->nPollFds[0] : 0 ],
+                                apiInfo->nPollFds[i] );
+    }
+  }
+
   // Allocate necessary internal buffers.
   unsigned long bufferBytes;
   bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
@@ -8607,11 +10042,30 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
   stream_.sampleRate = sampleRate;
   stream_.nBuffers = periods;
   stream_.deviceId[mode] = deviceId;
+  stream_.channelOffset[mode] = firstChannel;
   stream_.state = STREAM_STOPPED;
 
   // Setup the buffer conversion information structure.
   if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
 
+  // Open the aggregate devices, leaving only the leading channels of
+  // the user buffer to this device.
+  if ( aggregateChannels > 0 ) {
+    ConvertInfo &info = stream_.convertInfo[mode];
+    if ( info.channels > (int) channels ) {
+      info.channels = channels;
+      info.inOffset.resize( channels );
+      info.outOffset.resize( channels );
+      setConvertPlan( info );
+    }
+
+    unsigned int userChannel = channels;
+    for ( size_t i=0; i<aggregates.size(); i++ ) {
+      if ( openAggregate( mode, aggregates[i], userChannel ) == FAILURE ) goto error;
+      userChannel += aggregates[i].nChannels;
+    }
+  }
+
   // Setup thread if necessary.
   if ( stream_.mode == OUTPUT && mode == INPUT ) {
     // We had already set up an output stream.
@@ -8620,11 +10074,25 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
     apiInfo->synchronized = false;
     if ( snd_pcm_link( apiInfo->handles[0], apiInfo->handles[1] ) == 0 )
       apiInfo->synchronized = true;
+    else if ( compensateDrift )
+      setupDriftCompensation();
     else {
       errorText_ = "RtApiAlsa::probeDeviceOpen: unable to synchronize input and output devices.";
       error( RTAUDIO_WARNING );
     }
   }
+  else if ( options && ( options->flags & RTAUDIO_EXTERNAL_THREAD ) ) {
+    stream_.mode = mode;
+
+    // The stream is driven by processOnce() instead of a thread, with
+    // an epoll descriptor watching the devices while it is running.
+    stream_.external = true;
+    stream_.pollDescriptor = epoll_create1( EPOLL_CLOEXEC );
+    if ( stream_.pollDescriptor < 0 ) {
+      errorText_ = "RtApiAlsa::probeDeviceOpen: error creating the stream poll descriptor.";
+      error( RTAUDIO_WARNING );
+    }
+  }
   else {
     stream_.mode = mode;
 
@@ -8636,23 +10104,25 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
     // if the program is run as root or suid. Note, under Linux
     // processes with CAP_SYS_NICE privilege, a user can change
     // scheduling policy and priority (thus need not be root). See
-    // POSIX "capabilities".
+    // POSIX "capabilities".  The thread applies the other options
+    // itself (deadline scheduling starts as round-robin).
+    setCallbackThreadOptions( options );
     pthread_attr_t attr;
     pthread_attr_init( &attr );
     pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
 #ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
-    if ( options && options->flags & RTAUDIO_SCHEDULE_REALTIME ) {
-      stream_.callbackInfo.doRealtime = true;
+    if ( stream_.callbackInfo.doRealtime ) {
       struct sched_param param;
+      int policy = ( options->schedulingPolicy == RtAudio::SCHEDULE_FIFO ) ? SCHED_FIFO : SCHED_RR;
       int priority = options->priority;
-      int min = sched_get_priority_min( SCHED_RR );
-      int max = sched_get_priority_max( SCHED_RR );
+      int min = sched_get_priority_min( policy );
+      int max = sched_get_priority_max( policy );
       if ( priority < min ) priority = min;
       else if ( priority > max ) priority = max;
       param.sched_priority = priority;
 
       // Set the policy BEFORE the priority. Otherwise it fails.
-      pthread_attr_setschedpolicy(&attr, SCHED_RR);
+      pthread_attr_setschedpolicy(&attr, policy);
       pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
       // This is definitely required. Otherwise it fails.
       pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
@@ -8682,6 +10152,11 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsig
   return SUCCESS;
 
  error:
+  closeAggregate();
+  if ( stream_.pollDescriptor >= 0 ) {
+    close( stream_.pollDescriptor );
+    stream_.pollDescriptor = -1;
+  }
   if ( apiInfo ) {
     pthread_cond_destroy( &apiInfo->runnable_cv );
     bool pcm_closed = false;
@@ -8730,14 +10205,20 @@ void RtApiAlsa :: closeStream()
   }
 
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
-  stream_.callbackInfo.isRunning = false;
-  MUTEX_LOCK( &stream_.mutex );
-  if ( stream_.state == STREAM_STOPPED ) {
-    apiInfo->runnable = true;
-    pthread_cond_signal( &apiInfo->runnable_cv );
+  if ( stream_.external ) {
+    // Wait for a concurrent processOnce() call to return.
+    MUTEX_LOCK( &stream_.processMutex );
+  }
+  else {
+    stream_.callbackInfo.isRunning = false;
+    MUTEX_LOCK( &stream_.mutex );
+    if ( stream_.state == STREAM_STOPPED ) {
+      apiInfo->runnable = true;
+      pthread_cond_signal( &apiInfo->runnable_cv );
+    }
+    MUTEX_UNLOCK( &stream_.mutex );
+    pthread_join( stream_.callbackInfo.thread, NULL );
   }
-  MUTEX_UNLOCK( &stream_.mutex );
-  pthread_join( stream_.callbackInfo.thread, NULL );
 
   if ( stream_.state == STREAM_RUNNING ) {
     stream_.state = STREAM_STOPPED;
@@ -8746,6 +10227,9 @@ void RtApiAlsa :: closeStream()
     if ( stream_.mode == INPUT || stream_.mode == DUPLEX )
       snd_pcm_drop( apiInfo->handles[1] );
   }
+  closeAggregate();
+  if ( stream_.external ) MUTEX_UNLOCK( &stream_.processMutex );
+  if ( stream_.pollDescriptor >= 0 ) close( stream_.pollDescriptor );
 
   if ( apiInfo ) {
     pthread_cond_destroy( &apiInfo->runnable_cv );
@@ -8792,6 +10276,8 @@ RtAudioErrorType RtApiAlsa :: startStream()
     return error( RTAUDIO_WARNING );
   }
 
+  if ( stream_.rateConversion ) resetRateConversion();
+
   MUTEX_LOCK( &stream_.mutex );
 
   /*
@@ -8829,7 +10315,19 @@ RtAudioErrorType RtApiAlsa :: startStream()
     }
   }
 
+  // Capture is otherwise started by the first read, which processOnce()
+  // only gets to once the device polls ready.
+  if ( stream_.external && stream_.mode == INPUT ) {
+    result = snd_pcm_start( handle[1] );
+    if ( result < 0 ) {
+      errorStream_ << "RtApiAlsa::startStream: error starting input pcm device, " << snd_strerror( result ) << ".";
+      errorText_ = errorStream_.str();
+      goto unlock;
+    }
+  }
+
   stream_.state = STREAM_RUNNING;
+  if ( stream_.external ) watchDevices( true );
 
  unlock:
   apiInfo->runnable = true;
@@ -8850,39 +10348,7 @@ RtAudioErrorType RtApiAlsa :: stopStream()
     return error( RTAUDIO_WARNING );
   }
 
-  stream_.state = STREAM_STOPPED;
-  MUTEX_LOCK( &stream_.mutex );
-
-  int result = 0;
-  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
-  snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
-    if ( apiInfo->synchronized ) 
-      result = snd_pcm_drop( handle[0] );
-    else
-      result = snd_pcm_drain( handle[0] );
-    if ( result < 0 ) {
-      errorStream_ << "RtApiAlsa::stopStream: error draining output pcm device, " << snd_strerror( result ) << ".";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-  }
-
-  if ( ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && !apiInfo->synchronized ) {
-    result = snd_pcm_drop( handle[1] );
-    if ( result < 0 ) {
-      errorStream_ << "RtApiAlsa::stopStream: error stopping input pcm device, " << snd_strerror( result ) << ".";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-  }
-
- unlock:
-  apiInfo->runnable = false; // fixes high CPU usage when stopped
-  MUTEX_UNLOCK( &stream_.mutex );
-
-  if ( result < 0 ) return error( RTAUDIO_SYSTEM_ERROR );
-  return RTAUDIO_NO_ERROR;
+  return requestStop( 1 );
 }
 
 RtAudioErrorType RtApiAlsa :: abortStream()
@@ -8895,43 +10361,97 @@ RtAudioErrorType RtApiAlsa :: abortStream()
     return error( RTAUDIO_WARNING );
   }
 
-  stream_.state = STREAM_STOPPED;
-  MUTEX_LOCK( &stream_.mutex );
+  return requestStop( 2 );
+}
 
+// The devices are only used by the callback thread while the stream
+// is running, so that the callback thread never waits on a lock held
+// by another thread.  A stop (1) or abort (2) requested from any other
+// thread is posted by moving the stream to STREAM_STOPPING, and the
+// caller then waits for the callback thread to carry it out.
+RtAudioErrorType RtApiAlsa :: requestStop( int request )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   int result = 0;
+  if ( stream_.external ) {
+    // Without a callback thread, the stop is carried out here, once
+    // a processOnce() call from another thread has returned.
+    if ( inProcessOnce() )
+      result = finishStop( request );
+    else {
+      MUTEX_LOCK( &stream_.processMutex );
+      if ( stream_.state == STREAM_RUNNING ) result = finishStop( request );
+      MUTEX_UNLOCK( &stream_.processMutex );
+    }
+  }
+  else if ( pthread_equal( pthread_self(), stream_.callbackInfo.thread ) )
+    result = finishStop( request );
+  else {
+    MUTEX_LOCK( &stream_.mutex );
+    if ( stream_.state == STREAM_RUNNING ) {
+      apiInfo->stopRequest = request;
+      stream_.state.store( STREAM_STOPPING, std::memory_order_release );
+    }
+    while ( stream_.state == STREAM_STOPPING )
+      pthread_cond_wait( &apiInfo->runnable_cv, &stream_.mutex );
+    result = apiInfo->stopResult;
+    MUTEX_UNLOCK( &stream_.mutex );
+  }
+
+  if ( result < 0 ) return error( RTAUDIO_SYSTEM_ERROR );
+  return RTAUDIO_NO_ERROR;
+}
+
+// Drains (1) or drops (2) the devices from the callback thread and
+// marks the stream stopped.  Returns a negative value on error, with
+// errorText_ set.
+int RtApiAlsa :: finishStop( int request )
+{
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
+  const char *method = ( request == 1 ) ? "RtApiAlsa::stopStream" : "RtApiAlsa::abortStream";
+  int result = 0;
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
-    result = snd_pcm_drop( handle[0] );
+    if ( request == 1 && !apiInfo->synchronized )
+      result = snd_pcm_drain( handle[0] );
+    else
+      result = snd_pcm_drop( handle[0] );
     if ( result < 0 ) {
-      errorStream_ << "RtApiAlsa::abortStream: error aborting output pcm device, " << snd_strerror( result ) << ".";
+      errorStream_ << method << ": error " << ( request == 1 ? "draining" : "aborting" ) << " output pcm device, " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
-      goto unlock;
     }
   }
 
-  if ( ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && !apiInfo->synchronized ) {
+  if ( result >= 0 && ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && !apiInfo->synchronized ) {
     result = snd_pcm_drop( handle[1] );
     if ( result < 0 ) {
-      errorStream_ << "RtApiAlsa::abortStream: error aborting input pcm device, " << snd_strerror( result ) << ".";
+      errorStream_ << method << ": error " << ( request == 1 ? "stopping" : "aborting" ) << " input pcm device, " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
-      goto unlock;
     }
   }
+  stopAggregate();
+  if ( stream_.external ) watchDevices( false );
 
- unlock:
+  lockStreamMutex();
   apiInfo->runnable = false; // fixes high CPU usage when stopped
+  apiInfo->stopResult = result;
+  stream_.state.store( STREAM_STOPPED, std::memory_order_release );
+  pthread_cond_broadcast( &apiInfo->runnable_cv );
   MUTEX_UNLOCK( &stream_.mutex );
-
-  if ( result < 0 ) return error( RTAUDIO_SYSTEM_ERROR );
-  return RTAUDIO_NO_ERROR;
+  return result;
 }
 
 void RtApiAlsa :: callbackEvent()
 {
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_LOCK( &stream_.mutex );
+  StreamState state = stream_.state.load( std::memory_order_acquire );
+  if ( state == STREAM_STOPPING ) {
+    finishStop( apiInfo->stopRequest );
+    return;
+  }
+
+  if ( state == STREAM_STOPPED ) {
+    lockStreamMutex();
     while ( !apiInfo->runnable )
       pthread_cond_wait( &apiInfo->runnable_cv, &stream_.mutex );
 
@@ -8948,6 +10468,43 @@ void RtApiAlsa :: callbackEvent()
     return;
   }
 
+  // With mmap access, input is captured before running the callback
+  // and periods are mapped so that the callback can use the device
+  // buffers in place when no conversion is needed.  A planar callback
+  // is given the channels of non-interleaved devices in place.
+  char *userBuffer[2] = { stream_.userBuffer[0], stream_.userBuffer[1] };
+  char *mmapBuffer[2] = { 0, 0 };
+  bool mmapChannels[2] = { false, false };
+  if ( apiInfo->mmap[0] || apiInfo->mmap[1] ) {
+    if ( apiInfo->usePoll ) waitForPeriod( 1000 );
+    if ( apiInfo->mmap[1] && !stream_.driftCompensation ) {
+      if ( usePlanes( INPUT ) )
+        mmapChannels[1] = mmapPlanes( INPUT );
+      else
+        mmapBuffer[1] = mmapBegin( INPUT );
+      if ( mmapBuffer[1] ) {
+        if ( stream_.doByteSwap[1] )
+          byteSwapBuffer( mmapBuffer[1], stream_.bufferSize * stream_.nDeviceChannels[1], stream_.deviceFormat[1] );
+        if ( stream_.doConvertBuffer[1] )
+          convertBuffer( stream_.userBuffer[1], mmapBuffer[1], stream_.convertInfo[1] );
+        else
+          userBuffer[1] = mmapBuffer[1];
+      }
+      else if ( !mmapChannels[1] )
+        readInput();
+    }
+    if ( apiInfo->mmap[0] ) {
+      if ( usePlanes( OUTPUT ) )
+        mmapChannels[0] = mmapPlanes( OUTPUT );
+      else
+        mmapBuffer[0] = mmapBegin( OUTPUT );
+      if ( mmapBuffer[0] && !stream_.doConvertBuffer[0] ) userBuffer[0] = mmapBuffer[0];
+    }
+  }
+
+  if ( stream_.driftCompensation ) readDriftInput();
+  if ( !aggregate_.empty() ) readAggregate();
+
   int doStopStream = 0;
   RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
   double streamTime = getStreamTime();
@@ -8960,18 +10517,44 @@ void RtApiAlsa :: callbackEvent()
     status |= RTAUDIO_INPUT_OVERFLOW;
     apiInfo->xrun[1] = false;
   }
-  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                           stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
+
+  // Timestamp the period: mapped input was captured before the frames
+  // still available on the device, and output will be played after
+  // those queued.
+  long long time;
+  snd_pcm_sframes_t delay;
+  if ( stream_.mode != INPUT && deviceTimestamp( OUTPUT, &time, &delay ) )
+    setStreamClock( OUTPUT, time + delay * 1000000000LL / stream_.sampleRate );
+  if ( stream_.mode != OUTPUT && !stream_.driftCompensation ) {
+    if ( mmapBuffer[1] || mmapChannels[1] ) {
+      if ( deviceTimestamp( INPUT, &time, &delay ) )
+        setStreamClock( INPUT, time - delay * 1000000000LL / stream_.sampleRate );
+    }
+    else
+      setStreamClock( INPUT, apiInfo->inputTime );
+  }
+
+  beginCallback();
+  if ( mmapChannels[0] || mmapChannels[1] ) {
+    for ( int i=0; i<2; i++ )
+      if ( !mmapChannels[i] ) setPlanarChannels( (StreamMode) i, stream_.userBuffer[i], stream_.bufferSize );
+    doStopStream = invokePlanarCallback( stream_.bufferSize, streamTime, status );
+  }
+  else
+    doStopStream = callback( userBuffer[0], userBuffer[1],
+                             stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
+  endCallback( status );
 
   if ( doStopStream == 2 ) {
     abortStream();
     return;
   }
 
-  MUTEX_LOCK( &stream_.mutex );
-
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) goto unlock;
+  // A stop or abort might have been requested during the callback.
+  if ( stream_.state.load( std::memory_order_acquire ) == STREAM_STOPPING ) {
+    finishStop( apiInfo->stopRequest );
+    return;
+  }
 
   int result;
   char *buffer;
@@ -8981,73 +10564,32 @@ void RtApiAlsa :: callbackEvent()
   RtAudioFormat format;
   handle = (snd_pcm_t **) apiInfo->handles;
 
+  // Wait for all devices at once, so that the transfers below don't block.
+  if ( apiInfo->usePoll && !apiInfo->mmap[0] && !apiInfo->mmap[1] ) waitForPeriod( 1000 );
+
   if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+    if ( mmapBuffer[1] || mmapChannels[1] )
+      mmapCommit( INPUT );
+    else if ( !apiInfo->mmap[1] && !stream_.driftCompensation )
+      readInput();
+  }
 
-    // Setup parameters.
-    if ( stream_.doConvertBuffer[1] ) {
-      buffer = stream_.deviceBuffer;
-      channels = stream_.nDeviceChannels[1];
-      format = stream_.deviceFormat[1];
-    }
-    else {
-      buffer = stream_.userBuffer[1];
-      channels = stream_.nUserChannels[1];
-      format = stream_.userFormat;
-    }
+  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
 
-    // Read samples from device in interleaved/non-interleaved format.
-    if ( stream_.deviceInterleaved[1] )
-      result = snd_pcm_readi( handle[1], buffer, stream_.bufferSize );
-    else {
-      void *bufs[channels];
-      size_t offset = stream_.bufferSize * formatBytes( format );
-      for ( int i=0; i<channels; i++ )
-        bufs[i] = (void *) (buffer + (i * offset));
-      result = snd_pcm_readn( handle[1], bufs, stream_.bufferSize );
+    // Write directly into the mapped period, converting if necessary.
+    if ( mmapChannels[0] ) {
+      mmapCommit( OUTPUT );
+      goto tick;
     }
-
-    if ( result < (int) stream_.bufferSize ) {
-      // Either an error or overrun occurred.
-      if ( result == -EPIPE ) {
-        snd_pcm_state_t state = snd_pcm_state( handle[1] );
-        if ( state == SND_PCM_STATE_XRUN ) {
-          apiInfo->xrun[1] = true;
-          result = snd_pcm_prepare( handle[1] );
-          if ( result < 0 ) {
-            errorStream_ << "RtApiAlsa::callbackEvent: error preparing device after overrun, " << snd_strerror( result ) << ".";
-            errorText_ = errorStream_.str();
-          }
-        }
-        else {
-          errorStream_ << "RtApiAlsa::callbackEvent: error, current state is " << snd_pcm_state_name( state ) << ", " << snd_strerror( result ) << ".";
-          errorText_ = errorStream_.str();
-        }
-      }
-      else {
-        errorStream_ << "RtApiAlsa::callbackEvent: audio read error, " << snd_strerror( result ) << ".";
-        errorText_ = errorStream_.str();
-      }
-      error( RTAUDIO_WARNING );
-      goto tryOutput;
+    if ( mmapBuffer[0] ) {
+      if ( stream_.doConvertBuffer[0] )
+        convertBuffer( mmapBuffer[0], stream_.userBuffer[0], stream_.convertInfo[0] );
+      if ( stream_.doByteSwap[0] )
+        byteSwapBuffer( mmapBuffer[0], stream_.bufferSize * stream_.nDeviceChannels[0], stream_.deviceFormat[0] );
+      mmapCommit( OUTPUT );
+      goto tick;
     }
 
-    // Do byte swapping if necessary.
-    if ( stream_.doByteSwap[1] )
-      byteSwapBuffer( buffer, stream_.bufferSize * channels, format );
-
-    // Do buffer conversion if necessary.
-    if ( stream_.doConvertBuffer[1] )
-      convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
-
-    // Check stream latency
-    result = snd_pcm_delay( handle[1], &frames );
-    if ( result == 0 && frames > 0 ) stream_.latency[1] = frames;
-  }
-
- tryOutput:
-
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
-
     // Setup parameters and do buffer conversion if necessary.
     if ( stream_.doConvertBuffer[0] ) {
       buffer = stream_.deviceBuffer;
@@ -9066,14 +10608,21 @@ void RtApiAlsa :: callbackEvent()
       byteSwapBuffer(buffer, stream_.bufferSize * channels, format);
 
     // Write samples to device in interleaved/non-interleaved format.
-    if ( stream_.deviceInterleaved[0] )
-      result = snd_pcm_writei( handle[0], buffer, stream_.bufferSize );
+    if ( stream_.deviceInterleaved[0] ) {
+      if ( apiInfo->mmap[0] )
+        result = snd_pcm_mmap_writei( handle[0], buffer, stream_.bufferSize );
+      else
+        result = snd_pcm_writei( handle[0], buffer, stream_.bufferSize );
+    }
     else {
       void *bufs[channels];
       size_t offset = stream_.bufferSize * formatBytes( format );
       for ( int i=0; i<channels; i++ )
         bufs[i] = (void *) (buffer + (i * offset));
-      result = snd_pcm_writen( handle[0], bufs, stream_.bufferSize );
+      if ( apiInfo->mmap[0] )
+        result = snd_pcm_mmap_writen( handle[0], bufs, stream_.bufferSize );
+      else
+        result = snd_pcm_writen( handle[0], bufs, stream_.bufferSize );
     }
 
     if ( result < (int) stream_.bufferSize ) {
@@ -9100,7 +10649,7 @@ void RtApiAlsa :: callbackEvent()
         errorText_ = errorStream_.str();
       }
       error( RTAUDIO_WARNING );
-      goto unlock;
+      goto tick;
     }
 
     // Check stream latency
@@ -9108,46 +10657,701 @@ void RtApiAlsa :: callbackEvent()
     if ( result == 0 && frames > 0 ) stream_.latency[0] = frames;
   }
 
- unlock:
-  MUTEX_UNLOCK( &stream_.mutex );
-
+ tick:
+  if ( !aggregate_.empty() ) writeAggregate();
   RtApi::tickStreamTime();
   if ( doStopStream == 1 ) this->stopStream();
 }
 
-static void *alsaCallbackHandler( void *ptr )
+// Reads one period of input into the user or device buffer.  Only
+// called from the callback thread.
+void RtApiAlsa :: readInput()
 {
-  CallbackInfo *info = (CallbackInfo *) ptr;
-  RtApiAlsa *object = (RtApiAlsa *) info->object;
-  bool *isRunning = &info->isRunning;
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
+  snd_pcm_sframes_t frames;
+  RtAudioFormat format;
+  char *buffer;
+  int channels;
+  int result;
 
-#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
-  if ( info->doRealtime ) {
-    std::cerr << "RtAudio alsa: " << 
-             (sched_getscheduler(0) == SCHED_RR ? "" : "_NOT_ ") << 
-             "running realtime scheduling" << std::endl;
-  }
-#endif
+  apiInfo->inputTime = 0;
 
-  while ( *isRunning == true ) {
-    pthread_testcancel();
-    object->callbackEvent();
+  // Setup parameters.
+  if ( stream_.doConvertBuffer[1] ) {
+    buffer = stream_.deviceBuffer;
+    channels = stream_.nDeviceChannels[1];
+    format = stream_.deviceFormat[1];
+  }
+  else {
+    buffer = stream_.userBuffer[1];
+    channels = stream_.nUserChannels[1];
+    format = stream_.userFormat;
   }
 
-  pthread_exit( NULL );
-}
+  // Read samples from device in interleaved/non-interleaved format.
+  if ( stream_.deviceInterleaved[1] ) {
+    if ( apiInfo->mmap[1] )
+      result = snd_pcm_mmap_readi( handle[1], buffer, stream_.bufferSize );
+    else
+      result = snd_pcm_readi( handle[1], buffer, stream_.bufferSize );
+  }
+  else {
+    void *bufs[channels];
+    size_t offset = stream_.bufferSize * formatBytes( format );
+    for ( int i=0; i<channels; i++ )
+      bufs[i] = (void *) (buffer + (i * offset));
+    if ( apiInfo->mmap[1] )
+      result = snd_pcm_mmap_readn( handle[1], bufs, stream_.bufferSize );
+    else
+      result = snd_pcm_readn( handle[1], bufs, stream_.bufferSize );
+  }
 
-//******************** End of __LINUX_ALSA__ *********************//
-#endif
+  if ( result < (int) stream_.bufferSize ) {
+    // Either an error or overrun occurred.
+    if ( result == -EPIPE ) {
+      snd_pcm_state_t state = snd_pcm_state( handle[1] );
+      if ( state == SND_PCM_STATE_XRUN ) {
+        apiInfo->xrun[1] = true;
+        result = snd_pcm_prepare( handle[1] );
+        if ( result < 0 ) {
+          errorStream_ << "RtApiAlsa::callbackEvent: error preparing device after overrun, " << snd_strerror( result ) << ".";
+          errorText_ = errorStream_.str();
+        }
+      }
+      else {
+        errorStream_ << "RtApiAlsa::callbackEvent: error, current state is " << snd_pcm_state_name( state ) << ", " << snd_strerror( result ) << ".";
+        errorText_ = errorStream_.str();
+      }
+    }
+    else {
+      errorStream_ << "RtApiAlsa::callbackEvent: audio read error, " << snd_strerror( result ) << ".";
+      errorText_ = errorStream_.str();
+    }
+    error( RTAUDIO_WARNING );
+    return;
+  }
 
-#if defined(__LINUX_PULSE__)
+  // Do byte swapping if necessary.
+  if ( stream_.doByteSwap[1] )
+    byteSwapBuffer( buffer, stream_.bufferSize * channels, format );
 
-// Code written by Peter Meerwald, pmeerw@pmeerw.net and Tristan Matthews.
-// Updated by Gary Scavone, 2021.
+  // Do buffer conversion if necessary, or pass the period to the
+  // drift compensation.
+  if ( stream_.driftCompensation ) {
+    if ( !bufferDriftInput( buffer ) ) apiInfo->xrun[1] = true;
+  }
+  else if ( stream_.doConvertBuffer[1] )
+    convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
 
-#include <pulse/error.h>
-#include <pulse/simple.h>
-#include <cstdio>
+  // Check stream latency, and timestamp the period from the frames
+  // captured since.
+  long long time;
+  if ( deviceTimestamp( INPUT, &time, &frames ) ) {
+    if ( frames > 0 ) stream_.latency[1] = frames;
+    apiInfo->inputTime = time - ( frames + stream_.bufferSize ) * 1000000000LL / stream_.sampleRate;
+  }
+  else {
+    result = snd_pcm_delay( handle[1], &frames );
+    if ( result == 0 && frames > 0 ) stream_.latency[1] = frames;
+  }
+}
+
+// Reads all whole periods captured so far into the drift compensation
+// stage, then resamples a period of input for the callback.  The input
+// device is never waited on, so the callback is paced by the output
+// device.  Only called from the callback thread.
+void RtApiAlsa :: readDriftInput()
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[1];
+  if ( snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED ) {
+    resetDriftCompensation();
+    snd_pcm_start( handle );
+  }
+
+  snd_pcm_sframes_t avail;
+  while ( ( avail = snd_pcm_avail_update( handle ) ) >= (snd_pcm_sframes_t) stream_.bufferSize )
+    readInput();
+
+  if ( avail < 0 ) {
+    // An overrun, which is recovered from by restarting the device.
+    apiInfo->xrun[1] = true;
+    snd_pcm_prepare( handle );
+    avail = 0;
+  }
+  if ( !resampleDriftInput( (double) avail ) ) apiInfo->xrun[1] = true;
+}
+
+// Reads the status timestamp of a device, in nanoseconds of the
+// monotonic clock, and its delay in frames.  Returns false if the
+// device doesn't timestamp its status or isn't running.  Only called
+// from the callback thread.
+bool RtApiAlsa :: deviceTimestamp( StreamMode mode, long long *time, snd_pcm_sframes_t *delay )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  if ( !apiInfo->timestamps[mode] ) return false;
+
+  snd_pcm_status_t *status;
+  snd_pcm_status_alloca( &status );
+  if ( snd_pcm_status( apiInfo->handles[mode], status ) < 0 ) return false;
+  if ( snd_pcm_status_get_state( status ) != SND_PCM_STATE_RUNNING ) return false;
+
+  snd_htimestamp_t stamp;
+  snd_pcm_status_get_htstamp( status, &stamp );
+  if ( stamp.tv_sec == 0 && stamp.tv_nsec == 0 ) return false;
+  *time = stamp.tv_sec * 1000000000LL + stamp.tv_nsec;
+  *delay = snd_pcm_status_get_delay( status );
+  return true;
+}
+
+// Waits in a single poll() call until a full period can be transferred
+// on every open device.  Devices that have not been started yet are
+// considered ready, since the following transfer starts them.  Errors
+// and xruns are left to the transfer to report and recover from.
+// Returns false if the devices are still waiting after timeout
+// milliseconds (no limit if negative).  Only called from the callback
+// thread.
+bool RtApiAlsa :: waitForPeriod( int timeout )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  long long deadline = monotonicNanos() + timeout * 1000000LL;
+  struct pollfd *pfds[2];
+  pfds[0] = &apiInfo->pollFds[0];
+  pfds[1] = &apiInfo->pollFds[ apiInfo->nPollFds[0] ];
+  while ( true ) {
+    // Only poll the devices that are still short of a period, so
+    // that a ready device doesn't turn the wait into a busy loop.
+    bool waiting[2] = { false, false };
+    for ( int i=0; i<2; i++ ) {
+      snd_pcm_t *handle = apiInfo->handles[i];
+      if ( handle == 0 || snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED ) continue;
+      if ( i == 1 && stream_.driftCompensation ) continue; // Read without waiting.
+      snd_pcm_sframes_t avail = snd_pcm_avail_update( handle );
+      if ( avail < 0 ) return true;
+      if ( avail < (snd_pcm_sframes_t) stream_.bufferSize ) waiting[i] = true;
+    }
+    if ( !waiting[0] && !waiting[1] ) return true;
+
+    struct pollfd *first = waiting[0] ? pfds[0] : pfds[1];
+    nfds_t count = 0;
+    if ( waiting[0] ) count += apiInfo->nPollFds[0];
+    if ( waiting[1] ) count += apiInfo->nPollFds[1];
+
+    int wait = -1;
+    if ( timeout >= 0 ) {
+      long long remaining = deadline - monotonicNanos();
+      if ( remaining <= 0 ) return false;
+      wait = (int) ( ( remaining + 999999 ) / 1000000 );
+    }
+    int result = poll( first, count, wait );
+    if ( result < 0 && errno == EINTR ) continue;
+    if ( result < 0 ) return true;
+    if ( result == 0 ) return false;
+
+    for ( int i=0; i<2; i++ ) {
+      if ( !waiting[i] ) continue;
+      unsigned short revents = 0;
+      snd_pcm_poll_descriptors_revents( apiInfo->handles[i], pfds[i], apiInfo->nPollFds[i], &revents );
+      if ( revents & ( POLLERR | POLLNVAL ) ) return true;
+    }
+  }
+}
+
+// Adds the device descriptors to the stream poll descriptor, or
+// removes them, so that it only polls readable while the stream is
+// running.  Drift compensated input is read without waiting and isn't
+// watched.
+void RtApiAlsa :: watchDevices( bool watch )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  if ( stream_.pollDescriptor < 0 ) return;
+  unsigned int count = apiInfo->nPollFds[0];
+  if ( !stream_.driftCompensation ) count += apiInfo->nPollFds[1];
+  for ( unsigned int i=0; i<count; i++ ) {
+    struct pollfd &pfd = apiInfo->pollFds[i];
+    struct epoll_event event;
+    event.events = 0;
+    if ( pfd.events & POLLIN ) event.events |= EPOLLIN;
+    if ( pfd.events & POLLOUT ) event.events |= EPOLLOUT;
+    event.data.fd = pfd.fd;
+    // Descriptors shared by both devices fail to be added twice.
+    epoll_ctl( stream_.pollDescriptor, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, pfd.fd, &event );
+  }
+}
+
+// Runs the next period on the thread calling processOnce().
+int RtApiAlsa :: processExternal( int timeout )
+{
+  if ( stream_.state != STREAM_RUNNING ) return 0;
+  if ( !waitForPeriod( timeout ) ) return 0;
+  callbackEvent();
+  return 1;
+}
+
+// Waits for a full period of the given direction to be available and
+// maps it, returning the channel areas of the device buffer.  NULL is
+// returned if the period is not contiguous, in which case it must be
+// transferred with the snd_pcm_mmap_* read/write functions, which also
+// report errors.  Only called from the callback thread.
+const snd_pcm_channel_area_t *RtApiAlsa :: mmapAreas( StreamMode mode )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[mode];
+
+  snd_pcm_sframes_t avail;
+  while ( ( avail = snd_pcm_avail_update( handle ) ) >= 0 &&
+          avail < (snd_pcm_sframes_t) stream_.bufferSize ) {
+    // Capture devices must be started explicitly with mmap access.
+    int result = 0;
+    if ( snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED )
+      result = snd_pcm_start( handle );
+    if ( result >= 0 )
+      result = snd_pcm_wait( handle, 1000 );
+    if ( result < 0 ) return 0;
+  }
+  if ( avail < 0 ) return 0;
+
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t offset, frames = stream_.bufferSize;
+  if ( snd_pcm_mmap_begin( handle, &areas, &offset, &frames ) < 0 || frames < stream_.bufferSize )
+    return 0;
+
+  apiInfo->mmapOffset[mode] = offset;
+  return areas;
+}
+
+// Maps a period of an interleaved device, returning a pointer to it in
+// the device buffer, or NULL if it must be transferred instead (see
+// mmapAreas()).  Only called from the callback thread.
+char *RtApiAlsa :: mmapBegin( StreamMode mode )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  if ( !stream_.deviceInterleaved[mode] ) return 0;
+
+  const snd_pcm_channel_area_t *areas = mmapAreas( mode );
+  if ( areas == 0 ) return 0;
+  return (char *) areas[0].addr + ( areas[0].first + apiInfo->mmapOffset[mode] * areas[0].step ) / 8;
+}
+
+// Returns whether a planar callback can be given the channels of a
+// mapped period of the device in place, which requires a
+// non-interleaved FLOAT32 device in host byte order, and no aggregate
+// devices or sample rate conversion sharing the user buffers.
+bool RtApiAlsa :: usePlanes( StreamMode mode )
+{
+  return ( stream_.planar && !stream_.rateConversion && aggregate_.empty() &&
+           !stream_.deviceInterleaved[mode] && !stream_.doByteSwap[mode] &&
+           stream_.deviceFormat[mode] == RTAUDIO_FLOAT32 );
+}
+
+// Maps a period of a non-interleaved device and points the channels of
+// the planar callback at it, silencing the output channels that the
+// stream does not use.  False is returned if the period must be
+// transferred through the user buffer instead, because it is not
+// contiguous.  Only called from the callback thread.
+bool RtApiAlsa :: mmapPlanes( StreamMode mode )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  const snd_pcm_channel_area_t *areas = mmapAreas( mode );
+  if ( areas == 0 ) return false;
+
+  unsigned int channels = stream_.nDeviceChannels[mode];
+  for ( unsigned int i=0; i<channels; i++ )
+    if ( areas[i].step != 8 * sizeof( float ) || areas[i].first % ( 8 * sizeof( float ) ) ) return false;
+
+  std::vector<float *> &planes = stream_.planar->channels[mode];
+  unsigned int first = stream_.channelOffset[mode];
+  snd_pcm_uframes_t offset = apiInfo->mmapOffset[mode];
+  for ( unsigned int i=0; i<channels; i++ ) {
+    float *samples = (float *) areas[i].addr + areas[i].first / ( 8 * sizeof( float ) ) + offset;
+    if ( i >= first && i - first < planes.size() )
+      planes[i - first] = samples;
+    else if ( mode == OUTPUT )
+      memset( samples, 0, stream_.bufferSize * sizeof( float ) );
+  }
+  return true;
+}
+
+// Commits the period mapped by mmapBegin().  Only called from the
+// callback thread.
+void RtApiAlsa :: mmapCommit( StreamMode mode )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[mode];
+  snd_pcm_sframes_t result = snd_pcm_mmap_commit( handle, apiInfo->mmapOffset[mode], stream_.bufferSize );
+  if ( result == (snd_pcm_sframes_t) stream_.bufferSize ) {
+    snd_pcm_sframes_t frames;
+    if ( snd_pcm_delay( handle, &frames ) == 0 && frames > 0 ) stream_.latency[mode] = frames;
+    return;
+  }
+
+  // An xrun occurred while the period was mapped.
+  if ( result >= 0 || result == -EPIPE ) {
+    apiInfo->xrun[mode] = true;
+    result = snd_pcm_prepare( handle );
+    if ( result >= 0 ) return;
+  }
+  errorStream_ << "RtApiAlsa::callbackEvent: error committing mmap transfer, " << snd_strerror( result ) << ".";
+  errorText_ = errorStream_.str();
+  error( RTAUDIO_WARNING );
+}
+
+// Opens a device of an aggregate stream, whose channels start at
+// userChannel in the user buffer of the given direction.  The stream
+// device of that direction must be set up already.  Any sample rate
+// supported by the device is accepted, since its samples are
+// resampled anyway.
+bool RtApiAlsa :: openAggregate( StreamMode mode, const RtAudio::StreamParameters &parameters,
+                                 unsigned int userChannel )
+{
+  std::string name;
+  for ( auto& id : deviceIdPairs_) {
+    if ( id.second == parameters.deviceId ) {
+      name = id.first;
+      break;
+    }
+  }
+  if ( name.empty() || parameters.nChannels == 0 ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: invalid aggregate device ID (" << parameters.deviceId << ") or channel count.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  if ( stream_.stats.nDrift >= RtAudio::StreamStats::MAX_DRIFT_DEVICES ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: too many aggregate devices (at most " << RtAudio::StreamStats::MAX_DRIFT_DEVICES << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  snd_pcm_t *phandle;
+  snd_pcm_stream_t stream = ( mode == OUTPUT ) ? SND_PCM_STREAM_PLAYBACK : SND_PCM_STREAM_CAPTURE;
+  int result = snd_pcm_open( &phandle, name.c_str(), stream, SND_PCM_NONBLOCK );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: aggregate pcm device (" << name << ") won't open, " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // From here on, the device is closed by closeAggregate() on failure.
+  AggregateDevice *device = new AggregateDevice;
+  device->handle = phandle;
+  device->mode = mode;
+  device->name = name;
+  device->channels = parameters.nChannels;
+  aggregate_.push_back( device );
+
+  // Samples are resampled as FLOAT32, so the formats closest to it are
+  // preferred.
+  static const struct { snd_pcm_format_t alsaFormat; RtAudioFormat format; } formats[] = {
+    { SND_PCM_FORMAT_FLOAT, RTAUDIO_FLOAT32 }, { SND_PCM_FORMAT_S32, RTAUDIO_SINT32 },
+    { SND_PCM_FORMAT_S24, RTAUDIO_SINT24 }, { SND_PCM_FORMAT_S16, RTAUDIO_SINT16 },
+    { SND_PCM_FORMAT_FLOAT64, RTAUDIO_FLOAT64 }, { SND_PCM_FORMAT_S8, RTAUDIO_SINT8 } };
+  snd_pcm_format_t deviceFormat = SND_PCM_FORMAT_UNKNOWN;
+  unsigned int rate = stream_.sampleRate, periods = std::max( stream_.nBuffers, 4u );
+  unsigned int value;
+  snd_pcm_uframes_t periodFrames;
+  int dir = 0;
+
+  snd_pcm_hw_params_t *hw_params;
+  snd_pcm_hw_params_alloca( &hw_params );
+  result = snd_pcm_hw_params_any( phandle, hw_params );
+  if ( result >= 0 )
+    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: error setting interleaved access on aggregate device (" << name << "), " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  for ( unsigned int i=0; i<sizeof( formats ) / sizeof( formats[0] ); i++ ) {
+    if ( snd_pcm_hw_params_test_format( phandle, hw_params, formats[i].alsaFormat ) == 0 ) {
+      deviceFormat = formats[i].alsaFormat;
+      device->deviceFormat = formats[i].format;
+      break;
+    }
+  }
+  result = -EINVAL;
+  if ( deviceFormat != SND_PCM_FORMAT_UNKNOWN )
+    result = snd_pcm_hw_params_set_format( phandle, hw_params, deviceFormat );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: aggregate device (" << name << ") data format not supported by RtAudio.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  device->doByteSwap = ( deviceFormat != SND_PCM_FORMAT_S8 && snd_pcm_format_cpu_endian( deviceFormat ) == 0 );
+
+  result = snd_pcm_hw_params_get_channels_max( hw_params, &value );
+  if ( result < 0 || value < parameters.nChannels + parameters.firstChannel ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: requested channel parameters not supported by aggregate device (" << name << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  snd_pcm_hw_params_get_channels_min( hw_params, &value );
+  device->deviceChannels = std::max( value, parameters.nChannels + parameters.firstChannel );
+
+  result = snd_pcm_hw_params_set_channels( phandle, hw_params, device->deviceChannels );
+  if ( result >= 0 )
+    result = snd_pcm_hw_params_set_rate_near( phandle, hw_params, &rate, 0 );
+  if ( result >= 0 ) {
+    periodFrames = (snd_pcm_uframes_t) stream_.bufferSize * rate / stream_.sampleRate;
+    result = snd_pcm_hw_params_set_period_size_near( phandle, hw_params, &periodFrames, &dir );
+  }
+  if ( result >= 0 )
+    result = snd_pcm_hw_params_set_periods_near( phandle, hw_params, &periods, &dir );
+  if ( result >= 0 )
+    result = snd_pcm_hw_params( phandle, hw_params );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: error configuring aggregate device (" << name << "), " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  snd_pcm_hw_params_get_period_size( hw_params, &periodFrames, &dir );
+  snd_pcm_hw_params_get_buffer_size( hw_params, &device->bufferFrames );
+
+  // The device is started by the callback thread once it holds enough
+  // samples.
+  snd_pcm_sw_params_t *sw_params;
+  snd_pcm_sw_params_alloca( &sw_params );
+  snd_pcm_uframes_t boundary;
+  snd_pcm_sw_params_current( phandle, sw_params );
+  snd_pcm_sw_params_get_boundary( sw_params, &boundary );
+  snd_pcm_sw_params_set_start_threshold( phandle, sw_params, boundary );
+  result = snd_pcm_sw_params( phandle, sw_params );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: error installing software configuration on aggregate device (" << name << "), " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Output is kept one stream period short of a full device buffer.
+  // Input is kept a device period ahead of what each period consumes.
+  // Both levels are in device frames, which flow at the device rate.
+  double streamPeriod = (double) stream_.bufferSize * rate / stream_.sampleRate;
+  if ( mode == OUTPUT ) {
+    device->ratio = (double) rate / stream_.sampleRate;
+    device->maxFrames = (unsigned int) ( streamPeriod * 1.01 ) + 2;
+    device->target = device->bufferFrames - streamPeriod;
+    if ( device->target < 2 * streamPeriod ) {
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: buffer of aggregate device (" << name << ") too small for the stream buffer size.";
+      errorText_ = errorStream_.str();
+      return FAILURE;
+    }
+    device->resampler = new Resampler( device->channels, device->ratio, stream_.bufferSize );
+  }
+  else {
+    device->ratio = (double) stream_.sampleRate / rate;
+    device->maxFrames = device->bufferFrames;
+    device->resampler = new Resampler( device->channels, device->ratio, device->bufferFrames + periodFrames );
+    device->target = streamPeriod + periodFrames + device->resampler->latency();
+  }
+  device->loop.setup( streamPeriod, (double) stream_.sampleRate / stream_.bufferSize );
+  device->driftIndex = stream_.stats.nDrift++;
+  stream_.stats.drift[device->driftIndex].store( 0.0, std::memory_order_relaxed );
+
+  // The device side is interleaved, starting at the first channel.
+  // The output device buffer is followed by silence used to start the
+  // device with a full buffer.
+  unsigned int streamFrames = std::max( stream_.bufferSize, device->maxFrames );
+  device->floatBuffer[0].resize( (size_t) streamFrames * device->channels );
+  device->floatBuffer[1].resize( (size_t) streamFrames * device->channels );
+  size_t deviceFrames = device->maxFrames;
+  if ( mode == OUTPUT ) deviceFrames += (size_t) device->target;
+  device->deviceBuffer.resize( deviceFrames * device->deviceChannels * formatBytes( device->deviceFormat ) );
+
+  ConvertInfo &toFloat = device->toFloat, &fromFloat = device->fromFloat;
+  ConvertInfo &user = ( mode == OUTPUT ) ? toFloat : fromFloat;
+  ConvertInfo &alsa = ( mode == OUTPUT ) ? fromFloat : toFloat;
+  toFloat.channels = fromFloat.channels = device->channels;
+  toFloat.outFormat = fromFloat.inFormat = RTAUDIO_FLOAT32;
+  toFloat.outJump = fromFloat.inJump = device->channels;
+  toFloat.clearOutput = fromFloat.clearOutput = false;
+  if ( mode == OUTPUT ) {
+    toFloat.inFormat = stream_.userFormat;
+    fromFloat.outFormat = device->deviceFormat;
+  }
+  else {
+    toFloat.inFormat = device->deviceFormat;
+    fromFloat.outFormat = stream_.userFormat;
+  }
+  int &userJump = ( mode == OUTPUT ) ? user.inJump : user.outJump;
+  int &deviceJump = ( mode == OUTPUT ) ? alsa.outJump : alsa.inJump;
+  std::vector<int> &userOffset = ( mode == OUTPUT ) ? user.inOffset : user.outOffset;
+  std::vector<int> &deviceOffset = ( mode == OUTPUT ) ? alsa.outOffset : alsa.inOffset;
+  userJump = stream_.userInterleaved ? stream_.nUserChannels[mode] : 1;
+  deviceJump = device->deviceChannels;
+  for ( unsigned int k=0; k<device->channels; k++ ) {
+    toFloat.outOffset.push_back( k );
+    fromFloat.inOffset.push_back( k );
+    if ( stream_.userInterleaved )
+      userOffset.push_back( userChannel + k );
+    else
+      userOffset.push_back( ( userChannel + k ) * stream_.bufferSize );
+    deviceOffset.push_back( parameters.firstChannel + k );
+  }
+  setConvertPlan( toFloat );
+  setConvertPlan( fromFloat );
+
+  return SUCCESS;
+}
+
+void RtApiAlsa :: closeAggregate()
+{
+  for ( size_t i=0; i<aggregate_.size(); i++ )
+    delete aggregate_[i];
+  aggregate_.clear();
+}
+
+// Stops the aggregate devices.  Only called from the callback thread.
+void RtApiAlsa :: stopAggregate()
+{
+  for ( size_t i=0; i<aggregate_.size(); i++ ) {
+    snd_pcm_drop( aggregate_[i]->handle );
+    aggregate_[i]->running = false;
+  }
+}
+
+// Fills the aggregate channels of the user input buffer with a period
+// resampled from each aggregate input device.  A device is started,
+// and its channels left silent, until a little more than a period is
+// buffered.  Only called from the callback thread.
+void RtApiAlsa :: readAggregate()
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  for ( size_t i=0; i<aggregate_.size(); i++ ) {
+    AggregateDevice *device = aggregate_[i];
+    if ( device->mode != INPUT ) continue;
+    snd_pcm_t *handle = device->handle;
+    Resampler *resampler = device->resampler;
+
+    snd_pcm_state_t state = snd_pcm_state( handle );
+    if ( state != SND_PCM_STATE_RUNNING ) {
+      device->running = false;
+      resampler->reset();
+      if ( state != SND_PCM_STATE_PREPARED ) snd_pcm_prepare( handle );
+      snd_pcm_start( handle );
+    }
+
+    // Take everything captured so far.
+    snd_pcm_uframes_t frames = std::min( (snd_pcm_uframes_t) resampler->writeAvailable(), device->bufferFrames );
+    snd_pcm_sframes_t result = snd_pcm_readi( handle, &device->deviceBuffer[0], frames );
+    if ( result == -EPIPE ) {
+      apiInfo->xrun[1] = true;
+      device->running = false;
+      snd_pcm_prepare( handle );
+    }
+    else if ( result > 0 ) {
+      if ( device->doByteSwap )
+        byteSwapBuffer( &device->deviceBuffer[0], result * device->deviceChannels, device->deviceFormat );
+      char *floatBuffer = (char *) &device->floatBuffer[0][0];
+      device->toFloat.convert( floatBuffer, &device->deviceBuffer[0], device->toFloat, result );
+      resampler->write( &device->floatBuffer[0][0], result );
+    }
+
+    double level = resampler->bufferedFrames();
+    if ( !device->running && level >= device->target ) device->running = true;
+
+    unsigned int produced = 0;
+    float *output = &device->floatBuffer[1][0];
+    if ( device->running ) {
+      resampler->setRatio( device->ratio * ( 1.0 + device->loop.update( level - device->target ) ) );
+      stream_.stats.drift[device->driftIndex].store( -device->loop.drift() * 1e6, std::memory_order_relaxed );
+      produced = resampler->read( output, stream_.bufferSize );
+      if ( produced < stream_.bufferSize ) {
+        apiInfo->xrun[1] = true;
+        device->running = false;
+      }
+    }
+    std::fill( output + (size_t) produced * device->channels, output + (size_t) stream_.bufferSize * device->channels, 0.0f );
+    device->fromFloat.convert( stream_.userBuffer[1], (char *) output, device->fromFloat, stream_.bufferSize );
+  }
+}
+
+// Resamples the aggregate channels of the user output buffer to each
+// aggregate output device.  A device is started with a buffer of
+// silence, so that it holds the target level after the first period
+// is written.  Periods that don't fit in a device buffer are dropped.
+// Only called from the callback thread.
+void RtApiAlsa :: writeAggregate()
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  for ( size_t i=0; i<aggregate_.size(); i++ ) {
+    AggregateDevice *device = aggregate_[i];
+    if ( device->mode != OUTPUT ) continue;
+    snd_pcm_t *handle = device->handle;
+    Resampler *resampler = device->resampler;
+    char *buffer = &device->deviceBuffer[0];
+
+    float *input = &device->floatBuffer[0][0];
+    device->toFloat.convert( (char *) input, stream_.userBuffer[0], device->toFloat, stream_.bufferSize );
+    resampler->write( input, stream_.bufferSize );
+    unsigned int frames = resampler->read( &device->floatBuffer[1][0], device->maxFrames );
+    device->fromFloat.convert( buffer, (char *) &device->floatBuffer[1][0], device->fromFloat, frames );
+    if ( device->doByteSwap )
+      byteSwapBuffer( buffer, frames * device->deviceChannels, device->deviceFormat );
+
+    if ( !device->running ) {
+      snd_pcm_state_t state = snd_pcm_state( handle );
+      if ( state != SND_PCM_STATE_PREPARED ) snd_pcm_prepare( handle );
+      char *silence = buffer + (size_t) device->maxFrames * device->deviceChannels * formatBytes( device->deviceFormat );
+      snd_pcm_uframes_t prefill = (snd_pcm_uframes_t) device->target - frames;
+      snd_pcm_writei( handle, silence, prefill );
+    }
+
+    snd_pcm_sframes_t result = snd_pcm_writei( handle, buffer, frames );
+    if ( result == -EPIPE ) {
+      apiInfo->xrun[0] = true;
+      device->running = false;
+      resampler->reset();
+      continue;
+    }
+
+    if ( !device->running ) {
+      device->running = ( snd_pcm_start( handle ) == 0 );
+      continue;
+    }
+
+    snd_pcm_sframes_t delay;
+    if ( snd_pcm_delay( handle, &delay ) == 0 ) {
+      resampler->setRatio( device->ratio * ( 1.0 + device->loop.update( delay - device->target ) ) );
+      stream_.stats.drift[device->driftIndex].store( device->loop.drift() * 1e6, std::memory_order_relaxed );
+    }
+  }
+}
+
+static void *alsaCallbackHandler( void *ptr )
+{
+  CallbackInfo *info = (CallbackInfo *) ptr;
+  RtApiAlsa *object = (RtApiAlsa *) info->object;
+  bool *isRunning = &info->isRunning;
+
+  bool realtime = object->configureCallbackThread();
+  if ( info->doRealtime ) {
+    std::cerr << "RtAudio alsa: " << 
+             ( realtime ? "" : "_NOT_ " ) << 
+             "running realtime scheduling" << std::endl;
+  }
+
+  while ( *isRunning == true ) {
+    pthread_testcancel();
+    object->callbackEvent();
+  }
+
+  pthread_exit( NULL );
+}
+
+//******************** End of __LINUX_ALSA__ *********************//
+#endif
+
+#if defined(__LINUX_PULSE__)
+
+// Code written by Peter Meerwald, pmeerw@pmeerw.net and Tristan Matthews.
+// Updated by Gary Scavone, 2021.
+
+#include <pulse/error.h>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 
 // A structure needed to pass variables for device probing.
 struct PaDeviceProbeInfo {
@@ -9171,20 +11375,133 @@ struct rtaudio_pa_format_mapping_t {
 
 static const rtaudio_pa_format_mapping_t supported_sampleformats[] = {
   {RTAUDIO_SINT16, PA_SAMPLE_S16LE},
-  {RTAUDIO_SINT24, PA_SAMPLE_S24LE},
+  {RTAUDIO_SINT24, PA_SAMPLE_S24_32LE},
   {RTAUDIO_SINT32, PA_SAMPLE_S32LE},
   {RTAUDIO_FLOAT32, PA_SAMPLE_FLOAT32LE},
   {0, PA_SAMPLE_INVALID}};
 
 struct PulseAudioHandle {
-  pa_simple *s_play;
-  pa_simple *s_rec;
-  pthread_t thread;
-  pthread_cond_t runnable_cv;
-  bool runnable;
-  PulseAudioHandle() : s_play(0), s_rec(0), runnable(false) { }
+  pa_threaded_mainloop *mainloop;
+  pa_context *context;
+  pa_stream *play;
+  pa_stream *rec;
+  size_t periodBytes[2]; // One period in the device format.
+  size_t inputFill;      // Bytes of the current input period received so far.
+  long long inputTime;   // Capture time of the input period being processed, or 0.
+  bool xrun[2];          // Set by the underflow and overflow callbacks.
+  bool schedulePending;  // Realtime priority still to be applied.
+  int stopRequest; // 1 = stop, 2 = abort, posted with STREAM_STOPPING.
+  int stopResult;
+  int wakeup[2];         // Pipe signalled when processOnce() has periods to process.
+  bool wakeupPending;    // A byte is in the pipe.
+  int periodCount;       // Periods processed by the current processOnce() call.
+  PulseAudioHandle()
+    :mainloop(0), context(0), play(0), rec(0), inputFill(0), inputTime(0), schedulePending(false),
+     stopRequest(0), stopResult(0), wakeupPending(false), periodCount(0)
+  { periodBytes[0] = periodBytes[1] = 0; xrun[0] = xrun[1] = false; wakeup[0] = wakeup[1] = -1; }
 };
 
+// The following functions are called on the mainloop thread of an
+// open stream.  These two wake up a thread waiting on the mainloop for
+// a context or stream state change.
+static void rt_pa_context_notify( pa_context * /*c*/, void *userdata )
+{
+  pa_threaded_mainloop_signal( static_cast<pa_threaded_mainloop *>( userdata ), 0 );
+}
+
+static void rt_pa_stream_notify( pa_stream * /*s*/, void *userdata )
+{
+  pa_threaded_mainloop_signal( static_cast<pa_threaded_mainloop *>( userdata ), 0 );
+}
+
+// Called when the server requests more output.
+static void rt_pa_stream_write( pa_stream * /*s*/, size_t /*nbytes*/, void *userdata )
+{
+  static_cast<RtApiPulse *>( userdata )->writeEvent();
+}
+
+// Called when input data is available.
+static void rt_pa_stream_read( pa_stream * /*s*/, size_t /*nbytes*/, void *userdata )
+{
+  static_cast<RtApiPulse *>( userdata )->readEvent();
+}
+
+// Returns the time, in nanoseconds of the monotonic clock, at which
+// the byte at the given offset from the write index of a playback
+// stream will be played, or from the read index of a record stream was
+// captured.  It is taken from the latest timing info of the stream,
+// which the server updates regularly, and is 0 without one.
+static long long rt_pa_stream_time( pa_stream *s, bool playback, double offset, double nanosPerByte )
+{
+  const pa_timing_info *info = pa_stream_get_timing_info( s );
+  if ( !info || info->read_index_corrupt || info->write_index_corrupt ) return 0;
+
+  // The timing info is stamped with the real time clock.
+  long long now = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+  long long time = ( info->timestamp.tv_sec * 1000000LL + info->timestamp.tv_usec ) * 1000 - now + monotonicNanos();
+  if ( playback )
+    return time + (long long) info->sink_usec * 1000 + (long long) ( ( info->write_index - info->read_index + offset ) * nanosPerByte );
+  return time - (long long) info->source_usec * 1000 + (long long) ( ( info->read_index - info->write_index + offset ) * nanosPerByte );
+}
+
+// The xruns are reported with the status of the next callback.
+static void rt_pa_stream_underflow( pa_stream * /*s*/, void *userdata )
+{
+  static_cast<PulseAudioHandle *>( userdata )->xrun[0] = true;
+}
+
+static void rt_pa_stream_overflow( pa_stream * /*s*/, void *userdata )
+{
+  static_cast<PulseAudioHandle *>( userdata )->xrun[1] = true;
+}
+
+static void rt_pa_stream_drained( pa_stream * /*s*/, int success, void *userdata )
+{
+  static_cast<RtApiPulse *>( userdata )->drainEvent( success );
+}
+
+// Releases the operation started by an asynchronous request, which is
+// left to complete without being waited on.  Returns false if the
+// request failed.
+static bool rt_pa_release( pa_operation *operation )
+{
+  if ( !operation ) return false;
+  pa_operation_unref( operation );
+  return true;
+}
+
+// Disconnects the streams and context of a handle and stops its
+// mainloop thread.
+static void rt_pa_close_handle( PulseAudioHandle *pah )
+{
+  if ( !pah->mainloop ) return;
+
+  pa_threaded_mainloop_lock( pah->mainloop );
+  pa_stream **streams[2] = { &pah->play, &pah->rec };
+  for ( int i=0; i<2; i++ ) {
+    if ( *streams[i] ) {
+      pa_stream_disconnect( *streams[i] );
+      pa_stream_unref( *streams[i] );
+      *streams[i] = 0;
+    }
+  }
+  if ( pah->context ) {
+    pa_context_disconnect( pah->context );
+    pa_context_unref( pah->context );
+    pah->context = 0;
+  }
+  pa_threaded_mainloop_unlock( pah->mainloop );
+
+  pa_threaded_mainloop_stop( pah->mainloop );
+  pa_threaded_mainloop_free( pah->mainloop );
+  pah->mainloop = 0;
+
+  for ( int i=0; i<2; i++ ) {
+    if ( pah->wakeup[i] >= 0 ) close( pah->wakeup[i] );
+    pah->wakeup[i] = -1;
+  }
+}
+
 // The following 3 functions are called by the device probing
 // system. This first one gets overall system information.
 static void rt_pa_set_server_info( pa_context *context, const pa_server_info *info, void *userdata )
@@ -9391,28 +11708,6 @@ quit:
   pa_xfree(server);
 }
 
-static void *pulseaudio_callback( void * user )
-{
-  CallbackInfo *cbi = static_cast<CallbackInfo *>( user );
-  RtApiPulse *context = static_cast<RtApiPulse *>( cbi->object );
-  volatile bool *isRunning = &cbi->isRunning;
-  
-#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
-  if (cbi->doRealtime) {
-    std::cerr << "RtAudio pulse: " << 
-             (sched_getscheduler(0) == SCHED_RR ? "" : "_NOT_ ") << 
-             "running realtime scheduling" << std::endl;
-  }
-#endif
-  
-  while ( *isRunning ) {
-    pthread_testcancel();
-    context->callbackEvent();
-  }
-
-  pthread_exit( NULL );
-}
-
 bool RtApiPulse::probeDeviceOpen( unsigned int deviceId, StreamMode mode,
                                   unsigned int channels, unsigned int firstChannel,
                                   unsigned int sampleRate, RtAudioFormat format,
@@ -9456,6 +11751,12 @@ bool RtApiPulse::probeDeviceOpen( unsigned int deviceId, StreamMode mode,
 
   ss.channels = channels;
 
+  // Unless asked to resample, leave rate conversions to the server.
+  unsigned int deviceRate = deviceList_[deviceIdx].preferredSampleRate;
+  if ( deviceRate > 0 && sampleRate != deviceRate &&
+       convertStreamRate( sampleRate, deviceRate, bufferSize, options ) )
+    sampleRate = deviceRate;
+
   bool sr_found = false;
   for ( const unsigned int *sr = SUPPORTED_SAMPLERATES; *sr; ++sr ) {
     if ( sampleRate == *sr ) {
@@ -9497,6 +11798,7 @@ bool RtApiPulse::probeDeviceOpen( unsigned int deviceId, StreamMode mode,
   stream_.nDeviceChannels[mode] = channels + firstChannel;
   stream_.channelOffset[mode] = 0;
   std::string streamName = "RtAudio";
+  if ( options && !options->streamName.empty() ) streamName = options->streamName;
 
   // Set flags for buffer conversion.
   stream_.doConvertBuffer[mode] = false;
@@ -9507,6 +11809,10 @@ bool RtApiPulse::probeDeviceOpen( unsigned int deviceId, StreamMode mode,
   if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] )
     stream_.doConvertBuffer[mode] = true;
 
+  // The server requests and delivers whole periods, so a size must be
+  // chosen when none is given.
+  if ( *bufferSize == 0 ) *bufferSize = 256;
+
   // Allocate necessary internal buffers.
   bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
   stream_.userBuffer[mode] = (char *) calloc( bufferBytes, 1 );
@@ -9543,71 +11849,71 @@ bool RtApiPulse::probeDeviceOpen( unsigned int deviceId, StreamMode mode,
   // Setup the buffer conversion information structure.
   if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
 
+  // Both directions of a stream share one context, serviced by the
+  // thread of a threaded mainloop.
   if ( !stream_.apiHandle ) {
-    PulseAudioHandle *pah = new PulseAudioHandle;
-    if ( !pah ) {
-      errorText_ = "RtApiPulse::probeDeviceOpen: error allocating memory for handle.";
-      goto error;
-    }
-
+    pah = new PulseAudioHandle;
     stream_.apiHandle = pah;
-    if ( pthread_cond_init( &pah->runnable_cv, NULL ) != 0 ) {
-      errorText_ = "RtApiPulse::probeDeviceOpen: error creating condition variable.";
+
+    pah->mainloop = pa_threaded_mainloop_new();
+    if ( pah->mainloop )
+      pah->context = pa_context_new( pa_threaded_mainloop_get_api( pah->mainloop ),
+                                     streamName.c_str() );
+    if ( !pah->context ) {
+      errorText_ = "RtApiPulse::probeDeviceOpen: error creating PulseAudio mainloop or context.";
       goto error;
     }
-  }
-  pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
 
-  int error;
-  if ( options && !options->streamName.empty() ) streamName = options->streamName;
-  switch ( mode ) {
-    pa_buffer_attr buffer_attr;
-  case INPUT:
-    buffer_attr.fragsize = bufferBytes;
-    if ( options && options->numberOfBuffers > 0 )
-      buffer_attr.maxlength = bufferBytes * (options->numberOfBuffers + 1);
-    else
-      buffer_attr.maxlength = bufferBytes * 4;
-
-    pah->s_rec = pa_simple_new( NULL, streamName.c_str(), PA_STREAM_RECORD,
-                                dev_input, "Record", &ss, NULL, &buffer_attr, &error );
-    if ( !pah->s_rec ) {
-      errorText_ = "RtApiPulse::probeDeviceOpen: error connecting input to PulseAudio server.";
-      goto error;
+    pa_context_set_state_callback( pah->context, rt_pa_context_notify, pah->mainloop );
+    pa_threaded_mainloop_lock( pah->mainloop );
+    int result = pa_threaded_mainloop_start( pah->mainloop );
+    if ( result == 0 )
+      result = pa_context_connect( pah->context, NULL, PA_CONTEXT_NOFLAGS, NULL );
+    if ( result == 0 ) {
+      pa_context_state_t state;
+      while ( ( state = pa_context_get_state( pah->context ) ) != PA_CONTEXT_READY ) {
+        if ( !PA_CONTEXT_IS_GOOD( state ) ) {
+          result = -1;
+          break;
+        }
+        pa_threaded_mainloop_wait( pah->mainloop );
+      }
     }
-    break;
-  case OUTPUT: {
-    pa_buffer_attr * attr_ptr;
-
-    if ( options && options->numberOfBuffers > 0 ) {
-      // pa_buffer_attr::fragsize is recording-only.
-      // Hopefully PortAudio won't access uninitialized fields.
-      buffer_attr.maxlength = bufferBytes * options->numberOfBuffers;
-      buffer_attr.minreq = -1;
-      buffer_attr.prebuf = -1;
-      buffer_attr.tlength = -1;
-      attr_ptr = &buffer_attr;
-    } else {
-      attr_ptr = nullptr;
+    pa_threaded_mainloop_unlock( pah->mainloop );
+    if ( result < 0 ) {
+      errorStream_ << "RtApiPulse::probeDeviceOpen: error connecting to PulseAudio server, " <<
+        pa_strerror( pa_context_errno( pah->context ) ) << ".";
+      errorText_ = errorStream_.str();
+      goto error;
     }
 
-    pah->s_play = pa_simple_new( NULL, streamName.c_str(), PA_STREAM_PLAYBACK,
-                                 dev_output, "Playback", &ss, NULL, attr_ptr, &error );
-    if ( !pah->s_play ) {
-      errorText_ = "RtApiPulse::probeDeviceOpen: error connecting output to PulseAudio server.";
-      goto error;
+    if ( options && ( options->flags & RTAUDIO_EXTERNAL_THREAD ) ) {
+      // The callback is run by processOnce() instead of the mainloop
+      // thread, which signals a pipe when the server requests data.
+      stream_.external = true;
+      if ( pipe( pah->wakeup ) == 0 ) {
+        for ( int i=0; i<2; i++ ) {
+          fcntl( pah->wakeup[i], F_SETFL, fcntl( pah->wakeup[i], F_GETFL ) | O_NONBLOCK );
+          fcntl( pah->wakeup[i], F_SETFD, FD_CLOEXEC );
+        }
+        stream_.pollDescriptor = pah->wakeup[0];
+      }
+      else {
+        errorText_ = "RtApiPulse::probeDeviceOpen: error creating the stream poll descriptor.";
+        goto error;
+      }
+    }
+    else {
+      setCallbackThreadOptions( options );
+      pah->schedulePending = true;
     }
-    break;
   }
-  case DUPLEX:
-    /* Note: We could add DUPLEX by synchronizing multiple streams,
-       but it would mean moving from Simple API to Asynchronous API:
-       https://freedesktop.org/software/pulseaudio/doxygen/streams.html#sync_streams */
-    errorText_ = "RtApiPulse::probeDeviceOpen: duplex not supported for PulseAudio.";
-    goto error;
-  default:
+  pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+
+  pah->periodBytes[mode] = *bufferSize * stream_.nDeviceChannels[mode] *
+    formatBytes( stream_.deviceFormat[mode] );
+  if ( !connectStream( mode, mode == OUTPUT ? dev_output : dev_input, &ss, options ) )
     goto error;
-  }
 
   if ( stream_.mode == UNINITIALIZED )
     stream_.mode = mode;
@@ -9616,64 +11922,17 @@ bool RtApiPulse::probeDeviceOpen( unsigned int deviceId, StreamMode mode,
   else
     stream_.mode = DUPLEX;
 
-  if ( !stream_.callbackInfo.isRunning ) {
-    stream_.callbackInfo.object = this;
-    
-    stream_.state = STREAM_STOPPED;
-    // Set the thread attributes for joinable and realtime scheduling
-    // priority (optional).  The higher priority will only take affect
-    // if the program is run as root or suid. Note, under Linux
-    // processes with CAP_SYS_NICE privilege, a user can change
-    // scheduling policy and priority (thus need not be root). See
-    // POSIX "capabilities".
-    pthread_attr_t attr;
-    pthread_attr_init( &attr );
-    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
-#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
-    if ( options && options->flags & RTAUDIO_SCHEDULE_REALTIME ) {
-      stream_.callbackInfo.doRealtime = true;
-      struct sched_param param;
-      int priority = options->priority;
-      int min = sched_get_priority_min( SCHED_RR );
-      int max = sched_get_priority_max( SCHED_RR );
-      if ( priority < min ) priority = min;
-      else if ( priority > max ) priority = max;
-      param.sched_priority = priority;
-      
-      // Set the policy BEFORE the priority. Otherwise it fails.
-      pthread_attr_setschedpolicy(&attr, SCHED_RR);
-      pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
-      // This is definitely required. Otherwise it fails.
-      pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-      pthread_attr_setschedparam(&attr, &param);
-    }
-    else
-      pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
-#else
-    pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
-#endif
-
-    stream_.callbackInfo.isRunning = true;
-    int result = pthread_create( &pah->thread, &attr, pulseaudio_callback, (void *)&stream_.callbackInfo);
-    pthread_attr_destroy(&attr);
-    if(result != 0) {
-      // Failed. Try instead with default attributes.
-      result = pthread_create( &pah->thread, NULL, pulseaudio_callback, (void *)&stream_.callbackInfo);
-      if(result != 0) {
-        stream_.callbackInfo.isRunning = false;
-        errorText_ = "RtApiPulse::probeDeviceOpen: error creating thread.";
-        goto error;
-      }
-    }
-  }
-
+  stream_.callbackInfo.object = this;
+  stream_.state = STREAM_STOPPED;
   return SUCCESS;
  
  error:
-  if ( pah && stream_.callbackInfo.isRunning ) {
-    pthread_cond_destroy( &pah->runnable_cv );
+  pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( pah ) {
+    rt_pa_close_handle( pah );
     delete pah;
     stream_.apiHandle = 0;
+    stream_.pollDescriptor = -1;
   }
 
   for ( int i=0; i<2; i++ ) {
@@ -9692,136 +11951,354 @@ bool RtApiPulse::probeDeviceOpen( unsigned int deviceId, StreamMode mode,
   return FAILURE;
 }
 
-void RtApiPulse::closeStream( void )
+// Creates the playback or record stream and waits for the server to
+// accept it.  The server is asked to request output, or deliver input,
+// one period at a time.  Playback keeps numberOfBuffers periods queued
+// (4 by default).  With RTAUDIO_MINIMIZE_LATENCY, two periods are
+// queued and the server adjusts the device latency to match.  Record
+// streams hold at most twice as many periods at the server, beyond
+// which input is dropped and an overflow reported.  Returns false on
+// failure, with errorText_ set.
+bool RtApiPulse :: connectStream( StreamMode mode, const char *device, const pa_sample_spec *ss,
+                                  RtAudio::StreamOptions *options )
 {
   PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  uint32_t period = pah->periodBytes[mode];
+  uint32_t nBuffers = 4;
+  int flags = PA_STREAM_START_CORKED | PA_STREAM_AUTO_TIMING_UPDATE;
+  if ( options && options->flags & RTAUDIO_MINIMIZE_LATENCY ) {
+    nBuffers = 2;
+    flags |= PA_STREAM_ADJUST_LATENCY;
+  }
+  else if ( options && options->numberOfBuffers > 1 )
+    nBuffers = options->numberOfBuffers;
+
+  pa_buffer_attr attr;
+  attr.maxlength = (uint32_t) -1;
+  attr.prebuf = (uint32_t) -1;
+  attr.tlength = (uint32_t) -1;
+  attr.minreq = (uint32_t) -1;
+  attr.fragsize = (uint32_t) -1;
+  if ( mode == OUTPUT ) {
+    attr.tlength = period * nBuffers;
+    attr.minreq = period;
+  }
+  else {
+    attr.fragsize = period;
+    attr.maxlength = period * nBuffers * 2;
+  }
 
-  stream_.callbackInfo.isRunning = false;
-  if ( pah ) {
-    MUTEX_LOCK( &stream_.mutex );
-    if ( stream_.state == STREAM_STOPPED ) {
-      pah->runnable = true;
-      pthread_cond_signal( &pah->runnable_cv );
+  pa_threaded_mainloop_lock( pah->mainloop );
+  int result = -1;
+  pa_stream *s = pa_stream_new( pah->context, mode == OUTPUT ? "Playback" : "Record", ss, NULL );
+  if ( s ) {
+    pa_stream_set_state_callback( s, rt_pa_stream_notify, pah->mainloop );
+    if ( mode == OUTPUT ) {
+      pah->play = s;
+      pa_stream_set_write_callback( s, rt_pa_stream_write, this );
+      pa_stream_set_underflow_callback( s, rt_pa_stream_underflow, pah );
+      result = pa_stream_connect_playback( s, device, &attr, (pa_stream_flags_t) flags, NULL, NULL );
     }
-    MUTEX_UNLOCK( &stream_.mutex );
+    else {
+      pah->rec = s;
+      pa_stream_set_read_callback( s, rt_pa_stream_read, this );
+      pa_stream_set_overflow_callback( s, rt_pa_stream_overflow, pah );
+      result = pa_stream_connect_record( s, device, &attr, (pa_stream_flags_t) flags );
+    }
+  }
+  if ( result == 0 ) {
+    pa_stream_state_t state;
+    while ( ( state = pa_stream_get_state( s ) ) == PA_STREAM_CREATING )
+      pa_threaded_mainloop_wait( pah->mainloop );
+    if ( state != PA_STREAM_READY ) result = -1;
+  }
+  if ( result < 0 ) {
+    errorStream_ << "RtApiPulse::probeDeviceOpen: error connecting " <<
+      ( mode == OUTPUT ? "output" : "input" ) << " to PulseAudio server, " <<
+      pa_strerror( pa_context_errno( pah->context ) ) << ".";
+    errorText_ = errorStream_.str();
+    pa_threaded_mainloop_unlock( pah->mainloop );
+    return false;
+  }
+
+  // Report the buffering the server actually granted.
+  const pa_buffer_attr *actual = pa_stream_get_buffer_attr( s );
+  unsigned long frameBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
+  if ( mode == OUTPUT ) {
+    stream_.latency[mode] = actual->tlength / frameBytes;
+    stream_.nBuffers = std::max( actual->tlength / period, (uint32_t) 1 );
+  }
+  else
+    stream_.latency[mode] = actual->fragsize / frameBytes;
+  pa_threaded_mainloop_unlock( pah->mainloop );
+  return true;
+}
+
+void RtApiPulse::closeStream( void )
+{
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApiPulse::closeStream(): no open stream to close!";
+    error( RTAUDIO_WARNING );
+    return;
+  }
+
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( pah ) {
+    pa_threaded_mainloop_lock( pah->mainloop );
+    // Let the output drain after a stop requested by the callback.
+    while ( stream_.state == STREAM_STOPPING )
+      pa_threaded_mainloop_wait( pah->mainloop );
+    stream_.state.store( STREAM_STOPPED, std::memory_order_release );
+    if ( stream_.external ) wakeExternal();
+    pa_threaded_mainloop_unlock( pah->mainloop );
 
-    pthread_join( pah->thread, 0 );
-    if ( pah->s_play ) {
-      pa_simple_flush( pah->s_play, NULL );
-      pa_simple_free( pah->s_play );
+    // Wait for a concurrent processOnce() call to return.
+    if ( stream_.external ) {
+      MUTEX_LOCK( &stream_.processMutex );
+      MUTEX_UNLOCK( &stream_.processMutex );
     }
-    if ( pah->s_rec )
-      pa_simple_free( pah->s_rec );
 
-    pthread_cond_destroy( &pah->runnable_cv );
+    rt_pa_close_handle( pah );
     delete pah;
     stream_.apiHandle = 0;
   }
 
-  if ( stream_.userBuffer[0] ) {
-    free( stream_.userBuffer[0] );
-    stream_.userBuffer[0] = 0;
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
   }
-  if ( stream_.userBuffer[1] ) {
-    free( stream_.userBuffer[1] );
-    stream_.userBuffer[1] = 0;
+
+  if ( stream_.deviceBuffer ) {
+    free( stream_.deviceBuffer );
+    stream_.deviceBuffer = 0;
   }
 
   clearStreamInfo();
 }
 
-void RtApiPulse::callbackEvent( void )
+// Output-only streams run one period for each period of space the
+// server has requested.  Duplex streams are clocked by their input.
+void RtApiPulse :: writeEvent( void )
 {
   PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( pah->rec ) return;
+  if ( stream_.external && !inProcessOnce() ) {
+    wakeExternal();
+    return;
+  }
 
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_LOCK( &stream_.mutex );
-    while ( !pah->runnable )
-      pthread_cond_wait( &pah->runnable_cv, &stream_.mutex );
+  while ( stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING ) {
+    size_t writable = pa_stream_writable_size( pah->play );
+    if ( writable == (size_t) -1 || writable < pah->periodBytes[OUTPUT] ) break;
+    processPeriod( NULL );
+  }
+}
 
-    if ( stream_.state != STREAM_RUNNING ) {
-      MUTEX_UNLOCK( &stream_.mutex );
+// Gathers the input fragments delivered by the server into periods.
+// A whole period within a fragment is processed in place; otherwise
+// it is assembled in the stream buffer.  Holes in the input are
+// filled with silence.  Each period is timestamped from the capture
+// time of the fragment it ends in.
+void RtApiPulse :: readEvent( void )
+{
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( stream_.external && !inProcessOnce() ) {
+    wakeExternal();
+    return;
+  }
+
+  char *buffer = stream_.doConvertBuffer[INPUT] ? stream_.deviceBuffer : stream_.userBuffer[INPUT];
+  size_t period = pah->periodBytes[INPUT];
+  double nanosPerByte = 1e9 * stream_.bufferSize / ( (double) period * stream_.sampleRate );
+
+  while ( pa_stream_readable_size( pah->rec ) > 0 ) {
+    const void *data;
+    size_t bytes;
+    if ( pa_stream_peek( pah->rec, &data, &bytes ) < 0 ) {
+      errorStream_ << "RtApiPulse::readEvent: audio read error, " <<
+        pa_strerror( pa_context_errno( pah->context ) ) << ".";
+      errorText_ = errorStream_.str();
+      error( RTAUDIO_WARNING );
       return;
     }
-    MUTEX_UNLOCK( &stream_.mutex );
+    if ( bytes == 0 ) break;
+
+    const char *in = static_cast<const char *>( data );
+    size_t offset = 0;
+    while ( offset < bytes && stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING ) {
+      if ( in && pah->inputFill == 0 && bytes - offset >= period ) {
+        pah->inputTime = rt_pa_stream_time( pah->rec, false, (double) offset, nanosPerByte );
+        processPeriod( in + offset );
+        offset += period;
+        continue;
+      }
+
+      size_t n = std::min( period - pah->inputFill, bytes - offset );
+      if ( in ) memcpy( buffer + pah->inputFill, in + offset, n );
+      else memset( buffer + pah->inputFill, 0, n );
+      pah->inputFill += n;
+      offset += n;
+      if ( pah->inputFill == period ) {
+        pah->inputFill = 0;
+        pah->inputTime = rt_pa_stream_time( pah->rec, false, (double) offset - (double) period, nanosPerByte );
+        processPeriod( buffer );
+      }
+    }
+    pa_stream_drop( pah->rec );
   }
+}
 
-  if ( stream_.state == STREAM_CLOSED ) {
-    errorText_ = "RtApiPulse::callbackEvent(): the stream is closed ... "
-      "this shouldn't happen!";
-    error( RTAUDIO_WARNING );
-    return;
+// Runs the callback for one period, with the input (if any) at input
+// in the device format.  The output is written straight into memory
+// from pa_stream_begin_write() when the server provides a whole
+// period, and through the stream buffers otherwise.
+void RtApiPulse :: processPeriod( const char *input )
+{
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+
+  if ( pah->schedulePending ) {
+    // The mainloop thread is created by PulseAudio, so it is
+    // configured from the first period.
+    pah->schedulePending = false;
+    bool realtime = configureCallbackThread();
+    if ( stream_.callbackInfo.doRealtime )
+      std::cerr << "RtAudio pulse: " <<
+               ( realtime ? "" : "_NOT_ " ) <<
+               "running realtime scheduling" << std::endl;
+  }
+
+  if ( input ) {
+    if ( stream_.doConvertBuffer[INPUT] )
+      convertBuffer( stream_.userBuffer[INPUT], (char *) input, stream_.convertInfo[INPUT] );
+    else if ( input != stream_.userBuffer[INPUT] )
+      memcpy( stream_.userBuffer[INPUT], input, pah->periodBytes[INPUT] );
+  }
+
+  void *data = 0;
+  char *userOut = stream_.userBuffer[OUTPUT];
+  if ( pah->play ) {
+    size_t bytes = pah->periodBytes[OUTPUT];
+    if ( pa_stream_begin_write( pah->play, &data, &bytes ) < 0 )
+      data = 0;
+    else if ( bytes < pah->periodBytes[OUTPUT] ) {
+      pa_stream_cancel_write( pah->play );
+      data = 0;
+    }
+    if ( data && !stream_.doConvertBuffer[OUTPUT] ) userOut = (char *) data;
+  }
+
+  RtAudioStreamStatus status = 0;
+  if ( pah->xrun[OUTPUT] ) {
+    status |= RTAUDIO_OUTPUT_UNDERFLOW;
+    pah->xrun[OUTPUT] = false;
+  }
+  if ( pah->xrun[INPUT] ) {
+    status |= RTAUDIO_INPUT_OVERFLOW;
+    pah->xrun[INPUT] = false;
   }
 
+  // Timestamp the period.  Output is written at the write index.
+  if ( pah->play )
+    setStreamClock( OUTPUT, rt_pa_stream_time( pah->play, true, 0.0, 1e9 * stream_.bufferSize /
+                                               ( (double) pah->periodBytes[OUTPUT] * stream_.sampleRate ) ) );
+  if ( pah->rec ) setStreamClock( INPUT, pah->inputTime );
+
   RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
   double streamTime = getStreamTime();
-  RtAudioStreamStatus status = 0;
-  int doStopStream = callback( stream_.userBuffer[OUTPUT], stream_.userBuffer[INPUT],
+  beginCallback();
+  int doStopStream = callback( userOut, stream_.userBuffer[INPUT],
                                stream_.bufferSize, streamTime, status,
                                stream_.callbackInfo.userData );
+  endCallback( status );
 
   if ( doStopStream == 2 ) {
+    if ( data ) pa_stream_cancel_write( pah->play );
     abortStream();
     return;
   }
 
-  MUTEX_LOCK( &stream_.mutex );
-  void *pulse_in = stream_.doConvertBuffer[INPUT] ? stream_.deviceBuffer : stream_.userBuffer[INPUT];
-  void *pulse_out = stream_.doConvertBuffer[OUTPUT] ? stream_.deviceBuffer : stream_.userBuffer[OUTPUT];
-
-  if ( stream_.state != STREAM_RUNNING )
-    goto unlock;
+  // The callback may have called stopStream() or abortStream(), which
+  // corked or flushed the stream.
+  if ( stream_.state != STREAM_RUNNING ) {
+    if ( data ) pa_stream_cancel_write( pah->play );
+    return;
+  }
 
-  int pa_error;
-  size_t bytes;
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+  if ( pah->play ) {
+    char *out = userOut;
     if ( stream_.doConvertBuffer[OUTPUT] ) {
-        convertBuffer( stream_.deviceBuffer,
-                       stream_.userBuffer[OUTPUT],
-                       stream_.convertInfo[OUTPUT] );
-        bytes = stream_.nDeviceChannels[OUTPUT] * stream_.bufferSize *
-                formatBytes( stream_.deviceFormat[OUTPUT] );
-    } else
-        bytes = stream_.nUserChannels[OUTPUT] * stream_.bufferSize *
-                formatBytes( stream_.userFormat );
-
-    if ( pa_simple_write( pah->s_play, pulse_out, bytes, &pa_error ) < 0 ) {
-      errorStream_ << "RtApiPulse::callbackEvent: audio write error, " <<
-        pa_strerror( pa_error ) << ".";
-      errorText_ = errorStream_.str();
-      error( RTAUDIO_WARNING );
+      out = data ? (char *) data : stream_.deviceBuffer;
+      convertBuffer( out, stream_.userBuffer[OUTPUT], stream_.convertInfo[OUTPUT] );
     }
-  }
 
-  if ( stream_.mode == INPUT || stream_.mode == DUPLEX) {
-    if ( stream_.doConvertBuffer[INPUT] )
-      bytes = stream_.nDeviceChannels[INPUT] * stream_.bufferSize *
-        formatBytes( stream_.deviceFormat[INPUT] );
-    else
-      bytes = stream_.nUserChannels[INPUT] * stream_.bufferSize *
-        formatBytes( stream_.userFormat );
-            
-    if ( pa_simple_read( pah->s_rec, pulse_in, bytes, &pa_error ) < 0 ) {
-      errorStream_ << "RtApiPulse::callbackEvent: audio read error, " <<
-        pa_strerror( pa_error ) << ".";
+    if ( pa_stream_write( pah->play, out, pah->periodBytes[OUTPUT], NULL, 0, PA_SEEK_RELATIVE ) < 0 ) {
+      errorStream_ << "RtApiPulse::processPeriod: audio write error, " <<
+        pa_strerror( pa_context_errno( pah->context ) ) << ".";
       errorText_ = errorStream_.str();
       error( RTAUDIO_WARNING );
     }
-    if ( stream_.doConvertBuffer[INPUT] ) {
-      convertBuffer( stream_.userBuffer[INPUT],
-                     stream_.deviceBuffer,
-                     stream_.convertInfo[INPUT] );
-    }
   }
 
- unlock:
-  MUTEX_UNLOCK( &stream_.mutex );
   RtApi::tickStreamTime();
+  pah->periodCount++;
 
   if ( doStopStream == 1 )
     stopStream();
 }
 
+// Signals the pipe of a stream driven by processOnce(), once until the
+// next call.  This is also done when the stream stops or is closed, so
+// that a call waiting for the pipe returns.  Called with the mainloop
+// lock held.
+void RtApiPulse :: wakeExternal( void )
+{
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( pah->wakeupPending ) return;
+  char byte = 0;
+  if ( write( pah->wakeup[1], &byte, 1 ) == 1 ) pah->wakeupPending = true;
+}
+
+// Waits for the pipe and processes all the periods that the server
+// has requested, with the mainloop lock held as on the mainloop
+// thread.
+int RtApiPulse :: processExternal( int timeout )
+{
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( stream_.state != STREAM_RUNNING ) return 0;
+
+  struct pollfd pfd;
+  pfd.fd = pah->wakeup[0];
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  int result = poll( &pfd, 1, timeout );
+  if ( result < 0 && errno != EINTR ) {
+    errorText_ = "RtApiPulse::processOnce: error waiting for the stream.";
+    error( RTAUDIO_WARNING );
+    return -1;
+  }
+  if ( result <= 0 ) return 0;
+
+  char bytes[16];
+  while ( read( pah->wakeup[0], bytes, sizeof( bytes ) ) > 0 ) {}
+
+  pa_threaded_mainloop_lock( pah->mainloop );
+  pah->wakeupPending = false;
+  pah->periodCount = 0;
+  if ( stream_.state.load( std::memory_order_acquire ) != STREAM_RUNNING ) {
+    pa_threaded_mainloop_unlock( pah->mainloop );
+    return 0;
+  }
+  if ( pah->rec )
+    readEvent();
+  else
+    writeEvent();
+  int periods = pah->periodCount;
+  pa_threaded_mainloop_unlock( pah->mainloop );
+  return periods;
+}
+
 RtAudioErrorType RtApiPulse::startStream( void )
 {
   if ( stream_.state != STREAM_STOPPED ) {
@@ -9831,22 +12308,49 @@ RtAudioErrorType RtApiPulse::startStream( void )
       errorText_ = "RtApiPulse::startStream(): the stream is stopping or closed!";
     return error( RTAUDIO_WARNING );
   }
+
+  if ( stream_.rateConversion ) resetRateConversion();
   
   PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  bool ok = true;
+
+  pa_threaded_mainloop_lock( pah->mainloop );
+  pah->inputFill = 0;
+  pah->xrun[0] = pah->xrun[1] = false;
+  stream_.state.store( STREAM_RUNNING, std::memory_order_release );
+
+  if ( pah->play ) {
+    // Queue silence up to the target length, so playback begins as
+    // soon as the stream is uncorked.  The server then requests each
+    // further period through the write callback.
+    size_t bytes = pa_stream_writable_size( pah->play );
+    while ( ok && bytes > 0 && bytes != (size_t) -1 ) {
+      void *data = 0;
+      size_t n = bytes;
+      if ( pa_stream_begin_write( pah->play, &data, &n ) < 0 || !data ) {
+        ok = false;
+        break;
+      }
+      if ( n > bytes ) n = bytes;
+      memset( data, 0, n );
+      ok = ( pa_stream_write( pah->play, data, n, NULL, 0, PA_SEEK_RELATIVE ) == 0 );
+      bytes -= n;
+    }
+    ok = ok && rt_pa_release( pa_stream_cork( pah->play, 0, NULL, NULL ) );
+  }
+  if ( ok && pah->rec )
+    ok = rt_pa_release( pa_stream_cork( pah->rec, 0, NULL, NULL ) );
 
-  MUTEX_LOCK( &stream_.mutex );
-
-  /*
-  #if defined( HAVE_GETTIMEOFDAY )
-  gettimeofday( &stream_.lastTickTimestamp, NULL );
-  #endif
-  */
-  
-  stream_.state = STREAM_RUNNING;
+  if ( !ok ) {
+    errorStream_ << "RtApiPulse::startStream: error starting stream, " <<
+      pa_strerror( pa_context_errno( pah->context ) ) << ".";
+    errorText_ = errorStream_.str();
+    pah->stopRequest = 2;
+    finishStop( -1 );
+  }
+  pa_threaded_mainloop_unlock( pah->mainloop );
 
-  pah->runnable = true;
-  pthread_cond_signal( &pah->runnable_cv );
-  MUTEX_UNLOCK( &stream_.mutex );
+  if ( !ok ) return error( RTAUDIO_SYSTEM_ERROR );
   return RTAUDIO_NO_ERROR;
 }
 
@@ -9860,28 +12364,7 @@ RtAudioErrorType RtApiPulse::stopStream( void )
     return error( RTAUDIO_WARNING );
   }
     
-  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
-
-  stream_.state = STREAM_STOPPED;
-  MUTEX_LOCK( &stream_.mutex );
-
-  if ( pah ) {
-    pah->runnable = false;
-    if ( pah->s_play ) {
-      int pa_error;
-      if ( pa_simple_drain( pah->s_play, &pa_error ) < 0 ) {
-        errorStream_ << "RtApiPulse::stopStream: error draining output device, " <<
-          pa_strerror( pa_error ) << ".";
-        errorText_ = errorStream_.str();
-        MUTEX_UNLOCK( &stream_.mutex );
-        return error( RTAUDIO_SYSTEM_ERROR );
-      }
-    }
-  }
-
-  stream_.state = STREAM_STOPPED;
-  MUTEX_UNLOCK( &stream_.mutex );
-  return RTAUDIO_NO_ERROR;
+  return requestStop( 1 );
 }
 
 RtAudioErrorType RtApiPulse::abortStream( void )
@@ -9894,1589 +12377,4913 @@ RtAudioErrorType RtApiPulse::abortStream( void )
     return error( RTAUDIO_WARNING );
   }
   
-  PulseAudioHandle *pah = static_cast<PulseAudioHandle*>( stream_.apiHandle );
-
-  stream_.state = STREAM_STOPPED;
-  MUTEX_LOCK( &stream_.mutex );
+  return requestStop( 2 );
+}
 
-  if ( pah ) {
-    pah->runnable = false;
-    if ( pah->s_play ) {
-      int pa_error;
-      if ( pa_simple_flush( pah->s_play, &pa_error ) < 0 ) {
-        errorStream_ << "RtApiPulse::abortStream: error flushing output device, " <<
-          pa_strerror( pa_error ) << ".";
-        errorText_ = errorStream_.str();
-        MUTEX_UNLOCK( &stream_.mutex );
-        return error( RTAUDIO_SYSTEM_ERROR );
-      }
-    }
+// The streams are serviced on the mainloop thread, which holds the
+// mainloop lock while the callback runs.  A stop (1) or abort (2)
+// moves the stream to STREAM_STOPPING and, for a stop, drains the
+// output asynchronously.  A caller on any other thread then waits on
+// the mainloop until the stream is stopped, while a request made from
+// within the callback returns at once.
+RtAudioErrorType RtApiPulse::requestStop( int request )
+{
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( pa_threaded_mainloop_in_thread( pah->mainloop ) || inProcessOnce() ) {
+    if ( stream_.state == STREAM_RUNNING ) beginStop( request );
+    return RTAUDIO_NO_ERROR;
   }
 
-  stream_.state = STREAM_STOPPED;
-  MUTEX_UNLOCK( &stream_.mutex );
+  pa_threaded_mainloop_lock( pah->mainloop );
+  if ( stream_.state == STREAM_RUNNING ) beginStop( request );
+  while ( stream_.state == STREAM_STOPPING )
+    pa_threaded_mainloop_wait( pah->mainloop );
+  int result = pah->stopResult;
+  pa_threaded_mainloop_unlock( pah->mainloop );
+
+  if ( result < 0 ) return error( RTAUDIO_SYSTEM_ERROR );
   return RTAUDIO_NO_ERROR;
 }
 
-//******************** End of __LINUX_PULSE__ *********************//
-#endif
+// Called with the mainloop lock held.
+void RtApiPulse::beginStop( int request )
+{
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  pah->stopRequest = request;
+  stream_.state.store( STREAM_STOPPING, std::memory_order_release );
 
-#if defined(__LINUX_OSS__)
+  if ( pah->play && request == 1 ) {
+    if ( rt_pa_release( pa_stream_drain( pah->play, rt_pa_stream_drained, this ) ) )
+      return;
+    errorStream_ << "RtApiPulse::stopStream: error draining output device, " <<
+      pa_strerror( pa_context_errno( pah->context ) ) << ".";
+    errorText_ = errorStream_.str();
+    finishStop( -1 );
+    return;
+  }
 
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <errno.h>
-#include <math.h>
+  finishStop( 0 );
+}
 
-static void *ossCallbackHandler(void * ptr);
+void RtApiPulse::drainEvent( int success )
+{
+  if ( stream_.state.load( std::memory_order_acquire ) != STREAM_STOPPING ) return;
 
-// A structure to hold various information related to the OSS API
-// implementation.
-struct OssHandle {
-  int id[2];    // device ids
-  bool xrun[2];
-  bool triggered;
-  pthread_cond_t runnable;
+  if ( !success ) {
+    errorText_ = "RtApiPulse::stopStream: error draining output device.";
+    finishStop( -1 );
+  }
+  else
+    finishStop( 0 );
+}
 
-  OssHandle()
-    :triggered(false) { id[0] = 0; id[1] = 0; xrun[0] = false; xrun[1] = false; }
+// Flushes the output (for an abort) and any unread input, corks the
+// streams and marks the stream stopped.  Called with the mainloop
+// lock held.
+void RtApiPulse::finishStop( int result )
+{
+  PulseAudioHandle *pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+  if ( pah->play ) {
+    if ( pah->stopRequest == 2 )
+      rt_pa_release( pa_stream_flush( pah->play, NULL, NULL ) );
+    rt_pa_release( pa_stream_cork( pah->play, 1, NULL, NULL ) );
+  }
+  if ( pah->rec ) {
+    rt_pa_release( pa_stream_cork( pah->rec, 1, NULL, NULL ) );
+    rt_pa_release( pa_stream_flush( pah->rec, NULL, NULL ) );
+  }
+
+  pah->inputFill = 0;
+  pah->stopResult = result;
+  stream_.state.store( STREAM_STOPPED, std::memory_order_release );
+  if ( stream_.external ) wakeExternal();
+  pa_threaded_mainloop_signal( pah->mainloop, 0 );
+}
+
+//******************** End of __LINUX_PULSE__ *********************//
+#endif
+
+#if defined(__LINUX_PIPEWIRE__)
+
+// The PipeWire implementation opens a pw_stream for each direction of
+// a stream, with PW_STREAM_FLAG_RT_PROCESS so that the callback runs
+// directly on the data thread of the graph.  Buffers are dequeued and
+// written or read in place.  When the graph quantum differs from the
+// stream buffer size, periods are passed through an internal buffer
+// instead, and the change of quantum is reported as a warning.
+// Non-interleaved FLOAT32 streams use planar samples (F32P), with a
+// buffer data per channel, which are given to a planar callback in
+// place.  The internal periods remain interleaved.
+
+#include <pipewire/extensions/metadata.h>
+#include <spa/param/audio/format-utils.h>
+#include <cstdio>
+#include <mutex>
+
+#ifndef PW_KEY_TARGET_OBJECT
+#define PW_KEY_TARGET_OBJECT "target.object"
+#endif
+
+// The largest graph quantum that can be adapted to the stream buffer
+// size, in frames.
+static const unsigned int RT_PW_MAX_QUANTUM = 8192;
+
+static const unsigned int RT_PW_SAMPLERATES[] = { 8000, 11025, 16000, 22050, 32000, 44100,
+                                                  48000, 88200, 96000, 176400, 192000, 0 };
+
+struct rtaudio_pw_format_mapping_t {
+  RtAudioFormat rtaudio_format;
+  enum spa_audio_format pw_format;
 };
 
-RtApiOss :: RtApiOss()
+// The PipeWire adapter converts between all of these, so the device
+// format is always the user format.
+static const rtaudio_pw_format_mapping_t rt_pw_formats[] = {
+  {RTAUDIO_SINT8, SPA_AUDIO_FORMAT_S8},
+  {RTAUDIO_SINT16, SPA_AUDIO_FORMAT_S16},
+  {RTAUDIO_SINT24, SPA_AUDIO_FORMAT_S24_32},
+  {RTAUDIO_SINT32, SPA_AUDIO_FORMAT_S32},
+  {RTAUDIO_FLOAT32, SPA_AUDIO_FORMAT_F32},
+  {RTAUDIO_FLOAT64, SPA_AUDIO_FORMAT_F64},
+  {0, SPA_AUDIO_FORMAT_UNKNOWN}};
+
+// Channel positions in the ALSA order, as used by the ALSA nodes.
+static const uint32_t rt_pw_positions[] = { SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR,
+                                            SPA_AUDIO_CHANNEL_RL, SPA_AUDIO_CHANNEL_RR,
+                                            SPA_AUDIO_CHANNEL_FC, SPA_AUDIO_CHANNEL_LFE,
+                                            SPA_AUDIO_CHANNEL_SL, SPA_AUDIO_CHANNEL_SR };
+
+// A structure needed to collect the registry contents for device probing.
+struct PwProbeInfo {
+  struct Node {
+    uint32_t id;
+    std::string name;
+    std::string description;
+    bool sink;
+    bool source;
+    unsigned int channels;  // From "audio.channels", when the ports are not known.
+    unsigned int rate;
+    unsigned int inputPorts;
+    unsigned int outputPorts;
+  };
+
+  pw_main_loop *loop;
+  pw_core *core;
+  pw_registry *registry;
+  pw_metadata *metadata;
+  spa_hook metadataListener;
+  pw_metadata_events metadataEvents;
+  int pending;
+  bool metadataSynced;
+  bool failed;
+  std::string defaultSink;
+  std::string defaultSource;
+  std::vector< Node > nodes;
+  std::vector< std::pair< uint32_t, bool > > ports; // Node id and input direction.
+  PwProbeInfo()
+    :loop(0), core(0), registry(0), metadata(0), metadataListener(), metadataEvents(),
+     pending(0), metadataSynced(false), failed(false) {}
+};
+
+struct PipeWireHandle {
+  RtApiPipeWire *object;
+  pw_thread_loop *loop;
+  pw_context *context;
+  pw_core *core;
+  pw_stream *stream[2];           // Playback and capture.
+  spa_hook listener[2];
+  pw_stream_events events[2];
+  spa_io_position *position[2];   // Graph clock, for the quantum.
+  std::vector<char> period[2];    // One period in the device format.
+  bool planar[2];                 // Buffers hold planar samples, one data per channel.
+  std::vector<float *> planes[2]; // The channels of a planar buffer.
+  std::vector<float> frames[2];   // A planar buffer interleaved, for the quantum buffer.
+  std::atomic<pthread_t> processThread;
+  std::atomic<uint64_t> quantum;
+  bool xrun[2];
+  int stopRequest; // 1 = stop, 2 = abort, posted with STREAM_STOPPING.
+  int stopResult;
+  PipeWireHandle()
+    :object(0), loop(0), context(0), core(0), listener(), events(), processThread( pthread_t() ),
+     quantum(0), stopRequest(0), stopResult(0)
+    { stream[0] = stream[1] = 0; position[0] = position[1] = 0; xrun[0] = xrun[1] = false; planar[0] = planar[1] = false; }
+};
+
+// Interleave or deinterleave the samples of a planar buffer.
+static void rt_pw_interleave( float *frames, float * const *planes, unsigned int channels, unsigned int count )
 {
-  // Nothing to do here.
+  for ( unsigned int i=0; i<channels; i++ )
+    for ( unsigned int j=0; j<count; j++ )
+      frames[j * channels + i] = planes[i][j];
 }
 
-RtApiOss :: ~RtApiOss()
+static void rt_pw_deinterleave( float * const *planes, const float *frames, unsigned int channels, unsigned int count )
 {
-  if ( stream_.state != STREAM_CLOSED ) closeStream();
+  for ( unsigned int i=0; i<channels; i++ )
+    for ( unsigned int j=0; j<count; j++ )
+      planes[i][j] = frames[j * channels + i];
 }
 
-void RtApiOss :: probeDevices( void )
+// The following functions are called by the device probing system.
+// Extracts the name from a {"name":"..."} metadata value.
+static std::string rt_pw_metadata_name( const char *value )
 {
-  // See list of required functionality in RtApi::probeDevices().
-  
-  int mixerfd = open( "/dev/mixer", O_RDWR, 0 );
-  if ( mixerfd == -1 ) {
-    errorText_ = "RtApiOss::probeDevices: error opening '/dev/mixer'.";
-    error( RTAUDIO_SYSTEM_ERROR );
-    return;
-  }
+  std::string json( value );
+  size_t start = json.find( "\"name\"" );
+  if ( start != std::string::npos ) start = json.find( ':', start );
+  if ( start != std::string::npos ) start = json.find( '"', start );
+  if ( start == std::string::npos ) return std::string();
+  size_t end = json.find( '"', start + 1 );
+  if ( end == std::string::npos ) return std::string();
+  return json.substr( start + 1, end - start - 1 );
+}
 
-  oss_sysinfo sysinfo;
-  if ( ioctl( mixerfd, SNDCTL_SYSINFO, &sysinfo ) == -1 ) {
-    close( mixerfd );
-    errorText_ = "RtApiOss::probeDevices: error getting sysinfo, OSS version >= 4.0 is required.";
-    error( RTAUDIO_SYSTEM_ERROR );
-    return;
+static int rt_pw_metadata_property( void *data, uint32_t subject, const char *key,
+                                    const char * /*type*/, const char *value )
+{
+  PwProbeInfo *info = static_cast<PwProbeInfo *>( data );
+  if ( subject != PW_ID_CORE || !key || !value ) return 0;
+  if ( strcmp( key, "default.audio.sink" ) == 0 )
+    info->defaultSink = rt_pw_metadata_name( value );
+  else if ( strcmp( key, "default.audio.source" ) == 0 )
+    info->defaultSource = rt_pw_metadata_name( value );
+  return 0;
+}
+
+// Used to collect the audio device nodes, their ports and the default
+// device metadata.
+static void rt_pw_registry_global( void *data, uint32_t id, uint32_t /*permissions*/,
+                                   const char *type, uint32_t /*version*/,
+                                   const struct spa_dict *props )
+{
+  PwProbeInfo *info = static_cast<PwProbeInfo *>( data );
+  if ( !props ) return;
+
+  if ( strcmp( type, PW_TYPE_INTERFACE_Node ) == 0 ) {
+    const char *mediaClass = spa_dict_lookup( props, PW_KEY_MEDIA_CLASS );
+    const char *name = spa_dict_lookup( props, PW_KEY_NODE_NAME );
+    if ( !mediaClass || !name || strncmp( mediaClass, "Audio/", 6 ) != 0 ) return;
+
+    PwProbeInfo::Node node;
+    node.id = id;
+    node.name = name;
+    const char *description = spa_dict_lookup( props, PW_KEY_NODE_DESCRIPTION );
+    node.description = description ? description : name;
+    bool duplex = ( strstr( mediaClass, "Duplex" ) != NULL );
+    node.sink = duplex || strstr( mediaClass, "Sink" ) != NULL;
+    node.source = duplex || strstr( mediaClass, "Source" ) != NULL;
+    if ( !node.sink && !node.source ) return;
+    const char *value = spa_dict_lookup( props, "audio.channels" );
+    node.channels = value ? atoi( value ) : 0;
+    value = spa_dict_lookup( props, "audio.rate" );
+    node.rate = value ? atoi( value ) : 0;
+    node.inputPorts = 0;
+    node.outputPorts = 0;
+    info->nodes.push_back( node );
+  }
+  else if ( strcmp( type, PW_TYPE_INTERFACE_Port ) == 0 ) {
+    const char *node = spa_dict_lookup( props, PW_KEY_NODE_ID );
+    const char *direction = spa_dict_lookup( props, PW_KEY_PORT_DIRECTION );
+    const char *monitor = spa_dict_lookup( props, PW_KEY_PORT_MONITOR );
+    if ( !node || !direction || ( monitor && strcmp( monitor, "true" ) == 0 ) ) return;
+    info->ports.push_back( std::make_pair( (uint32_t) atoi( node ), strcmp( direction, "in" ) == 0 ) );
+  }
+  else if ( strcmp( type, PW_TYPE_INTERFACE_Metadata ) == 0 && !info->metadata ) {
+    const char *name = spa_dict_lookup( props, PW_KEY_METADATA_NAME );
+    if ( !name || strcmp( name, "default" ) != 0 ) return;
+    info->metadata = static_cast<pw_metadata *>(
+      pw_registry_bind( info->registry, id, type, PW_VERSION_METADATA, 0 ) );
+    if ( !info->metadata ) return;
+    info->metadataEvents.version = PW_VERSION_METADATA_EVENTS;
+    info->metadataEvents.property = rt_pw_metadata_property;
+    pw_metadata_add_listener( info->metadata, &info->metadataListener,
+                              &info->metadataEvents, info );
   }
+}
 
-  unsigned int nDevices = sysinfo.numaudios;
-  if ( nDevices == 0 ) {
-    close( mixerfd );
-    deviceList_.clear();
+// The registry has been listed once the server answers a sync.  The
+// default device metadata bound meanwhile needs a second round trip.
+static void rt_pw_core_done( void *data, uint32_t id, int seq )
+{
+  PwProbeInfo *info = static_cast<PwProbeInfo *>( data );
+  if ( id != PW_ID_CORE || seq != info->pending ) return;
+  if ( info->metadata && !info->metadataSynced ) {
+    info->metadataSynced = true;
+    info->pending = pw_core_sync( info->core, PW_ID_CORE, info->pending );
     return;
   }
+  pw_main_loop_quit( info->loop );
+}
 
-  oss_audioinfo ainfo;
-  unsigned int m, n;
-  std::vector<std::string> deviceNames;
-  for ( n=0; n<nDevices; n++ ) {
-    ainfo.dev = n;
-    if ( ioctl( mixerfd, SNDCTL_AUDIOINFO, &ainfo ) == -1 ) continue;
-    deviceNames.push_back( ainfo.name );
-    for ( m=0; m<deviceList_.size(); m++ ) {
-      if ( deviceList_[m].name == deviceNames.back() )
-        break; // We already have this device.
-    }
-    if ( m == deviceList_.size() ) { // new device
-      RtAudio::DeviceInfo info;
-      if ( probeDeviceInfo( info, ainfo ) == false ) continue; // ignore if probe fails
-      info.ID = currentDeviceId_++;  // arbitrary internal device ID
-      deviceList_.push_back( info );
+static void rt_pw_core_error( void *data, uint32_t id, int /*seq*/, int /*res*/,
+                              const char * /*message*/ )
+{
+  PwProbeInfo *info = static_cast<PwProbeInfo *>( data );
+  if ( id != PW_ID_CORE ) return;
+  info->failed = true;
+  pw_main_loop_quit( info->loop );
+}
+
+// The following functions are called for an open stream.  This one
+// wakes up a thread waiting on the loop for a stream state change.
+static void rt_pw_stream_state_changed( void *data, enum pw_stream_state /*old*/,
+                                        enum pw_stream_state /*state*/, const char * /*error*/ )
+{
+  pw_thread_loop_signal( static_cast<PipeWireHandle *>( data )->loop, false );
+}
+
+static void rt_pw_output_io_changed( void *data, uint32_t id, void *area, uint32_t /*size*/ )
+{
+  if ( id == SPA_IO_Position )
+    static_cast<PipeWireHandle *>( data )->position[0] = static_cast<spa_io_position *>( area );
+}
+
+static void rt_pw_input_io_changed( void *data, uint32_t id, void *area, uint32_t /*size*/ )
+{
+  if ( id == SPA_IO_Position )
+    static_cast<PipeWireHandle *>( data )->position[1] = static_cast<spa_io_position *>( area );
+}
+
+// Called on the data thread of the graph for each cycle.
+static void rt_pw_output_process( void *data )
+{
+  static_cast<PipeWireHandle *>( data )->object->processOutput();
+}
+
+static void rt_pw_input_process( void *data )
+{
+  static_cast<PipeWireHandle *>( data )->object->processInput();
+}
+
+static void rt_pw_stream_drained( void *data )
+{
+  static_cast<PipeWireHandle *>( data )->object->drainEvent();
+}
+
+// The following are invoked on the loop thread from the data thread.
+static int rt_pw_invoke_stop( struct spa_loop * /*loop*/, bool /*async*/, uint32_t /*seq*/,
+                              const void * /*data*/, size_t /*size*/, void *userData )
+{
+  static_cast<PipeWireHandle *>( userData )->object->stopEvent();
+  return 0;
+}
+
+static int rt_pw_invoke_quantum( struct spa_loop * /*loop*/, bool /*async*/, uint32_t seq,
+                                 const void * /*data*/, size_t /*size*/, void *userData )
+{
+  static_cast<PipeWireHandle *>( userData )->object->quantumEvent( seq );
+  return 0;
+}
+
+// Destroys the streams and the connection of a handle and stops its
+// loop thread.
+static void rt_pw_close_handle( PipeWireHandle *handle )
+{
+  if ( !handle->loop ) return;
+
+  pw_thread_loop_lock( handle->loop );
+  for ( int i=0; i<2; i++ ) {
+    if ( handle->stream[i] ) {
+      pw_stream_destroy( handle->stream[i] );
+      handle->stream[i] = 0;
     }
   }
-  close( mixerfd );
+  if ( handle->core ) {
+    pw_core_disconnect( handle->core );
+    handle->core = 0;
+  }
+  pw_thread_loop_unlock( handle->loop );
 
-  // Remove any devices left in the list that are no longer available.
-  for ( std::vector<RtAudio::DeviceInfo>::iterator it=deviceList_.begin(); it!=deviceList_.end(); ) {
-    for ( m=0; m<deviceNames.size(); m++ ) {
-      if ( (*it).name == deviceNames[m] ) {
-        ++it;
-        break;
-      }
-    }
-    if ( m == deviceNames.size() ) // not found so remove it from our list
-      it = deviceList_.erase( it );
+  pw_thread_loop_stop( handle->loop );
+  if ( handle->context ) {
+    pw_context_destroy( handle->context );
+    handle->context = 0;
   }
+  pw_thread_loop_destroy( handle->loop );
+  handle->loop = 0;
+}
 
-  // I don't think the OSS API supports default devices. Our parent
-  // class versions of the getDefault functions will return the first
-  // one found.
+// The library is initialized while any RtApiPipeWire exists, since
+// an RtAudio instance with several streams holds one per stream, and
+// older versions of libpipewire do not count pw_init() calls.
+static std::mutex rtPwInitMutex;
+static unsigned int rtPwInitCount = 0;
+
+RtApiPipeWire :: RtApiPipeWire()
+{
+  quantumBuffer_[0] = 0;
+  quantumBuffer_[1] = 0;
+  std::lock_guard<std::mutex> lock( rtPwInitMutex );
+  if ( rtPwInitCount++ == 0 ) pw_init( NULL, NULL );
 }
 
-bool RtApiOss :: probeDeviceInfo( RtAudio::DeviceInfo &info, oss_audioinfo &ainfo )
+RtApiPipeWire :: ~RtApiPipeWire()
 {
-  // Probe channels
-  if ( ainfo.caps & PCM_CAP_OUTPUT ) info.outputChannels = ainfo.max_channels;
-  if ( ainfo.caps & PCM_CAP_INPUT ) info.inputChannels = ainfo.max_channels;
-  if ( ainfo.caps & PCM_CAP_DUPLEX ) {
-    if ( info.outputChannels > 0 && info.inputChannels > 0 && ainfo.caps & PCM_CAP_DUPLEX )
-      info.duplexChannels = (info.outputChannels > info.inputChannels) ? info.inputChannels : info.outputChannels;
-  }
+  if ( stream_.state != STREAM_CLOSED )
+    closeStream();
+  std::lock_guard<std::mutex> lock( rtPwInitMutex );
+  if ( --rtPwInitCount == 0 ) pw_deinit();
+}
 
-  // Probe data formats ... do for input
-  unsigned long mask = ainfo.iformats;
-  if ( mask & AFMT_S16_LE || mask & AFMT_S16_BE )
-    info.nativeFormats |= RTAUDIO_SINT16;
-  if ( mask & AFMT_S8 )
-    info.nativeFormats |= RTAUDIO_SINT8;
-  if ( mask & AFMT_S32_LE || mask & AFMT_S32_BE )
-    info.nativeFormats |= RTAUDIO_SINT32;
-#ifdef AFMT_FLOAT
-  if ( mask & AFMT_FLOAT )
-    info.nativeFormats |= RTAUDIO_FLOAT32;
-#endif
-  if ( mask & AFMT_S24_LE || mask & AFMT_S24_BE )
-    info.nativeFormats |= RTAUDIO_SINT24;
+void RtApiPipeWire :: probeDevices( void )
+{
+  // See list of required functionality in RtApi::probeDevices().
 
-  // Check that we have at least one supported format
-  if ( info.nativeFormats == 0 ) {
-    errorStream_ << "RtApiOss::probeDeviceInfo: device (" << ainfo.name << ") data format not supported by RtAudio.";
-    errorText_ = errorStream_.str();
+  PwProbeInfo info;
+  pw_context *context = NULL;
+  spa_hook coreListener, registryListener;
+  pw_core_events coreEvents;
+  pw_registry_events registryEvents;
+  memset( &coreListener, 0, sizeof( coreListener ) );
+  memset( &registryListener, 0, sizeof( registryListener ) );
+  memset( &coreEvents, 0, sizeof( coreEvents ) );
+  memset( &registryEvents, 0, sizeof( registryEvents ) );
+  coreEvents.version = PW_VERSION_CORE_EVENTS;
+  coreEvents.done = rt_pw_core_done;
+  coreEvents.error = rt_pw_core_error;
+  registryEvents.version = PW_VERSION_REGISTRY_EVENTS;
+  registryEvents.global = rt_pw_registry_global;
+  unsigned int m;
+
+  info.loop = pw_main_loop_new( NULL );
+  if ( !info.loop ) {
+    errorText_ = "RtApiPipeWire::probeDevices: pw_main_loop_new() failed.";
     error( RTAUDIO_WARNING );
-    return false;
+    return;
   }
 
-  // Probe the supported sample rates.
-  info.sampleRates.clear();
-  if ( ainfo.nrates ) {
-    for ( unsigned int i=0; i<ainfo.nrates; i++ ) {
-      for ( unsigned int k=0; k<MAX_SAMPLE_RATES; k++ ) {
-        if ( ainfo.rates[i] == SAMPLE_RATES[k] ) {
-          info.sampleRates.push_back( SAMPLE_RATES[k] );
+  context = pw_context_new( pw_main_loop_get_loop( info.loop ), NULL, 0 );
+  if ( context ) info.core = pw_context_connect( context, NULL, 0 );
+  if ( !info.core ) {
+    errorText_ = "RtApiPipeWire::probeDevices: could not connect to the PipeWire daemon.";
+    error( RTAUDIO_WARNING );
+    goto quit;
+  }
 
-          if ( !info.preferredSampleRate || ( SAMPLE_RATES[k] <= 48000 && SAMPLE_RATES[k] > info.preferredSampleRate ) )
-            info.preferredSampleRate = SAMPLE_RATES[k];
+  pw_core_add_listener( info.core, &coreListener, &coreEvents, &info );
+  info.registry = pw_core_get_registry( info.core, PW_VERSION_REGISTRY, 0 );
+  pw_registry_add_listener( info.registry, &registryListener, &registryEvents, &info );
+  info.pending = pw_core_sync( info.core, PW_ID_CORE, 0 );
+  pw_main_loop_run( info.loop );
 
-          break;
-        }
-      }
-    }
+  if ( info.failed ) {
+    errorText_ = "RtApiPipeWire::probeDevices: error listing the PipeWire registry.";
+    error( RTAUDIO_WARNING );
+    goto quit;
   }
-  else {
-    // Check min and max rate values;
-    for ( unsigned int k=0; k<MAX_SAMPLE_RATES; k++ ) {
-      if ( ainfo.min_rate <= (int) SAMPLE_RATES[k] && ainfo.max_rate >= (int) SAMPLE_RATES[k] ) {
-        info.sampleRates.push_back( SAMPLE_RATES[k] );
 
-        if ( !info.preferredSampleRate || ( SAMPLE_RATES[k] <= 48000 && SAMPLE_RATES[k] > info.preferredSampleRate ) )
-          info.preferredSampleRate = SAMPLE_RATES[k];
-      }
+  for ( size_t n=0; n<info.nodes.size(); n++ ) {
+    PwProbeInfo::Node &node = info.nodes[n];
+    for ( size_t p=0; p<info.ports.size(); p++ ) {
+      if ( info.ports[p].first != node.id ) continue;
+      if ( info.ports[p].second ) node.inputPorts++;
+      else node.outputPorts++;
+    }
+
+    RtAudio::DeviceInfo device;
+    device.name = node.description;
+    if ( node.sink ) device.outputChannels = node.inputPorts ? node.inputPorts : node.channels;
+    if ( node.source ) device.inputChannels = node.outputPorts ? node.outputPorts : node.channels;
+    if ( device.outputChannels == 0 && device.inputChannels == 0 ) continue;
+    device.duplexChannels = std::min( device.outputChannels, device.inputChannels );
+    device.isDefaultOutput = ( device.outputChannels > 0 && node.name == info.defaultSink );
+    device.isDefaultInput = ( device.inputChannels > 0 && node.name == info.defaultSource );
+    device.preferredSampleRate = node.rate ? node.rate : 48000;
+    for ( const unsigned int *sr = RT_PW_SAMPLERATES; *sr; ++sr )
+      device.sampleRates.push_back( *sr );
+    for ( const rtaudio_pw_format_mapping_t *fm = rt_pw_formats; fm->rtaudio_format; ++fm )
+      device.nativeFormats |= fm->rtaudio_format;
+
+    // Devices already in the list keep their ID.
+    for ( m=0; m<pwDeviceList_.size(); m++ )
+      if ( pwDeviceList_[m].nodeName == node.name ) break;
+    if ( m < pwDeviceList_.size() ) {
+      device.ID = deviceList_[m].ID;
+      deviceList_[m] = device;
+      pwDeviceList_[m].nodeId = node.id;
+      continue;
     }
+
+    device.ID = currentDeviceId_++;
+    deviceList_.push_back( device );
+    PwDeviceInfo pwInfo;
+    pwInfo.nodeName = node.name;
+    pwInfo.nodeId = node.id;
+    pwDeviceList_.push_back( pwInfo );
   }
 
-  if ( info.sampleRates.size() == 0 ) {
-    errorStream_ << "RtApiOss::probeDeviceInfo: no supported sample rates found for device (" << ainfo.name << ").";
-    errorText_ = errorStream_.str();
-    error( RTAUDIO_WARNING );
-    return false;
+  // Check for devices that have been unplugged.
+  for ( m=0; m<pwDeviceList_.size(); ) {
+    size_t n;
+    for ( n=0; n<info.nodes.size(); n++ )
+      if ( info.nodes[n].name == pwDeviceList_[m].nodeName ) break;
+    if ( n < info.nodes.size() ) {
+      m++;
+      continue;
+    }
+    deviceList_.erase( deviceList_.begin() + m );
+    pwDeviceList_.erase( pwDeviceList_.begin() + m );
   }
 
-  return true;
+ quit:
+  if ( info.metadata ) pw_proxy_destroy( (pw_proxy *) info.metadata );
+  if ( info.registry ) pw_proxy_destroy( (pw_proxy *) info.registry );
+  if ( info.core ) pw_core_disconnect( info.core );
+  if ( context ) pw_context_destroy( context );
+  pw_main_loop_destroy( info.loop );
 }
 
-
-bool RtApiOss :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
-                                  unsigned int firstChannel, unsigned int sampleRate,
-                                  RtAudioFormat format, unsigned int *bufferSize,
-                                  RtAudio::StreamOptions *options )
+bool RtApiPipeWire :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
+                                       unsigned int firstChannel, unsigned int sampleRate,
+                                       RtAudioFormat format, unsigned int *bufferSize,
+                                       RtAudio::StreamOptions *options )
 {
-  int mixerfd = open( "/dev/mixer", O_RDWR, 0 );
-  if ( mixerfd == -1 ) {
-    errorText_ = "RtApiOss::probeDeviceOpen: error opening '/dev/mixer'.";
-    return FAILURE;
-  }
+  PipeWireHandle *handle = 0;
+  unsigned long bufferBytes, frameBytes;
+  enum spa_audio_format pwFormat = SPA_AUDIO_FORMAT_UNKNOWN;
+  std::string streamName = "RtAudio";
+  pw_properties *props;
+  uint8_t podBuffer[1024];
+  spa_pod_builder builder;
+  spa_audio_info_raw rawInfo;
+  const spa_pod *params[1];
+  const char *streamError = NULL;
+  pw_stream_state state;
+  int result;
 
-  oss_sysinfo sysinfo;
-  int result = ioctl( mixerfd, SNDCTL_SYSINFO, &sysinfo );
-  if ( result == -1 ) {
-    close( mixerfd );
-    errorText_ = "RtApiOss::probeDeviceOpen: error getting sysinfo, OSS version >= 4.0 is required.";
+  int deviceIdx = -1;
+  for ( unsigned int m=0; m<deviceList_.size(); m++ ) {
+    if ( deviceList_[m].ID == deviceId ) {
+      deviceIdx = m;
+      break;
+    }
+  }
+  if ( deviceIdx < 0 ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: device ID is invalid!";
     return FAILURE;
   }
 
-  unsigned int nDevices = sysinfo.numaudios;
-  if ( nDevices == 0 ) {
-    // This should not happen because a check is made before this function is called.
-    close( mixerfd );
-    errorText_ = "RtApiOss::probeDeviceOpen: no devices found!";
+  unsigned int deviceChannels = ( mode == OUTPUT ) ? deviceList_[deviceIdx].outputChannels
+                                                   : deviceList_[deviceIdx].inputChannels;
+  if ( channels + firstChannel > deviceChannels ) {
+    errorStream_ << "RtApiPipeWire::probeDeviceOpen: device (" << deviceList_[deviceIdx].name <<
+      ") does not support requested channel count.";
+    errorText_ = errorStream_.str();
     return FAILURE;
   }
 
-  std::string deviceName;
-  unsigned int m, device;
-  for ( m=0; m<deviceList_.size(); m++ ) {
-    if ( deviceList_[m].ID == deviceId ) {
-      deviceName = deviceList_[m].name;
+  for ( const rtaudio_pw_format_mapping_t *fm = rt_pw_formats; fm->rtaudio_format; ++fm ) {
+    if ( format == fm->rtaudio_format ) {
+      pwFormat = fm->pw_format;
       break;
     }
   }
-
-  if ( deviceName.empty() ) {
-    errorText_ = "RtApiOss::probeDeviceOpen: device ID is invalid!";
+  if ( pwFormat == SPA_AUDIO_FORMAT_UNKNOWN ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: unsupported sample format.";
     return FAILURE;
   }
 
-  oss_audioinfo ainfo;
-  for ( device=0; device<nDevices; device++ ) {
-    ainfo.dev = device;
-    result = ioctl( mixerfd, SNDCTL_AUDIOINFO, &ainfo );
-    if ( result == -1 ) continue;
-    if ( deviceName == std::string( ainfo.name ) ) break;
-  }
-
-  close( mixerfd );
-  if ( device == nDevices ) {
-    errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") not found.";
-    errorText_ = errorStream_.str();
-    return FAILURE;
-  }
+  // The graph requests whole periods, so a size must be chosen when
+  // none is given.
+  if ( *bufferSize == 0 ) *bufferSize = 1024;
+  if ( *bufferSize > RT_PW_MAX_QUANTUM ) *bufferSize = RT_PW_MAX_QUANTUM;
 
-  // Check if device supports input or output
-  if ( ( mode == OUTPUT && !( ainfo.caps & PCM_CAP_OUTPUT ) ) ||
-       ( mode == INPUT && !( ainfo.caps & PCM_CAP_INPUT ) ) ) {
+  // Set the stream parameters.
+  stream_.sampleRate = sampleRate;
+  stream_.bufferSize = *bufferSize;
+  stream_.nBuffers = 1;
+  stream_.userFormat = format;
+  stream_.deviceFormat[mode] = format;
+  if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) stream_.userInterleaved = false;
+  else stream_.userInterleaved = true;
+  if ( format == RTAUDIO_FLOAT32 && !stream_.userInterleaved ) pwFormat = SPA_AUDIO_FORMAT_F32P;
+  stream_.deviceInterleaved[mode] = true;  // The internal periods.
+  stream_.doByteSwap[mode] = false;
+  stream_.nUserChannels[mode] = channels;
+  stream_.nDeviceChannels[mode] = channels + firstChannel;
+  stream_.channelOffset[mode] = 0;
+  stream_.latency[mode] = *bufferSize;
+  if ( options && !options->streamName.empty() ) streamName = options->streamName;
+
+  // Set flags for buffer conversion.
+  stream_.doConvertBuffer[mode] = false;
+  if ( stream_.nUserChannels[mode] < stream_.nDeviceChannels[mode] )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
+       stream_.nUserChannels[mode] > 1 )
+    stream_.doConvertBuffer[mode] = true;
+
+  // Allocate necessary internal buffers.
+  bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
+  stream_.userBuffer[mode] = (char *) calloc( bufferBytes, 1 );
+  if ( stream_.userBuffer[mode] == NULL ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: error allocating user buffer memory.";
+    goto error;
+  }
+
+  stream_.deviceId[mode] = deviceIdx;
+
+  // Setup the buffer conversion information structure.
+  if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
+
+  // Both directions of a stream share one connection, serviced by a
+  // thread loop.
+  if ( !stream_.apiHandle ) {
+    handle = new PipeWireHandle;
+    stream_.apiHandle = handle;
+    handle->object = this;
+    handle->quantum = *bufferSize;
+
+    handle->loop = pw_thread_loop_new( "RtAudio", NULL );
+    if ( handle->loop )
+      handle->context = pw_context_new( pw_thread_loop_get_loop( handle->loop ), NULL, 0 );
+    if ( !handle->context || pw_thread_loop_start( handle->loop ) < 0 ) {
+      errorText_ = "RtApiPipeWire::probeDeviceOpen: error creating PipeWire thread loop or context.";
+      goto error;
+    }
+
+    pw_thread_loop_lock( handle->loop );
+    handle->core = pw_context_connect( handle->context, NULL, 0 );
+    pw_thread_loop_unlock( handle->loop );
+    if ( !handle->core ) {
+      errorText_ = "RtApiPipeWire::probeDeviceOpen: could not connect to the PipeWire daemon.";
+      goto error;
+    }
+  }
+  handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+
+  frameBytes = stream_.nDeviceChannels[mode] * formatBytes( format );
+  handle->period[mode].assign( *bufferSize * frameBytes, 0 );
+  quantumBuffer_[mode] = new RingBuffer( 2 * *bufferSize + RT_PW_MAX_QUANTUM, frameBytes );
+  handle->planar[mode] = ( pwFormat == SPA_AUDIO_FORMAT_F32P );
+  if ( handle->planar[mode] ) {
+    handle->planes[mode].resize( stream_.nDeviceChannels[mode] );
+    handle->frames[mode].resize( (size_t) RT_PW_MAX_QUANTUM * stream_.nDeviceChannels[mode] );
+  }
+
+  // Ask for a graph quantum of one period, on the chosen device.
+  props = pw_properties_new( PW_KEY_MEDIA_TYPE, "Audio",
+                             PW_KEY_MEDIA_CATEGORY, mode == OUTPUT ? "Playback" : "Capture",
+                             PW_KEY_TARGET_OBJECT, pwDeviceList_[deviceIdx].nodeName.c_str(),
+                             NULL );
+  pw_properties_setf( props, PW_KEY_NODE_LATENCY, "%u/%u", *bufferSize, sampleRate );
+
+  memset( &rawInfo, 0, sizeof( rawInfo ) );
+  rawInfo.format = pwFormat;
+  rawInfo.rate = sampleRate;
+  rawInfo.channels = stream_.nDeviceChannels[mode];
+  for ( unsigned int i=0; i<rawInfo.channels && i<SPA_AUDIO_MAX_CHANNELS; i++ ) {
+    if ( rawInfo.channels == 1 ) rawInfo.position[i] = SPA_AUDIO_CHANNEL_MONO;
+    else if ( rawInfo.channels <= 8 ) rawInfo.position[i] = rt_pw_positions[i];
+    else rawInfo.position[i] = SPA_AUDIO_CHANNEL_AUX0 + i;
+  }
+  spa_pod_builder_init( &builder, podBuffer, sizeof( podBuffer ) );
+  params[0] = spa_format_audio_raw_build( &builder, SPA_PARAM_EnumFormat, &rawInfo );
+
+  pw_thread_loop_lock( handle->loop );
+  handle->stream[mode] = pw_stream_new( handle->core, streamName.c_str(), props );
+  result = -1;
+  if ( handle->stream[mode] ) {
+    pw_stream_events &events = handle->events[mode];
+    events.version = PW_VERSION_STREAM_EVENTS;
+    events.state_changed = rt_pw_stream_state_changed;
+    if ( mode == OUTPUT ) {
+      events.io_changed = rt_pw_output_io_changed;
+      events.process = rt_pw_output_process;
+      events.drained = rt_pw_stream_drained;
+    }
+    else {
+      events.io_changed = rt_pw_input_io_changed;
+      events.process = rt_pw_input_process;
+    }
+    pw_stream_add_listener( handle->stream[mode], &handle->listener[mode], &events, handle );
+
+    result = pw_stream_connect( handle->stream[mode],
+                                mode == OUTPUT ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT,
+                                pwDeviceList_[deviceIdx].nodeId,
+                                (enum pw_stream_flags) ( PW_STREAM_FLAG_AUTOCONNECT |
+                                                         PW_STREAM_FLAG_MAP_BUFFERS |
+                                                         PW_STREAM_FLAG_RT_PROCESS |
+                                                         PW_STREAM_FLAG_INACTIVE ),
+                                params, 1 );
+  }
+  if ( result == 0 ) {
+    while ( ( state = pw_stream_get_state( handle->stream[mode], &streamError ) ) ==
+            PW_STREAM_STATE_CONNECTING )
+      pw_thread_loop_wait( handle->loop );
+    if ( state != PW_STREAM_STATE_PAUSED && state != PW_STREAM_STATE_STREAMING ) result = -1;
+  }
+  pw_thread_loop_unlock( handle->loop );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiPipeWire::probeDeviceOpen: error connecting " <<
+      ( mode == OUTPUT ? "output" : "input" ) << " stream to device (" <<
+      deviceList_[deviceIdx].name << ")";
+    if ( streamError ) errorStream_ << ", " << streamError;
+    errorStream_ << ".";
+    errorText_ = errorStream_.str();
+    goto error;
+  }
+
+  if ( stream_.mode == OUTPUT && mode == INPUT )
+    stream_.mode = DUPLEX;
+  else
+    stream_.mode = mode;
+
+  stream_.callbackInfo.object = this;
+  stream_.state = STREAM_STOPPED;
+  return SUCCESS;
+
+ error:
+  handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  if ( handle ) {
+    rt_pw_close_handle( handle );
+    delete handle;
+    stream_.apiHandle = 0;
+  }
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+    if ( quantumBuffer_[i] ) {
+      delete quantumBuffer_[i];
+      quantumBuffer_[i] = 0;
+    }
+  }
+
+  stream_.state = STREAM_CLOSED;
+  return FAILURE;
+}
+
+void RtApiPipeWire :: closeStream( void )
+{
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApiPipeWire::closeStream(): no open stream to close!";
+    error( RTAUDIO_WARNING );
+    return;
+  }
+
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  if ( handle ) {
+    pw_thread_loop_lock( handle->loop );
+    // Let the output drain after a stop requested by the callback, or
+    // by stopStream() from another thread.
+    while ( stream_.state == STREAM_STOPPING ) {
+      if ( pw_thread_loop_timed_wait( handle->loop, 3 ) != 0 )
+        finishStop( 0 );
+    }
+    stream_.state.store( STREAM_STOPPED, std::memory_order_release );
+    pw_thread_loop_unlock( handle->loop );
+
+    rt_pw_close_handle( handle );
+    delete handle;
+    stream_.apiHandle = 0;
+  }
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+    if ( quantumBuffer_[i] ) {
+      delete quantumBuffer_[i];
+      quantumBuffer_[i] = 0;
+    }
+  }
+
+  clearStreamInfo();
+}
+
+RtAudioErrorType RtApiPipeWire :: startStream( void )
+{
+  if ( stream_.state != STREAM_STOPPED ) {
+    if ( stream_.state == STREAM_RUNNING )
+      errorText_ = "RtApiPipeWire::startStream(): the stream is already running!";
+    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiPipeWire::startStream(): the stream is stopping or closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  int result = 0;
+
+  pw_thread_loop_lock( handle->loop );
+  for ( int i=0; i<2; i++ ) {
+    if ( quantumBuffer_[i] ) quantumBuffer_[i]->reset();
+    handle->xrun[i] = false;
+  }
+
+  // A duplex stream writes the output of each input period for the
+  // playback stream to pick up, which starts one period behind.
+  if ( stream_.mode == DUPLEX ) {
+    std::fill( handle->period[OUTPUT].begin(), handle->period[OUTPUT].end(), 0 );
+    quantumBuffer_[OUTPUT]->write( &handle->period[OUTPUT][0], stream_.bufferSize );
+  }
+
+  stream_.state.store( STREAM_RUNNING, std::memory_order_release );
+  for ( int i=0; i<2 && result == 0; i++ )
+    if ( handle->stream[i] ) result = pw_stream_set_active( handle->stream[i], true );
+
+  if ( result < 0 ) {
+    errorStream_ << "RtApiPipeWire::startStream: error activating stream, " <<
+      spa_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    handle->stopRequest = 2;
+    finishStop( result );
+  }
+  pw_thread_loop_unlock( handle->loop );
+
+  if ( result < 0 ) return error( RTAUDIO_SYSTEM_ERROR );
+  return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiPipeWire :: stopStream( void )
+{
+  if ( stream_.state != STREAM_RUNNING && stream_.state != STREAM_STOPPING ) {
+    if ( stream_.state == STREAM_STOPPED )
+      errorText_ = "RtApiPipeWire::stopStream(): the stream is already stopped!";
+    else if ( stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiPipeWire::stopStream(): the stream is closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  return requestStop( 1 );
+}
+
+RtAudioErrorType RtApiPipeWire :: abortStream( void )
+{
+  if ( stream_.state != STREAM_RUNNING ) {
+    if ( stream_.state == STREAM_STOPPED )
+      errorText_ = "RtApiPipeWire::abortStream(): the stream is already stopped!";
+    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiPipeWire::abortStream(): the stream is stopping or closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  return requestStop( 2 );
+}
+
+// A stop (1) or abort (2) moves the stream to STREAM_STOPPING and is
+// then carried out on the loop thread, where a stop drains the output
+// first.  A request from within the callback, on the data thread, is
+// handed to the loop thread and returns at once.  Other callers wait
+// on the loop until the stream is stopped, giving up on a drain that
+// has not completed within a few seconds.
+RtAudioErrorType RtApiPipeWire :: requestStop( int request )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  if ( pthread_equal( handle->processThread.load( std::memory_order_relaxed ), pthread_self() ) ) {
+    if ( stream_.state == STREAM_RUNNING ) {
+      handle->stopRequest = request;
+      stream_.state.store( STREAM_STOPPING, std::memory_order_release );
+      pw_loop_invoke( pw_thread_loop_get_loop( handle->loop ), rt_pw_invoke_stop,
+                      0, NULL, 0, false, handle );
+    }
+    return RTAUDIO_NO_ERROR;
+  }
+
+  pw_thread_loop_lock( handle->loop );
+  if ( stream_.state == STREAM_RUNNING ) {
+    handle->stopRequest = request;
+    stream_.state.store( STREAM_STOPPING, std::memory_order_release );
+    beginStop();
+  }
+  while ( stream_.state == STREAM_STOPPING ) {
+    if ( pw_thread_loop_timed_wait( handle->loop, 3 ) != 0 )
+      finishStop( 0 );
+  }
+  int result = handle->stopResult;
+  pw_thread_loop_unlock( handle->loop );
+
+  if ( result < 0 ) return error( RTAUDIO_SYSTEM_ERROR );
+  return RTAUDIO_NO_ERROR;
+}
+
+void RtApiPipeWire :: stopEvent( void )
+{
+  beginStop();
+}
+
+// Called on the loop thread, or with the loop locked.
+void RtApiPipeWire :: beginStop( void )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  if ( stream_.state.load( std::memory_order_acquire ) != STREAM_STOPPING ) return;
+
+  if ( handle->stream[OUTPUT] && handle->stopRequest == 1 ) {
+    int result = pw_stream_flush( handle->stream[OUTPUT], true );
+    if ( result == 0 ) return; // drainEvent() follows.
+    errorStream_ << "RtApiPipeWire::stopStream: error draining output stream, " <<
+      spa_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    finishStop( result );
+    return;
+  }
+
+  finishStop( 0 );
+}
+
+void RtApiPipeWire :: drainEvent( void )
+{
+  if ( stream_.state.load( std::memory_order_acquire ) == STREAM_STOPPING )
+    finishStop( 0 );
+}
+
+// Discards the queued output (for an abort), deactivates the streams
+// and marks the stream stopped.  Called on the loop thread, or with
+// the loop locked.
+void RtApiPipeWire :: finishStop( int result )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  if ( handle->stream[OUTPUT] && handle->stopRequest == 2 )
+    pw_stream_flush( handle->stream[OUTPUT], false );
+  for ( int i=0; i<2; i++ )
+    if ( handle->stream[i] ) pw_stream_set_active( handle->stream[i], false );
+
+  handle->stopResult = result;
+  stream_.state.store( STREAM_STOPPED, std::memory_order_release );
+  pw_thread_loop_signal( handle->loop, false );
+}
+
+// Hands a change of the graph quantum to the loop thread, which
+// reports it.
+void RtApiPipeWire :: noteQuantum( StreamMode mode )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  spa_io_position *position = handle->position[mode];
+  if ( !position ) return;
+
+  uint64_t quantum = position->clock.duration;
+  if ( quantum == handle->quantum.exchange( quantum, std::memory_order_relaxed ) ) return;
+  pw_loop_invoke( pw_thread_loop_get_loop( handle->loop ), rt_pw_invoke_quantum,
+                  (uint32_t) quantum, NULL, 0, false, handle );
+}
+
+void RtApiPipeWire :: quantumEvent( unsigned int frames )
+{
+  errorStream_ << "RtApiPipeWire: the graph quantum is now " << frames <<
+    " frames, for a stream buffer size of " << stream_.bufferSize << " frames.";
+  errorText_ = errorStream_.str();
+  error( RTAUDIO_WARNING );
+}
+
+// Fills a dequeued playback buffer.  A buffer of exactly one period is
+// written in place by the callback (or by the conversion from the user
+// buffer).  Otherwise, periods are queued through the quantum buffer,
+// which a duplex stream fills from its input side.
+void RtApiPipeWire :: processOutput( void )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  pw_buffer *buffer = pw_stream_dequeue_buffer( handle->stream[OUTPUT] );
+  if ( !buffer ) return;
+
+  handle->processThread.store( pthread_self(), std::memory_order_relaxed );
+  noteQuantum( OUTPUT );
+
+  spa_data *data = &buffer->buffer->datas[0];
+  RingBuffer *fifo = quantumBuffer_[OUTPUT];
+  unsigned int frameBytes = fifo->frameBytes();
+  bool planar = handle->planar[OUTPUT];
+  unsigned int stride = planar ? sizeof( float ) : frameBytes;
+  unsigned int frames = 0;
+  char *out = static_cast<char *>( data->data );
+  if ( planar ? mapPlanes( OUTPUT, buffer->buffer ) : out != NULL ) {
+    frames = data->maxsize / stride;
+    if ( buffer->requested && buffer->requested < frames ) frames = buffer->requested;
+    if ( planar && frames > RT_PW_MAX_QUANTUM ) frames = RT_PW_MAX_QUANTUM;
+
+    bool duplex = ( stream_.mode == DUPLEX );
+    if ( !duplex && frames == stream_.bufferSize && fifo->readAvailable() == 0 &&
+         stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING ) {
+      if ( planar )
+        processPeriod( NULL, NULL, NULL, &handle->planes[OUTPUT][0] );
+      else
+        processPeriod( NULL, out );
+    }
+    else {
+      while ( !duplex && fifo->readAvailable() < frames && fifo->writeAvailable() >= stream_.bufferSize &&
+              stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING ) {
+        processPeriod( NULL, &handle->period[OUTPUT][0] );
+        fifo->write( &handle->period[OUTPUT][0], stream_.bufferSize );
+      }
+
+      char *period = planar ? (char *) &handle->frames[OUTPUT][0] : out;
+      unsigned int n = fifo->read( period, frames );
+      if ( n < frames ) {
+        memset( period + n * frameBytes, 0, ( frames - n ) * frameBytes );
+        if ( stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING )
+          handle->xrun[OUTPUT] = true;
+      }
+      if ( planar )
+        rt_pw_deinterleave( &handle->planes[OUTPUT][0], &handle->frames[OUTPUT][0],
+                            stream_.nDeviceChannels[OUTPUT], frames );
+    }
+  }
+
+  uint32_t nDatas = planar ? handle->planes[OUTPUT].size() : 1;
+  for ( uint32_t i=0; i<nDatas && i<buffer->buffer->n_datas; i++ ) {
+    spa_chunk *chunk = buffer->buffer->datas[i].chunk;
+    chunk->offset = 0;
+    chunk->stride = stride;
+    chunk->size = frames * stride;
+  }
+  pw_stream_queue_buffer( handle->stream[OUTPUT], buffer );
+}
+
+// Processes a dequeued capture buffer.  A buffer of exactly one period
+// is read in place; otherwise it is gathered into periods through the
+// quantum buffer.
+void RtApiPipeWire :: processInput( void )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  pw_buffer *buffer = pw_stream_dequeue_buffer( handle->stream[INPUT] );
+  if ( !buffer ) return;
+
+  handle->processThread.store( pthread_self(), std::memory_order_relaxed );
+  noteQuantum( INPUT );
+
+  spa_data *data = &buffer->buffer->datas[0];
+  bool planar = handle->planar[INPUT];
+  if ( ( planar ? mapPlanes( INPUT, buffer->buffer ) : data->data != NULL ) &&
+       stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING ) {
+    RingBuffer *fifo = quantumBuffer_[INPUT];
+    uint32_t offset = std::min( data->chunk->offset, data->maxsize );
+    uint32_t size = std::min( data->chunk->size, data->maxsize - offset );
+    unsigned int frames = size / ( planar ? sizeof( float ) : fifo->frameBytes() );
+    const char *in = static_cast<const char *>( data->data ) + offset;
+
+    if ( frames == stream_.bufferSize && fifo->readAvailable() == 0 ) {
+      if ( planar )
+        processPeriod( NULL, NULL, &handle->planes[INPUT][0] );
+      else
+        processPeriod( in, NULL );
+    }
+    else {
+      if ( planar ) {
+        if ( frames > RT_PW_MAX_QUANTUM ) frames = RT_PW_MAX_QUANTUM;
+        rt_pw_interleave( &handle->frames[INPUT][0], &handle->planes[INPUT][0],
+                          stream_.nDeviceChannels[INPUT], frames );
+        in = (const char *) &handle->frames[INPUT][0];
+      }
+      if ( fifo->write( in, frames ) < frames ) handle->xrun[INPUT] = true;
+      while ( fifo->readAvailable() >= stream_.bufferSize &&
+              stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING ) {
+        fifo->read( &handle->period[INPUT][0], stream_.bufferSize );
+        processPeriod( &handle->period[INPUT][0], NULL );
+      }
+    }
+  }
+
+  pw_stream_queue_buffer( handle->stream[INPUT], buffer );
+}
+
+// Points handle->planes at the channels of a buffer with planar
+// samples.  False is returned if the buffer does not have a mapped
+// data for each channel.
+bool RtApiPipeWire :: mapPlanes( StreamMode mode, spa_buffer *buffer )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  std::vector<float *> &planes = handle->planes[mode];
+  if ( buffer->n_datas < planes.size() ) return false;
+
+  for ( size_t i=0; i<planes.size(); i++ ) {
+    spa_data &data = buffer->datas[i];
+    if ( !data.data ) return false;
+    uint32_t offset = ( mode == INPUT ) ? std::min( data.chunk->offset, data.maxsize ) : 0;
+    planes[i] = (float *) ( static_cast<char *>( data.data ) + offset );
+  }
+  return true;
+}
+
+// Runs the callback for one period.  The input (if any) is at input
+// and the output is written to output, both interleaved in the device
+// format, or else at the device channels in inputPlanes and
+// outputPlanes, for buffers with planar samples.  A planar callback is
+// given these channels in place.  For a duplex stream, which is driven
+// by its input, the output period is queued for the playback stream
+// instead.
+void RtApiPipeWire :: processPeriod( const char *input, char *output,
+                                     float * const *inputPlanes, float * const *outputPlanes )
+{
+  PipeWireHandle *handle = static_cast<PipeWireHandle *>( stream_.apiHandle );
+  char *out = output;
+  if ( ( input || inputPlanes ) && stream_.mode == DUPLEX ) {
+    out = &handle->period[OUTPUT][0];
+    outputPlanes = NULL;
+  }
+
+  // The device channels before those of the stream.
+  unsigned int first[2] = { stream_.nDeviceChannels[OUTPUT] - stream_.nUserChannels[OUTPUT],
+                            stream_.nDeviceChannels[INPUT] - stream_.nUserChannels[INPUT] };
+  bool direct = ( stream_.planar && !stream_.rateConversion );
+  size_t planeBytes = stream_.bufferSize * sizeof( float );
+
+  if ( inputPlanes ) {
+    for ( unsigned int i=0; i<stream_.nUserChannels[INPUT]; i++ ) {
+      if ( direct )
+        stream_.planar->channels[INPUT][i] = inputPlanes[first[INPUT] + i];
+      else
+        memcpy( stream_.userBuffer[INPUT] + i * planeBytes, inputPlanes[first[INPUT] + i], planeBytes );
+    }
+  }
+  else if ( input ) {
+    if ( stream_.doConvertBuffer[INPUT] )
+      convertBuffer( stream_.userBuffer[INPUT], (char *) input, stream_.convertInfo[INPUT] );
+    else
+      memcpy( stream_.userBuffer[INPUT], input, handle->period[INPUT].size() );
+  }
+
+  if ( outputPlanes ) {
+    for ( unsigned int i=0; i<first[OUTPUT]; i++ )
+      memset( outputPlanes[i], 0, planeBytes );
+    if ( direct )
+      for ( unsigned int i=0; i<stream_.nUserChannels[OUTPUT]; i++ )
+        stream_.planar->channels[OUTPUT][i] = outputPlanes[first[OUTPUT] + i];
+  }
+
+  char *userOut = stream_.userBuffer[OUTPUT];
+  if ( out && !stream_.doConvertBuffer[OUTPUT] ) userOut = out;
+
+  RtAudioStreamStatus status = 0;
+  if ( handle->xrun[OUTPUT] ) {
+    status |= RTAUDIO_OUTPUT_UNDERFLOW;
+    handle->xrun[OUTPUT] = false;
+  }
+  if ( handle->xrun[INPUT] ) {
+    status |= RTAUDIO_INPUT_OVERFLOW;
+    handle->xrun[INPUT] = false;
+  }
+
+  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+  double streamTime = getStreamTime();
+  int doStopStream;
+  beginCallback();
+  if ( direct && ( inputPlanes || outputPlanes ) ) {
+    if ( !inputPlanes ) setPlanarChannels( INPUT, stream_.userBuffer[INPUT], stream_.bufferSize );
+    if ( !outputPlanes ) setPlanarChannels( OUTPUT, userOut, stream_.bufferSize );
+    doStopStream = invokePlanarCallback( stream_.bufferSize, streamTime, status );
+  }
+  else
+    doStopStream = callback( userOut, stream_.userBuffer[INPUT],
+                             stream_.bufferSize, streamTime, status,
+                             stream_.callbackInfo.userData );
+  endCallback( status );
+
+  if ( doStopStream == 2 ) {
+    if ( out ) memset( out, 0, handle->period[OUTPUT].size() );
+    for ( unsigned int i=0; outputPlanes && i<stream_.nDeviceChannels[OUTPUT]; i++ )
+      memset( outputPlanes[i], 0, planeBytes );
+    abortStream();
+    return;
+  }
+
+  if ( outputPlanes && !direct ) {
+    for ( unsigned int i=0; i<stream_.nUserChannels[OUTPUT]; i++ )
+      memcpy( outputPlanes[first[OUTPUT] + i], stream_.userBuffer[OUTPUT] + i * planeBytes, planeBytes );
+  }
+  if ( out && stream_.doConvertBuffer[OUTPUT] )
+    convertBuffer( out, stream_.userBuffer[OUTPUT], stream_.convertInfo[OUTPUT] );
+  if ( out && !output )
+    quantumBuffer_[OUTPUT]->write( out, stream_.bufferSize );
+
+  RtApi::tickStreamTime();
+
+  if ( doStopStream == 1 )
+    stopStream();
+}
+
+//******************** End of __LINUX_PIPEWIRE__ *********************//
+#endif
+
+
+#if defined(__LINUX_OSS__)
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <sys/mman.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
+static void *ossCallbackHandler(void * ptr);
+
+// A structure to hold various information related to the OSS API
+// implementation.
+struct OssHandle {
+  int id[2];    // device ids
+  bool xrun[2];
+  bool triggered;
+  bool inputTriggered; // Separate input device started (RTAUDIO_DRIFT_COMPENSATION).
+  pthread_cond_t runnable;
+  int stopRequest; // 1 = stop, 2 = abort, posted with STREAM_STOPPING.
+  int stopResult;
+  bool mmap[2];         // DMA buffers mapped for RTAUDIO_OSS_USE_MMAP.
+  bool mmapStarted;     // Mapped devices triggered.
+  char *mmapBuffer[2];
+  int mmapBytes[2];
+  int periodBytes[2];   // One period, which is one fragment, in the device format.
+  int mmapOffset[2];    // Offset of the next period to write or read.
+  int mmapPeriods[2];   // Periods queued ahead of the DMA pointer, or captured and not read.
+
+  OssHandle()
+    :triggered(false), inputTriggered(false), stopRequest(0), stopResult(0), mmapStarted(false)
+  {
+    for ( int i=0; i<2; i++ ) {
+      id[i] = 0; xrun[i] = false; mmap[i] = false; mmapBuffer[i] = 0;
+      mmapBytes[i] = 0; periodBytes[i] = 0; mmapOffset[i] = 0; mmapPeriods[i] = 0;
+    }
+  }
+};
+
+RtApiOss :: RtApiOss()
+{
+  // Nothing to do here.
+}
+
+RtApiOss :: ~RtApiOss()
+{
+  if ( stream_.state != STREAM_CLOSED ) closeStream();
+}
+
+void RtApiOss :: probeDevices( void )
+{
+  // See list of required functionality in RtApi::probeDevices().
+  
+  int mixerfd = open( "/dev/mixer", O_RDWR, 0 );
+  if ( mixerfd == -1 ) {
+    errorText_ = "RtApiOss::probeDevices: error opening '/dev/mixer'.";
+    error( RTAUDIO_SYSTEM_ERROR );
+    return;
+  }
+
+  oss_sysinfo sysinfo;
+  if ( ioctl( mixerfd, SNDCTL_SYSINFO, &sysinfo ) == -1 ) {
+    close( mixerfd );
+    errorText_ = "RtApiOss::probeDevices: error getting sysinfo, OSS version >= 4.0 is required.";
+    error( RTAUDIO_SYSTEM_ERROR );
+    return;
+  }
+
+  unsigned int nDevices = sysinfo.numaudios;
+  if ( nDevices == 0 ) {
+    close( mixerfd );
+    deviceList_.clear();
+    return;
+  }
+
+  oss_audioinfo ainfo;
+  unsigned int m, n;
+  std::vector<std::string> deviceNames;
+  for ( n=0; n<nDevices; n++ ) {
+    ainfo.dev = n;
+    if ( ioctl( mixerfd, SNDCTL_AUDIOINFO, &ainfo ) == -1 ) continue;
+    deviceNames.push_back( ainfo.name );
+    for ( m=0; m<deviceList_.size(); m++ ) {
+      if ( deviceList_[m].name == deviceNames.back() )
+        break; // We already have this device.
+    }
+    if ( m == deviceList_.size() ) { // new device
+      RtAudio::DeviceInfo info;
+      if ( probeDeviceInfo( info, ainfo ) == false ) continue; // ignore if probe fails
+      info.ID = currentDeviceId_++;  // arbitrary internal device ID
+      deviceList_.push_back( info );
+    }
+  }
+  close( mixerfd );
+
+  // Remove any devices left in the list that are no longer available.
+  for ( std::vector<RtAudio::DeviceInfo>::iterator it=deviceList_.begin(); it!=deviceList_.end(); ) {
+    for ( m=0; m<deviceNames.size(); m++ ) {
+      if ( (*it).name == deviceNames[m] ) {
+        ++it;
+        break;
+      }
+    }
+    if ( m == deviceNames.size() ) // not found so remove it from our list
+      it = deviceList_.erase( it );
+  }
+
+  // I don't think the OSS API supports default devices. Our parent
+  // class versions of the getDefault functions will return the first
+  // one found.
+}
+
+bool RtApiOss :: probeDeviceInfo( RtAudio::DeviceInfo &info, oss_audioinfo &ainfo )
+{
+  // Probe channels
+  if ( ainfo.caps & PCM_CAP_OUTPUT ) info.outputChannels = ainfo.max_channels;
+  if ( ainfo.caps & PCM_CAP_INPUT ) info.inputChannels = ainfo.max_channels;
+  if ( ainfo.caps & PCM_CAP_DUPLEX ) {
+    if ( info.outputChannels > 0 && info.inputChannels > 0 && ainfo.caps & PCM_CAP_DUPLEX )
+      info.duplexChannels = (info.outputChannels > info.inputChannels) ? info.inputChannels : info.outputChannels;
+  }
+
+  // Probe data formats ... do for input
+  unsigned long mask = ainfo.iformats;
+  if ( mask & AFMT_S16_LE || mask & AFMT_S16_BE )
+    info.nativeFormats |= RTAUDIO_SINT16;
+  if ( mask & AFMT_S8 )
+    info.nativeFormats |= RTAUDIO_SINT8;
+  if ( mask & AFMT_S32_LE || mask & AFMT_S32_BE )
+    info.nativeFormats |= RTAUDIO_SINT32;
+#ifdef AFMT_FLOAT
+  if ( mask & AFMT_FLOAT )
+    info.nativeFormats |= RTAUDIO_FLOAT32;
+#endif
+  if ( mask & AFMT_S24_LE || mask & AFMT_S24_BE )
+    info.nativeFormats |= RTAUDIO_SINT24;
+
+  // Check that we have at least one supported format
+  if ( info.nativeFormats == 0 ) {
+    errorStream_ << "RtApiOss::probeDeviceInfo: device (" << ainfo.name << ") data format not supported by RtAudio.";
+    errorText_ = errorStream_.str();
+    error( RTAUDIO_WARNING );
+    return false;
+  }
+
+  // Probe the supported sample rates.
+  info.sampleRates.clear();
+  if ( ainfo.nrates ) {
+    for ( unsigned int i=0; i<ainfo.nrates; i++ ) {
+      for ( unsigned int k=0; k<MAX_SAMPLE_RATES; k++ ) {
+        if ( ainfo.rates[i] == SAMPLE_RATES[k] ) {
+          info.sampleRates.push_back( SAMPLE_RATES[k] );
+
+          if ( !info.preferredSampleRate || ( SAMPLE_RATES[k] <= 48000 && SAMPLE_RATES[k] > info.preferredSampleRate ) )
+            info.preferredSampleRate = SAMPLE_RATES[k];
+
+          break;
+        }
+      }
+    }
+  }
+  else {
+    // Check min and max rate values;
+    for ( unsigned int k=0; k<MAX_SAMPLE_RATES; k++ ) {
+      if ( ainfo.min_rate <= (int) SAMPLE_RATES[k] && ainfo.max_rate >= (int) SAMPLE_RATES[k] ) {
+        info.sampleRates.push_back( SAMPLE_RATES[k] );
+
+        if ( !info.preferredSampleRate || ( SAMPLE_RATES[k] <= 48000 && SAMPLE_RATES[k] > info.preferredSampleRate ) )
+          info.preferredSampleRate = SAMPLE_RATES[k];
+      }
+    }
+  }
+
+  if ( info.sampleRates.size() == 0 ) {
+    errorStream_ << "RtApiOss::probeDeviceInfo: no supported sample rates found for device (" << ainfo.name << ").";
+    errorText_ = errorStream_.str();
+    error( RTAUDIO_WARNING );
+    return false;
+  }
+
+  return true;
+}
+
+
+bool RtApiOss :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
+                                  unsigned int firstChannel, unsigned int sampleRate,
+                                  RtAudioFormat format, unsigned int *bufferSize,
+                                  RtAudio::StreamOptions *options )
+{
+  int mixerfd = open( "/dev/mixer", O_RDWR, 0 );
+  if ( mixerfd == -1 ) {
+    errorText_ = "RtApiOss::probeDeviceOpen: error opening '/dev/mixer'.";
+    return FAILURE;
+  }
+
+  oss_sysinfo sysinfo;
+  int result = ioctl( mixerfd, SNDCTL_SYSINFO, &sysinfo );
+  if ( result == -1 ) {
+    close( mixerfd );
+    errorText_ = "RtApiOss::probeDeviceOpen: error getting sysinfo, OSS version >= 4.0 is required.";
+    return FAILURE;
+  }
+
+  unsigned int nDevices = sysinfo.numaudios;
+  if ( nDevices == 0 ) {
+    // This should not happen because a check is made before this function is called.
+    close( mixerfd );
+    errorText_ = "RtApiOss::probeDeviceOpen: no devices found!";
+    return FAILURE;
+  }
+
+  std::string deviceName;
+  unsigned int m, device;
+  for ( m=0; m<deviceList_.size(); m++ ) {
+    if ( deviceList_[m].ID == deviceId ) {
+      deviceName = deviceList_[m].name;
+      break;
+    }
+  }
+
+  if ( deviceName.empty() ) {
+    errorText_ = "RtApiOss::probeDeviceOpen: device ID is invalid!";
+    return FAILURE;
+  }
+
+  oss_audioinfo ainfo;
+  for ( device=0; device<nDevices; device++ ) {
+    ainfo.dev = device;
+    result = ioctl( mixerfd, SNDCTL_AUDIOINFO, &ainfo );
+    if ( result == -1 ) continue;
+    if ( deviceName == std::string( ainfo.name ) ) break;
+  }
+
+  close( mixerfd );
+  if ( device == nDevices ) {
+    errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") not found.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Check if device supports input or output
+  if ( ( mode == OUTPUT && !( ainfo.caps & PCM_CAP_OUTPUT ) ) ||
+       ( mode == INPUT && !( ainfo.caps & PCM_CAP_INPUT ) ) ) {
     if ( mode == OUTPUT )
       errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") does not support output.";
     else
-      errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") does not support input.";
+      errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") does not support input.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // DMA buffers are mapped for RTAUDIO_OSS_USE_MMAP, except for input
+  // resampled by RTAUDIO_DRIFT_COMPENSATION.  Mapping the output needs
+  // a device opened for reading too.
+  bool sameDevice = ( mode == INPUT && stream_.mode == OUTPUT && stream_.deviceId[0] == device );
+  bool useMmap = ( options && options->flags & RTAUDIO_OSS_USE_MMAP &&
+                   ( ainfo.caps & PCM_CAP_MMAP ) && ( ainfo.caps & PCM_CAP_TRIGGER ) );
+  if ( mode == OUTPUT && !( ainfo.caps & PCM_CAP_DUPLEX ) ) useMmap = false;
+  if ( useMmap && mode == INPUT && !sameDevice && stream_.mode == OUTPUT && options->flags & RTAUDIO_DRIFT_COMPENSATION )
+    useMmap = false;
+
+  int flags = 0;
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( mode == OUTPUT )
+    flags |= useMmap ? O_RDWR : O_WRONLY;
+  else { // mode == INPUT
+    if (stream_.mode == OUTPUT && stream_.deviceId[0] == device) {
+      // We just set the same device for playback ... close and reopen for duplex (OSS only).
+      unmapBuffer( OUTPUT );
+      close( handle->id[0] );
+      handle->id[0] = 0;
+      if ( !( ainfo.caps & PCM_CAP_DUPLEX ) ) {
+        errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") does not support duplex mode.";
+        errorText_ = errorStream_.str();
+        return FAILURE;
+      }
+      // Check that the number previously set channels is the same.
+      if ( stream_.nUserChannels[0] != channels ) {
+        errorStream_ << "RtApiOss::probeDeviceOpen: input/output channels must be equal for OSS duplex device (" << ainfo.name << ").";
+        errorText_ = errorStream_.str();
+        return FAILURE;
+      }
+      flags |= O_RDWR;
+    }
+    else
+      flags |= O_RDONLY;
+  }
+
+  // Set exclusive access if specified.
+  if ( options && options->flags & RTAUDIO_HOG_DEVICE ) flags |= O_EXCL;
+
+  // Try to open the device.
+  int fd;
+  fd = open( ainfo.devnode, flags, 0 );
+  if ( fd == -1 ) {
+    if ( errno == EBUSY )
+      errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") is busy.";
+    else
+      errorStream_ << "RtApiOss::probeDeviceOpen: error opening device (" << ainfo.name << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Mapped buffers hold the device samples, so the software
+  // conversions of OSS must be disabled (failures are to be ignored).
+  if ( useMmap ) {
+    int cooked = 0;
+    ioctl( fd, SNDCTL_DSP_COOKEDMODE, &cooked );
+  }
+
+  // For duplex operation, specifically set this mode (this doesn't seem to work).
+  /*
+    if ( flags | O_RDWR ) {
+    result = ioctl( fd, SNDCTL_DSP_SETDUPLEX, NULL );
+    if ( result == -1) {
+    errorStream_ << "RtApiOss::probeDeviceOpen: error setting duplex mode for device (" << ainfo.name << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+    }
+    }
+  */
+
+  // Check the device channel support.
+  stream_.nUserChannels[mode] = channels;
+  if ( ainfo.max_channels < (int)(channels + firstChannel) ) {
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: the device (" << ainfo.name << ") does not support requested channel parameters.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Set the number of channels.
+  int deviceChannels = channels + firstChannel;
+  result = ioctl( fd, SNDCTL_DSP_CHANNELS, &deviceChannels );
+  if ( result == -1 || deviceChannels < (int)(channels + firstChannel) ) {
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: error setting channel parameters on device (" << ainfo.name << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  stream_.nDeviceChannels[mode] = deviceChannels;
+
+  // Get the data format mask
+  int mask;
+  result = ioctl( fd, SNDCTL_DSP_GETFMTS, &mask );
+  if ( result == -1 ) {
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: error getting device (" << ainfo.name << ") data formats.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Determine how to set the device format.
+  stream_.userFormat = format;
+  int deviceFormat = -1;
+  stream_.doByteSwap[mode] = false;
+  if ( format == RTAUDIO_SINT8 ) {
+    if ( mask & AFMT_S8 ) {
+      deviceFormat = AFMT_S8;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT8;
+    }
+  }
+  else if ( format == RTAUDIO_SINT16 ) {
+    if ( mask & AFMT_S16_NE ) {
+      deviceFormat = AFMT_S16_NE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
+    }
+    else if ( mask & AFMT_S16_OE ) {
+      deviceFormat = AFMT_S16_OE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
+      stream_.doByteSwap[mode] = true;
+    }
+  }
+  else if ( format == RTAUDIO_SINT24 ) {
+    if ( mask & AFMT_S24_NE ) {
+      deviceFormat = AFMT_S24_NE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
+    }
+    else if ( mask & AFMT_S24_OE ) {
+      deviceFormat = AFMT_S24_OE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
+      stream_.doByteSwap[mode] = true;
+    }
+  }
+  else if ( format == RTAUDIO_SINT32 ) {
+    if ( mask & AFMT_S32_NE ) {
+      deviceFormat = AFMT_S32_NE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
+    }
+    else if ( mask & AFMT_S32_OE ) {
+      deviceFormat = AFMT_S32_OE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
+      stream_.doByteSwap[mode] = true;
+    }
+  }
+
+  if ( deviceFormat == -1 ) {
+    // The user requested format is not natively supported by the device.
+    if ( mask & AFMT_S16_NE ) {
+      deviceFormat = AFMT_S16_NE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
+    }
+    else if ( mask & AFMT_S32_NE ) {
+      deviceFormat = AFMT_S32_NE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
+    }
+    else if ( mask & AFMT_S24_NE ) {
+      deviceFormat = AFMT_S24_NE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
+    }
+    else if ( mask & AFMT_S16_OE ) {
+      deviceFormat = AFMT_S16_OE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
+      stream_.doByteSwap[mode] = true;
+    }
+    else if ( mask & AFMT_S32_OE ) {
+      deviceFormat = AFMT_S32_OE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
+      stream_.doByteSwap[mode] = true;
+    }
+    else if ( mask & AFMT_S24_OE ) {
+      deviceFormat = AFMT_S24_OE;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
+      stream_.doByteSwap[mode] = true;
+    }
+    else if ( mask & AFMT_S8) {
+      deviceFormat = AFMT_S8;
+      stream_.deviceFormat[mode] = RTAUDIO_SINT8;
+    }
+  }
+
+  if ( stream_.deviceFormat[mode] == 0 ) {
+    // This really shouldn't happen ...
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") data format not supported by RtAudio.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Set the data format.
+  int temp = deviceFormat;
+  result = ioctl( fd, SNDCTL_DSP_SETFMT, &deviceFormat );
+  if ( result == -1 || deviceFormat != temp ) {
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: error setting data format on device (" << ainfo.name << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Attempt to set the buffer size.  According to OSS, the minimum
+  // number of buffers is two.  The supposed minimum buffer size is 16
+  // bytes, so that will be our lower bound.  The argument to this
+  // call is in the form 0xMMMMSSSS (hex), where the buffer size (in
+  // bytes) is given as 2^SSSS and the number of buffers as 2^MMMM.
+  // We'll check the actual value used near the end of the setup
+  // procedure.
+  int ossBufferBytes = *bufferSize * formatBytes( stream_.deviceFormat[mode] ) * deviceChannels;
+  if ( ossBufferBytes < 16 ) ossBufferBytes = 16;
+  int buffers = 0;
+  if ( options ) buffers = options->numberOfBuffers;
+  if ( options && options->flags & RTAUDIO_MINIMIZE_LATENCY ) buffers = 2;
+  if ( buffers < 2 ) buffers = 3;
+  temp = ((int) buffers << 16) + (int)( log10( (double)ossBufferBytes ) / log10( 2.0 ) );
+  result = ioctl( fd, SNDCTL_DSP_SETFRAGMENT, &temp );
+  if ( result == -1 ) {
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: error setting buffer size on device (" << ainfo.name << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  stream_.nBuffers = buffers;
+
+  // Save buffer size (in sample frames).
+  *bufferSize = ossBufferBytes / ( formatBytes(stream_.deviceFormat[mode]) * deviceChannels );
+  stream_.bufferSize = *bufferSize;
+
+  // Set the sample rate.
+  int srate = sampleRate;
+  result = ioctl( fd, SNDCTL_DSP_SPEED, &srate );
+  if ( result == -1 ) {
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: error setting sample rate (" << sampleRate << ") on device (" << ainfo.name << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
+  // Verify the sample rate setup worked.
+  if ( abs( srate - (int)sampleRate ) > 100 ) {
+    close( fd );
+    errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") does not support sample rate (" << sampleRate << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  stream_.sampleRate = sampleRate;
+
+  if ( mode == INPUT && stream_.mode == OUTPUT && stream_.deviceId[0] == device) {
+    // We're doing duplex setup here.
+    stream_.deviceFormat[0] = stream_.deviceFormat[1];
+    stream_.nDeviceChannels[0] = deviceChannels;
+  }
+
+  // Set interleaving parameters.
+  stream_.userInterleaved = true;
+  stream_.deviceInterleaved[mode] =  true;
+  if ( options && options->flags & RTAUDIO_NONINTERLEAVED )
+    stream_.userInterleaved = false;
+
+  // Set flags for buffer conversion
+  stream_.doConvertBuffer[mode] = false;
+  if ( stream_.userFormat != stream_.deviceFormat[mode] )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.nUserChannels[mode] < stream_.nDeviceChannels[mode] )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
+       stream_.nUserChannels[mode] > 1 )
+    stream_.doConvertBuffer[mode] = true;
+
+  // Input from a second device is resampled to the output clock after
+  // conversion (RTAUDIO_DRIFT_COMPENSATION).
+  bool compensateDrift = ( mode == INPUT && stream_.mode == OUTPUT && stream_.deviceId[0] != device &&
+                           options && options->flags & RTAUDIO_DRIFT_COMPENSATION );
+  if ( compensateDrift )
+    stream_.doConvertBuffer[mode] = true;
+
+  // Allocate the stream handles if necessary and then save.
+  if ( stream_.apiHandle == 0 ) {
+    try {
+      handle = new OssHandle;
+    }
+    catch ( std::bad_alloc& ) {
+      errorText_ = "RtApiOss::probeDeviceOpen: error allocating OssHandle memory.";
+      goto error;
+    }
+
+    if ( pthread_cond_init( &handle->runnable, NULL ) ) {
+      errorText_ = "RtApiOss::probeDeviceOpen: error initializing pthread condition variable.";
+      goto error;
+    }
+
+    stream_.apiHandle = (void *) handle;
+  }
+  else {
+    handle = (OssHandle *) stream_.apiHandle;
+  }
+  handle->id[mode] = fd;
+
+  // Map the DMA buffers, both at once for a duplex device, and keep
+  // the device stopped until the stream starts.  Otherwise, read() and
+  // write() are used.
+  if ( useMmap ) {
+    bool mapped = mapBuffer( mode, fd );
+    if ( sameDevice ) mapped = mapped && mapBuffer( OUTPUT, fd );
+    int trig = 0;
+    if ( !mapped ) {
+      unmapBuffer( mode );
+      if ( sameDevice ) unmapBuffer( OUTPUT );
+      trig = PCM_ENABLE_INPUT | PCM_ENABLE_OUTPUT;
+    }
+    ioctl( fd, SNDCTL_DSP_SETTRIGGER, &trig );
+  }
+
+  // Allocate necessary internal buffers.
+  unsigned long bufferBytes;
+  bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
+  stream_.userBuffer[mode] = (char *) calloc( bufferBytes, 1 );
+  if ( stream_.userBuffer[mode] == NULL ) {
+    errorText_ = "RtApiOss::probeDeviceOpen: error allocating user buffer memory.";
+    goto error;
+  }
+
+  if ( stream_.doConvertBuffer[mode] ) {
+
+    bool makeBuffer = true;
+    bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
+    if ( mode == INPUT ) {
+      if ( stream_.mode == OUTPUT && stream_.deviceBuffer ) {
+        unsigned long bytesOut = stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] );
+        if ( bufferBytes <= bytesOut ) makeBuffer = false;
+      }
+    }
+
+    if ( makeBuffer ) {
+      bufferBytes *= *bufferSize;
+      if ( stream_.deviceBuffer ) free( stream_.deviceBuffer );
+      stream_.deviceBuffer = (char *) calloc( bufferBytes, 1 );
+      if ( stream_.deviceBuffer == NULL ) {
+        errorText_ = "RtApiOss::probeDeviceOpen: error allocating device buffer memory.";
+        goto error;
+      }
+    }
+  }
+
+  stream_.deviceId[mode] = device;
+  stream_.state = STREAM_STOPPED;
+
+  // Setup the buffer conversion information structure.
+  if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
+
+  // Setup thread if necessary.
+  if ( stream_.mode == OUTPUT && mode == INPUT ) {
+    // We had already set up an output stream.
+    stream_.mode = DUPLEX;
+    if ( stream_.deviceId[0] == device ) handle->id[0] = fd;
+    if ( compensateDrift ) setupDriftCompensation();
+  }
+  else if ( options && ( options->flags & RTAUDIO_EXTERNAL_THREAD ) ) {
+    stream_.mode = mode;
+
+    // The stream is driven by processOnce() instead of a thread, with
+    // an epoll descriptor watching the devices while it is running.
+    stream_.external = true;
+#if defined(__linux__)
+    stream_.pollDescriptor = epoll_create1( EPOLL_CLOEXEC );
+    if ( stream_.pollDescriptor < 0 ) {
+      errorText_ = "RtApiOss::probeDeviceOpen: error creating the stream poll descriptor.";
+      error( RTAUDIO_WARNING );
+    }
+#endif
+  }
+  else {
+    stream_.mode = mode;
+
+    // Setup callback thread.
+    stream_.callbackInfo.object = (void *) this;
+
+    // Set the thread attributes for joinable and realtime scheduling
+    // priority.  The higher priority will only take affect if the
+    // program is run as root or suid.  The thread applies the other
+    // options itself (deadline scheduling starts as round-robin).
+    setCallbackThreadOptions( options );
+    pthread_attr_t attr;
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
+#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
+    if ( stream_.callbackInfo.doRealtime ) {
+      struct sched_param param;
+      int policy = ( options->schedulingPolicy == RtAudio::SCHEDULE_FIFO ) ? SCHED_FIFO : SCHED_RR;
+      int priority = options->priority;
+      int min = sched_get_priority_min( policy );
+      int max = sched_get_priority_max( policy );
+      if ( priority < min ) priority = min;
+      else if ( priority > max ) priority = max;
+      param.sched_priority = priority;
+      
+      // Set the policy BEFORE the priority. Otherwise it fails.
+      pthread_attr_setschedpolicy(&attr, policy);
+      pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
+      // This is definitely required. Otherwise it fails.
+      pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+      pthread_attr_setschedparam(&attr, &param);
+    }
+    else
+      pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
+#else
+    pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
+#endif
+
+    stream_.callbackInfo.isRunning = true;
+    result = pthread_create( &stream_.callbackInfo.thread, &attr, ossCallbackHandler, &stream_.callbackInfo );
+    pthread_attr_destroy( &attr );
+    if ( result ) {
+      // Failed. Try instead with default attributes.
+      result = pthread_create( &stream_.callbackInfo.thread, NULL, ossCallbackHandler, &stream_.callbackInfo );
+      if ( result ) {
+        stream_.callbackInfo.isRunning = false;
+        errorText_ = "RtApiOss::error creating callback thread!";
+        goto error;
+      }
+    }
+  }
+
+  return SUCCESS;
+
+ error:
+  if ( stream_.pollDescriptor >= 0 ) {
+    close( stream_.pollDescriptor );
+    stream_.pollDescriptor = -1;
+  }
+  if ( handle ) {
+    unmapBuffer( OUTPUT );
+    unmapBuffer( INPUT );
+    pthread_cond_destroy( &handle->runnable );
+    if ( handle->id[0] ) close( handle->id[0] );
+    if ( handle->id[1] ) close( handle->id[1] );
+    delete handle;
+    stream_.apiHandle = 0;
+  }
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+  }
+
+  if ( stream_.deviceBuffer ) {
+    free( stream_.deviceBuffer );
+    stream_.deviceBuffer = 0;
+  }
+
+  stream_.state = STREAM_CLOSED;
+  return FAILURE;
+}
+
+// Maps the DMA buffer of a device for RTAUDIO_OSS_USE_MMAP.  This
+// requires the fragments set up by probeDeviceOpen() to hold exactly
+// one period.  Returns false if the buffer cannot be mapped, in which
+// case read() and write() are used.
+bool RtApiOss :: mapBuffer( StreamMode mode, int fd )
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  int periodBytes = stream_.bufferSize * stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
+  audio_buf_info info;
+  if ( ioctl( fd, ( mode == OUTPUT ) ? SNDCTL_DSP_GETOSPACE : SNDCTL_DSP_GETISPACE, &info ) == -1 ||
+       info.fragsize != periodBytes || info.fragstotal < 2 )
+    return false;
+
+  // Input is mapped read-only, which selects the capture buffer of a
+  // duplex device.
+  int bytes = info.fragsize * info.fragstotal;
+  void *buffer = mmap( NULL, bytes, ( mode == OUTPUT ) ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+  if ( buffer == MAP_FAILED ) return false;
+
+  handle->mmap[mode] = true;
+  handle->mmapBuffer[mode] = (char *) buffer;
+  handle->mmapBytes[mode] = bytes;
+  handle->periodBytes[mode] = periodBytes;
+  return true;
+}
+
+void RtApiOss :: unmapBuffer( StreamMode mode )
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( handle == 0 || !handle->mmap[mode] ) return;
+  munmap( handle->mmapBuffer[mode], handle->mmapBytes[mode] );
+  handle->mmap[mode] = false;
+  handle->mmapBuffer[mode] = 0;
+}
+
+// Starts the mapped devices from the beginning of their buffers, with
+// the output buffer full of silence.  Only called from the callback
+// thread.
+void RtApiOss :: startMmap()
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  for ( int i=0; i<2; i++ ) {
+    if ( !handle->mmap[i] ) continue;
+
+    // Clear the fragment count of the device.
+    count_info ci;
+    ioctl( handle->id[i], ( i == OUTPUT ) ? SNDCTL_DSP_GETOPTR : SNDCTL_DSP_GETIPTR, &ci );
+    handle->mmapOffset[i] = 0;
+    handle->mmapPeriods[i] = 0;
+    if ( i == OUTPUT ) {
+      memset( handle->mmapBuffer[i], 0, handle->mmapBytes[i] );
+      handle->mmapPeriods[i] = handle->mmapBytes[i] / handle->periodBytes[i];
+    }
+  }
+
+  int trig;
+  if ( handle->mmap[0] && handle->mmap[1] && handle->id[0] == handle->id[1] ) {
+    trig = PCM_ENABLE_INPUT | PCM_ENABLE_OUTPUT;
+    ioctl( handle->id[0], SNDCTL_DSP_SETTRIGGER, &trig );
+  }
+  else {
+    for ( int i=0; i<2; i++ ) {
+      if ( !handle->mmap[i] ) continue;
+      trig = ( i == OUTPUT ) ? PCM_ENABLE_OUTPUT : PCM_ENABLE_INPUT;
+      ioctl( handle->id[i], SNDCTL_DSP_SETTRIGGER, &trig );
+    }
+  }
+  handle->mmapStarted = true;
+}
+
+// Waits with poll() until a period can be written to, and read from,
+// each mapped buffer.  The fragments that the DMA pointers went
+// through since the last call are counted to track the periods queued
+// for playback and those captured.  After an xrun, the next period is
+// moved next to the DMA pointer.  The device latencies are updated
+// from the same counts.  Returns false if the wait was interrupted by
+// a stop, failed, or lasted more than limit milliseconds (no limit if
+// negative).  Only called from the callback thread.
+bool RtApiOss :: waitMmap( int limit )
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  int timeout = std::max( 10, (int) ( 4000.0 * stream_.bufferSize / stream_.sampleRate ) );
+  long long deadline = monotonicNanos() + limit * 1000000LL;
+  while ( stream_.state.load( std::memory_order_acquire ) == STREAM_RUNNING ) {
+    struct pollfd pfds[2];
+    int nfds = 0;
+    for ( int i=0; i<2; i++ ) {
+      if ( !handle->mmap[i] ) continue;
+      count_info ci;
+      if ( ioctl( handle->id[i], ( i == OUTPUT ) ? SNDCTL_DSP_GETOPTR : SNDCTL_DSP_GETIPTR, &ci ) == -1 ) {
+        errorText_ = "RtApiOss::callbackEvent: error reading the DMA pointer.";
+        error( RTAUDIO_WARNING );
+        poll( NULL, 0, timeout );
+        return false;
+      }
+
+      int period = handle->periodBytes[i];
+      int periods = handle->mmapBytes[i] / period;
+      int frameBytes = stream_.nDeviceChannels[i] * formatBytes( stream_.deviceFormat[i] );
+      if ( i == OUTPUT ) {
+        // The fragment being played counts as queued.
+        handle->mmapPeriods[i] -= ci.blocks;
+        if ( handle->mmapPeriods[i] <= 0 ) {
+          handle->xrun[i] = true;
+          handle->mmapOffset[i] = ( ( ci.ptr / period + 1 ) % periods ) * period;
+          handle->mmapPeriods[i] = 1;
+        }
+        stream_.latency[i] = ( handle->mmapPeriods[i] * period - ci.ptr % period ) / frameBytes;
+        if ( handle->mmapPeriods[i] < periods ) continue;
+        pfds[nfds].events = POLLOUT;
+      }
+      else {
+        // The fragment being captured is not counted.
+        handle->mmapPeriods[i] += ci.blocks;
+        if ( handle->mmapPeriods[i] >= periods ) {
+          handle->xrun[i] = true;
+          handle->mmapOffset[i] = ( ( ci.ptr / period + periods - 1 ) % periods ) * period;
+          handle->mmapPeriods[i] = 1;
+        }
+        stream_.latency[i] = ( ( handle->mmapPeriods[i] - 1 ) * period + ci.ptr % period ) / frameBytes;
+        if ( handle->mmapPeriods[i] > 0 ) continue;
+        pfds[nfds].events = POLLIN;
+      }
+      pfds[nfds].fd = handle->id[i];
+      pfds[nfds++].revents = 0;
+    }
+
+    if ( nfds == 0 ) return true;
+    int wait = timeout;
+    if ( limit >= 0 ) {
+      long long remaining = deadline - monotonicNanos();
+      if ( remaining <= 0 ) return false;
+      wait = std::min( wait, (int) ( ( remaining + 999999 ) / 1000000 ) );
+    }
+    if ( poll( pfds, nfds, wait ) < 0 && errno != EINTR ) {
+      errorText_ = "RtApiOss::callbackEvent: error waiting for the device.";
+      error( RTAUDIO_WARNING );
+      return false;
+    }
+  }
+  return false;
+}
+
+// Reads the next captured period from the mapped input buffer into the
+// user buffer.  The buffer is mapped read-only, so byte swapping is
+// done on a copy.  Only called from the callback thread.
+void RtApiOss :: readMmap()
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  char *period = handle->mmapBuffer[1] + handle->mmapOffset[1];
+  if ( stream_.doByteSwap[1] ) {
+    char *buffer = stream_.doConvertBuffer[1] ? stream_.deviceBuffer : stream_.userBuffer[1];
+    memcpy( buffer, period, handle->periodBytes[1] );
+    byteSwapBuffer( buffer, stream_.bufferSize * stream_.nDeviceChannels[1], stream_.deviceFormat[1] );
+    period = buffer;
+  }
+  if ( stream_.doConvertBuffer[1] )
+    convertBuffer( stream_.userBuffer[1], period, stream_.convertInfo[1] );
+  else if ( period != stream_.userBuffer[1] )
+    memcpy( stream_.userBuffer[1], period, handle->periodBytes[1] );
+
+  handle->mmapOffset[1] = ( handle->mmapOffset[1] + handle->periodBytes[1] ) % handle->mmapBytes[1];
+  handle->mmapPeriods[1]--;
+}
+
+// Waits until a period can be written to the output device, or read
+// from the input device of an input-only stream, without blocking.
+// Drift compensated input is read without waiting.  Returns false if
+// the device is still busy after timeout milliseconds (no limit if
+// negative).
+bool RtApiOss :: waitForPeriod( int timeout )
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  struct pollfd pfd;
+  if ( stream_.mode == INPUT ) {
+    pfd.fd = handle->id[1];
+    pfd.events = POLLIN;
+  }
+  else {
+    pfd.fd = handle->id[0];
+    pfd.events = POLLOUT;
+  }
+
+  long long deadline = monotonicNanos() + timeout * 1000000LL;
+  while ( true ) {
+    int wait = -1;
+    if ( timeout >= 0 ) {
+      long long remaining = deadline - monotonicNanos();
+      if ( remaining < 0 ) return false;
+      wait = (int) ( ( remaining + 999999 ) / 1000000 );
+    }
+    pfd.revents = 0;
+    int result = poll( &pfd, 1, wait );
+    if ( result < 0 && errno == EINTR ) continue;
+    if ( result == 0 ) return false;
+    return true; // Errors are left to the transfer to report.
+  }
+}
+
+// Adds the device descriptors to the stream poll descriptor, or
+// removes them, so that it only polls readable while the stream is
+// running.  A duplex device is watched for output only.
+void RtApiOss :: watchDevices( bool watch )
+{
+#if defined(__linux__)
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( stream_.pollDescriptor < 0 ) return;
+  for ( int i=0; i<2; i++ ) {
+    if ( i == OUTPUT && stream_.mode == INPUT ) continue;
+    if ( i == INPUT && ( stream_.mode == OUTPUT || stream_.driftCompensation ||
+                         ( stream_.mode == DUPLEX && handle->id[0] == handle->id[1] ) ) ) continue;
+    struct epoll_event event;
+    event.events = ( i == OUTPUT ) ? EPOLLOUT : EPOLLIN;
+    event.data.fd = handle->id[i];
+    epoll_ctl( stream_.pollDescriptor, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, handle->id[i], &event );
+  }
+#else
+  (void) watch;
+#endif
+}
+
+// Runs the next period on the thread calling processOnce().
+int RtApiOss :: processExternal( int timeout )
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( stream_.state != STREAM_RUNNING ) return 0;
+  if ( handle->mmap[0] || handle->mmap[1] ) {
+    if ( !waitMmap( timeout ) ) return 0;
+  }
+  else if ( !waitForPeriod( timeout ) )
+    return 0;
+  callbackEvent();
+  return 1;
+}
+
+void RtApiOss :: closeStream()
+{
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApiOss::closeStream(): no open stream to close!";
+    error( RTAUDIO_WARNING );
+    return;
+  }
+
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( stream_.external ) {
+    // Wait for a concurrent processOnce() call to return.
+    MUTEX_LOCK( &stream_.processMutex );
+  }
+  else {
+    stream_.callbackInfo.isRunning = false;
+    MUTEX_LOCK( &stream_.mutex );
+    if ( stream_.state == STREAM_STOPPED )
+      pthread_cond_signal( &handle->runnable );
+    MUTEX_UNLOCK( &stream_.mutex );
+    pthread_join( stream_.callbackInfo.thread, NULL );
+  }
+
+  if ( stream_.state == STREAM_RUNNING ) {
+    if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX )
+      ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
+    else
+      ioctl( handle->id[1], SNDCTL_DSP_HALT, 0 );
+    stream_.state = STREAM_STOPPED;
+  }
+  if ( stream_.external ) MUTEX_UNLOCK( &stream_.processMutex );
+  if ( stream_.pollDescriptor >= 0 ) close( stream_.pollDescriptor );
+
+  if ( handle ) {
+    unmapBuffer( OUTPUT );
+    unmapBuffer( INPUT );
+    pthread_cond_destroy( &handle->runnable );
+    if ( handle->id[0] ) close( handle->id[0] );
+    if ( handle->id[1] ) close( handle->id[1] );
+    delete handle;
+    stream_.apiHandle = 0;
+  }
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+  }
+
+  if ( stream_.deviceBuffer ) {
+    free( stream_.deviceBuffer );
+    stream_.deviceBuffer = 0;
+  }
+
+  clearStreamInfo();
+  //stream_.mode = UNINITIALIZED;
+  //stream_.state = STREAM_CLOSED;
+}
+
+RtAudioErrorType RtApiOss :: startStream()
+{
+  if ( stream_.state != STREAM_STOPPED ) {
+    if ( stream_.state == STREAM_RUNNING )
+      errorText_ = "RtApiOss::startStream(): the stream is already running!";
+    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiOss::startStream(): the stream is stopping or closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  MUTEX_LOCK( &stream_.mutex );
+
+  /*
+  #if defined( HAVE_GETTIMEOFDAY )
+  gettimeofday( &stream_.lastTickTimestamp, NULL );
+  #endif
+  */
+
+  stream_.state = STREAM_RUNNING;
+
+  // No need to do anything else here ... OSS automatically starts
+  // when fed samples.  Without a callback thread though, the devices
+  // that would only be started by the first period are started here,
+  // so that processOnce() finds them ready.
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( stream_.external ) {
+    if ( handle->mmap[0] || handle->mmap[1] )
+      startMmap();
+    else if ( stream_.mode == INPUT ) {
+      int trig = PCM_ENABLE_INPUT;
+      ioctl( handle->id[1], SNDCTL_DSP_SETTRIGGER, &trig );
+    }
+    watchDevices( true );
+  }
+
+  MUTEX_UNLOCK( &stream_.mutex );
+
+  pthread_cond_signal( &handle->runnable );
+  return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiOss :: stopStream()
+{
+  if ( stream_.state != STREAM_RUNNING && stream_.state != STREAM_STOPPING ) {
+    if ( stream_.state == STREAM_STOPPED )
+      errorText_ = "RtApiOss::stopStream(): the stream is already stopped!";
+    else if ( stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiOss::stopStream(): the stream is closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  return requestStop( 1 );
+}
+
+RtAudioErrorType RtApiOss :: abortStream()
+{
+  if ( stream_.state != STREAM_RUNNING ) {
+    if ( stream_.state == STREAM_STOPPED )
+      errorText_ = "RtApiOss::abortStream(): the stream is already stopped!";
+    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiOss::abortStream(): the stream is stopping or closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  return requestStop( 2 );
+}
+
+// The devices are only used by the callback thread while the stream
+// is running.  A stop (1) or abort (2) requested from any other thread
+// is posted by moving the stream to STREAM_STOPPING, and the caller
+// then waits for the callback thread to carry it out.
+RtAudioErrorType RtApiOss :: requestStop( int request )
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  int result = 0;
+  if ( stream_.external ) {
+    // Without a callback thread, the stop is carried out here, once
+    // a processOnce() call from another thread has returned.
+    if ( inProcessOnce() )
+      result = finishStop( request );
+    else {
+      MUTEX_LOCK( &stream_.processMutex );
+      if ( stream_.state == STREAM_RUNNING ) result = finishStop( request );
+      MUTEX_UNLOCK( &stream_.processMutex );
+    }
+  }
+  else if ( pthread_equal( pthread_self(), stream_.callbackInfo.thread ) )
+    result = finishStop( request );
+  else {
+    MUTEX_LOCK( &stream_.mutex );
+    if ( stream_.state == STREAM_RUNNING ) {
+      handle->stopRequest = request;
+      stream_.state.store( STREAM_STOPPING, std::memory_order_release );
+    }
+    while ( stream_.state == STREAM_STOPPING )
+      pthread_cond_wait( &handle->runnable, &stream_.mutex );
+    result = handle->stopResult;
+    MUTEX_UNLOCK( &stream_.mutex );
+  }
+
+  if ( result != -1 ) return RTAUDIO_NO_ERROR;
+  return error( RTAUDIO_SYSTEM_ERROR );
+}
+
+// Halts the devices from the callback thread, first flushing the
+// output with zeros for a stop (1), and marks the stream stopped.
+// Returns -1 on error, with errorText_ set.
+int RtApiOss :: finishStop( int request )
+{
+  int result = 0;
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  const char *method = ( request == 1 ) ? "RtApiOss::stopStream" : "RtApiOss::abortStream";
+  if ( stream_.external ) watchDevices( false );
+  if ( handle->mmap[0] && handle->mmapStarted && request == 1 ) {
+    // Let the queued periods of the mapped buffer play out.
+    double seconds = (double) handle->mmapPeriods[0] * stream_.bufferSize / stream_.sampleRate;
+    std::this_thread::sleep_for( std::chrono::microseconds( (long long) ( seconds * 1e6 ) ) );
+  }
+  else if ( ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) && request == 1 ) {
+
+    // Flush the output with zeros a few times.
+    char *buffer;
+    int samples;
+    RtAudioFormat format;
+
+    if ( stream_.doConvertBuffer[0] ) {
+      buffer = stream_.deviceBuffer;
+      samples = stream_.bufferSize * stream_.nDeviceChannels[0];
+      format = stream_.deviceFormat[0];
+    }
+    else {
+      buffer = stream_.userBuffer[0];
+      samples = stream_.bufferSize * stream_.nUserChannels[0];
+      format = stream_.userFormat;
+    }
+
+    memset( buffer, 0, samples * formatBytes(format) );
+    for ( unsigned int i=0; i<stream_.nBuffers+1; i++ ) {
+      result = write( handle->id[0], buffer, samples * formatBytes(format) );
+      if ( result == -1 ) {
+        errorText_ = "RtApiOss::stopStream: audio write error.";
+        error( RTAUDIO_WARNING );
+      }
+    }
+  }
+
+  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+    result = ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
+    if ( result == -1 ) {
+      errorStream_ << method << ": system error stopping callback procedure on device (" << stream_.deviceId[0] << ").";
+      errorText_ = errorStream_.str();
+      goto unlock;
+    }
+    handle->triggered = false;
+  }
+
+  if ( stream_.mode == INPUT || ( stream_.mode == DUPLEX && handle->id[0] != handle->id[1] ) ) {
+    result = ioctl( handle->id[1], SNDCTL_DSP_HALT, 0 );
+    if ( result == -1 ) {
+      errorStream_ << method << ": system error stopping input callback procedure on device (" << stream_.deviceId[0] << ").";
+      errorText_ = errorStream_.str();
+      goto unlock;
+    }
+    handle->inputTriggered = false;
+  }
+  handle->mmapStarted = false;
+
+ unlock:
+  lockStreamMutex();
+  handle->stopResult = result;
+  stream_.state.store( STREAM_STOPPED, std::memory_order_release );
+  pthread_cond_broadcast( &handle->runnable );
+  MUTEX_UNLOCK( &stream_.mutex );
+  return result;
+}
+
+void RtApiOss :: callbackEvent()
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  StreamState state = stream_.state.load( std::memory_order_acquire );
+  if ( state == STREAM_STOPPING ) {
+    finishStop( handle->stopRequest );
+    return;
+  }
+
+  if ( state == STREAM_STOPPED ) {
+    lockStreamMutex();
+    while ( stream_.state == STREAM_STOPPED && stream_.callbackInfo.isRunning )
+      pthread_cond_wait( &handle->runnable, &stream_.mutex );
+    if ( stream_.state != STREAM_RUNNING ) {
+      MUTEX_UNLOCK( &stream_.mutex );
+      return;
+    }
+    MUTEX_UNLOCK( &stream_.mutex );
+  }
+
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApiOss::callbackEvent(): the stream is closed ... this shouldn't happen!";
+    error( RTAUDIO_WARNING );
+    return;
+  }
+
+  // With mapped buffers, wait until a period can be transferred on
+  // each of them, and capture the input before running the callback.
+  // Output is written straight into the mapped period.
+  char *userOutput = stream_.userBuffer[0];
+  char *mmapOutput = 0;
+  if ( handle->mmap[0] || handle->mmap[1] ) {
+    if ( !handle->mmapStarted ) startMmap();
+    if ( !waitMmap( -1 ) ) return;
+    if ( handle->mmap[1] ) readMmap();
+    if ( handle->mmap[0] ) {
+      mmapOutput = handle->mmapBuffer[0] + handle->mmapOffset[0];
+      if ( !stream_.doConvertBuffer[0] ) userOutput = mmapOutput;
+    }
+  }
+
+  // Invoke user callback to get fresh output data.
+  int doStopStream = 0;
+  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+  double streamTime = getStreamTime();
+  RtAudioStreamStatus status = 0;
+  if ( stream_.mode != INPUT && handle->xrun[0] == true ) {
+    status |= RTAUDIO_OUTPUT_UNDERFLOW;
+    handle->xrun[0] = false;
+  }
+  if ( stream_.mode != OUTPUT && handle->xrun[1] == true ) {
+    status |= RTAUDIO_INPUT_OVERFLOW;
+    handle->xrun[1] = false;
+  }
+  beginCallback();
+  doStopStream = callback( userOutput, stream_.userBuffer[1],
+                           stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
+  endCallback( status );
+  if ( doStopStream == 2 ) {
+    this->abortStream();
+    return;
+  }
+
+  // A stop or abort might have been requested during the callback.
+  if ( stream_.state.load( std::memory_order_acquire ) == STREAM_STOPPING ) {
+    finishStop( handle->stopRequest );
+    return;
+  }
+
+  int result;
+  char *buffer;
+  int samples;
+  RtAudioFormat format;
+
+  if ( mmapOutput ) {
+    if ( stream_.doConvertBuffer[0] )
+      convertBuffer( mmapOutput, stream_.userBuffer[0], stream_.convertInfo[0] );
+    if ( stream_.doByteSwap[0] )
+      byteSwapBuffer( mmapOutput, stream_.bufferSize * stream_.nDeviceChannels[0], stream_.deviceFormat[0] );
+    handle->mmapOffset[0] = ( handle->mmapOffset[0] + handle->periodBytes[0] ) % handle->mmapBytes[0];
+    handle->mmapPeriods[0]++;
+  }
+  else if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+
+    // Setup parameters and do buffer conversion if necessary.
+    if ( stream_.doConvertBuffer[0] ) {
+      buffer = stream_.deviceBuffer;
+      convertBuffer( buffer, stream_.userBuffer[0], stream_.convertInfo[0] );
+      samples = stream_.bufferSize * stream_.nDeviceChannels[0];
+      format = stream_.deviceFormat[0];
+    }
+    else {
+      buffer = stream_.userBuffer[0];
+      samples = stream_.bufferSize * stream_.nUserChannels[0];
+      format = stream_.userFormat;
+    }
+
+    // Do byte swapping if necessary.
+    if ( stream_.doByteSwap[0] )
+      byteSwapBuffer( buffer, samples, format );
+
+    if ( stream_.mode == DUPLEX && handle->triggered == false ) {
+      int trig = 0;
+      ioctl( handle->id[0], SNDCTL_DSP_SETTRIGGER, &trig );
+      result = write( handle->id[0], buffer, samples * formatBytes(format) );
+      trig = PCM_ENABLE_INPUT|PCM_ENABLE_OUTPUT;
+      ioctl( handle->id[0], SNDCTL_DSP_SETTRIGGER, &trig );
+      handle->triggered = true;
+    }
+    else
+      // Write samples to device.
+      result = write( handle->id[0], buffer, samples * formatBytes(format) );
+
+    if ( result == -1 ) {
+      // We'll assume this is an underrun, though there isn't a
+      // specific means for determining that.
+      handle->xrun[0] = true;
+      errorText_ = "RtApiOss::callbackEvent: audio write error.";
+      error( RTAUDIO_WARNING );
+      // Continue on to input section.
+    }
+
+    // Check stream latency
+    int delay;
+    if ( ioctl( handle->id[0], SNDCTL_DSP_GETODELAY, &delay ) != -1 && delay >= 0 )
+      stream_.latency[0] = delay / ( stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] ) );
+  }
+
+  if ( stream_.driftCompensation ) {
+    readDriftInput();
+    goto tick;
+  }
+
+  if ( ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && !handle->mmap[1] ) {
+
+    // Setup parameters.
+    if ( stream_.doConvertBuffer[1] ) {
+      buffer = stream_.deviceBuffer;
+      samples = stream_.bufferSize * stream_.nDeviceChannels[1];
+      format = stream_.deviceFormat[1];
+    }
+    else {
+      buffer = stream_.userBuffer[1];
+      samples = stream_.bufferSize * stream_.nUserChannels[1];
+      format = stream_.userFormat;
+    }
+
+    // Read samples from device.
+    result = read( handle->id[1], buffer, samples * formatBytes(format) );
+
+    if ( result == -1 ) {
+      // We'll assume this is an overrun, though there isn't a
+      // specific means for determining that.
+      handle->xrun[1] = true;
+      errorText_ = "RtApiOss::callbackEvent: audio read error.";
+      error( RTAUDIO_WARNING );
+      goto tick;
+    }
+
+    // Do byte swapping if necessary.
+    if ( stream_.doByteSwap[1] )
+      byteSwapBuffer( buffer, samples, format );
+
+    // Do buffer conversion if necessary.
+    if ( stream_.doConvertBuffer[1] )
+      convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
+
+    // Check stream latency
+    audio_buf_info info;
+    if ( ioctl( handle->id[1], SNDCTL_DSP_GETISPACE, &info ) != -1 && info.bytes >= 0 )
+      stream_.latency[1] = info.bytes / ( stream_.nDeviceChannels[1] * formatBytes( stream_.deviceFormat[1] ) );
+  }
+
+ tick:
+  RtApi::tickStreamTime();
+  if ( doStopStream == 1 ) this->stopStream();
+}
+
+// Reads the whole periods captured so far into the drift compensation
+// stage, then resamples a period of input for the next callback.  The
+// input device is never waited on, so the callback is paced by the
+// output device.
+void RtApiOss :: readDriftInput()
+{
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  int fd = handle->id[1];
+  int frameBytes = stream_.nDeviceChannels[1] * formatBytes( stream_.deviceFormat[1] );
+  int periodBytes = stream_.bufferSize * frameBytes;
+  if ( !handle->inputTriggered ) {
+    resetDriftCompensation();
+    int trig = PCM_ENABLE_INPUT;
+    ioctl( fd, SNDCTL_DSP_SETTRIGGER, &trig );
+    handle->inputTriggered = true;
+  }
+
+  audio_buf_info info;
+  info.bytes = 0;
+  while ( ioctl( fd, SNDCTL_DSP_GETISPACE, &info ) != -1 && info.bytes >= periodBytes ) {
+    if ( read( fd, stream_.deviceBuffer, periodBytes ) != periodBytes ) {
+      handle->xrun[1] = true;
+      break;
+    }
+    if ( stream_.doByteSwap[1] )
+      byteSwapBuffer( stream_.deviceBuffer, stream_.bufferSize * stream_.nDeviceChannels[1], stream_.deviceFormat[1] );
+    if ( !bufferDriftInput( stream_.deviceBuffer ) ) handle->xrun[1] = true;
+    info.bytes = 0;
+  }
+
+  if ( !resampleDriftInput( (double) std::max( info.bytes, 0 ) / frameBytes ) ) handle->xrun[1] = true;
+}
+
+static void *ossCallbackHandler( void *ptr )
+{
+  CallbackInfo *info = (CallbackInfo *) ptr;
+  RtApiOss *object = (RtApiOss *) info->object;
+  bool *isRunning = &info->isRunning;
+
+  bool realtime = object->configureCallbackThread();
+  if ( info->doRealtime ) {
+    std::cerr << "RtAudio oss: " << 
+             ( realtime ? "" : "_NOT_ " ) << 
+             "running realtime scheduling" << std::endl;
+  }
+
+  while ( *isRunning == true ) {
+    pthread_testcancel();
+    object->callbackEvent();
+  }
+
+  pthread_exit( NULL );
+}
+
+//******************** End of __LINUX_OSS__ *********************//
+#endif
+
+
+#if defined(__RTAUDIO_NULL__)
+
+// The null API has no hardware behind it.  Its devices differ only in
+// their native sample format and byte order, so that a stream opened
+// on one of them goes through the same conversion paths as a stream
+// on a real device.  Periods are either paced by the system clock or
+// run back-to-back (RTAUDIO_NULL_FREE_RUN), and the device data can be
+// written to, or read from, raw or WAV files.
+
+struct NullDevice {
+  const char *name;
+  RtAudioFormat format;
+  bool byteSwap;
+};
+
+static const NullDevice nullDevices[] = {
+  { "Null Device (FLOAT32)", RTAUDIO_FLOAT32, false },
+  { "Null Device (FLOAT64)", RTAUDIO_FLOAT64, false },
+  { "Null Device (SINT8)", RTAUDIO_SINT8, false },
+  { "Null Device (SINT16)", RTAUDIO_SINT16, false },
+  { "Null Device (SINT24)", RTAUDIO_SINT24, false },
+  { "Null Device (SINT32)", RTAUDIO_SINT32, false },
+  { "Null Device (FLOAT32, byte-swapped)", RTAUDIO_FLOAT32, true },
+  { "Null Device (FLOAT64, byte-swapped)", RTAUDIO_FLOAT64, true },
+  { "Null Device (SINT16, byte-swapped)", RTAUDIO_SINT16, true },
+  { "Null Device (SINT24, byte-swapped)", RTAUDIO_SINT24, true },
+  { "Null Device (SINT32, byte-swapped)", RTAUDIO_SINT32, true },
+};
+
+static const unsigned int NULL_DEVICE_COUNT = sizeof( nullDevices ) / sizeof( nullDevices[0] );
+static const unsigned int NULL_MAX_CHANNELS = 128;
+
+static void nullCallbackHandler( CallbackInfo *info );
+
+// A structure to hold various information related to the null API
+// implementation.
+struct NullHandle {
+  FILE *file[2];              // output and input files, if any
+  bool waveFile[2];
+  bool fileSwap[2];           // file and device byte orders differ
+  bool fileUnsigned[2];       // 8-bit WAV samples are unsigned
+  unsigned int fileSampleBytes[2]; // 24-bit WAV samples are packed in 3 bytes
+  unsigned long fileBytes[2]; // data bytes written (output) or left to read (input)
+  bool freeRun;
+  bool xrun;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point deadline;
+  unsigned long long frames;  // frames processed since start
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable runnable;
+  int stopRequest; // 1 = stop, 2 = abort, posted with STREAM_STOPPING.
+  int stopResult;
+
+  NullHandle()
+    :freeRun(false), xrun(false), frames(0), stopRequest(0), stopResult(0)
+  {
+    for ( int i=0; i<2; i++ ) {
+      file[i] = 0;
+      waveFile[i] = false;
+      fileSwap[i] = false;
+      fileUnsigned[i] = false;
+      fileSampleBytes[i] = 0;
+      fileBytes[i] = 0;
+    }
+  }
+};
+
+static void putLittleEndian( unsigned char *buffer, unsigned long value, int bytes )
+{
+  for ( int i=0; i<bytes; i++ )
+    buffer[i] = (unsigned char) ( ( value >> ( 8 * i ) ) & 0xff );
+}
+
+static unsigned long getLittleEndian( const unsigned char *buffer, int bytes )
+{
+  unsigned long value = 0;
+  for ( int i=0; i<bytes; i++ )
+    value |= (unsigned long) buffer[i] << ( 8 * i );
+  return value;
+}
+
+// Writes a canonical 44-byte WAV header at the start of the file and
+// returns to the end of the data.
+static bool writeWaveHeader( FILE *fd, RtAudioFormat format, unsigned int sampleBytes,
+                             unsigned int channels, unsigned int sampleRate,
+                             unsigned long dataBytes )
+{
+  unsigned char header[44];
+  unsigned int tag = ( format == RTAUDIO_FLOAT32 || format == RTAUDIO_FLOAT64 ) ? 3 : 1;
+  memcpy( header, "RIFF", 4 );
+  putLittleEndian( header + 4, 36 + dataBytes, 4 );
+  memcpy( header + 8, "WAVEfmt ", 8 );
+  putLittleEndian( header + 16, 16, 4 );
+  putLittleEndian( header + 20, tag, 2 );
+  putLittleEndian( header + 22, channels, 2 );
+  putLittleEndian( header + 24, sampleRate, 4 );
+  putLittleEndian( header + 28, sampleRate * channels * sampleBytes, 4 );
+  putLittleEndian( header + 32, channels * sampleBytes, 2 );
+  putLittleEndian( header + 34, 8 * sampleBytes, 2 );
+  memcpy( header + 36, "data", 4 );
+  putLittleEndian( header + 40, dataBytes, 4 );
+
+  if ( fseek( fd, 0, SEEK_SET ) ) return false;
+  if ( fwrite( header, 1, 44, fd ) != 44 ) return false;
+  return fseek( fd, 0, SEEK_END ) == 0;
+}
+
+// Reads a WAV header, leaving the file positioned at the start of the
+// sample data.  The format is zero if the encoding is not supported.
+static bool readWaveHeader( FILE *fd, RtAudioFormat &format, unsigned int &channels,
+                            unsigned int &sampleRate, unsigned long &dataBytes )
+{
+  unsigned char buffer[40];
+  if ( fread( buffer, 1, 12, fd ) != 12 ) return false;
+  if ( memcmp( buffer, "RIFF", 4 ) || memcmp( buffer + 8, "WAVE", 4 ) ) return false;
+
+  format = 0;
+  channels = 0;
+  while ( fread( buffer, 1, 8, fd ) == 8 ) {
+    unsigned long size = getLittleEndian( buffer + 4, 4 );
+    if ( memcmp( buffer, "data", 4 ) == 0 ) {
+      dataBytes = size;
+      return channels > 0;
+    }
+
+    if ( memcmp( buffer, "fmt ", 4 ) == 0 && size >= 16 ) {
+      unsigned long bytes = ( size < 40 ) ? size : 40;
+      if ( fread( buffer, 1, bytes, fd ) != bytes ) return false;
+      size -= bytes;
+      unsigned int tag = getLittleEndian( buffer, 2 );
+      channels = getLittleEndian( buffer + 2, 2 );
+      sampleRate = getLittleEndian( buffer + 4, 4 );
+      unsigned int bits = getLittleEndian( buffer + 14, 2 );
+      if ( tag == 0xFFFE && bytes >= 26 ) // WAVE_FORMAT_EXTENSIBLE
+        tag = getLittleEndian( buffer + 24, 2 );
+      if ( tag == 1 ) {
+        if ( bits == 8 ) format = RTAUDIO_SINT8;
+        else if ( bits == 16 ) format = RTAUDIO_SINT16;
+        else if ( bits == 24 ) format = RTAUDIO_SINT24;
+        else if ( bits == 32 ) format = RTAUDIO_SINT32;
+      }
+      else if ( tag == 3 ) {
+        if ( bits == 32 ) format = RTAUDIO_FLOAT32;
+        else if ( bits == 64 ) format = RTAUDIO_FLOAT64;
+      }
+    }
+
+    // Chunks are padded to an even size.
+    if ( fseek( fd, size + ( size & 1 ), SEEK_CUR ) ) return false;
+  }
+
+  return false;
+}
+
+RtApiNull :: RtApiNull()
+{
+  // Nothing to do here.
+}
+
+RtApiNull :: ~RtApiNull()
+{
+  if ( stream_.state != STREAM_CLOSED ) closeStream();
+}
+
+void RtApiNull :: probeDevices( void )
+{
+  // See list of required functionality in RtApi::probeDevices().
+
+  // The devices never change, so they are only listed once.
+  if ( deviceList_.size() > 0 ) return;
+
+  for ( unsigned int n=0; n<NULL_DEVICE_COUNT; n++ ) {
+    RtAudio::DeviceInfo info;
+    info.ID = currentDeviceId_++;  // arbitrary internal device ID
+    info.name = nullDevices[n].name;
+    info.outputChannels = NULL_MAX_CHANNELS;
+    info.inputChannels = NULL_MAX_CHANNELS;
+    info.duplexChannels = NULL_MAX_CHANNELS;
+    info.isDefaultOutput = ( n == 0 );
+    info.isDefaultInput = ( n == 0 );
+    for ( unsigned int k=0; k<MAX_SAMPLE_RATES; k++ )
+      info.sampleRates.push_back( SAMPLE_RATES[k] );
+    info.preferredSampleRate = 48000;
+    info.nativeFormats = nullDevices[n].format;
+    deviceList_.push_back( info );
+  }
+}
+
+// Opens the output or input file for a stream direction.  Names
+// ending in ".wav" are WAV files, anything else holds raw samples in
+// the device format and byte order.
+bool RtApiNull :: openFile( StreamMode mode, const std::string &path )
+{
+  NullHandle *handle = (NullHandle *) stream_.apiHandle;
+  std::string extension = ( path.size() > 4 ) ? path.substr( path.size() - 4 ) : "";
+  std::transform( extension.begin(), extension.end(), extension.begin(), ::tolower );
+  bool wave = ( extension == ".wav" );
+
+  FILE *fd = fopen( path.c_str(), ( mode == OUTPUT ) ? "wb" : "rb" );
+  if ( fd == NULL ) {
+    errorStream_ << "RtApiNull::probeDeviceOpen: error opening file (" << path << ").";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+  handle->file[mode] = fd;
+  handle->waveFile[mode] = wave;
+
+  RtAudioFormat format = stream_.deviceFormat[mode];
+  unsigned int channels = stream_.nDeviceChannels[mode];
+  handle->fileSampleBytes[mode] = formatBytes( format );
+  if ( wave ) {
+    // WAV data is little-endian, signed only above 8 bits, and packs
+    // 24-bit samples in 3 bytes rather than in a 32-bit container.
+    unsigned short word = 1;
+    bool littleEndianHost = *( (unsigned char *) &word ) == 1;
+    handle->fileSwap[mode] = ( littleEndianHost == stream_.doByteSwap[mode] );
+    handle->fileUnsigned[mode] = ( format == RTAUDIO_SINT8 );
+    if ( format == RTAUDIO_SINT24 ) handle->fileSampleBytes[mode] = 3;
+  }
+
+  if ( mode == OUTPUT ) {
+    if ( wave && !writeWaveHeader( fd, format, handle->fileSampleBytes[mode], channels, stream_.sampleRate, 0 ) ) {
+      errorStream_ << "RtApiNull::probeDeviceOpen: error writing file (" << path << ").";
+      errorText_ = errorStream_.str();
+      return FAILURE;
+    }
+    return SUCCESS;
+  }
+
+  handle->fileBytes[mode] = ULONG_MAX;
+  if ( wave ) {
+    RtAudioFormat fileFormat;
+    unsigned int fileChannels, fileRate;
+    if ( !readWaveHeader( fd, fileFormat, fileChannels, fileRate, handle->fileBytes[mode] ) ) {
+      errorStream_ << "RtApiNull::probeDeviceOpen: error reading WAV header of file (" << path << ").";
+      errorText_ = errorStream_.str();
+      return FAILURE;
+    }
+    if ( fileFormat != format || fileChannels != channels ) {
+      errorStream_ << "RtApiNull::probeDeviceOpen: the sample format or channel count of file (" << path << ") does not match the device and stream parameters.";
+      errorText_ = errorStream_.str();
+      return FAILURE;
+    }
+    if ( fileRate != stream_.sampleRate ) {
+      errorStream_ << "RtApiNull::probeDeviceOpen: the sample rate of file (" << path << ") differs from the stream sample rate.";
+      errorText_ = errorStream_.str();
+      error( RTAUDIO_WARNING );
+    }
+  }
+
+  return SUCCESS;
+}
+
+void RtApiNull :: closeFiles( void )
+{
+  NullHandle *handle = (NullHandle *) stream_.apiHandle;
+  for ( int i=0; i<2; i++ ) {
+    if ( handle->file[i] == 0 ) continue;
+    if ( i == OUTPUT && handle->waveFile[i] )
+      writeWaveHeader( handle->file[i], stream_.deviceFormat[i], handle->fileSampleBytes[i],
+                       stream_.nDeviceChannels[i], stream_.sampleRate, handle->fileBytes[i] );
+    fclose( handle->file[i] );
+    handle->file[i] = 0;
+  }
+}
+
+bool RtApiNull :: probeDeviceOpen( unsigned int deviceId, StreamMode mode, unsigned int channels,
+                                   unsigned int firstChannel, unsigned int sampleRate,
+                                   RtAudioFormat format, unsigned int *bufferSize,
+                                   RtAudio::StreamOptions *options )
+{
+  NullHandle *handle = 0;
+  unsigned long bufferBytes;
+  unsigned int m, device, deviceChannels;
+  for ( m=0; m<deviceList_.size(); m++ ) {
+    if ( deviceList_[m].ID == deviceId ) break;
+  }
+  for ( device=0; m<deviceList_.size() && device<NULL_DEVICE_COUNT; device++ ) {
+    if ( deviceList_[m].name == nullDevices[device].name ) break;
+  }
+  if ( m == deviceList_.size() || device == NULL_DEVICE_COUNT ) {
+    errorText_ = "RtApiNull::probeDeviceOpen: device ID is invalid!";
+    return FAILURE;
+  }
+
+  deviceChannels = channels + firstChannel;
+  if ( deviceChannels > NULL_MAX_CHANNELS ) {
+    errorStream_ << "RtApiNull::probeDeviceOpen: device (" << nullDevices[device].name << ") does not support " << deviceChannels << " channels.";
     errorText_ = errorStream_.str();
     return FAILURE;
   }
 
-  int flags = 0;
-  OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  if ( mode == OUTPUT )
-    flags |= O_WRONLY;
-  else { // mode == INPUT
-    if (stream_.mode == OUTPUT && stream_.deviceId[0] == device) {
-      // We just set the same device for playback ... close and reopen for duplex (OSS only).
-      close( handle->id[0] );
-      handle->id[0] = 0;
-      if ( !( ainfo.caps & PCM_CAP_DUPLEX ) ) {
-        errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") does not support duplex mode.";
-        errorText_ = errorStream_.str();
-        return FAILURE;
+  if ( sampleRate == 0 ) {
+    errorText_ = "RtApiNull::probeDeviceOpen: the sample rate cannot be zero.";
+    return FAILURE;
+  }
+
+  // Any buffer size will do, and a duplex stream keeps the one chosen
+  // for its output.
+  if ( *bufferSize == 0 ) *bufferSize = 256;
+  stream_.bufferSize = *bufferSize;
+  stream_.nBuffers = 2;
+  if ( options && options->numberOfBuffers > 0 ) stream_.nBuffers = options->numberOfBuffers;
+  stream_.sampleRate = sampleRate;
+  stream_.latency[mode] = *bufferSize;
+
+  stream_.nUserChannels[mode] = channels;
+  stream_.nDeviceChannels[mode] = deviceChannels;
+  stream_.userFormat = format;
+  stream_.deviceFormat[mode] = nullDevices[device].format;
+  stream_.doByteSwap[mode] = nullDevices[device].byteSwap;
+
+  // Set interleaving parameters.
+  stream_.userInterleaved = true;
+  stream_.deviceInterleaved[mode] = true;
+  if ( options && options->flags & RTAUDIO_NONINTERLEAVED )
+    stream_.userInterleaved = false;
+
+  // Set flags for buffer conversion
+  stream_.doConvertBuffer[mode] = false;
+  if ( stream_.userFormat != stream_.deviceFormat[mode] )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.nUserChannels[mode] < stream_.nDeviceChannels[mode] )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
+       stream_.nUserChannels[mode] > 1 )
+    stream_.doConvertBuffer[mode] = true;
+
+  // Allocate the stream handle if necessary and then save.
+  if ( stream_.apiHandle == 0 ) {
+    try {
+      handle = new NullHandle;
+    }
+    catch ( std::bad_alloc& ) {
+      errorText_ = "RtApiNull::probeDeviceOpen: error allocating NullHandle memory.";
+      goto error;
+    }
+    handle->freeRun = ( options && options->flags & RTAUDIO_NULL_FREE_RUN );
+    stream_.apiHandle = (void *) handle;
+  }
+  else {
+    handle = (NullHandle *) stream_.apiHandle;
+  }
+
+  if ( options ) {
+    const std::string &path = ( mode == OUTPUT ) ? options->outputFile : options->inputFile;
+    if ( !path.empty() && openFile( mode, path ) == FAILURE ) goto error;
+  }
+
+  // Allocate necessary internal buffers.
+  bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
+  stream_.userBuffer[mode] = (char *) calloc( bufferBytes, 1 );
+  if ( stream_.userBuffer[mode] == NULL ) {
+    errorText_ = "RtApiNull::probeDeviceOpen: error allocating user buffer memory.";
+    goto error;
+  }
+
+  if ( stream_.doConvertBuffer[mode] ) {
+
+    bool makeBuffer = true;
+    bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
+    if ( mode == INPUT ) {
+      if ( stream_.mode == OUTPUT && stream_.deviceBuffer ) {
+        unsigned long bytesOut = stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] );
+        if ( bufferBytes <= bytesOut ) makeBuffer = false;
       }
-      // Check that the number previously set channels is the same.
-      if ( stream_.nUserChannels[0] != channels ) {
-        errorStream_ << "RtApiOss::probeDeviceOpen: input/output channels must be equal for OSS duplex device (" << ainfo.name << ").";
-        errorText_ = errorStream_.str();
-        return FAILURE;
+    }
+
+    if ( makeBuffer ) {
+      bufferBytes *= *bufferSize;
+      if ( stream_.deviceBuffer ) free( stream_.deviceBuffer );
+      stream_.deviceBuffer = (char *) calloc( bufferBytes, 1 );
+      if ( stream_.deviceBuffer == NULL ) {
+        errorText_ = "RtApiNull::probeDeviceOpen: error allocating device buffer memory.";
+        goto error;
       }
-      flags |= O_RDWR;
     }
-    else
-      flags |= O_RDONLY;
   }
 
-  // Set exclusive access if specified.
-  if ( options && options->flags & RTAUDIO_HOG_DEVICE ) flags |= O_EXCL;
+  stream_.deviceId[mode] = deviceId;
+  stream_.state = STREAM_STOPPED;
+
+  // Setup the buffer conversion information structure.
+  if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
+
+  // Setup thread if necessary.
+  if ( stream_.mode == OUTPUT && mode == INPUT ) {
+    // We had already set up an output stream.
+    stream_.mode = DUPLEX;
+  }
+  else {
+    stream_.mode = mode;
+
+    // Setup callback thread.  There is no device to keep fed, so
+    // RTAUDIO_SCHEDULE_REALTIME is ignored.
+    stream_.callbackInfo.object = (void *) this;
+    stream_.callbackInfo.isRunning = true;
+    try {
+      handle->thread = std::thread( nullCallbackHandler, &stream_.callbackInfo );
+    }
+    catch ( std::system_error& ) {
+      stream_.callbackInfo.isRunning = false;
+      errorText_ = "RtApiNull::error creating callback thread!";
+      goto error;
+    }
+  }
+
+  return SUCCESS;
+
+ error:
+  if ( handle ) {
+    if ( handle->thread.joinable() ) {
+      {
+        std::lock_guard<std::mutex> lock( handle->mutex );
+        stream_.callbackInfo.isRunning = false;
+      }
+      handle->runnable.notify_all();
+      handle->thread.join();
+    }
+    closeFiles();
+    delete handle;
+    stream_.apiHandle = 0;
+  }
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+  }
+
+  if ( stream_.deviceBuffer ) {
+    free( stream_.deviceBuffer );
+    stream_.deviceBuffer = 0;
+  }
+
+  stream_.state = STREAM_CLOSED;
+  return FAILURE;
+}
+
+void RtApiNull :: closeStream()
+{
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApiNull::closeStream(): no open stream to close!";
+    error( RTAUDIO_WARNING );
+    return;
+  }
+
+  NullHandle *handle = (NullHandle *) stream_.apiHandle;
+  {
+    std::lock_guard<std::mutex> lock( handle->mutex );
+    stream_.callbackInfo.isRunning = false;
+  }
+  handle->runnable.notify_all();
+  handle->thread.join();
+  stream_.state = STREAM_STOPPED;
+
+  closeFiles();
+  delete handle;
+  stream_.apiHandle = 0;
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+  }
+
+  if ( stream_.deviceBuffer ) {
+    free( stream_.deviceBuffer );
+    stream_.deviceBuffer = 0;
+  }
+
+  clearStreamInfo();
+}
+
+RtAudioErrorType RtApiNull :: startStream()
+{
+  if ( stream_.state != STREAM_STOPPED ) {
+    if ( stream_.state == STREAM_RUNNING )
+      errorText_ = "RtApiNull::startStream(): the stream is already running!";
+    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiNull::startStream(): the stream is stopping or closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  NullHandle *handle = (NullHandle *) stream_.apiHandle;
+  {
+    std::lock_guard<std::mutex> lock( handle->mutex );
+    handle->start = std::chrono::steady_clock::now();
+    handle->deadline = handle->start;
+    handle->frames = 0;
+    stream_.state = STREAM_RUNNING;
+  }
+  handle->runnable.notify_all();
+  return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiNull :: stopStream()
+{
+  if ( stream_.state != STREAM_RUNNING && stream_.state != STREAM_STOPPING ) {
+    if ( stream_.state == STREAM_STOPPED )
+      errorText_ = "RtApiNull::stopStream(): the stream is already stopped!";
+    else if ( stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiNull::stopStream(): the stream is closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  return requestStop( 1 );
+}
+
+RtAudioErrorType RtApiNull :: abortStream()
+{
+  if ( stream_.state != STREAM_RUNNING ) {
+    if ( stream_.state == STREAM_STOPPED )
+      errorText_ = "RtApiNull::abortStream(): the stream is already stopped!";
+    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
+      errorText_ = "RtApiNull::abortStream(): the stream is stopping or closed!";
+    return error( RTAUDIO_WARNING );
+  }
+
+  return requestStop( 2 );
+}
+
+// As with the other APIs, a stop (1) or abort (2) requested from
+// outside the callback thread is posted by moving the stream to
+// STREAM_STOPPING, and the caller waits for the callback thread to
+// carry it out.
+RtAudioErrorType RtApiNull :: requestStop( int request )
+{
+  NullHandle *handle = (NullHandle *) stream_.apiHandle;
+  int result = 0;
+  if ( std::this_thread::get_id() == handle->thread.get_id() )
+    result = finishStop( request );
+  else {
+    std::unique_lock<std::mutex> lock( handle->mutex );
+    if ( stream_.state == STREAM_RUNNING ) {
+      handle->stopRequest = request;
+      stream_.state.store( STREAM_STOPPING, std::memory_order_release );
+    }
+    while ( stream_.state == STREAM_STOPPING )
+      handle->runnable.wait( lock );
+    result = handle->stopResult;
+  }
+
+  if ( result != -1 ) return RTAUDIO_NO_ERROR;
+  return error( RTAUDIO_SYSTEM_ERROR );
+}
+
+// Nothing is queued behind the callback, so a stop and an abort both
+// just bring the output file up to date and mark the stream stopped.
+// Returns -1 on error, with errorText_ set.
+int RtApiNull :: finishStop( int /*request*/ )
+{
+  int result = 0;
+  NullHandle *handle = (NullHandle *) stream_.apiHandle;
+  FILE *fd = handle->file[OUTPUT];
+  if ( fd ) {
+    if ( handle->waveFile[OUTPUT] )
+      writeWaveHeader( fd, stream_.deviceFormat[0], handle->fileSampleBytes[0],
+                       stream_.nDeviceChannels[0], stream_.sampleRate, handle->fileBytes[0] );
+    if ( fflush( fd ) ) {
+      errorText_ = "RtApiNull::stopStream: error flushing output file.";
+      result = -1;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock( handle->mutex );
+    handle->stopResult = result;
+    stream_.state.store( STREAM_STOPPED, std::memory_order_release );
+  }
+  handle->runnable.notify_all();
+  return result;
+}
+
+void RtApiNull :: callbackEvent()
+{
+  NullHandle *handle = (NullHandle *) stream_.apiHandle;
+  StreamState state = stream_.state.load( std::memory_order_acquire );
+  if ( state == STREAM_STOPPING ) {
+    finishStop( handle->stopRequest );
+    return;
+  }
+
+  if ( state == STREAM_STOPPED ) {
+    std::unique_lock<std::mutex> lock( handle->mutex );
+    while ( stream_.state == STREAM_STOPPED && stream_.callbackInfo.isRunning )
+      handle->runnable.wait( lock );
+    if ( stream_.state != STREAM_RUNNING ) return;
+  }
+
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApiNull::callbackEvent(): the stream is closed ... this shouldn't happen!";
+    error( RTAUDIO_WARNING );
+    return;
+  }
+
+  // Wait for the period to become due, as a device would.
+  if ( !handle->freeRun )
+    std::this_thread::sleep_until( handle->deadline );
 
-  // Try to open the device.
-  int fd;
-  fd = open( ainfo.devnode, flags, 0 );
-  if ( fd == -1 ) {
-    if ( errno == EBUSY )
-      errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") is busy.";
-    else
-      errorStream_ << "RtApiOss::probeDeviceOpen: error opening device (" << ainfo.name << ").";
-    errorText_ = errorStream_.str();
-    return FAILURE;
-  }
+  char *buffer;
+  unsigned int samples;
+  unsigned long bytes;
+  RtAudioFormat format;
 
-  // For duplex operation, specifically set this mode (this doesn't seem to work).
-  /*
-    if ( flags | O_RDWR ) {
-    result = ioctl( fd, SNDCTL_DSP_SETDUPLEX, NULL );
-    if ( result == -1) {
-    errorStream_ << "RtApiOss::probeDeviceOpen: error setting duplex mode for device (" << ainfo.name << ").";
-    errorText_ = errorStream_.str();
-    return FAILURE;
+  if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+
+    // Setup parameters.
+    if ( stream_.doConvertBuffer[1] ) {
+      buffer = stream_.deviceBuffer;
+      samples = stream_.bufferSize * stream_.nDeviceChannels[1];
+      format = stream_.deviceFormat[1];
+    }
+    else {
+      buffer = stream_.userBuffer[1];
+      samples = stream_.bufferSize * stream_.nUserChannels[1];
+      format = stream_.userFormat;
     }
+    bytes = samples * formatBytes( format );
+
+    // Read samples from the file, with silence past its end.
+    unsigned int count = 0;
+    FILE *fd = handle->file[INPUT];
+    if ( fd ) {
+      unsigned int sampleBytes = handle->fileSampleBytes[1];
+      unsigned long request = samples * sampleBytes;
+      if ( request > handle->fileBytes[1] ) request = handle->fileBytes[1];
+      count = fread( buffer, 1, request, fd ) / sampleBytes;
+      handle->fileBytes[1] -= count * sampleBytes;
+      if ( sampleBytes < formatBytes( format ) ) {
+        for ( unsigned int i=count; i>0; i-- ) {
+          memmove( buffer + 4 * ( i - 1 ), buffer + 3 * ( i - 1 ), 3 );
+          buffer[4 * ( i - 1 ) + 3] = 0;
+        }
+      }
+      if ( handle->fileUnsigned[1] )
+        for ( unsigned int i=0; i<count; i++ ) buffer[i] ^= (char) 0x80;
+      if ( handle->fileSwap[1] )
+        byteSwapBuffer( buffer, count, format );
+      count *= formatBytes( format );
     }
-  */
+    memset( buffer + count, 0, bytes - count );
 
-  // Check the device channel support.
-  stream_.nUserChannels[mode] = channels;
-  if ( ainfo.max_channels < (int)(channels + firstChannel) ) {
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: the device (" << ainfo.name << ") does not support requested channel parameters.";
-    errorText_ = errorStream_.str();
-    return FAILURE;
+    // Do byte swapping if necessary.
+    if ( stream_.doByteSwap[1] )
+      byteSwapBuffer( buffer, samples, format );
+
+    // Do buffer conversion if necessary.
+    if ( stream_.doConvertBuffer[1] )
+      convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
   }
 
-  // Set the number of channels.
-  int deviceChannels = channels + firstChannel;
-  result = ioctl( fd, SNDCTL_DSP_CHANNELS, &deviceChannels );
-  if ( result == -1 || deviceChannels < (int)(channels + firstChannel) ) {
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: error setting channel parameters on device (" << ainfo.name << ").";
-    errorText_ = errorStream_.str();
-    return FAILURE;
+  // Invoke user callback to get fresh output data.
+  int doStopStream = 0;
+  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+  double streamTime = getStreamTime();
+  RtAudioStreamStatus status = 0;
+  if ( handle->xrun ) {
+    if ( stream_.mode != INPUT ) status |= RTAUDIO_OUTPUT_UNDERFLOW;
+    if ( stream_.mode != OUTPUT ) status |= RTAUDIO_INPUT_OVERFLOW;
+    handle->xrun = false;
+  }
+  beginCallback();
+  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+                           stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
+  endCallback( status );
+  if ( doStopStream == 2 ) {
+    this->abortStream();
+    return;
   }
-  stream_.nDeviceChannels[mode] = deviceChannels;
 
-  // Get the data format mask
-  int mask;
-  result = ioctl( fd, SNDCTL_DSP_GETFMTS, &mask );
-  if ( result == -1 ) {
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: error getting device (" << ainfo.name << ") data formats.";
-    errorText_ = errorStream_.str();
-    return FAILURE;
+  // A stop or abort might have been requested during the callback.
+  if ( stream_.state.load( std::memory_order_acquire ) == STREAM_STOPPING ) {
+    finishStop( handle->stopRequest );
+    return;
   }
 
-  // Determine how to set the device format.
-  stream_.userFormat = format;
-  int deviceFormat = -1;
-  stream_.doByteSwap[mode] = false;
-  if ( format == RTAUDIO_SINT8 ) {
-    if ( mask & AFMT_S8 ) {
-      deviceFormat = AFMT_S8;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT8;
+  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+
+    // Setup parameters and do buffer conversion if necessary.
+    if ( stream_.doConvertBuffer[0] ) {
+      buffer = stream_.deviceBuffer;
+      convertBuffer( buffer, stream_.userBuffer[0], stream_.convertInfo[0] );
+      samples = stream_.bufferSize * stream_.nDeviceChannels[0];
+      format = stream_.deviceFormat[0];
     }
-  }
-  else if ( format == RTAUDIO_SINT16 ) {
-    if ( mask & AFMT_S16_NE ) {
-      deviceFormat = AFMT_S16_NE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
+    else {
+      buffer = stream_.userBuffer[0];
+      samples = stream_.bufferSize * stream_.nUserChannels[0];
+      format = stream_.userFormat;
     }
-    else if ( mask & AFMT_S16_OE ) {
-      deviceFormat = AFMT_S16_OE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
-      stream_.doByteSwap[mode] = true;
+    bytes = samples * formatBytes( format );
+
+    // Do byte swapping if necessary.
+    if ( stream_.doByteSwap[0] )
+      byteSwapBuffer( buffer, samples, format );
+
+    // Write samples to the file.  The buffer is not used again, so
+    // it can be put in file order in place.
+    FILE *fd = handle->file[OUTPUT];
+    if ( fd ) {
+      if ( handle->fileSwap[0] )
+        byteSwapBuffer( buffer, samples, format );
+      if ( handle->fileUnsigned[0] )
+        for ( unsigned int i=0; i<samples; i++ ) buffer[i] ^= (char) 0x80;
+      if ( handle->fileSampleBytes[0] < formatBytes( format ) ) {
+        for ( unsigned int i=0; i<samples; i++ )
+          memmove( buffer + 3 * i, buffer + 4 * i, 3 );
+      }
+      bytes = samples * handle->fileSampleBytes[0];
+      if ( fwrite( buffer, 1, bytes, fd ) != bytes ) {
+        errorText_ = "RtApiNull::callbackEvent: error writing output file.";
+        error( RTAUDIO_WARNING );
+      }
+      else
+        handle->fileBytes[0] += bytes;
     }
   }
-  else if ( format == RTAUDIO_SINT24 ) {
-    if ( mask & AFMT_S24_NE ) {
-      deviceFormat = AFMT_S24_NE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
-    }
-    else if ( mask & AFMT_S24_OE ) {
-      deviceFormat = AFMT_S24_OE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
-      stream_.doByteSwap[mode] = true;
+
+  // Schedule the next period.  If the callback is late by more than a
+  // whole period, report an xrun and restart the clock from now.
+  if ( !handle->freeRun ) {
+    handle->frames += stream_.bufferSize;
+    handle->deadline = handle->start +
+      std::chrono::nanoseconds( handle->frames * 1000000000ULL / stream_.sampleRate );
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if ( now - handle->deadline > std::chrono::nanoseconds( stream_.bufferSize * 1000000000ULL / stream_.sampleRate ) ) {
+      handle->xrun = true;
+      handle->start = now;
+      handle->deadline = now;
+      handle->frames = 0;
     }
   }
-  else if ( format == RTAUDIO_SINT32 ) {
-    if ( mask & AFMT_S32_NE ) {
-      deviceFormat = AFMT_S32_NE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
-    }
-    else if ( mask & AFMT_S32_OE ) {
-      deviceFormat = AFMT_S32_OE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
-      stream_.doByteSwap[mode] = true;
+
+  RtApi::tickStreamTime();
+  if ( doStopStream == 1 ) this->stopStream();
+}
+
+static void nullCallbackHandler( CallbackInfo *info )
+{
+  RtApiNull *object = (RtApiNull *) info->object;
+  bool *isRunning = &info->isRunning;
+
+  while ( *isRunning == true )
+    object->callbackEvent();
+}
+
+//******************** End of __RTAUDIO_NULL__ *********************//
+#endif
+
+// *************************************************** //
+//
+// Callback thread configuration for the ALSA, PulseAudio and OSS
+// APIs, whose callbacks run on a thread of their own: realtime
+// scheduling policy, CPU affinity and memory locking (see
+// RtAudio::StreamOptions).
+//
+// *************************************************** //
+
+#if defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__LINUX_OSS__)
+
+#if defined(__linux__) && defined(SYS_sched_setattr)
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+// The argument of the sched_setattr() system call, which has no libc
+// wrapper.
+struct RtSchedAttr {
+  uint32_t size;
+  uint32_t sched_policy;
+  uint64_t sched_flags;
+  int32_t sched_nice;
+  uint32_t sched_priority;
+  uint64_t sched_runtime;
+  uint64_t sched_deadline;
+  uint64_t sched_period;
+};
+
+// Selects SCHED_DEADLINE for the calling thread, with a period and
+// deadline of one buffer and the given fraction of it as runtime.
+static bool setDeadlineScheduling( unsigned int bufferSize, unsigned int sampleRate, double runtime )
+{
+  RtSchedAttr attr;
+  memset( &attr, 0, sizeof( attr ) );
+  attr.size = sizeof( attr );
+  attr.sched_policy = SCHED_DEADLINE;
+  attr.sched_period = (uint64_t) ( 1e9 * bufferSize / sampleRate );
+  attr.sched_deadline = attr.sched_period;
+  attr.sched_runtime = (uint64_t) ( attr.sched_period * runtime );
+  return syscall( SYS_sched_setattr, 0, &attr, 0 ) == 0;
+}
+
+#endif
+
+#if defined(HAVE_RTKIT) && defined(__linux__)
+
+// Reads an integer property of RealtimeKit, or returns -1.
+static long long rtkitProperty( DBusConnection *bus, const char *name )
+{
+  long long value = -1;
+  const char *interface = "org.freedesktop.RealtimeKit1";
+  DBusMessage *message = dbus_message_new_method_call( "org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+                                                       "org.freedesktop.DBus.Properties", "Get" );
+  if ( message == NULL ) return value;
+  DBusMessage *reply = NULL;
+  if ( dbus_message_append_args( message, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID ) )
+    reply = dbus_connection_send_with_reply_and_block( bus, message, 1000, NULL );
+  dbus_message_unref( message );
+  if ( reply == NULL ) return value;
+
+  DBusMessageIter iter, variant;
+  if ( dbus_message_iter_init( reply, &iter ) && dbus_message_iter_get_arg_type( &iter ) == DBUS_TYPE_VARIANT ) {
+    dbus_message_iter_recurse( &iter, &variant );
+    if ( dbus_message_iter_get_arg_type( &variant ) == DBUS_TYPE_INT32 ) {
+      dbus_int32_t i;
+      dbus_message_iter_get_basic( &variant, &i );
+      value = i;
+    }
+    else if ( dbus_message_iter_get_arg_type( &variant ) == DBUS_TYPE_INT64 ) {
+      dbus_int64_t i;
+      dbus_message_iter_get_basic( &variant, &i );
+      value = i;
+    }
+  }
+  dbus_message_unref( reply );
+  return value;
+}
+
+// Asks RealtimeKit to make the calling thread SCHED_RR, which is how
+// unprivileged processes are given realtime scheduling on desktop
+// systems.  RealtimeKit only accepts processes whose hard limit on
+// realtime CPU time (RLIMIT_RTTIME) is within its own maximum, and
+// caps the priority.  The limit is left to the application, since an
+// unprivileged process cannot raise a hard limit again: when it is
+// too high, RealtimeKit is not asked and its maximum is returned in
+// requiredLimit (in microseconds).
+static bool rtkitMakeRealtime( int priority, long long &requiredLimit )
+{
+  requiredLimit = 0;
+  DBusConnection *bus = dbus_bus_get_private( DBUS_BUS_SYSTEM, NULL );
+  if ( bus == NULL ) return false;
+  dbus_connection_set_exit_on_disconnect( bus, FALSE );
+
+  bool result = false;
+  long long maxPriority = rtkitProperty( bus, "MaxRealtimePriority" );
+  long long maxTime = rtkitProperty( bus, "RTTimeUSecMax" );
+  struct rlimit limit;
+  if ( maxPriority > 0 && maxTime > 0 && getrlimit( RLIMIT_RTTIME, &limit ) == 0 ) {
+    bool limited = ( limit.rlim_max != RLIM_INFINITY && limit.rlim_max <= (rlim_t) maxTime );
+    if ( !limited ) requiredLimit = maxTime;
+
+    DBusMessage *message = dbus_message_new_method_call( "org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+                                                         "org.freedesktop.RealtimeKit1", "MakeThreadRealtime" );
+    dbus_uint64_t thread = (dbus_uint64_t) syscall( SYS_gettid );
+    dbus_uint32_t rtPriority = (dbus_uint32_t) std::min( (long long) std::max( priority, 1 ), maxPriority );
+    if ( limited && message &&
+         dbus_message_append_args( message, DBUS_TYPE_UINT64, &thread, DBUS_TYPE_UINT32, &rtPriority, DBUS_TYPE_INVALID ) ) {
+      DBusMessage *reply = dbus_connection_send_with_reply_and_block( bus, message, 1000, NULL );
+      if ( reply ) {
+        result = true;
+        dbus_message_unref( reply );
+      }
     }
+    if ( message ) dbus_message_unref( message );
   }
 
-  if ( deviceFormat == -1 ) {
-    // The user requested format is not natively supported by the device.
-    if ( mask & AFMT_S16_NE ) {
-      deviceFormat = AFMT_S16_NE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
-    }
-    else if ( mask & AFMT_S32_NE ) {
-      deviceFormat = AFMT_S32_NE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
-    }
-    else if ( mask & AFMT_S24_NE ) {
-      deviceFormat = AFMT_S24_NE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
-    }
-    else if ( mask & AFMT_S16_OE ) {
-      deviceFormat = AFMT_S16_OE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT16;
-      stream_.doByteSwap[mode] = true;
+  dbus_connection_close( bus );
+  dbus_connection_unref( bus );
+  return result;
+}
+
+#endif
+
+void RtApi :: setCallbackThreadOptions( RtAudio::StreamOptions *options )
+{
+  CallbackInfo &info = stream_.callbackInfo;
+  info.doRealtime = false;
+#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
+  info.doRealtime = ( options && options->flags & RTAUDIO_SCHEDULE_REALTIME );
+#endif
+  info.priority = options ? options->priority : 0;
+  info.policy = options ? options->schedulingPolicy : RtAudio::SCHEDULE_RR;
+  info.deadlineRuntime = options ? options->deadlineRuntime : 0.5;
+  info.cpuAffinity = options ? options->cpuAffinity : std::vector<unsigned int>();
+  info.lockMemory = ( options && options->lockMemory );
+}
+
+// Applies the options saved by setCallbackThreadOptions() to the
+// calling thread, which must be the callback thread, before its first
+// period.  Returns true if the thread runs with realtime scheduling.
+bool RtApi :: configureCallbackThread( void )
+{
+  CallbackInfo &info = stream_.callbackInfo;
+
+  if ( !info.cpuAffinity.empty() ) {
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO( &cpus );
+    for ( unsigned int cpu : info.cpuAffinity )
+      if ( cpu < CPU_SETSIZE ) CPU_SET( cpu, &cpus );
+    if ( pthread_setaffinity_np( pthread_self(), sizeof( cpus ), &cpus ) ) {
+      errorText_ = "RtApi::configureCallbackThread: error setting the CPU affinity of the callback thread.";
+      error( RTAUDIO_WARNING );
     }
-    else if ( mask & AFMT_S32_OE ) {
-      deviceFormat = AFMT_S32_OE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT32;
-      stream_.doByteSwap[mode] = true;
+#else
+    errorText_ = "RtApi::configureCallbackThread: CPU affinity is not supported on this system.";
+    error( RTAUDIO_WARNING );
+#endif
+  }
+
+  bool realtime = false;
+#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
+  if ( info.doRealtime ) {
+    // The ALSA and OSS threads are created with the policy when the
+    // process is privileged, the PulseAudio mainloop thread is not.
+    int policy = ( info.policy == RtAudio::SCHEDULE_FIFO ) ? SCHED_FIFO : SCHED_RR;
+    int current;
+    struct sched_param param;
+    pthread_getschedparam( pthread_self(), &current, &param );
+    param.sched_priority = std::min( std::max( info.priority, sched_get_priority_min( policy ) ),
+                                     sched_get_priority_max( policy ) );
+    realtime = ( current == policy || pthread_setschedparam( pthread_self(), policy, &param ) == 0 );
+
+    if ( info.policy == RtAudio::SCHEDULE_DEADLINE ) {
+#if defined(__linux__) && defined(SYS_sched_setattr)
+      if ( setDeadlineScheduling( stream_.bufferSize, stream_.sampleRate, info.deadlineRuntime ) )
+        realtime = true;
+      else {
+        errorText_ = "RtApi::configureCallbackThread: error selecting deadline scheduling, using round-robin scheduling.";
+        error( RTAUDIO_WARNING );
+      }
+#else
+      errorText_ = "RtApi::configureCallbackThread: deadline scheduling is not supported on this system.";
+      error( RTAUDIO_WARNING );
+#endif
     }
-    else if ( mask & AFMT_S24_OE ) {
-      deviceFormat = AFMT_S24_OE;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT24;
-      stream_.doByteSwap[mode] = true;
+
+#if defined(HAVE_RTKIT) && defined(__linux__)
+    long long requiredLimit = 0;
+    if ( !realtime ) realtime = rtkitMakeRealtime( info.priority, requiredLimit );
+    if ( requiredLimit > 0 ) {
+      errorStream_ << "RtApi::configureCallbackThread: RealtimeKit requires a hard RLIMIT_RTTIME of at most " <<
+        requiredLimit << " microseconds (see setrlimit()).";
+      errorText_ = errorStream_.str();
+      error( RTAUDIO_WARNING );
     }
-    else if ( mask & AFMT_S8) {
-      deviceFormat = AFMT_S8;
-      stream_.deviceFormat[mode] = RTAUDIO_SINT8;
+#endif
+  }
+#endif
+
+  if ( info.lockMemory ) {
+    if ( mlockall( MCL_CURRENT | MCL_FUTURE ) ) {
+      errorText_ = "RtApi::configureCallbackThread: error locking the process memory (see RLIMIT_MEMLOCK).";
+      error( RTAUDIO_WARNING );
     }
+
+    // Map some stack before the first period, even when the memory
+    // could not be locked.  The stream buffers are prefaulted by
+    // openStream().
+    volatile char stack[65536];
+    for ( size_t j=0; j<sizeof( stack ); j+=1024 ) stack[j] = 0;
+  }
+
+  return realtime;
+}
+
+#endif
+
+
+// *************************************************** //
+//
+// Protected common (OS-independent) RtAudio methods.
+//
+// *************************************************** //
+
+// This method can be modified to control the behavior of error
+// message printing.
+RtAudioErrorType RtApi :: error( RtAudioErrorType type )
+{
+  errorStream_.str(""); // clear the ostringstream to avoid repeated messages
+
+  // Don't output warnings if showWarnings_ is false
+  if ( type == RTAUDIO_WARNING && showWarnings_ == false ) return type;
+  
+  if ( errorCallback_ ) {
+    //const std::string errorMessage = errorText_;
+    //errorCallback_( type, errorMessage );
+    errorCallback_( type, errorText_ );
   }
+  else
+    std::cerr << '\n' << errorText_ << "\n\n";
+  return type;
+}
 
-  if ( stream_.deviceFormat[mode] == 0 ) {
-    // This really shouldn't happen ...
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") data format not supported by RtAudio.";
-    errorText_ = errorStream_.str();
-    return FAILURE;
+/*
+void RtApi :: verifyStream()
+{
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApi:: a stream is not open!";
+    error( RtAudioError::INVALID_USE );
   }
+}
+*/
 
-  // Set the data format.
-  int temp = deviceFormat;
-  result = ioctl( fd, SNDCTL_DSP_SETFMT, &deviceFormat );
-  if ( result == -1 || deviceFormat != temp ) {
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: error setting data format on device (" << ainfo.name << ").";
-    errorText_ = errorStream_.str();
-    return FAILURE;
+int RtApi :: ringBufferCallback( void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                                 double /*streamTime*/, RtAudioStreamStatus status, void *userData )
+{
+  RtApiStream &stream = ( (RtApi *) userData )->stream_;
+
+  RingBuffer *ring = stream.ringBuffer[OUTPUT];
+  if ( ring ) {
+    unsigned int frames = ring->read( (char *) outputBuffer, nFrames );
+    if ( frames < nFrames ) {
+      memset( (char *) outputBuffer + (size_t) frames * ring->frameBytes(), 0,
+              (size_t) ( nFrames - frames ) * ring->frameBytes() );
+      status |= RTAUDIO_OUTPUT_UNDERFLOW;
+    }
   }
 
-  // Attempt to set the buffer size.  According to OSS, the minimum
-  // number of buffers is two.  The supposed minimum buffer size is 16
-  // bytes, so that will be our lower bound.  The argument to this
-  // call is in the form 0xMMMMSSSS (hex), where the buffer size (in
-  // bytes) is given as 2^SSSS and the number of buffers as 2^MMMM.
-  // We'll check the actual value used near the end of the setup
-  // procedure.
-  int ossBufferBytes = *bufferSize * formatBytes( stream_.deviceFormat[mode] ) * deviceChannels;
-  if ( ossBufferBytes < 16 ) ossBufferBytes = 16;
-  int buffers = 0;
-  if ( options ) buffers = options->numberOfBuffers;
-  if ( options && options->flags & RTAUDIO_MINIMIZE_LATENCY ) buffers = 2;
-  if ( buffers < 2 ) buffers = 3;
-  temp = ((int) buffers << 16) + (int)( log10( (double)ossBufferBytes ) / log10( 2.0 ) );
-  result = ioctl( fd, SNDCTL_DSP_SETFRAGMENT, &temp );
-  if ( result == -1 ) {
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: error setting buffer size on device (" << ainfo.name << ").";
-    errorText_ = errorStream_.str();
-    return FAILURE;
-  }
-  stream_.nBuffers = buffers;
+  ring = stream.ringBuffer[INPUT];
+  if ( ring && ring->write( (const char *) inputBuffer, nFrames ) < nFrames )
+    status |= RTAUDIO_INPUT_OVERFLOW;
 
-  // Save buffer size (in sample frames).
-  *bufferSize = ossBufferBytes / ( formatBytes(stream_.deviceFormat[mode]) * deviceChannels );
-  stream_.bufferSize = *bufferSize;
+  if ( status ) stream.ringStatus.fetch_or( status, std::memory_order_relaxed );
+  return 0;
+}
 
-  // Set the sample rate.
-  int srate = sampleRate;
-  result = ioctl( fd, SNDCTL_DSP_SPEED, &srate );
-  if ( result == -1 ) {
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: error setting sample rate (" << sampleRate << ") on device (" << ainfo.name << ").";
-    errorText_ = errorStream_.str();
-    return FAILURE;
-  }
+int RtApi :: planarCallback( void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                             double streamTime, RtAudioStreamStatus status, void *userData )
+{
+  RtApi *api = (RtApi *) userData;
+  PlanarCallback *planar = api->stream_.planar;
+  api->setPlanarChannels( OUTPUT, (char *) outputBuffer, nFrames );
+  api->setPlanarChannels( INPUT, (char *) inputBuffer, nFrames );
+  return planar->callback( outputBuffer ? &planar->channels[OUTPUT][0] : NULL,
+                           inputBuffer ? &planar->channels[INPUT][0] : NULL,
+                           nFrames, streamTime, status, planar->userData );
+}
 
-  // Verify the sample rate setup worked.
-  if ( abs( srate - (int)sampleRate ) > 100 ) {
-    close( fd );
-    errorStream_ << "RtApiOss::probeDeviceOpen: device (" << ainfo.name << ") does not support sample rate (" << sampleRate << ").";
-    errorText_ = errorStream_.str();
-    return FAILURE;
-  }
-  stream_.sampleRate = sampleRate;
+void RtApi :: setPlanarChannels( StreamMode mode, char *buffer, unsigned int nFrames )
+{
+  if ( buffer == NULL ) return;
+  std::vector<float *> &channels = stream_.planar->channels[mode];
+  for ( size_t i=0; i<channels.size(); i++ )
+    channels[i] = (float *) buffer + i * nFrames;
+}
 
-  if ( mode == INPUT && stream_.mode == OUTPUT && stream_.deviceId[0] == device) {
-    // We're doing duplex setup here.
-    stream_.deviceFormat[0] = stream_.deviceFormat[1];
-    stream_.nDeviceChannels[0] = deviceChannels;
-  }
+int RtApi :: invokePlanarCallback( unsigned int nFrames, double streamTime, RtAudioStreamStatus status )
+{
+  PlanarCallback *planar = stream_.planar;
+  std::vector<float *> *channels = planar->channels;
+  return planar->callback( channels[OUTPUT].empty() ? NULL : &channels[OUTPUT][0],
+                           channels[INPUT].empty() ? NULL : &channels[INPUT][0],
+                           nFrames, streamTime, status, planar->userData );
+}
 
-  // Set interleaving parameters.
-  stream_.userInterleaved = true;
-  stream_.deviceInterleaved[mode] =  true;
-  if ( options && options->flags & RTAUDIO_NONINTERLEAVED )
-    stream_.userInterleaved = false;
+static void statsAdd( std::atomic<unsigned long long> &value, unsigned long long amount )
+{
+  value.store( value.load( std::memory_order_relaxed ) + amount, std::memory_order_relaxed );
+}
 
-  // Set flags for buffer conversion
-  stream_.doConvertBuffer[mode] = false;
-  if ( stream_.userFormat != stream_.deviceFormat[mode] )
-    stream_.doConvertBuffer[mode] = true;
-  if ( stream_.nUserChannels[mode] < stream_.nDeviceChannels[mode] )
-    stream_.doConvertBuffer[mode] = true;
-  if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
-       stream_.nUserChannels[mode] > 1 )
-    stream_.doConvertBuffer[mode] = true;
+static void statsMax( std::atomic<unsigned long long> &value, unsigned long long amount )
+{
+  if ( amount > value.load( std::memory_order_relaxed ) )
+    value.store( amount, std::memory_order_relaxed );
+}
 
-  // Allocate the stream handles if necessary and then save.
-  if ( stream_.apiHandle == 0 ) {
-    try {
-      handle = new OssHandle;
-    }
-    catch ( std::bad_alloc& ) {
-      errorText_ = "RtApiOss::probeDeviceOpen: error allocating OssHandle memory.";
-      goto error;
-    }
+void RtApi :: clearStreamStats( void )
+{
+  StatsData &stats = stream_.stats;
+  unsigned int sequence = beginStatsUpdate( stats );
+  stats.resetRequested.store( false, std::memory_order_relaxed );
+  stats.lastWakeup = 0;
+  stats.callbackStart = 0;
+  stats.callbacks.store( 0, std::memory_order_relaxed );
+  for ( unsigned int i=0; i<RtAudio::StreamStats::HISTOGRAM_BINS; i++ )
+    stats.histogram[i].store( 0, std::memory_order_relaxed );
+  stats.callbackTime.store( 0, std::memory_order_relaxed );
+  stats.maxCallbackTime.store( 0, std::memory_order_relaxed );
+  stats.wakeups.store( 0, std::memory_order_relaxed );
+  stats.jitter.store( 0, std::memory_order_relaxed );
+  stats.maxJitter.store( 0, std::memory_order_relaxed );
+  stats.converts.store( 0, std::memory_order_relaxed );
+  stats.convertTime.store( 0, std::memory_order_relaxed );
+  stats.maxConvertTime.store( 0, std::memory_order_relaxed );
+  stats.xruns[0].store( 0, std::memory_order_relaxed );
+  stats.xruns[1].store( 0, std::memory_order_relaxed );
+  stats.mutexTime.store( 0, std::memory_order_relaxed );
+  endStatsUpdate( stats, sequence );
+}
 
-    if ( pthread_cond_init( &handle->runnable, NULL ) ) {
-      errorText_ = "RtApiOss::probeDeviceOpen: error initializing pthread condition variable.";
-      goto error;
-    }
+void RtApi :: recordCallbackStart( void )
+{
+  StatsData &stats = stream_.stats;
+  if ( stats.resetRequested.exchange( false, std::memory_order_acquire ) )
+    clearStreamStats();
+
+  long long now = monotonicNanos();
+  long long period = (long long) stream_.bufferSize * 1000000000LL / stream_.sampleRate;
+  if ( stats.lastWakeup != 0 && now - stats.lastWakeup <= 10 * period ) {
+    long long jitter = now - stats.lastWakeup - period;
+    if ( jitter < 0 ) jitter = -jitter;
+    unsigned int sequence = beginStatsUpdate( stats );
+    statsAdd( stats.wakeups, 1 );
+    statsAdd( stats.jitter, jitter );
+    statsMax( stats.maxJitter, jitter );
+    endStatsUpdate( stats, sequence );
+  }
+  stats.lastWakeup = now;
+  stats.callbackStart = now;
+}
 
-    stream_.apiHandle = (void *) handle;
-  }
-  else {
-    handle = (OssHandle *) stream_.apiHandle;
+void RtApi :: recordCallbackEnd( RtAudioStreamStatus status )
+{
+  StatsData &stats = stream_.stats;
+  long long duration = monotonicNanos() - stats.callbackStart;
+  long long period = (long long) stream_.bufferSize * 1000000000LL / stream_.sampleRate;
+  unsigned int bin = ( period > 0 ) ? (unsigned int) std::min( duration * 10 / period, 10LL ) : 10;
+  if ( bin == 10 && duration >= 2 * period ) bin = 11;
+
+  unsigned int sequence = beginStatsUpdate( stats );
+  statsAdd( stats.callbacks, 1 );
+  statsAdd( stats.histogram[bin], 1 );
+  statsAdd( stats.callbackTime, duration );
+  statsMax( stats.maxCallbackTime, duration );
+  if ( status & RTAUDIO_OUTPUT_UNDERFLOW ) statsAdd( stats.xruns[0], 1 );
+  if ( status & RTAUDIO_INPUT_OVERFLOW ) statsAdd( stats.xruns[1], 1 );
+  endStatsUpdate( stats, sequence );
+}
+
+void RtApi :: recordConvertTime( long long nanoseconds )
+{
+  StatsData &stats = stream_.stats;
+  unsigned int sequence = beginStatsUpdate( stats );
+  statsAdd( stats.converts, 1 );
+  statsAdd( stats.convertTime, nanoseconds );
+  statsMax( stats.maxConvertTime, nanoseconds );
+  endStatsUpdate( stats, sequence );
+}
+
+void RtApi :: lockStreamMutex( void )
+{
+  if ( !stream_.stats.enabled ) {
+    MUTEX_LOCK( &stream_.mutex );
+    return;
   }
-  handle->id[mode] = fd;
 
-  // Allocate necessary internal buffers.
-  unsigned long bufferBytes;
-  bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
-  stream_.userBuffer[mode] = (char *) calloc( bufferBytes, 1 );
-  if ( stream_.userBuffer[mode] == NULL ) {
-    errorText_ = "RtApiOss::probeDeviceOpen: error allocating user buffer memory.";
-    goto error;
+  long long start = monotonicNanos();
+  MUTEX_LOCK( &stream_.mutex );
+  StatsData &stats = stream_.stats;
+  unsigned int sequence = beginStatsUpdate( stats );
+  statsAdd( stats.mutexTime, monotonicNanos() - start );
+  endStatsUpdate( stats, sequence );
+}
+
+// Sets up the input stage of a duplex stream opened with
+// RTAUDIO_DRIFT_COMPENSATION.  The backend reads input periods into
+// the device buffer, as described by the input conversion (which must
+// be enabled), and passes them to bufferDriftInput() instead of
+// converting them.
+void RtApi :: setupDriftCompensation( void )
+{
+  unsigned int channels = stream_.convertInfo[1].channels;
+  DriftCompensation *drift = new DriftCompensation( channels, ( stream_.nBuffers + 2 ) * stream_.bufferSize );
+  drift->buffer[0].resize( (size_t) stream_.bufferSize * channels );
+  drift->buffer[1].resize( (size_t) stream_.bufferSize * channels );
+
+  // Convert to interleaved FLOAT32 with the input conversion, and from
+  // there to the user buffer.
+  ConvertInfo &toFloat = drift->toFloat, &fromFloat = drift->fromFloat;
+  toFloat = stream_.convertInfo[1];
+  toFloat.outFormat = RTAUDIO_FLOAT32;
+  toFloat.outJump = channels;
+  fromFloat.channels = channels;
+  fromFloat.inFormat = RTAUDIO_FLOAT32;
+  fromFloat.inJump = channels;
+  fromFloat.outFormat = stream_.userFormat;
+  fromFloat.outJump = stream_.userInterleaved ? stream_.nUserChannels[1] : 1;
+  fromFloat.clearOutput = false;
+  for ( unsigned int k=0; k<channels; k++ ) {
+    toFloat.outOffset[k] = k;
+    fromFloat.inOffset.push_back( k );
+    fromFloat.outOffset.push_back( stream_.userInterleaved ? k : k * stream_.bufferSize );
+  }
+  setConvertPlan( toFloat );
+  setConvertPlan( fromFloat );
+
+  // The level counts the frames still waiting in the input device, of
+  // up to a period, so keep a period to spare on top of those and of
+  // the one each callback consumes.
+  drift->target = 3.0 * stream_.bufferSize + drift->resampler.latency();
+  drift->loop.setup( stream_.bufferSize, (double) stream_.sampleRate / stream_.bufferSize );
+  if ( stream_.stats.nDrift < RtAudio::StreamStats::MAX_DRIFT_DEVICES ) {
+    drift->driftIndex = stream_.stats.nDrift++;
+    stream_.stats.drift[drift->driftIndex].store( 0.0, std::memory_order_relaxed );
   }
+  else
+    drift->driftIndex = RtAudio::StreamStats::MAX_DRIFT_DEVICES;
 
-  if ( stream_.doConvertBuffer[mode] ) {
+  delete stream_.driftCompensation;
+  stream_.driftCompensation = drift;
+}
 
-    bool makeBuffer = true;
-    bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
-    if ( mode == INPUT ) {
-      if ( stream_.mode == OUTPUT && stream_.deviceBuffer ) {
-        unsigned long bytesOut = stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] );
-        if ( bufferBytes <= bytesOut ) makeBuffer = false;
-      }
-    }
+// Empties the input stage, when the input device is (re)started.
+void RtApi :: resetDriftCompensation( void )
+{
+  stream_.driftCompensation->resampler.reset();
+  stream_.driftCompensation->running = false;
+}
 
-    if ( makeBuffer ) {
-      bufferBytes *= *bufferSize;
-      if ( stream_.deviceBuffer ) free( stream_.deviceBuffer );
-      stream_.deviceBuffer = (char *) calloc( bufferBytes, 1 );
-      if ( stream_.deviceBuffer == NULL ) {
-        errorText_ = "RtApiOss::probeDeviceOpen: error allocating device buffer memory.";
-        goto error;
-      }
-    }
-  }
+// Buffers one period read from the input device.  Returns false if
+// the input stage overflowed.
+bool RtApi :: bufferDriftInput( char *buffer )
+{
+  DriftCompensation *drift = stream_.driftCompensation;
+  float *input = &drift->buffer[0][0];
+  drift->toFloat.convert( (char *) input, buffer, drift->toFloat, stream_.bufferSize );
+  return drift->resampler.write( input, stream_.bufferSize ) == stream_.bufferSize;
+}
 
-  stream_.deviceId[mode] = device;
-  stream_.state = STREAM_STOPPED;
+// Resamples one period of input into the user buffer, given the number
+// of frames still waiting in the input device.  The period is silent
+// until the stage holds its target level, from which it then starts
+// (dropping any input beyond), so that the loop doesn't start with an
+// error of up to a period.  Returns false if the stage ran short of
+// input.
+bool RtApi :: resampleDriftInput( double pendingFrames )
+{
+  DriftCompensation *drift = stream_.driftCompensation;
+  double level = drift->resampler.bufferedFrames() + pendingFrames;
+  if ( !drift->running && level >= drift->target ) {
+    drift->resampler.skip( level - drift->target );
+    level = drift->resampler.bufferedFrames() + pendingFrames;
+    drift->running = true;
+  }
+
+  bool complete = true;
+  unsigned int produced = 0;
+  float *output = &drift->buffer[1][0];
+  unsigned int channels = drift->fromFloat.channels;
+  if ( drift->running ) {
+    drift->resampler.setRatio( 1.0 + drift->loop.update( level - drift->target ) );
+    if ( drift->driftIndex < RtAudio::StreamStats::MAX_DRIFT_DEVICES )
+      stream_.stats.drift[drift->driftIndex].store( -drift->loop.drift() * 1e6, std::memory_order_relaxed );
+    produced = drift->resampler.read( output, stream_.bufferSize );
+    if ( produced < stream_.bufferSize ) {
+      drift->running = false;
+      complete = false;
+    }
+  }
+  std::fill( output + (size_t) produced * channels, output + (size_t) stream_.bufferSize * channels, 0.0f );
+  drift->fromFloat.convert( stream_.userBuffer[1], (char *) output, drift->fromFloat, stream_.bufferSize );
+  return complete;
+}
 
-  // Setup the buffer conversion information structure.
-  if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
+bool RtApi :: convertStreamRate( unsigned int sampleRate, unsigned int deviceRate,
+                                 unsigned int *bufferSize, RtAudio::StreamOptions *options )
+{
+  if ( !options || !( options->flags & RTAUDIO_CONVERT_SAMPLE_RATE ) ) return false;
+  if ( stream_.mode != UNINITIALIZED || stream_.rateConversion ) return false;
 
-  // Setup thread if necessary.
-  if ( stream_.mode == OUTPUT && mode == INPUT ) {
-    // We had already set up an output stream.
-    stream_.mode = DUPLEX;
-    if ( stream_.deviceId[0] == device ) handle->id[0] = fd;
-  }
-  else {
-    stream_.mode = mode;
+  stream_.rateConversion = new RateConversion( sampleRate, *bufferSize );
+  if ( *bufferSize > 0 )
+    *bufferSize = std::max( 1u, (unsigned int) std::lround( (double) *bufferSize * deviceRate / sampleRate ) );
+  return true;
+}
 
-    // Setup callback thread.
-    stream_.callbackInfo.object = (void *) this;
+// Completes the conversion once the device periods are known.
+void RtApi :: setupRateConversion( RtAudioCallback callback, void *userData )
+{
+  RateConversion *conversion = stream_.rateConversion;
+  conversion->callback = callback;
+  conversion->userData = userData;
+
+  // Output flows from user periods to device periods, and input the
+  // other way around.
+  double ratio = (double) stream_.sampleRate / conversion->sampleRate;
+  unsigned int capacity = 4 * std::max( conversion->bufferFrames, stream_.bufferSize );
+  for ( int i=0; i<2; i++ ) {
+    unsigned int channels = stream_.nUserChannels[i];
+    if ( channels == 0 ) continue;
+    conversion->resampler[i] = new Resampler( channels, ( i == OUTPUT ) ? ratio : 1.0 / ratio, capacity );
+    conversion->userFloat[i].resize( (size_t) conversion->bufferFrames * channels );
+    conversion->deviceFloat[i].resize( (size_t) stream_.bufferSize * channels );
+    conversion->userBuffer[i].resize( (size_t) conversion->bufferFrames * channels * formatBytes( stream_.userFormat ) );
+
+    unsigned int frames[2] = { conversion->bufferFrames, stream_.bufferSize };
+    if ( i == INPUT ) std::swap( frames[0], frames[1] );
+    ConvertInfo &toFloat = conversion->toFloat[i], &fromFloat = conversion->fromFloat[i];
+    toFloat.channels = fromFloat.channels = channels;
+    toFloat.inFormat = fromFloat.outFormat = stream_.userFormat;
+    toFloat.outFormat = fromFloat.inFormat = RTAUDIO_FLOAT32;
+    toFloat.inJump = fromFloat.outJump = stream_.userInterleaved ? channels : 1;
+    toFloat.outJump = fromFloat.inJump = channels;
+    toFloat.inOffset.clear(); toFloat.outOffset.clear();
+    fromFloat.inOffset.clear(); fromFloat.outOffset.clear();
+    for ( unsigned int k=0; k<channels; k++ ) {
+      toFloat.inOffset.push_back( stream_.userInterleaved ? k : k * frames[0] );
+      toFloat.outOffset.push_back( k );
+      fromFloat.inOffset.push_back( k );
+      fromFloat.outOffset.push_back( stream_.userInterleaved ? k : k * frames[1] );
+    }
+    toFloat.clearOutput = fromFloat.clearOutput = false;
+    setConvertPlan( toFloat );
+    setConvertPlan( fromFloat );
+  }
+  resetRateConversion();
+}
 
-    // Set the thread attributes for joinable and realtime scheduling
-    // priority.  The higher priority will only take affect if the
-    // program is run as root or suid.
-    pthread_attr_t attr;
-    pthread_attr_init( &attr );
-    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
-#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
-    if ( options && options->flags & RTAUDIO_SCHEDULE_REALTIME ) {
-      stream_.callbackInfo.doRealtime = true;
-      struct sched_param param;
-      int priority = options->priority;
-      int min = sched_get_priority_min( SCHED_RR );
-      int max = sched_get_priority_max( SCHED_RR );
-      if ( priority < min ) priority = min;
-      else if ( priority > max ) priority = max;
-      param.sched_priority = priority;
-      
-      // Set the policy BEFORE the priority. Otherwise it fails.
-      pthread_attr_setschedpolicy(&attr, SCHED_RR);
-      pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
-      // This is definitely required. Otherwise it fails.
-      pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-      pthread_attr_setschedparam(&attr, &param);
-    }
-    else
-      pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
-#else
-    pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
-#endif
+// Empties the resamplers, when the stream is (re)started.  The input
+// is primed with a device period of silence, so that a duplex callback
+// always finds a whole period of input, and the output with the
+// lookahead of its filter, so that one user period yields about one
+// device period.
+void RtApi :: resetRateConversion( void )
+{
+  RateConversion *conversion = stream_.rateConversion;
+  for ( int i=0; i<2; i++ ) {
+    Resampler *resampler = conversion->resampler[i];
+    if ( resampler == 0 ) continue;
+    resampler->reset();
+    std::vector<float> &silence = conversion->deviceFloat[i];
+    std::fill( silence.begin(), silence.end(), 0.0f );
+    unsigned int frames = resampler->latency() + 1;
+    if ( i == INPUT ) frames += stream_.bufferSize;
+    while ( frames > 0 ) {
+      unsigned int n = resampler->write( &silence[0], std::min( frames, stream_.bufferSize ) );
+      if ( n == 0 ) break;
+      frames -= n;
+    }
+  }
+  conversion->inputFrames = 0;
+  conversion->status = 0;
+}
 
-    stream_.callbackInfo.isRunning = true;
-    result = pthread_create( &stream_.callbackInfo.thread, &attr, ossCallbackHandler, &stream_.callbackInfo );
-    pthread_attr_destroy( &attr );
-    if ( result ) {
-      // Failed. Try instead with default attributes.
-      result = pthread_create( &stream_.callbackInfo.thread, NULL, ossCallbackHandler, &stream_.callbackInfo );
-      if ( result ) {
-        stream_.callbackInfo.isRunning = false;
-        errorText_ = "RtApiOss::error creating callback thread!";
-        goto error;
-      }
-    }
+// Resamples as much of the next user input period as the buffered
+// input allows, and returns true once the period is complete.
+bool RtApi :: fillConvertedInput( void )
+{
+  RateConversion *conversion = stream_.rateConversion;
+  unsigned int channels = conversion->fromFloat[INPUT].channels;
+  float *input = &conversion->userFloat[INPUT][ (size_t) conversion->inputFrames * channels ];
+  conversion->inputFrames += conversion->resampler[INPUT]->read( input, conversion->bufferFrames - conversion->inputFrames );
+  return conversion->inputFrames == conversion->bufferFrames;
+}
+
+// Invokes the user callback for one period at the requested rate, with
+// the status collected since the last one, taking its input from fillConvertedInput() (padded with silence if
+// short) and passing its output to the output resampler.
+int RtApi :: invokeConvertedCallback( double streamTime )
+{
+  RateConversion *conversion = stream_.rateConversion;
+  char *buffers[2] = { 0, 0 };
+  if ( conversion->resampler[INPUT] ) {
+    unsigned int channels = conversion->fromFloat[INPUT].channels;
+    float *input = &conversion->userFloat[INPUT][0];
+    std::fill( input + (size_t) conversion->inputFrames * channels,
+               input + (size_t) conversion->bufferFrames * channels, 0.0f );
+    buffers[INPUT] = &conversion->userBuffer[INPUT][0];
+    conversion->fromFloat[INPUT].convert( buffers[INPUT], (char *) input, conversion->fromFloat[INPUT], conversion->bufferFrames );
+    conversion->inputFrames = 0;
+  }
+  if ( conversion->resampler[OUTPUT] ) buffers[OUTPUT] = &conversion->userBuffer[OUTPUT][0];
+
+  int result = conversion->callback( buffers[OUTPUT], buffers[INPUT], conversion->bufferFrames,
+                                     streamTime, conversion->status, conversion->userData );
+  conversion->status = 0;
+
+  if ( buffers[OUTPUT] ) {
+    float *output = &conversion->userFloat[OUTPUT][0];
+    conversion->toFloat[OUTPUT].convert( (char *) output, buffers[OUTPUT], conversion->toFloat[OUTPUT], conversion->bufferFrames );
+    conversion->resampler[OUTPUT]->write( output, conversion->bufferFrames );
   }
+  return result;
+}
 
-  return SUCCESS;
+// Callback installed for streams with a sample rate conversion, which
+// the backend invokes with device periods.  The user callback is run
+// as often as the output needs, or else as often as the input allows.
+int RtApi :: rateConversionCallback( void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                                     double streamTime, RtAudioStreamStatus status, void *userData )
+{
+  RtApi *api = (RtApi *) userData;
+  RateConversion *conversion = api->stream_.rateConversion;
+  double period = (double) conversion->bufferFrames / conversion->sampleRate;
+  conversion->status |= status;
 
- error:
-  if ( handle ) {
-    pthread_cond_destroy( &handle->runnable );
-    if ( handle->id[0] ) close( handle->id[0] );
-    if ( handle->id[1] ) close( handle->id[1] );
-    delete handle;
-    stream_.apiHandle = 0;
+  if ( inputBuffer ) {
+    float *input = &conversion->deviceFloat[INPUT][0];
+    conversion->toFloat[INPUT].convert( (char *) input, (char *) inputBuffer, conversion->toFloat[INPUT], nFrames );
+    if ( conversion->resampler[INPUT]->write( input, nFrames ) < nFrames )
+      conversion->status |= RTAUDIO_INPUT_OVERFLOW;
+  }
+
+  int result = 0;
+  if ( outputBuffer ) {
+    unsigned int channels = conversion->fromFloat[OUTPUT].channels;
+    float *output = &conversion->deviceFloat[OUTPUT][0];
+    unsigned int frames = conversion->resampler[OUTPUT]->read( output, nFrames );
+    while ( frames < nFrames && result == 0 ) {
+      if ( inputBuffer ) api->fillConvertedInput();
+      result = api->invokeConvertedCallback( streamTime );
+      streamTime += period;
+      frames += conversion->resampler[OUTPUT]->read( output + (size_t) frames * channels, nFrames - frames );
+    }
+    std::fill( output + (size_t) frames * channels, output + (size_t) nFrames * channels, 0.0f );
+    conversion->fromFloat[OUTPUT].convert( (char *) outputBuffer, (char *) output, conversion->fromFloat[OUTPUT], nFrames );
+  }
+  else {
+    while ( result == 0 && api->fillConvertedInput() ) {
+      result = api->invokeConvertedCallback( streamTime );
+      streamTime += period;
+    }
   }
+  return result;
+}
+
+void RtApi :: waitForRingBuffer( void )
+{
+  // A quarter of a buffer keeps the wakeups well inside each period
+  // without the audio thread having to signal anyone.
+  long micros = 250;
+  if ( stream_.sampleRate > 0 )
+    micros = (long) ( 250000.0 * stream_.bufferSize / stream_.sampleRate );
+  std::this_thread::sleep_for( std::chrono::microseconds( std::max( micros, 50L ) ) );
+}
 
+void RtApi :: prefaultStreamBuffers( void )
+{
+  // Write to every page of the stream buffers (at the smallest page
+  // size in use), so that the first periods do not fault them in.  The
+  // device buffer is as large as the larger of its two uses.
+  size_t bytes[3] = { 0, 0, 0 };
   for ( int i=0; i<2; i++ ) {
-    if ( stream_.userBuffer[i] ) {
-      free( stream_.userBuffer[i] );
-      stream_.userBuffer[i] = 0;
-    }
+    if ( stream_.userBuffer[i] )
+      bytes[i] = (size_t) stream_.nUserChannels[i] * stream_.bufferSize * formatBytes( stream_.userFormat );
+    if ( stream_.doConvertBuffer[i] )
+      bytes[2] = std::max( bytes[2], (size_t) stream_.nDeviceChannels[i] * stream_.bufferSize * formatBytes( stream_.deviceFormat[i] ) );
   }
-
-  if ( stream_.deviceBuffer ) {
-    free( stream_.deviceBuffer );
-    stream_.deviceBuffer = 0;
+  char *buffers[3] = { stream_.userBuffer[0], stream_.userBuffer[1], stream_.deviceBuffer };
+  for ( int i=0; i<3; i++ ) {
+    if ( buffers[i] == NULL ) continue;
+    volatile char *p = buffers[i];
+    for ( size_t j=0; j<bytes[i]; j+=4096 ) p[j] = p[j];
   }
+}
 
+void RtApi :: clearStreamInfo()
+{
+  stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
-  return FAILURE;
+  stream_.sampleRate = 0;
+  stream_.bufferSize = 0;
+  stream_.nBuffers = 0;
+  stream_.userFormat = 0;
+  stream_.userInterleaved = true;
+  stream_.streamTime = 0.0;
+  stream_.framePosition = 0;
+  stream_.clock.framePosition = 0;
+  stream_.clock.published = false;
+  stream_.apiHandle = 0;
+  stream_.deviceBuffer = 0;
+  stream_.callbackInfo.callback = 0;
+  stream_.callbackInfo.userData = 0;
+  stream_.callbackInfo.isRunning = false;
+  stream_.callbackInfo.deviceDisconnected = false;
+  stream_.ringStatus = 0;
+  stream_.stats.enabled = false;
+  stream_.stats.nDrift = 0;
+  delete stream_.driftCompensation;
+  stream_.driftCompensation = 0;
+  delete stream_.rateConversion;
+  stream_.rateConversion = 0;
+  delete stream_.planar;
+  stream_.planar = 0;
+  stream_.external = false;
+  stream_.pollDescriptor = -1;
+  clearStreamStats();
+  for ( int i=0; i<2; i++ ) {
+    delete stream_.ringBuffer[i];
+    stream_.ringBuffer[i] = 0;
+    stream_.clock.pending[i] = 0;
+    stream_.clock.time[i] = 0;
+    stream_.clock.timestamped[i] = false;
+    stream_.clock.latency[i] = 0;
+    stream_.deviceId[i] = 11111;
+    stream_.doConvertBuffer[i] = false;
+    stream_.deviceInterleaved[i] = true;
+    stream_.doByteSwap[i] = false;
+    stream_.nUserChannels[i] = 0;
+    stream_.nDeviceChannels[i] = 0;
+    stream_.channelOffset[i] = 0;
+    stream_.deviceFormat[i] = 0;
+    stream_.latency[i] = 0;
+    stream_.userBuffer[i] = 0;
+    stream_.convertInfo[i].channels = 0;
+    stream_.convertInfo[i].inJump = 0;
+    stream_.convertInfo[i].outJump = 0;
+    stream_.convertInfo[i].inFormat = 0;
+    stream_.convertInfo[i].outFormat = 0;
+    stream_.convertInfo[i].inOffset.clear();
+    stream_.convertInfo[i].outOffset.clear();
+    stream_.convertInfo[i].convert = 0;
+    stream_.convertInfo[i].kernel = 0;
+    stream_.convertInfo[i].clearOutput = false;
+  }
 }
 
-void RtApiOss :: closeStream()
+unsigned int RtApi :: formatBytes( RtAudioFormat format )
 {
-  if ( stream_.state == STREAM_CLOSED ) {
-    errorText_ = "RtApiOss::closeStream(): no open stream to close!";
-    error( RTAUDIO_WARNING );
-    return;
-  }
+  if ( format == RTAUDIO_SINT16 )
+    return 2;
+  else if ( format == RTAUDIO_SINT32 || format == RTAUDIO_FLOAT32 || format == RTAUDIO_SINT24)
+    return 4;
+  else if ( format == RTAUDIO_FLOAT64 )
+    return 8;
+  else if ( format == RTAUDIO_SINT8 )
+    return 1;
 
-  OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  stream_.callbackInfo.isRunning = false;
-  MUTEX_LOCK( &stream_.mutex );
-  if ( stream_.state == STREAM_STOPPED )
-    pthread_cond_signal( &handle->runnable );
-  MUTEX_UNLOCK( &stream_.mutex );
-  pthread_join( stream_.callbackInfo.thread, NULL );
+  errorText_ = "RtApi::formatBytes: undefined format.";
+  error( RTAUDIO_WARNING );
 
-  if ( stream_.state == STREAM_RUNNING ) {
-    if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX )
-      ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
-    else
-      ioctl( handle->id[1], SNDCTL_DSP_HALT, 0 );
-    stream_.state = STREAM_STOPPED;
-  }
+  return 0;
+}
 
-  if ( handle ) {
-    pthread_cond_destroy( &handle->runnable );
-    if ( handle->id[0] ) close( handle->id[0] );
-    if ( handle->id[1] ) close( handle->id[1] );
-    delete handle;
-    stream_.apiHandle = 0;
+void RtApi :: setConvertInfo( StreamMode mode, unsigned int firstChannel )
+{
+  if ( mode == INPUT ) { // convert device to user buffer
+    stream_.convertInfo[mode].inJump = stream_.nDeviceChannels[1];
+    stream_.convertInfo[mode].outJump = stream_.nUserChannels[1];
+    stream_.convertInfo[mode].inFormat = stream_.deviceFormat[1];
+    stream_.convertInfo[mode].outFormat = stream_.userFormat;
+  }
+  else { // convert user to device buffer
+    stream_.convertInfo[mode].inJump = stream_.nUserChannels[0];
+    stream_.convertInfo[mode].outJump = stream_.nDeviceChannels[0];
+    stream_.convertInfo[mode].inFormat = stream_.userFormat;
+    stream_.convertInfo[mode].outFormat = stream_.deviceFormat[0];
   }
 
-  for ( int i=0; i<2; i++ ) {
-    if ( stream_.userBuffer[i] ) {
-      free( stream_.userBuffer[i] );
-      stream_.userBuffer[i] = 0;
+  if ( stream_.convertInfo[mode].inJump < stream_.convertInfo[mode].outJump )
+    stream_.convertInfo[mode].channels = stream_.convertInfo[mode].inJump;
+  else
+    stream_.convertInfo[mode].channels = stream_.convertInfo[mode].outJump;
+
+  // Set up the interleave/deinterleave offsets.
+  if ( stream_.deviceInterleaved[mode] != stream_.userInterleaved ) {
+    if ( ( mode == OUTPUT && stream_.deviceInterleaved[mode] ) ||
+         ( mode == INPUT && stream_.userInterleaved ) ) {
+      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
+        stream_.convertInfo[mode].inOffset.push_back( k * stream_.bufferSize );
+        stream_.convertInfo[mode].outOffset.push_back( k );
+        stream_.convertInfo[mode].inJump = 1;
+      }
+    }
+    else {
+      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
+        stream_.convertInfo[mode].inOffset.push_back( k );
+        stream_.convertInfo[mode].outOffset.push_back( k * stream_.bufferSize );
+        stream_.convertInfo[mode].outJump = 1;
+      }
+    }
+  }
+  else { // no (de)interleaving
+    if ( stream_.userInterleaved ) {
+      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
+        stream_.convertInfo[mode].inOffset.push_back( k );
+        stream_.convertInfo[mode].outOffset.push_back( k );
+      }
+    }
+    else {
+      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
+        stream_.convertInfo[mode].inOffset.push_back( k * stream_.bufferSize );
+        stream_.convertInfo[mode].outOffset.push_back( k * stream_.bufferSize );
+        stream_.convertInfo[mode].inJump = 1;
+        stream_.convertInfo[mode].outJump = 1;
+      }
     }
   }
 
-  if ( stream_.deviceBuffer ) {
-    free( stream_.deviceBuffer );
-    stream_.deviceBuffer = 0;
+  // Add channel offset.
+  if ( firstChannel > 0 ) {
+    if ( stream_.deviceInterleaved[mode] ) {
+      if ( mode == OUTPUT ) {
+        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
+          stream_.convertInfo[mode].outOffset[k] += firstChannel;
+      }
+      else {
+        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
+          stream_.convertInfo[mode].inOffset[k] += firstChannel;
+      }
+    }
+    else {
+      if ( mode == OUTPUT ) {
+        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
+          stream_.convertInfo[mode].outOffset[k] += ( firstChannel * stream_.bufferSize );
+      }
+      else {
+        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
+          stream_.convertInfo[mode].inOffset[k] += ( firstChannel  * stream_.bufferSize );
+      }
+    }
   }
 
-  clearStreamInfo();
-  //stream_.mode = UNINITIALIZED;
-  //stream_.state = STREAM_CLOSED;
+  setConvertPlan( stream_.convertInfo[mode] );
 }
 
-RtAudioErrorType RtApiOss :: startStream()
-{
-  if ( stream_.state != STREAM_STOPPED ) {
-    if ( stream_.state == STREAM_RUNNING )
-      errorText_ = "RtApiOss::startStream(): the stream is already running!";
-    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
-      errorText_ = "RtApiOss::startStream(): the stream is stopping or closed!";
-    return error( RTAUDIO_WARNING );
-  }
-
-  MUTEX_LOCK( &stream_.mutex );
+// *************************************************** //
+//
+// Vectorized sample conversion kernels.
+//
+// These handle the most common contiguous conversions (FLOAT32 to
+// and from SINT16, SINT24, SINT32 and FLOAT64) used by convertBuffer()
+// when the source and destination samples form unbroken runs.  The
+// scalar conversions in convertSample() remain the reference
+// implementation: the kernels produce identical results, including
+// llround()'s round-half-away-from-zero behavior and clamping.  The
+// differences are that SINT24 output writes a zero pad byte and that
+// values too large for llround() (where its result is unspecified)
+// saturate.
+// Define RTAUDIO_NO_SIMD to disable them.  At runtime, the RTAUDIO_SIMD
+// environment variable limits them to an instruction set ("none",
+// "sse2" or "avx2"), so that each one can be tested on one machine.
+//
+// *************************************************** //
 
-  /*
-  #if defined( HAVE_GETTIMEOFDAY )
-  gettimeofday( &stream_.lastTickTimestamp, NULL );
+#if !defined(RTAUDIO_NO_SIMD)
+  #if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+    #define RTAUDIO_HAVE_SSE2
+    #include <emmintrin.h>
+    #if ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+      // AVX2 kernels are compiled with a target attribute and only
+      // selected at runtime when the CPU supports them.
+      #define RTAUDIO_HAVE_AVX2
+      #include <immintrin.h>
+    #endif
+  #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define RTAUDIO_HAVE_NEON
+    #include <arm_neon.h>
   #endif
-  */
-
-  stream_.state = STREAM_RUNNING;
-
-  // No need to do anything else here ... OSS automatically starts
-  // when fed samples.
+#endif
 
-  MUTEX_UNLOCK( &stream_.mutex );
+typedef void (*ConvertKernel)( void *out, const void *in, size_t samples );
 
-  OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  pthread_cond_signal( &handle->runnable );
-  return RTAUDIO_NO_ERROR;
+// Scalar element conversions, identical to those in convertBuffer().
+static inline short floatToInt16( float x )
+{
+  return (short) std::max(std::min(std::llround(x * 32768.f), 32767LL), -32768LL);
 }
 
-RtAudioErrorType RtApiOss :: stopStream()
+static inline int floatToInt24( float x )
 {
-  if ( stream_.state != STREAM_RUNNING && stream_.state != STREAM_STOPPING ) {
-    if ( stream_.state == STREAM_STOPPED )
-      errorText_ = "RtApiOss::stopStream(): the stream is already stopped!";
-    else if ( stream_.state == STREAM_CLOSED )
-      errorText_ = "RtApiOss::stopStream(): the stream is closed!";
-    return error( RTAUDIO_WARNING );
-  }
+  return (int) std::max(std::min(std::llround(x * 8388608.f), 8388607LL), -8388608LL) & 0x00ffffff;
+}
 
-  MUTEX_LOCK( &stream_.mutex );
+static inline int floatToInt32( float x )
+{
+  return (int) std::max(std::min(std::llround(x * 2147483648.f), 2147483647LL), -2147483648LL);
+}
 
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_UNLOCK( &stream_.mutex );
-    return RTAUDIO_NO_ERROR;
-  }
+static inline float int24ToFloat( int x )
+{
+  // Sign extend the lower three bytes.
+  return (float) ( (int) ( (unsigned int) x << 8 ) >> 8 ) / 8388608.f;
+}
 
-  int result = 0;
-  OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+#if defined(RTAUDIO_HAVE_SSE2)
 
-    // Flush the output with zeros a few times.
-    char *buffer;
-    int samples;
-    RtAudioFormat format;
+// Round half away from zero: truncate, then adjust by one where the
+// discarded fraction is at least one half.  The subtraction is exact.
+static inline __m128i roundSse2( __m128 y )
+{
+  __m128i t = _mm_cvttps_epi32( y );
+  __m128 d = _mm_sub_ps( y, _mm_cvtepi32_ps( t ) );
+  t = _mm_sub_epi32( t, _mm_castps_si128( _mm_cmpge_ps( d, _mm_set1_ps( 0.5f ) ) ) );
+  return _mm_add_epi32( t, _mm_castps_si128( _mm_cmple_ps( d, _mm_set1_ps( -0.5f ) ) ) );
+}
 
-    if ( stream_.doConvertBuffer[0] ) {
-      buffer = stream_.deviceBuffer;
-      samples = stream_.bufferSize * stream_.nDeviceChannels[0];
-      format = stream_.deviceFormat[0];
-    }
-    else {
-      buffer = stream_.userBuffer[0];
-      samples = stream_.bufferSize * stream_.nUserChannels[0];
-      format = stream_.userFormat;
-    }
+// Scale and clamp to [lo, hi].  The operand order lets NaN through to
+// the integer conversion, matching llround() on this platform.
+static inline __m128 scaleClampSse2( __m128 x, float scale, float lo, float hi )
+{
+  __m128 y = _mm_mul_ps( x, _mm_set1_ps( scale ) );
+  return _mm_max_ps( _mm_set1_ps( lo ), _mm_min_ps( _mm_set1_ps( hi ), y ) );
+}
 
-    memset( buffer, 0, samples * formatBytes(format) );
-    for ( unsigned int i=0; i<stream_.nBuffers+1; i++ ) {
-      result = write( handle->id[0], buffer, samples * formatBytes(format) );
-      if ( result == -1 ) {
-        errorText_ = "RtApiOss::stopStream: audio write error.";
-        error( RTAUDIO_WARNING );
-      }
-    }
+static void float32ToInt16Sse2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  short *dst = (short *) out;
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    __m128i a = roundSse2( scaleClampSse2( _mm_loadu_ps( src + i ), 32768.f, -32768.f, 32767.f ) );
+    __m128i b = roundSse2( scaleClampSse2( _mm_loadu_ps( src + i + 4 ), 32768.f, -32768.f, 32767.f ) );
+    _mm_storeu_si128( (__m128i *) ( dst + i ), _mm_packs_epi32( a, b ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt16( src[i] );
+}
 
-    result = ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
-    if ( result == -1 ) {
-      errorStream_ << "RtApiOss::stopStream: system error stopping callback procedure on device (" << stream_.deviceId[0] << ").";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-    handle->triggered = false;
-  }
+static void float32ToInt24Sse2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  int *dst = (int *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    __m128i a = roundSse2( scaleClampSse2( _mm_loadu_ps( src + i ), 8388608.f, -8388608.f, 8388607.f ) );
+    _mm_storeu_si128( (__m128i *) ( dst + i ), _mm_and_si128( a, _mm_set1_epi32( 0x00ffffff ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt24( src[i] );
+}
 
-  if ( stream_.mode == INPUT || ( stream_.mode == DUPLEX && handle->id[0] != handle->id[1] ) ) {
-    result = ioctl( handle->id[1], SNDCTL_DSP_HALT, 0 );
-    if ( result == -1 ) {
-      errorStream_ << "RtApiOss::stopStream: system error stopping input callback procedure on device (" << stream_.deviceId[0] << ").";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-  }
+static void float32ToInt32Sse2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  int *dst = (int *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    __m128 x = _mm_mul_ps( _mm_loadu_ps( src + i ), _mm_set1_ps( 2147483648.f ) );
+    // 2^31 is not representable as an Int32, so clamp to the largest
+    // float below it and saturate those lanes afterwards.
+    __m128i over = _mm_srli_epi32( _mm_castps_si128( _mm_cmpge_ps( x, _mm_set1_ps( 2147483648.f ) ) ), 1 );
+    __m128i a = roundSse2( scaleClampSse2( x, 1.f, -2147483648.f, 2147483520.f ) );
+    _mm_storeu_si128( (__m128i *) ( dst + i ), _mm_or_si128( a, over ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt32( src[i] );
+}
 
- unlock:
-  stream_.state = STREAM_STOPPED;
-  MUTEX_UNLOCK( &stream_.mutex );
+static void int16ToFloat32Sse2( void *out, const void *in, size_t samples )
+{
+  const short *src = (const short *) in;
+  float *dst = (float *) out;
+  const __m128 scale = _mm_set1_ps( 1.f / 32768.f );
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    __m128i s = _mm_loadu_si128( (const __m128i *) ( src + i ) );
+    __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 16 );
+    __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( s, s ), 16 );
+    _mm_storeu_ps( dst + i, _mm_mul_ps( _mm_cvtepi32_ps( lo ), scale ) );
+    _mm_storeu_ps( dst + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( hi ), scale ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i] / 32768.f;
+}
 
-  if ( result != -1 ) return RTAUDIO_NO_ERROR;
-  return error( RTAUDIO_SYSTEM_ERROR );
+static void int24ToFloat32Sse2( void *out, const void *in, size_t samples )
+{
+  const int *src = (const int *) in;
+  float *dst = (float *) out;
+  const __m128 scale = _mm_set1_ps( 1.f / 8388608.f );
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    __m128i s = _mm_loadu_si128( (const __m128i *) ( src + i ) );
+    s = _mm_srai_epi32( _mm_slli_epi32( s, 8 ), 8 );
+    _mm_storeu_ps( dst + i, _mm_mul_ps( _mm_cvtepi32_ps( s ), scale ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = int24ToFloat( src[i] );
 }
 
-RtAudioErrorType RtApiOss :: abortStream()
+static void int32ToFloat32Sse2( void *out, const void *in, size_t samples )
 {
-  if ( stream_.state != STREAM_RUNNING ) {
-    if ( stream_.state == STREAM_STOPPED )
-      errorText_ = "RtApiOss::abortStream(): the stream is already stopped!";
-    else if ( stream_.state == STREAM_STOPPING || stream_.state == STREAM_CLOSED )
-      errorText_ = "RtApiOss::abortStream(): the stream is stopping or closed!";
-    return error( RTAUDIO_WARNING );
-  }
+  const int *src = (const int *) in;
+  float *dst = (float *) out;
+  const __m128 scale = _mm_set1_ps( 1.f / 2147483648.f );
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    __m128i s = _mm_loadu_si128( (const __m128i *) ( src + i ) );
+    _mm_storeu_ps( dst + i, _mm_mul_ps( _mm_cvtepi32_ps( s ), scale ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i] / 2147483648.f;
+}
 
-  MUTEX_LOCK( &stream_.mutex );
+static void float32ToFloat64Sse2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  double *dst = (double *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    __m128 s = _mm_loadu_ps( src + i );
+    _mm_storeu_pd( dst + i, _mm_cvtps_pd( s ) );
+    _mm_storeu_pd( dst + i + 2, _mm_cvtps_pd( _mm_movehl_ps( s, s ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (double) src[i];
+}
 
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_UNLOCK( &stream_.mutex );
-    return RTAUDIO_NO_ERROR;
-  }
+static void float64ToFloat32Sse2( void *out, const void *in, size_t samples )
+{
+  const double *src = (const double *) in;
+  float *dst = (float *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    __m128 lo = _mm_cvtpd_ps( _mm_loadu_pd( src + i ) );
+    __m128 hi = _mm_cvtpd_ps( _mm_loadu_pd( src + i + 2 ) );
+    _mm_storeu_ps( dst + i, _mm_movelh_ps( lo, hi ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i];
+}
 
-  int result = 0;
-  OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
-    result = ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
-    if ( result == -1 ) {
-      errorStream_ << "RtApiOss::abortStream: system error stopping callback procedure on device (" << stream_.deviceId[0] << ").";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-    handle->triggered = false;
-  }
+#endif // RTAUDIO_HAVE_SSE2
 
-  if ( stream_.mode == INPUT || ( stream_.mode == DUPLEX && handle->id[0] != handle->id[1] ) ) {
-    result = ioctl( handle->id[1], SNDCTL_DSP_HALT, 0 );
-    if ( result == -1 ) {
-      errorStream_ << "RtApiOss::abortStream: system error stopping input callback procedure on device (" << stream_.deviceId[0] << ").";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-  }
+#if defined(RTAUDIO_HAVE_AVX2)
 
- unlock:
-  stream_.state = STREAM_STOPPED;
-  MUTEX_UNLOCK( &stream_.mutex );
+#define RTAUDIO_AVX2_TARGET __attribute__((target("avx2")))
 
-  if ( result != -1 ) return RTAUDIO_SYSTEM_ERROR;
-  return error( RTAUDIO_SYSTEM_ERROR );
+RTAUDIO_AVX2_TARGET static inline __m256i roundAvx2( __m256 y )
+{
+  __m256i t = _mm256_cvttps_epi32( y );
+  __m256 d = _mm256_sub_ps( y, _mm256_cvtepi32_ps( t ) );
+  t = _mm256_sub_epi32( t, _mm256_castps_si256( _mm256_cmp_ps( d, _mm256_set1_ps( 0.5f ), _CMP_GE_OQ ) ) );
+  return _mm256_add_epi32( t, _mm256_castps_si256( _mm256_cmp_ps( d, _mm256_set1_ps( -0.5f ), _CMP_LE_OQ ) ) );
 }
 
-void RtApiOss :: callbackEvent()
+RTAUDIO_AVX2_TARGET static inline __m256 scaleClampAvx2( __m256 x, float scale, float lo, float hi )
 {
-  OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_LOCK( &stream_.mutex );
-    pthread_cond_wait( &handle->runnable, &stream_.mutex );
-    if ( stream_.state != STREAM_RUNNING ) {
-      MUTEX_UNLOCK( &stream_.mutex );
-      return;
-    }
-    MUTEX_UNLOCK( &stream_.mutex );
-  }
+  __m256 y = _mm256_mul_ps( x, _mm256_set1_ps( scale ) );
+  return _mm256_max_ps( _mm256_set1_ps( lo ), _mm256_min_ps( _mm256_set1_ps( hi ), y ) );
+}
 
-  if ( stream_.state == STREAM_CLOSED ) {
-    errorText_ = "RtApiOss::callbackEvent(): the stream is closed ... this shouldn't happen!";
-    error( RTAUDIO_WARNING );
-    return;
-  }
+RTAUDIO_AVX2_TARGET static void float32ToInt16Avx2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  short *dst = (short *) out;
+  size_t i = 0;
+  for ( ; i + 16 <= samples; i += 16 ) {
+    __m256i a = roundAvx2( scaleClampAvx2( _mm256_loadu_ps( src + i ), 32768.f, -32768.f, 32767.f ) );
+    __m256i b = roundAvx2( scaleClampAvx2( _mm256_loadu_ps( src + i + 8 ), 32768.f, -32768.f, 32767.f ) );
+    // The pack works per 128-bit lane, so restore the sample order.
+    __m256i p = _mm256_permute4x64_epi64( _mm256_packs_epi32( a, b ), 0xd8 );
+    _mm256_storeu_si256( (__m256i *) ( dst + i ), p );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt16( src[i] );
+}
 
-  // Invoke user callback to get fresh output data.
-  int doStopStream = 0;
-  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
-  double streamTime = getStreamTime();
-  RtAudioStreamStatus status = 0;
-  if ( stream_.mode != INPUT && handle->xrun[0] == true ) {
-    status |= RTAUDIO_OUTPUT_UNDERFLOW;
-    handle->xrun[0] = false;
-  }
-  if ( stream_.mode != OUTPUT && handle->xrun[1] == true ) {
-    status |= RTAUDIO_INPUT_OVERFLOW;
-    handle->xrun[1] = false;
-  }
-  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                           stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
-  if ( doStopStream == 2 ) {
-    this->abortStream();
-    return;
-  }
+RTAUDIO_AVX2_TARGET static void float32ToInt24Avx2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  int *dst = (int *) out;
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    __m256i a = roundAvx2( scaleClampAvx2( _mm256_loadu_ps( src + i ), 8388608.f, -8388608.f, 8388607.f ) );
+    _mm256_storeu_si256( (__m256i *) ( dst + i ), _mm256_and_si256( a, _mm256_set1_epi32( 0x00ffffff ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt24( src[i] );
+}
 
-  MUTEX_LOCK( &stream_.mutex );
+RTAUDIO_AVX2_TARGET static void float32ToInt32Avx2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  int *dst = (int *) out;
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    __m256 x = _mm256_mul_ps( _mm256_loadu_ps( src + i ), _mm256_set1_ps( 2147483648.f ) );
+    __m256i over = _mm256_srli_epi32( _mm256_castps_si256( _mm256_cmp_ps( x, _mm256_set1_ps( 2147483648.f ), _CMP_GE_OQ ) ), 1 );
+    __m256i a = roundAvx2( scaleClampAvx2( x, 1.f, -2147483648.f, 2147483520.f ) );
+    _mm256_storeu_si256( (__m256i *) ( dst + i ), _mm256_or_si256( a, over ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt32( src[i] );
+}
 
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) goto unlock;
+RTAUDIO_AVX2_TARGET static void int16ToFloat32Avx2( void *out, const void *in, size_t samples )
+{
+  const short *src = (const short *) in;
+  float *dst = (float *) out;
+  const __m256 scale = _mm256_set1_ps( 1.f / 32768.f );
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    __m256i s = _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *) ( src + i ) ) );
+    _mm256_storeu_ps( dst + i, _mm256_mul_ps( _mm256_cvtepi32_ps( s ), scale ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i] / 32768.f;
+}
 
-  int result;
-  char *buffer;
-  int samples;
-  RtAudioFormat format;
+RTAUDIO_AVX2_TARGET static void int24ToFloat32Avx2( void *out, const void *in, size_t samples )
+{
+  const int *src = (const int *) in;
+  float *dst = (float *) out;
+  const __m256 scale = _mm256_set1_ps( 1.f / 8388608.f );
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    __m256i s = _mm256_loadu_si256( (const __m256i *) ( src + i ) );
+    s = _mm256_srai_epi32( _mm256_slli_epi32( s, 8 ), 8 );
+    _mm256_storeu_ps( dst + i, _mm256_mul_ps( _mm256_cvtepi32_ps( s ), scale ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = int24ToFloat( src[i] );
+}
 
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+RTAUDIO_AVX2_TARGET static void int32ToFloat32Avx2( void *out, const void *in, size_t samples )
+{
+  const int *src = (const int *) in;
+  float *dst = (float *) out;
+  const __m256 scale = _mm256_set1_ps( 1.f / 2147483648.f );
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    __m256i s = _mm256_loadu_si256( (const __m256i *) ( src + i ) );
+    _mm256_storeu_ps( dst + i, _mm256_mul_ps( _mm256_cvtepi32_ps( s ), scale ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i] / 2147483648.f;
+}
 
-    // Setup parameters and do buffer conversion if necessary.
-    if ( stream_.doConvertBuffer[0] ) {
-      buffer = stream_.deviceBuffer;
-      convertBuffer( buffer, stream_.userBuffer[0], stream_.convertInfo[0] );
-      samples = stream_.bufferSize * stream_.nDeviceChannels[0];
-      format = stream_.deviceFormat[0];
-    }
-    else {
-      buffer = stream_.userBuffer[0];
-      samples = stream_.bufferSize * stream_.nUserChannels[0];
-      format = stream_.userFormat;
-    }
+RTAUDIO_AVX2_TARGET static void float32ToFloat64Avx2( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  double *dst = (double *) out;
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    _mm256_storeu_pd( dst + i, _mm256_cvtps_pd( _mm_loadu_ps( src + i ) ) );
+    _mm256_storeu_pd( dst + i + 4, _mm256_cvtps_pd( _mm_loadu_ps( src + i + 4 ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (double) src[i];
+}
 
-    // Do byte swapping if necessary.
-    if ( stream_.doByteSwap[0] )
-      byteSwapBuffer( buffer, samples, format );
+RTAUDIO_AVX2_TARGET static void float64ToFloat32Avx2( void *out, const void *in, size_t samples )
+{
+  const double *src = (const double *) in;
+  float *dst = (float *) out;
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    _mm_storeu_ps( dst + i, _mm256_cvtpd_ps( _mm256_loadu_pd( src + i ) ) );
+    _mm_storeu_ps( dst + i + 4, _mm256_cvtpd_ps( _mm256_loadu_pd( src + i + 4 ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i];
+}
 
-    if ( stream_.mode == DUPLEX && handle->triggered == false ) {
-      int trig = 0;
-      ioctl( handle->id[0], SNDCTL_DSP_SETTRIGGER, &trig );
-      result = write( handle->id[0], buffer, samples * formatBytes(format) );
-      trig = PCM_ENABLE_INPUT|PCM_ENABLE_OUTPUT;
-      ioctl( handle->id[0], SNDCTL_DSP_SETTRIGGER, &trig );
-      handle->triggered = true;
-    }
-    else
-      // Write samples to device.
-      result = write( handle->id[0], buffer, samples * formatBytes(format) );
+#endif // RTAUDIO_HAVE_AVX2
 
-    if ( result == -1 ) {
-      // We'll assume this is an underrun, though there isn't a
-      // specific means for determining that.
-      handle->xrun[0] = true;
-      errorText_ = "RtApiOss::callbackEvent: audio write error.";
-      error( RTAUDIO_WARNING );
-      // Continue on to input section.
-    }
-  }
+#if defined(RTAUDIO_HAVE_NEON)
 
-  if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+static inline int32x4_t roundNeon( float32x4_t y )
+{
+  int32x4_t t = vcvtq_s32_f32( y );
+  float32x4_t d = vsubq_f32( y, vcvtq_f32_s32( t ) );
+  t = vsubq_s32( t, vreinterpretq_s32_u32( vcgeq_f32( d, vdupq_n_f32( 0.5f ) ) ) );
+  return vaddq_s32( t, vreinterpretq_s32_u32( vcleq_f32( d, vdupq_n_f32( -0.5f ) ) ) );
+}
 
-    // Setup parameters.
-    if ( stream_.doConvertBuffer[1] ) {
-      buffer = stream_.deviceBuffer;
-      samples = stream_.bufferSize * stream_.nDeviceChannels[1];
-      format = stream_.deviceFormat[1];
-    }
-    else {
-      buffer = stream_.userBuffer[1];
-      samples = stream_.bufferSize * stream_.nUserChannels[1];
-      format = stream_.userFormat;
-    }
+static inline float32x4_t scaleClampNeon( float32x4_t x, float scale, float lo, float hi )
+{
+  float32x4_t y = vmulq_n_f32( x, scale );
+  return vmaxq_f32( vdupq_n_f32( lo ), vminq_f32( vdupq_n_f32( hi ), y ) );
+}
 
-    // Read samples from device.
-    result = read( handle->id[1], buffer, samples * formatBytes(format) );
+static void float32ToInt16Neon( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  short *dst = (short *) out;
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    int32x4_t a = roundNeon( scaleClampNeon( vld1q_f32( src + i ), 32768.f, -32768.f, 32767.f ) );
+    int32x4_t b = roundNeon( scaleClampNeon( vld1q_f32( src + i + 4 ), 32768.f, -32768.f, 32767.f ) );
+    vst1q_s16( dst + i, vcombine_s16( vqmovn_s32( a ), vqmovn_s32( b ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt16( src[i] );
+}
 
-    if ( result == -1 ) {
-      // We'll assume this is an overrun, though there isn't a
-      // specific means for determining that.
-      handle->xrun[1] = true;
-      errorText_ = "RtApiOss::callbackEvent: audio read error.";
-      error( RTAUDIO_WARNING );
-      goto unlock;
-    }
+static void float32ToInt24Neon( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  int *dst = (int *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    int32x4_t a = roundNeon( scaleClampNeon( vld1q_f32( src + i ), 8388608.f, -8388608.f, 8388607.f ) );
+    vst1q_s32( dst + i, vandq_s32( a, vdupq_n_s32( 0x00ffffff ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt24( src[i] );
+}
 
-    // Do byte swapping if necessary.
-    if ( stream_.doByteSwap[1] )
-      byteSwapBuffer( buffer, samples, format );
+static void float32ToInt32Neon( void *out, const void *in, size_t samples )
+{
+  const float *src = (const float *) in;
+  int *dst = (int *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    float32x4_t x = vmulq_n_f32( vld1q_f32( src + i ), 2147483648.f );
+    int32x4_t over = vreinterpretq_s32_u32( vshrq_n_u32( vcgeq_f32( x, vdupq_n_f32( 2147483648.f ) ), 1 ) );
+    int32x4_t a = roundNeon( scaleClampNeon( x, 1.f, -2147483648.f, 2147483520.f ) );
+    vst1q_s32( dst + i, vorrq_s32( a, over ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = floatToInt32( src[i] );
+}
 
-    // Do buffer conversion if necessary.
-    if ( stream_.doConvertBuffer[1] )
-      convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
-  }
+static void int16ToFloat32Neon( void *out, const void *in, size_t samples )
+{
+  const short *src = (const short *) in;
+  float *dst = (float *) out;
+  size_t i = 0;
+  for ( ; i + 8 <= samples; i += 8 ) {
+    int16x8_t s = vld1q_s16( src + i );
+    vst1q_f32( dst + i, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_low_s16( s ) ) ), 1.f / 32768.f ) );
+    vst1q_f32( dst + i + 4, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_high_s16( s ) ) ), 1.f / 32768.f ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i] / 32768.f;
+}
 
- unlock:
-  MUTEX_UNLOCK( &stream_.mutex );
+static void int24ToFloat32Neon( void *out, const void *in, size_t samples )
+{
+  const int *src = (const int *) in;
+  float *dst = (float *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    int32x4_t s = vshrq_n_s32( vshlq_n_s32( vld1q_s32( src + i ), 8 ), 8 );
+    vst1q_f32( dst + i, vmulq_n_f32( vcvtq_f32_s32( s ), 1.f / 8388608.f ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = int24ToFloat( src[i] );
+}
 
-  RtApi::tickStreamTime();
-  if ( doStopStream == 1 ) this->stopStream();
+static void int32ToFloat32Neon( void *out, const void *in, size_t samples )
+{
+  const int *src = (const int *) in;
+  float *dst = (float *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 )
+    vst1q_f32( dst + i, vmulq_n_f32( vcvtq_f32_s32( vld1q_s32( src + i ) ), 1.f / 2147483648.f ) );
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i] / 2147483648.f;
 }
 
-static void *ossCallbackHandler( void *ptr )
+#if defined(__aarch64__)
+// Double precision vector conversions are only available on AArch64.
+static void float32ToFloat64Neon( void *out, const void *in, size_t samples )
 {
-  CallbackInfo *info = (CallbackInfo *) ptr;
-  RtApiOss *object = (RtApiOss *) info->object;
-  bool *isRunning = &info->isRunning;
+  const float *src = (const float *) in;
+  double *dst = (double *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    float32x4_t s = vld1q_f32( src + i );
+    vst1q_f64( dst + i, vcvt_f64_f32( vget_low_f32( s ) ) );
+    vst1q_f64( dst + i + 2, vcvt_high_f64_f32( s ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (double) src[i];
+}
 
-#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
-  if (info->doRealtime) {
-    std::cerr << "RtAudio oss: " << 
-             (sched_getscheduler(0) == SCHED_RR ? "" : "_NOT_ ") << 
-             "running realtime scheduling" << std::endl;
-  }
+static void float64ToFloat32Neon( void *out, const void *in, size_t samples )
+{
+  const double *src = (const double *) in;
+  float *dst = (float *) out;
+  size_t i = 0;
+  for ( ; i + 4 <= samples; i += 4 ) {
+    float32x2_t lo = vcvt_f32_f64( vld1q_f64( src + i ) );
+    vst1q_f32( dst + i, vcvt_high_f32_f64( lo, vld1q_f64( src + i + 2 ) ) );
+  }
+  for ( ; i < samples; i++ ) dst[i] = (float) src[i];
+}
 #endif
 
-  while ( *isRunning == true ) {
-    pthread_testcancel();
-    object->callbackEvent();
-  }
+#endif // RTAUDIO_HAVE_NEON
 
-  pthread_exit( NULL );
-}
+// The set of kernels usable on this machine, chosen once at runtime.
+struct ConvertKernels {
+  ConvertKernel float32ToInt16, float32ToInt24, float32ToInt32, float32ToFloat64;
+  ConvertKernel int16ToFloat32, int24ToFloat32, int32ToFloat32, float64ToFloat32;
+};
 
-//******************** End of __LINUX_OSS__ *********************//
+static ConvertKernels detectConvertKernels( void )
+{
+  ConvertKernels k = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  const char *limit = getenv( "RTAUDIO_SIMD" );
+  std::string simd = limit ? limit : "";
+  if ( simd == "none" ) return k;
+#if defined(RTAUDIO_HAVE_AVX2)
+  if ( simd != "sse2" && __builtin_cpu_supports( "avx2" ) ) {
+    k.float32ToInt16 = float32ToInt16Avx2;
+    k.float32ToInt24 = float32ToInt24Avx2;
+    k.float32ToInt32 = float32ToInt32Avx2;
+    k.float32ToFloat64 = float32ToFloat64Avx2;
+    k.int16ToFloat32 = int16ToFloat32Avx2;
+    k.int24ToFloat32 = int24ToFloat32Avx2;
+    k.int32ToFloat32 = int32ToFloat32Avx2;
+    k.float64ToFloat32 = float64ToFloat32Avx2;
+    return k;
+  }
+#endif
+#if defined(RTAUDIO_HAVE_SSE2)
+  k.float32ToInt16 = float32ToInt16Sse2;
+  k.float32ToInt24 = float32ToInt24Sse2;
+  k.float32ToInt32 = float32ToInt32Sse2;
+  k.float32ToFloat64 = float32ToFloat64Sse2;
+  k.int16ToFloat32 = int16ToFloat32Sse2;
+  k.int24ToFloat32 = int24ToFloat32Sse2;
+  k.int32ToFloat32 = int32ToFloat32Sse2;
+  k.float64ToFloat32 = float64ToFloat32Sse2;
+#elif defined(RTAUDIO_HAVE_NEON)
+  k.float32ToInt16 = float32ToInt16Neon;
+  k.float32ToInt24 = float32ToInt24Neon;
+  k.float32ToInt32 = float32ToInt32Neon;
+  k.int16ToFloat32 = int16ToFloat32Neon;
+  k.int24ToFloat32 = int24ToFloat32Neon;
+  k.int32ToFloat32 = int32ToFloat32Neon;
+#if defined(__aarch64__)
+  k.float32ToFloat64 = float32ToFloat64Neon;
+  k.float64ToFloat32 = float64ToFloat32Neon;
 #endif
+#endif
+  return k;
+}
+
+// Returns a vectorized kernel for the given conversion, or NULL if
+// there is none and the scalar code should be used.
+static ConvertKernel findConvertKernel( RtAudioFormat outFormat, RtAudioFormat inFormat )
+{
+  static const ConvertKernels kernels = detectConvertKernels();
 
+  if ( inFormat == RTAUDIO_FLOAT32 ) {
+    if ( outFormat == RTAUDIO_SINT16 ) return kernels.float32ToInt16;
+    if ( outFormat == RTAUDIO_SINT24 ) return kernels.float32ToInt24;
+    if ( outFormat == RTAUDIO_SINT32 ) return kernels.float32ToInt32;
+    if ( outFormat == RTAUDIO_FLOAT64 ) return kernels.float32ToFloat64;
+  }
+  else if ( outFormat == RTAUDIO_FLOAT32 ) {
+    if ( inFormat == RTAUDIO_SINT16 ) return kernels.int16ToFloat32;
+    if ( inFormat == RTAUDIO_SINT24 ) return kernels.int24ToFloat32;
+    if ( inFormat == RTAUDIO_SINT32 ) return kernels.int32ToFloat32;
+    if ( inFormat == RTAUDIO_FLOAT64 ) return kernels.float64ToFloat32;
+  }
+  return 0;
+}
 
 // *************************************************** //
 //
-// Protected common (OS-independent) RtAudio methods.
+// Scalar sample conversions and conversion plans.
+//
+// convertSample() defines every format conversion supported by
+// convertBuffer() and is the reference for the vectorized kernels.
+// 24-bit integers are assumed to occupy the lower three bytes of a
+// 32-bit integer.  setConvertInfo() selects a plan once at open time,
+// specialized on the sample types and on the buffer layout, so that
+// convertBuffer() does no format or layout tests per period.
 //
 // *************************************************** //
 
-// This method can be modified to control the behavior of error
-// message printing.
-RtAudioErrorType RtApi :: error( RtAudioErrorType type )
+static inline void convertSample( double &out, signed char in ) { out = (double) in / 128.0; }
+static inline void convertSample( double &out, short in ) { out = (double) in / 32768.0; }
+static inline void convertSample( double &out, S24 in ) { out = (double) in.asInt() / 8388608.0; }
+static inline void convertSample( double &out, int in ) { out = (double) in / 2147483648.0; }
+static inline void convertSample( double &out, float in ) { out = (double) in; }
+static inline void convertSample( double &out, double in ) { out = in; }
+
+static inline void convertSample( float &out, signed char in ) { out = (float) in / 128.f; }
+static inline void convertSample( float &out, short in ) { out = (float) in / 32768.f; }
+static inline void convertSample( float &out, S24 in ) { out = (float) in.asInt() / 8388608.f; }
+static inline void convertSample( float &out, int in ) { out = (float) in / 2147483648.f; }
+static inline void convertSample( float &out, float in ) { out = in; }
+static inline void convertSample( float &out, double in ) { out = (float) in; }
+
+static inline void convertSample( int &out, signed char in ) { out = (int) in; out <<= 24; }
+static inline void convertSample( int &out, short in ) { out = (int) in; out <<= 16; }
+static inline void convertSample( int &out, S24 in ) { out = (int) in.asInt(); out <<= 8; }
+static inline void convertSample( int &out, int in ) { out = in; }
+static inline void convertSample( int &out, float in )
 {
-  errorStream_.str(""); // clear the ostringstream to avoid repeated messages
+  // Use llround() which returns `long long` which is guaranteed to be at least 64 bits.
+  out = (int) std::max(std::min(std::llround(in * 2147483648.f), 2147483647LL), -2147483648LL);
+}
+static inline void convertSample( int &out, double in )
+{
+  out = (int) std::max(std::min(std::llround(in * 2147483648.0), 2147483647LL), -2147483648LL);
+}
 
-  // Don't output warnings if showWarnings_ is false
-  if ( type == RTAUDIO_WARNING && showWarnings_ == false ) return type;
-  
-  if ( errorCallback_ ) {
-    //const std::string errorMessage = errorText_;
-    //errorCallback_( type, errorMessage );
-    errorCallback_( type, errorText_ );
-  }
-  else
-    std::cerr << '\n' << errorText_ << "\n\n";
-  return type;
+static inline void convertSample( S24 &out, signed char in ) { out = (int) (in << 16); }
+static inline void convertSample( S24 &out, short in ) { out = (int) (in << 8); }
+static inline void convertSample( S24 &out, S24 in ) { out = in; }
+static inline void convertSample( S24 &out, int in ) { out = (int) (in >> 8); }
+static inline void convertSample( S24 &out, float in )
+{
+  out = (int) std::max(std::min(std::llround(in * 8388608.f), 8388607LL), -8388608LL);
+}
+static inline void convertSample( S24 &out, double in )
+{
+  out = (int) std::max(std::min(std::llround(in * 8388608.0), 8388607LL), -8388608LL);
+}
+
+static inline void convertSample( short &out, signed char in ) { out = (short) in; out <<= 8; }
+static inline void convertSample( short &out, short in ) { out = in; }
+static inline void convertSample( short &out, S24 in ) { out = (short) (in.asInt() >> 8); }
+static inline void convertSample( short &out, int in ) { out = (short) ((in >> 16) & 0x0000ffff); }
+static inline void convertSample( short &out, float in )
+{
+  out = (short) std::max(std::min(std::llround(in * 32768.f), 32767LL), -32768LL);
+}
+static inline void convertSample( short &out, double in )
+{
+  out = (short) std::max(std::min(std::llround(in * 32768.0), 32767LL), -32768LL);
 }
 
-/*
-void RtApi :: verifyStream()
+static inline void convertSample( signed char &out, signed char in ) { out = in; }
+static inline void convertSample( signed char &out, short in ) { out = (signed char) ((in >> 8) & 0x00ff); }
+static inline void convertSample( signed char &out, S24 in ) { out = (signed char) (in.asInt() >> 16); }
+static inline void convertSample( signed char &out, int in ) { out = (signed char) ((in >> 24) & 0x000000ff); }
+static inline void convertSample( signed char &out, float in )
 {
-  if ( stream_.state == STREAM_CLOSED ) {
-    errorText_ = "RtApi:: a stream is not open!";
-    error( RtAudioError::INVALID_USE );
-  }
+  out = (signed char) std::max(std::min(std::llround(in * 128.f), 127LL), -128LL);
+}
+static inline void convertSample( signed char &out, double in )
+{
+  out = (signed char) std::max(std::min(std::llround(in * 128.0), 127LL), -128LL);
 }
-*/
 
-void RtApi :: clearStreamInfo()
+// General case: channel compensation and/or (de)interleaving, with the
+// channel loop unrolled for common channel counts (CHANNELS > 0).
+template <typename OutType, typename InType, int CHANNELS>
+void RtApi :: convertFrames( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames )
 {
-  stream_.mode = UNINITIALIZED;
-  stream_.state = STREAM_CLOSED;
-  stream_.sampleRate = 0;
-  stream_.bufferSize = 0;
-  stream_.nBuffers = 0;
-  stream_.userFormat = 0;
-  stream_.userInterleaved = true;
-  stream_.streamTime = 0.0;
-  stream_.apiHandle = 0;
-  stream_.deviceBuffer = 0;
-  stream_.callbackInfo.callback = 0;
-  stream_.callbackInfo.userData = 0;
-  stream_.callbackInfo.isRunning = false;
-  stream_.callbackInfo.deviceDisconnected = false;
-  for ( int i=0; i<2; i++ ) {
-    stream_.deviceId[i] = 11111;
-    stream_.doConvertBuffer[i] = false;
-    stream_.deviceInterleaved[i] = true;
-    stream_.doByteSwap[i] = false;
-    stream_.nUserChannels[i] = 0;
-    stream_.nDeviceChannels[i] = 0;
-    stream_.channelOffset[i] = 0;
-    stream_.deviceFormat[i] = 0;
-    stream_.latency[i] = 0;
-    stream_.userBuffer[i] = 0;
-    stream_.convertInfo[i].channels = 0;
-    stream_.convertInfo[i].inJump = 0;
-    stream_.convertInfo[i].outJump = 0;
-    stream_.convertInfo[i].inFormat = 0;
-    stream_.convertInfo[i].outFormat = 0;
-    stream_.convertInfo[i].inOffset.clear();
-    stream_.convertInfo[i].outOffset.clear();
+  OutType *out = (OutType *) outBuffer;
+  InType *in = (InType *) inBuffer;
+  const int channels = ( CHANNELS > 0 ) ? CHANNELS : info.channels;
+  const int *inOffset = info.inOffset.data();
+  const int *outOffset = info.outOffset.data();
+  for ( unsigned int i=0; i<frames; i++ ) {
+    for ( int j=0; j<channels; j++ )
+      convertSample( out[outOffset[j]], in[inOffset[j]] );
+    in += info.inJump;
+    out += info.outJump;
   }
 }
 
-unsigned int RtApi :: formatBytes( RtAudioFormat format )
+// Non-interleaved buffers: each channel is a contiguous run of samples.
+template <typename OutType, typename InType>
+void RtApi :: convertChannels( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames )
 {
-  if ( format == RTAUDIO_SINT16 )
-    return 2;
-  else if ( format == RTAUDIO_SINT32 || format == RTAUDIO_FLOAT32 || format == RTAUDIO_SINT24)
-    return 4;
-  else if ( format == RTAUDIO_FLOAT64 )
-    return 8;
-  else if ( format == RTAUDIO_SINT8 )
-    return 1;
+  for ( int j=0; j<info.channels; j++ ) {
+    OutType *out = (OutType *) outBuffer + info.outOffset[j];
+    InType *in = (InType *) inBuffer + info.inOffset[j];
+    for ( unsigned int i=0; i<frames; i++ )
+      convertSample( out[i], in[i] );
+  }
+}
 
-  errorText_ = "RtApi::formatBytes: undefined format.";
-  error( RTAUDIO_WARNING );
+// Interleaved buffers with identical layouts: a single run of samples.
+template <typename OutType, typename InType>
+void RtApi :: convertSamples( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames )
+{
+  OutType *out = (OutType *) outBuffer;
+  InType *in = (InType *) inBuffer;
+  size_t samples = (size_t) frames * info.channels;
+  for ( size_t i=0; i<samples; i++ )
+    convertSample( out[i], in[i] );
+}
 
-  return 0;
+void RtApi :: convertWithKernel( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames )
+{
+  info.kernel( outBuffer, inBuffer, (size_t) frames * info.channels );
 }
 
-void RtApi :: setConvertInfo( StreamMode mode, unsigned int firstChannel )
+template <typename OutType, typename InType>
+void RtApi :: convertChannelsWithKernel( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames )
 {
-  if ( mode == INPUT ) { // convert device to user buffer
-    stream_.convertInfo[mode].inJump = stream_.nDeviceChannels[1];
-    stream_.convertInfo[mode].outJump = stream_.nUserChannels[1];
-    stream_.convertInfo[mode].inFormat = stream_.deviceFormat[1];
-    stream_.convertInfo[mode].outFormat = stream_.userFormat;
-  }
-  else { // convert user to device buffer
-    stream_.convertInfo[mode].inJump = stream_.nUserChannels[0];
-    stream_.convertInfo[mode].outJump = stream_.nDeviceChannels[0];
-    stream_.convertInfo[mode].inFormat = stream_.userFormat;
-    stream_.convertInfo[mode].outFormat = stream_.deviceFormat[0];
-  }
+  for ( int j=0; j<info.channels; j++ )
+    info.kernel( (OutType *) outBuffer + info.outOffset[j], (InType *) inBuffer + info.inOffset[j], frames );
+}
 
-  if ( stream_.convertInfo[mode].inJump < stream_.convertInfo[mode].outJump )
-    stream_.convertInfo[mode].channels = stream_.convertInfo[mode].inJump;
-  else
-    stream_.convertInfo[mode].channels = stream_.convertInfo[mode].outJump;
+template <typename OutType, typename InType>
+RtApi::ConvertFunction RtApi :: findConvertPlan( const ConvertInfo &info )
+{
+  bool contiguous = ( info.inJump == info.channels && info.outJump == info.channels );
+  for ( int j=0; contiguous && j<info.channels; j++ )
+    contiguous = ( info.inOffset[j] == j && info.outOffset[j] == j );
+
+  if ( contiguous )
+    return info.kernel ? convertWithKernel : convertSamples<OutType, InType>;
+  if ( info.inJump == 1 && info.outJump == 1 )
+    return info.kernel ? convertChannelsWithKernel<OutType, InType> : convertChannels<OutType, InType>;
+  if ( info.channels == 1 )
+    return convertFrames<OutType, InType, 1>;
+  if ( info.channels == 2 )
+    return convertFrames<OutType, InType, 2>;
+  return convertFrames<OutType, InType, 0>;
+}
 
-  // Set up the interleave/deinterleave offsets.
-  if ( stream_.deviceInterleaved[mode] != stream_.userInterleaved ) {
-    if ( ( mode == OUTPUT && stream_.deviceInterleaved[mode] ) ||
-         ( mode == INPUT && stream_.userInterleaved ) ) {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].outOffset.push_back( k );
-        stream_.convertInfo[mode].inJump = 1;
-      }
-    }
-    else {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k );
-        stream_.convertInfo[mode].outOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].outJump = 1;
-      }
-    }
-  }
-  else { // no (de)interleaving
-    if ( stream_.userInterleaved ) {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k );
-        stream_.convertInfo[mode].outOffset.push_back( k );
-      }
-    }
-    else {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].outOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].inJump = 1;
-        stream_.convertInfo[mode].outJump = 1;
-      }
-    }
+template <typename OutType>
+RtApi::ConvertFunction RtApi :: findConvertPlan( const ConvertInfo &info )
+{
+  switch ( info.inFormat ) {
+  case RTAUDIO_SINT8: return findConvertPlan<OutType, signed char>( info );
+  case RTAUDIO_SINT16: return findConvertPlan<OutType, Int16>( info );
+  case RTAUDIO_SINT24: return findConvertPlan<OutType, Int24>( info );
+  case RTAUDIO_SINT32: return findConvertPlan<OutType, Int32>( info );
+  case RTAUDIO_FLOAT32: return findConvertPlan<OutType, Float32>( info );
+  case RTAUDIO_FLOAT64: return findConvertPlan<OutType, Float64>( info );
   }
+  return 0;
+}
 
-  // Add channel offset.
-  if ( firstChannel > 0 ) {
-    if ( stream_.deviceInterleaved[mode] ) {
-      if ( mode == OUTPUT ) {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].outOffset[k] += firstChannel;
-      }
-      else {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].inOffset[k] += firstChannel;
-      }
-    }
-    else {
-      if ( mode == OUTPUT ) {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].outOffset[k] += ( firstChannel * stream_.bufferSize );
-      }
-      else {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].inOffset[k] += ( firstChannel  * stream_.bufferSize );
-      }
-    }
+void RtApi :: setConvertPlan( ConvertInfo &info )
+{
+  info.kernel = findConvertKernel( info.outFormat, info.inFormat );
+
+  switch ( info.outFormat ) {
+  case RTAUDIO_SINT8: info.convert = findConvertPlan<signed char>( info ); break;
+  case RTAUDIO_SINT16: info.convert = findConvertPlan<Int16>( info ); break;
+  case RTAUDIO_SINT24: info.convert = findConvertPlan<Int24>( info ); break;
+  case RTAUDIO_SINT32: info.convert = findConvertPlan<Int32>( info ); break;
+  case RTAUDIO_FLOAT32: info.convert = findConvertPlan<Float32>( info ); break;
+  case RTAUDIO_FLOAT64: info.convert = findConvertPlan<Float64>( info ); break;
+  default: info.convert = 0;
   }
 }
 
 void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info )
 {
   // This function does format conversion, input/output channel compensation, and
-  // data interleaving/deinterleaving.  24-bit integers are assumed to occupy
-  // the lower three bytes of a 32-bit integer.
+  // data interleaving/deinterleaving, using the plan selected by setConvertInfo().
+
+  long long start = stream_.stats.enabled ? monotonicNanos() : 0;
 
   // Clear our duplex device output buffer if there are more device outputs than user outputs
-  if ( outBuffer == stream_.deviceBuffer && stream_.mode == DUPLEX && info.outJump > info.inJump )
+  if ( info.clearOutput && outBuffer == stream_.deviceBuffer )
     memset( outBuffer, 0, stream_.bufferSize * info.outJump * formatBytes( info.outFormat ) );
 
-  int j;
-  if (info.outFormat == RTAUDIO_FLOAT64) {
-    Float64 *out = (Float64 *)outBuffer;
-
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]] / 128.0;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]] / 32768.0;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]].asInt() / 8388608.0;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]] / 2147483648.0;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      // Channel compensation and/or (de)interleaving only.
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-  }
-  else if (info.outFormat == RTAUDIO_FLOAT32) {
-    Float32 *out = (Float32 *)outBuffer;
+  info.convert( outBuffer, inBuffer, info, stream_.bufferSize );
 
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]] / 128.f;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]] / 32768.f;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]].asInt() / 8388608.f;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]] / 2147483648.f;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      // Channel compensation and/or (de)interleaving only.
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-  }
-  else if (info.outFormat == RTAUDIO_SINT32) {
-    Int32 *out = (Int32 *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 24;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 16;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]].asInt();
-          out[info.outOffset[j]] <<= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      // Channel compensation and/or (de)interleaving only.
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          // Use llround() which returns `long long` which is guaranteed to be at least 64 bits.
-          out[info.outOffset[j]] = (Int32) std::max(std::min(std::llround(in[info.inOffset[j]] * 2147483648.f), 2147483647LL), -2147483648LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) std::max(std::min(std::llround(in[info.inOffset[j]] * 2147483648.0), 2147483647LL), -2147483648LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-  }
-  else if (info.outFormat == RTAUDIO_SINT24) {
-    Int24 *out = (Int24 *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] << 16);
-          //out[info.outOffset[j]] <<= 16;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] << 8);
-          //out[info.outOffset[j]] <<= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      // Channel compensation and/or (de)interleaving only.
-      Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] >> 8);
-          //out[info.outOffset[j]] >>= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) std::max(std::min(std::llround(in[info.inOffset[j]] * 8388608.f), 8388607LL), -8388608LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) std::max(std::min(std::llround(in[info.inOffset[j]] * 8388608.0), 8388607LL), -8388608LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-  }
-  else if (info.outFormat == RTAUDIO_SINT16) {
-    Int16 *out = (Int16 *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      // Channel compensation and/or (de)interleaving only.
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]].asInt() >> 8);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) ((in[info.inOffset[j]] >> 16) & 0x0000ffff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) std::max(std::min(std::llround(in[info.inOffset[j]] * 32768.f), 32767LL), -32768LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) std::max(std::min(std::llround(in[info.inOffset[j]] * 32768.0), 32767LL), -32768LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-  }
-  else if (info.outFormat == RTAUDIO_SINT8) {
-    signed char *out = (signed char *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      // Channel compensation and/or (de)interleaving only.
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 8) & 0x00ff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]].asInt() >> 16);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 24) & 0x000000ff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) std::max(std::min(std::llround(in[info.inOffset[j]] * 128.f), 127LL), -128LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) std::max(std::min(std::llround(in[info.inOffset[j]] * 128.0), 127LL), -128LL);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-  }
+  if ( stream_.stats.enabled ) recordConvertTime( monotonicNanos() - start );
 }
 
 //static inline uint16_t bswap_16(uint16_t x) { return (x>>8) | (x<<8); }
@@ -11525,8 +17332,8 @@ void RtApi :: byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat
       *(ptr) = *(ptr+2);
       *(ptr+2) = val;
 
-      // Increment 2 more bytes.
-      ptr += 2;
+      // Increment 4 bytes.
+      ptr += 4;
     }
   }
   else if ( format == RTAUDIO_FLOAT64 ) {
@@ -83,6 +83,8 @@
 #include <vector>
 #include <iostream>
 #include <functional>
+#include <atomic>
+#include <thread>
 
 /*! \typedef typedef unsigned long RtAudioFormat;
     \brief RtAudio data format type.
@@ -121,6 +123,14 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     - \e RTAUDIO_HOG_DEVICE:       Attempt grab device for exclusive use.
     - \e RTAUDIO_ALSA_USE_DEFAULT: Use the "default" PCM device (ALSA only).
     - \e RTAUDIO_JACK_DONT_CONNECT: Do not automatically connect ports (JACK only).
+    - \e RTAUDIO_ALSA_USE_MMAP:    Use mmap access to the device buffers (ALSA only).
+    - \e RTAUDIO_ALSA_USE_POLL:    Wait for periods with poll() (ALSA only).
+    - \e RTAUDIO_COLLECT_STATS:    Collect callback timing statistics.
+    - \e RTAUDIO_NULL_FREE_RUN:    Process periods as fast as possible (null API only).
+    - \e RTAUDIO_DRIFT_COMPENSATION: Resample duplex input to the output device clock (ALSA and OSS only).
+    - \e RTAUDIO_CONVERT_SAMPLE_RATE: Resample when the device cannot run at the stream rate (ALSA, JACK and PulseAudio only).
+    - \e RTAUDIO_OSS_USE_MMAP:     Use mmap access to the device buffers, with poll() wakeups (OSS only).
+    - \e RTAUDIO_EXTERNAL_THREAD:  Drive the stream with processOnce() instead of a callback thread (ALSA, OSS and PulseAudio only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -155,6 +165,48 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
 
     If the RTAUDIO_JACK_DONT_CONNECT flag is set, RtAudio will not attempt
     to automatically connect the ports of the client to the audio device.
+
+    If the RTAUDIO_ALSA_USE_MMAP flag is set, RtAudio will attempt to
+    open ALSA devices with mmap access.  When no format, channel or
+    interleaving conversion is required, the callback buffers then
+    point directly into the device buffer, otherwise the conversion
+    is written straight into it.  Input is captured before the
+    callback is invoked.  Devices without mmap support fall back to
+    read/write access.
+
+    If the RTAUDIO_ALSA_USE_POLL flag is set, the ALSA callback thread
+    waits for each period with poll() on the device descriptors, with
+    an explicit wakeup threshold of one period, before transferring
+    data.  Duplex streams wait on both devices in a single call rather
+    than blocking on capture and then on playback.
+
+    If the RTAUDIO_COLLECT_STATS flag is set, RtAudio records timing
+    statistics for the audio thread, which can be retrieved with
+    RtAudio::getStreamStats().
+
+    If the RTAUDIO_NULL_FREE_RUN flag is set, the null API processes
+    periods back-to-back instead of pacing them at the sample rate.
+
+    If the RTAUDIO_DRIFT_COMPENSATION flag is set for a duplex stream
+    whose input and output devices differ and cannot be synchronized,
+    the input is resampled to follow the clock of the output device,
+    so that the stream never runs into xruns caused by clock drift.
+
+    If the RTAUDIO_CONVERT_SAMPLE_RATE flag is set and the device
+    cannot run at the requested sample rate, the device is opened at
+    its own rate and RtAudio resamples between it and the callback,
+    which keeps the requested rate and buffer size.
+
+    If the RTAUDIO_OSS_USE_MMAP flag is set, RtAudio maps the DMA
+    buffers of OSS devices and waits for each period with poll(),
+    instead of blocking in read() and write().  Devices that cannot
+    map a buffer of whole periods fall back to read/write access.
+
+    If the RTAUDIO_EXTERNAL_THREAD flag is set, RtAudio creates no
+    callback thread for the stream.  The application calls
+    RtAudio::processOnce() instead, from a thread of its own, and can
+    wait for the stream with the descriptor returned by
+    RtAudio::getStreamPollDescriptor().
 */
 typedef unsigned int RtAudioStreamFlags;
 static const RtAudioStreamFlags RTAUDIO_NONINTERLEAVED = 0x1;    // Use non-interleaved buffers (default = interleaved).
@@ -163,6 +215,14 @@ static const RtAudioStreamFlags RTAUDIO_HOG_DEVICE = 0x4;        // Attempt grab
 static const RtAudioStreamFlags RTAUDIO_SCHEDULE_REALTIME = 0x8; // Try to select realtime scheduling for callback thread.
 static const RtAudioStreamFlags RTAUDIO_ALSA_USE_DEFAULT = 0x10; // Use the "default" PCM device (ALSA only).
 static const RtAudioStreamFlags RTAUDIO_JACK_DONT_CONNECT = 0x20; // Do not automatically connect ports (JACK only).
+static const RtAudioStreamFlags RTAUDIO_ALSA_USE_MMAP = 0x40;    // Use mmap access to the device buffers (ALSA only).
+static const RtAudioStreamFlags RTAUDIO_ALSA_USE_POLL = 0x80;    // Wait for periods with poll() (ALSA only).
+static const RtAudioStreamFlags RTAUDIO_COLLECT_STATS = 0x100;   // Collect callback timing statistics.
+static const RtAudioStreamFlags RTAUDIO_NULL_FREE_RUN = 0x200;   // Process periods as fast as possible (null API only).
+static const RtAudioStreamFlags RTAUDIO_DRIFT_COMPENSATION = 0x400; // Resample duplex input to the output device clock (ALSA and OSS only).
+static const RtAudioStreamFlags RTAUDIO_CONVERT_SAMPLE_RATE = 0x800; // Resample when the device cannot run at the stream rate (ALSA, JACK and PulseAudio only).
+static const RtAudioStreamFlags RTAUDIO_OSS_USE_MMAP = 0x1000;   // Use mmap access to the device buffers, with poll() wakeups (OSS only).
+static const RtAudioStreamFlags RTAUDIO_EXTERNAL_THREAD = 0x2000; // Drive the stream with processOnce() instead of a callback thread (ALSA, OSS and PulseAudio only).
 
 /*! \typedef typedef unsigned long RtAudioStreamStatus;
     \brief RtAudio stream status (over- or underflow) flags.
@@ -225,6 +285,38 @@ typedef int (*RtAudioCallback)( void *outputBuffer, void *inputBuffer,
                                 RtAudioStreamStatus status,
                                 void *userData );
 
+//! RtAudio planar callback function prototype.
+/*!
+   A callback of type RtAudioPlanarCallback can be passed to the
+   RtAudio::openStream() variants without a format argument.  The
+   stream then uses RTAUDIO_FLOAT32 samples with the
+   RTAUDIO_NONINTERLEAVED flag, and each channel is passed as a
+   separate buffer of \c nFrames samples.  Where the audio system
+   provides a buffer per channel (the ports of a JACK client, the
+   buffers of non-interleaved ALSA devices opened with the
+   RTAUDIO_ALSA_USE_MMAP flag, and PipeWire buffers), these pointers
+   refer to its buffers directly and no data is copied.
+   They can change from one callback to the next.
+
+   \param outputChannels For output (or duplex) streams, an array of
+          one pointer per output channel, to which the client should
+          write \c nFrames samples.  For input-only streams, this
+          argument will be NULL.
+
+   \param inputChannels For input (or duplex) streams, an array of one
+          pointer per input channel, holding \c nFrames samples.  For
+          output-only streams, this argument will be NULL.
+
+   The other parameters and the return value are the same as for an
+   RtAudioCallback.
+ */
+typedef int (*RtAudioPlanarCallback)( float * const *outputChannels,
+                                      const float * const *inputChannels,
+                                      unsigned int nFrames,
+                                      double streamTime,
+                                      RtAudioStreamStatus status,
+                                      void *userData );
+
 enum RtAudioErrorType {
   RTAUDIO_NO_ERROR = 0,      /*!< No error. */
   RTAUDIO_WARNING,           /*!< A non-critical error. */
@@ -280,9 +372,27 @@ class RTAUDIO_DLL_PUBLIC RtAudio
     WINDOWS_WASAPI, /*!< The Microsoft WASAPI API. */
     WINDOWS_DS,     /*!< The Microsoft DirectSound API. */
     RTAUDIO_DUMMY,  /*!< A compilable but non-functional API. */
+    RTAUDIO_NULL,   /*!< A device-less API that reads and writes files. */
+    LINUX_PIPEWIRE, /*!< The Linux PipeWire API. */
     NUM_APIS        /*!< Number of values in this enum. */
   };
 
+  //! Realtime scheduling policies of the callback thread (see StreamOptions).
+  /*!
+    SCHEDULE_DEADLINE uses the Linux SCHED_DEADLINE policy, with a
+    period and a relative deadline of one stream buffer, and a runtime
+    budget of \c deadlineRuntime buffers (half of one by default).  It
+    is only available to privileged processes.  The kernel refuses it
+    for threads restricted to some CPUs, so openStream() rejects it
+    with a \c cpuAffinity.  When it cannot be selected, the thread
+    runs with round-robin scheduling.
+  */
+  enum SchedulingPolicy {
+    SCHEDULE_RR,       /*!< Round-robin realtime scheduling (SCHED_RR). */
+    SCHEDULE_FIFO,     /*!< First-in first-out realtime scheduling (SCHED_FIFO). */
+    SCHEDULE_DEADLINE  /*!< Earliest deadline first scheduling (SCHED_DEADLINE, Linux only). */
+  };
+
   //! The public device information structure for returning queried values.
   struct DeviceInfo {
     unsigned int ID{};              /*!< Device ID used to specify a device to RtAudio. */
@@ -316,6 +426,14 @@ class RTAUDIO_DLL_PUBLIC RtAudio
     - \e RTAUDIO_HOG_DEVICE:        Attempt grab device for exclusive use.
     - \e RTAUDIO_SCHEDULE_REALTIME: Attempt to select realtime scheduling for callback thread.
     - \e RTAUDIO_ALSA_USE_DEFAULT:  Use the "default" PCM device (ALSA only).
+    - \e RTAUDIO_ALSA_USE_MMAP:     Use mmap access to the device buffers (ALSA only).
+    - \e RTAUDIO_ALSA_USE_POLL:     Wait for periods with poll() (ALSA only).
+    - \e RTAUDIO_COLLECT_STATS:     Collect callback timing statistics.
+    - \e RTAUDIO_NULL_FREE_RUN:     Process periods as fast as possible (null API only).
+    - \e RTAUDIO_DRIFT_COMPENSATION: Resample duplex input to the output device clock (ALSA and OSS only).
+    - \e RTAUDIO_CONVERT_SAMPLE_RATE: Resample when the device cannot run at the stream rate (ALSA, JACK and PulseAudio only).
+    - \e RTAUDIO_OSS_USE_MMAP:      Use mmap access to the device buffers, with poll() wakeups (OSS only).
+    - \e RTAUDIO_EXTERNAL_THREAD:   Drive the stream with processOnce() instead of a callback thread (ALSA, OSS and PulseAudio only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -344,12 +462,66 @@ class RTAUDIO_DLL_PUBLIC RtAudio
     If the RTAUDIO_SCHEDULE_REALTIME flag is set, RtAudio will attempt 
     to select realtime scheduling (round-robin) for the callback thread.
     The \c priority parameter will only be used if the RTAUDIO_SCHEDULE_REALTIME
-    flag is set. It defines the thread's realtime priority.
+    flag is set. It defines the thread's realtime priority.  The
+    \c schedulingPolicy parameter selects another policy (see
+    RtAudio::SchedulingPolicy).  With the ALSA, OSS and PulseAudio
+    APIs, a process without the privilege to select realtime
+    scheduling asks RealtimeKit for it instead, when RtAudio is built
+    with D-Bus support (round-robin only).  RealtimeKit requires the
+    hard RLIMIT_RTTIME limit of the process to be within its maximum,
+    which the application must set with setrlimit().  The \c
+    deadlineRuntime parameter is the share of each buffer period that
+    SCHEDULE_DEADLINE reserves for the callback thread, greater than
+    zero and at most one.
 
     If the RTAUDIO_ALSA_USE_DEFAULT flag is set, RtAudio will attempt to
     open the "default" PCM device when using the ALSA API. Note that this
     will override any specified input or output device id.
 
+    If the RTAUDIO_ALSA_USE_MMAP flag is set, RtAudio will attempt to
+    transfer audio data through the mmap areas of the ALSA devices,
+    avoiding a copy per period where possible.
+
+    If the RTAUDIO_ALSA_USE_POLL flag is set, the ALSA callback thread
+    waits for all stream devices in a single poll() call, which gives
+    more regular wakeups for duplex streams.
+
+    If the RTAUDIO_COLLECT_STATS flag is set, callback timing
+    statistics are collected for the stream (see getStreamStats()).
+
+    If the RTAUDIO_NULL_FREE_RUN flag is set, a null API stream runs
+    its periods as fast as the callback allows, which is useful for
+    offline processing and benchmarks.  By default the periods are
+    paced in real time.
+
+    If the RTAUDIO_DRIFT_COMPENSATION flag is set for a duplex stream
+    with different input and output devices (ALSA and OSS only), the
+    callback is paced by the output device alone.  The input device is
+    read without blocking, and its samples are resampled with a ratio
+    steered by a delay-locked loop on the amount of buffered input, so
+    that the drift between the two device clocks is absorbed instead of
+    causing periodic xruns.  This adds about two buffers of input
+    latency.  The flag has no effect on devices that can be linked to
+    a common clock.
+
+    If the RTAUDIO_CONVERT_SAMPLE_RATE flag is set, a stream can be
+    opened at a sample rate that its device does not support: the
+    device runs at its own rate (the nearest rate with ALSA, the server
+    rate with JACK and the device rate with PulseAudio), and a
+    windowed-sinc resampler converts between the device periods and
+    the callback, which is invoked with the requested sample rate and
+    \c bufferFrames.  getStreamSampleRate() returns the requested rate.
+    Periods of the two sizes do not line up, so the callback may be
+    invoked zero, one or two times for each device period.  A duplex
+    stream runs both devices at the rate chosen for its output.
+
+    If the RTAUDIO_OSS_USE_MMAP flag is set, OSS devices that support
+    it are accessed through their mapped DMA buffers.  The callback
+    thread waits for each period with poll() and tracks the device
+    pointers, and the callback writes its output straight into the
+    device buffer when no conversion is required.  Input is captured
+    before the callback is invoked.
+
     The \c numberOfBuffers parameter can be used to control stream
     latency in the Windows DirectSound, Linux OSS, and Linux Alsa APIs
     only.  A value of two is usually the smallest allowed.  Larger
@@ -360,16 +532,153 @@ class RTAUDIO_DLL_PUBLIC RtAudio
 
     The \c streamName parameter can be used to set the client name
     when using the Jack API or the application name when using the
-    Pulse API.  By default, the Jack client name is set to RtApiJack.
-    However, if you wish to create multiple instances of RtAudio with
-    Jack, each instance must have a unique client name. The default
-    Pulse application name is set to "RtAudio."
+    Pulse API, and the stream node name when using the PipeWire API.
+    By default, the Jack client name is set to RtApiJack.  However, if
+    you wish to create multiple instances of RtAudio with Jack, each
+    instance must have a unique client name. The default Pulse
+    application name and PipeWire node name are set to "RtAudio."
+
+    The \c ringBufferFrames parameter sets the capacity, in sample
+    frames, of the ring buffers used by writeFrames() and readFrames()
+    when a stream is opened without a callback function.  If a value
+    of zero is specified, a capacity of four stream buffers is used.
+    The value actually used is returned via the structure argument.
+
+    The \c outputFile and \c inputFile parameters are only used by the
+    null API.  Output is written to, and input read from, the named
+    files in the device sample format.  Files with a ".wav" extension
+    are written and read as WAV files, any other name as raw
+    interleaved samples.  When empty, output is discarded and input is
+    silent.
+
+    The \c cpuAffinity and \c lockMemory parameters are used by the
+    ALSA, OSS and PulseAudio APIs, whose callbacks run on a thread of
+    their own.  The callback thread is restricted to the CPUs listed
+    in \c cpuAffinity (by index, Linux only), for instance to keep it
+    away from the CPUs that service network interrupts.  If \c
+    lockMemory is true, the memory of the process is locked with
+    mlockall(), and the stream buffers and the stack of the callback
+    thread are touched before the first period, so that the callback
+    does not take page faults.  Both are applied when the thread
+    starts (with PulseAudio, before the first period), and failures
+    are reported as warnings.  With the RTAUDIO_EXTERNAL_THREAD flag,
+    these options and RTAUDIO_SCHEDULE_REALTIME are not applied to the
+    thread calling processOnce(), and a warning is issued.
+
+    The \c aggregateOutputs and \c aggregateInputs parameters add
+    further devices to the output or input of a stream, making an
+    aggregate device (currently with the Linux ALSA API only).  Their
+    channels follow those of the stream device in the user buffers, in
+    the order given.  Since each device runs on its own clock, the
+    samples of the added devices are resampled, with a ratio that is
+    continuously adjusted to follow the clock of the stream device.
+    The estimated drift of each added device is reported by
+    getStreamStats().  Aggregate inputs and outputs are only used when
+    the stream has input or output parameters, respectively.
   */
   struct StreamOptions {
     RtAudioStreamFlags flags{};      /*!< A bit-mask of stream flags (RTAUDIO_NONINTERLEAVED, RTAUDIO_MINIMIZE_LATENCY, RTAUDIO_HOG_DEVICE, RTAUDIO_ALSA_USE_DEFAULT). */
     unsigned int numberOfBuffers{};  /*!< Number of stream buffers. */
     std::string streamName;        /*!< A stream name (currently used only in Jack). */
     int priority{};                  /*!< Scheduling priority of callback thread (only used with flag RTAUDIO_SCHEDULE_REALTIME). */
+    unsigned int ringBufferFrames{}; /*!< Capacity of the writeFrames()/readFrames() ring buffers in sample frames. */
+    std::string outputFile;          /*!< File receiving the output samples (null API only). */
+    std::string inputFile;           /*!< File supplying the input samples (null API only). */
+    std::vector<RtAudio::StreamParameters> aggregateOutputs; /*!< Further output devices resampled to the stream clock (ALSA only). */
+    std::vector<RtAudio::StreamParameters> aggregateInputs;  /*!< Further input devices resampled to the stream clock (ALSA only). */
+    SchedulingPolicy schedulingPolicy{SCHEDULE_RR}; /*!< Realtime scheduling policy of the callback thread (only used with flag RTAUDIO_SCHEDULE_REALTIME). */
+    std::vector<unsigned int> cpuAffinity; /*!< CPUs the callback thread may run on (all if empty). */
+    bool lockMemory{false};                /*!< Lock the process memory and prefault the stream buffers. */
+    double deadlineRuntime{0.5};           /*!< Runtime budget of SCHEDULE_DEADLINE, as a fraction of the buffer period. */
+  };
+
+  //! The public stream statistics structure, returned by getStreamStats().
+  /*!
+    Statistics are only collected for streams opened with the
+    RTAUDIO_COLLECT_STATS flag.  All times are in seconds.  The
+    duration of each user callback is counted in \c
+    durationHistogram, where bin \e i (for \e i < 10) holds callbacks
+    that took between \e i and \e i+1 tenths of the buffer period, bin
+    10 those that took between one and two periods and bin 11 those
+    that took longer.  The wakeup jitter is the absolute difference
+    between the interval separating consecutive callbacks and the
+    buffer period (intervals longer than ten periods, such as across a
+    stop, are not counted).  The mutex time is the time the audio
+    thread spent waiting to acquire the stream mutex.
+
+    For streams with aggregate devices (see StreamOptions), \c drift
+    holds the estimated deviation of the clock of each added device
+    from that of the stream device, in parts per million, for the
+    output devices followed by the input devices.  The input device of
+    a stream opened with the RTAUDIO_DRIFT_COMPENSATION flag comes
+    last, relative to the output device.  These estimates are
+    kept whether or not RTAUDIO_COLLECT_STATS is set, and are not
+    cleared by resetStreamStats().
+  */
+  struct StreamStats {
+    static const unsigned int HISTOGRAM_BINS = 12;
+    static const unsigned int MAX_DRIFT_DEVICES = 8;
+    unsigned long long callbacks{};      /*!< Number of user callbacks. */
+    unsigned long long durationHistogram[HISTOGRAM_BINS]{}; /*!< Callback durations in tenths of a period. */
+    double meanCallbackTime{};           /*!< Mean duration of the user callback. */
+    double maxCallbackTime{};            /*!< Longest duration of the user callback. */
+    double meanWakeupJitter{};           /*!< Mean absolute wakeup jitter. */
+    double maxWakeupJitter{};            /*!< Largest absolute wakeup jitter. */
+    double meanConvertTime{};            /*!< Mean duration of a buffer conversion. */
+    double maxConvertTime{};             /*!< Longest duration of a buffer conversion. */
+    unsigned long long outputUnderflows{}; /*!< Number of periods reporting an output underflow. */
+    unsigned long long inputOverflows{};   /*!< Number of periods reporting an input overflow. */
+    double mutexBlockedTime{};           /*!< Total time spent acquiring the stream mutex. */
+    unsigned int driftDevices{};         /*!< Number of aggregate devices with a drift estimate. */
+    double drift[MAX_DRIFT_DEVICES]{};   /*!< Clock drift of each aggregate device, in parts per million. */
+  };
+
+  //! The clock of the current buffer period, returned by getStreamClock().
+  /*!
+    \c framePosition counts the frames of the callback since the
+    stream was opened, like the stream time, and is the position of
+    the first frame of the period.  The times are those of
+    std::chrono::steady_clock (CLOCK_MONOTONIC on Linux), in
+    nanoseconds: \c outputTime is when the first output frame of the
+    period will be played by the device and \c inputTime when the
+    first input frame was captured.  They are taken from the device
+    or server timestamps where the API provides them (ALSA, JACK and
+    PulseAudio), as flagged by \c outputTimestamped and \c
+    inputTimestamped, and are otherwise estimated from the time at
+    which the callback starts and the stream latency.  The times of a
+    direction that is not open are zero.
+  */
+  struct StreamClock {
+    unsigned long long framePosition{}; /*!< Position of the first frame of the period, in frames. */
+    long long outputTime{};              /*!< Time at which the first output frame will be played, in nanoseconds. */
+    long long inputTime{};               /*!< Time at which the first input frame was captured, in nanoseconds. */
+    bool outputTimestamped{};            /*!< True if \c outputTime comes from a device timestamp. */
+    bool inputTimestamped{};             /*!< True if \c inputTime comes from a device timestamp. */
+  };
+
+  //! The latencies of a stream, returned by getStreamLatencies().
+  /*!
+    The output latency separates the start of a callback from the
+    playback of the first frame of its output buffer, and the input
+    latency the capture of the first frame of the input buffer from
+    the start of the callback.  The round-trip latency is their sum,
+    which separates the capture of an input frame from the playback of
+    the output frame at the same position of the buffers.  They are
+    measured at each buffer period from the stream clock (see
+    StreamClock), and include the sample rate conversion and drift
+    compensation stages of RtAudio.  For streams opened without a
+    callback function, the frames queued in the ring buffers are
+    added, so that the latencies are those of writeFrames() and
+    readFrames().  Frames are counted at the sample rate of the
+    callback.  The latencies of a direction that is not open are zero.
+  */
+  struct StreamLatency {
+    unsigned long outputFrames{};        /*!< Output latency, in frames. */
+    unsigned long inputFrames{};         /*!< Input latency, in frames. */
+    unsigned long roundTripFrames{};     /*!< Round-trip latency, in frames. */
+    long long outputNanos{};             /*!< Output latency, in nanoseconds. */
+    long long inputNanos{};              /*!< Input latency, in nanoseconds. */
+    long long roundTripNanos{};          /*!< Round-trip latency, in nanoseconds. */
   };
 
   //! A static function to determine the current RtAudio version.
@@ -485,7 +794,8 @@ class RTAUDIO_DLL_PUBLIC RtAudio
     initialized to default, invalid values (ID = 0, empty name, ...).
     If the specified device is the current default input or output
     device, the corresponding "isDefault" member will have a value of
-    "true".
+    "true".  Some APIs (ALSA) only probe the capabilities of a device
+    when this function is first called for it, and keep the result.
   */
   RtAudio::DeviceInfo getDeviceInfo( unsigned int deviceId );
 
@@ -533,6 +843,8 @@ class RTAUDIO_DLL_PUBLIC RtAudio
            allowable value is determined.
     \param callback A client-defined function that will be invoked
            when input data is available and/or output data is needed.
+           If NULL, audio data is instead exchanged with the stream
+           through writeFrames() and readFrames().
     \param userData An optional pointer to data that can be accessed
            from within the callback function.
     \param options An optional pointer to a structure containing various
@@ -551,6 +863,20 @@ class RTAUDIO_DLL_PUBLIC RtAudio
                                unsigned int *bufferFrames, RtAudioCallback callback,
                                void *userData = NULL, RtAudio::StreamOptions *options = NULL );
 
+  //! A function that opens a stream with a planar callback function.
+  /*!
+    This function takes the same parameters as the openStream()
+    function above, except for the sample format.  The stream uses
+    RTAUDIO_FLOAT32 samples with the RTAUDIO_NONINTERLEAVED flag, and
+    the callback function receives a pointer to the buffer of each
+    channel (see RtAudioPlanarCallback).  The callback cannot be NULL.
+  */
+  RtAudioErrorType openStream( RtAudio::StreamParameters *outputParameters,
+                               RtAudio::StreamParameters *inputParameters,
+                               unsigned int sampleRate, unsigned int *bufferFrames,
+                               RtAudioPlanarCallback callback,
+                               void *userData = NULL, RtAudio::StreamOptions *options = NULL );
+
   //! A function that closes a stream and frees any associated stream memory.
   /*!
     If a stream is not open, an RTAUDIO_WARNING will be passed to the
@@ -621,6 +947,15 @@ class RTAUDIO_DLL_PUBLIC RtAudio
   */
   long getStreamLatency( void );
 
+  //! Returns the input, output and round-trip latencies of the stream.
+  /*!
+    The latencies are updated without locking by the audio thread at
+    each buffer period and can be read from any thread.  Before the
+    first period, they are estimated from the buffering of the stream.
+    If a stream is not open, all latencies are zero.
+  */
+  RtAudio::StreamLatency getStreamLatencies( void );
+
   //! Returns actual sample rate in use by the (open) stream.
   /*!
     On some systems, the sample rate used may be slightly different
@@ -629,6 +964,206 @@ class RTAUDIO_DLL_PUBLIC RtAudio
   */
   unsigned int getStreamSampleRate( void );
 
+  //! Queue output data for a stream that was opened without a callback function.
+  /*!
+    The data is copied into a lock-free ring buffer that is drained
+    by the stream's audio thread, so this function can be called from
+    any single producer thread.  The \c buffer must hold \c frames
+    interleaved sample frames in the stream's format.  If \c wait is
+    true and the stream is running, the function blocks until all
+    frames have been queued.  Otherwise, only the frames that fit are
+    queued.  Output can be queued before the stream is started.  The
+    number of frames queued is returned.  If the ring buffer runs
+    empty, silence is played and the RTAUDIO_OUTPUT_UNDERFLOW status
+    is set (see getStreamStatus()).
+  */
+  unsigned int writeFrames( const void *buffer, unsigned int frames, bool wait = true );
+
+  //! Retrieve input data from a stream that was opened without a callback function.
+  /*!
+    Captured data is collected in a lock-free ring buffer that is
+    filled by the stream's audio thread, so this function can be
+    called from any single consumer thread.  Up to \c frames
+    interleaved sample frames in the stream's format are copied to \c
+    buffer.  If \c wait is true and the stream is running, the
+    function blocks until all frames have been read.  The number of
+    frames read is returned.  If the ring buffer is full when input
+    arrives, the newest input is discarded and the
+    RTAUDIO_INPUT_OVERFLOW status is set (see getStreamStatus()).
+  */
+  unsigned int readFrames( void *buffer, unsigned int frames, bool wait = true );
+
+  //! Returns the number of frames that writeFrames() can currently queue without blocking.
+  unsigned int getWriteAvailable( void );
+
+  //! Returns the number of frames that readFrames() can currently return without blocking.
+  unsigned int getReadAvailable( void );
+
+  //! Returns and clears the stream status collected since the last call.
+  /*!
+    For streams opened without a callback function, this returns the
+    RtAudioStreamStatus bits reported by the audio system, together
+    with ring buffer underflows and overflows, since the previous
+    call.
+  */
+  RtAudioStreamStatus getStreamStatus( void );
+
+  //! Returns a snapshot of the statistics collected for the stream.
+  /*!
+    The statistics are recorded without locking by the audio thread
+    and can be read from any thread.  All values are zero unless the
+    stream was opened with the RTAUDIO_COLLECT_STATS flag.
+  */
+  RtAudio::StreamStats getStreamStats( void );
+
+  //! Clears the statistics collected for the stream.
+  /*!
+    If the stream is running, the statistics are cleared by the audio
+    thread at the start of its next callback.
+  */
+  void resetStreamStats( void );
+
+  //! Returns the clock of the current or last buffer period of the stream.
+  /*!
+    The clock is published without locking by the audio thread just
+    before each callback, so that a callback calling this function
+    gets the clock of the period it is processing, and it can be read
+    from any thread.  When the sample rate is converted
+    (RTAUDIO_CONVERT_SAMPLE_RATE), it is that of the device period,
+    with the frame position at the rate of the callback.
+  */
+  RtAudio::StreamClock getStreamClock( void );
+
+  //! Processes the next period of a stream opened with the RTAUDIO_EXTERNAL_THREAD flag.
+  /*!
+    The stream devices are waited on for up to \c timeout
+    milliseconds (indefinitely if negative), and the callback is then
+    invoked on the calling thread.  The number of periods processed
+    is returned, which is zero if the wait timed out or the stream is
+    not running (without waiting), and -1 on error.  With PulseAudio,
+    all the periods requested by the server are processed.  Calls for
+    one stream must not overlap, but stopStream() and abortStream()
+    can be called from any thread, including the callback, and then
+    wait for a concurrent call to return.
+  */
+  int processOnce( int timeout = -1 );
+
+  //! Returns a descriptor that polls readable when processOnce() has a period to process, or -1.
+  /*!
+    The descriptor belongs to the stream and must not be read or
+    closed.  It only becomes readable while the stream is running, so
+    that several streams, and other sources, can be waited on
+    together with poll() or select().  As a duplex stream can be
+    waiting for one of its devices when it polls readable, processOnce()
+    should then be called with a timeout of about one buffer.  -1 is
+    returned for streams opened without the RTAUDIO_EXTERNAL_THREAD
+    flag, or if the descriptor could not be created (on systems
+    without epoll, for ALSA and OSS streams).
+  */
+  int getStreamPollDescriptor( void );
+
+  //! Open one of several simultaneous streams, identified by the returned stream ID.
+  /*!
+    This function takes the same parameters as openStream() but
+    allows any number of streams to be open at the same time on one
+    RtAudio instance.  The ID of the new stream is returned via \c
+    streamId (also when opening fails, so that its error text can be
+    retrieved) and is passed to the functions below to control that
+    stream.  These otherwise behave as the functions of the same name
+    without a stream ID, which address the stream with ID 0.  The
+    lowest ID without an open stream is chosen, so that IDs are
+    reused once their streams are closed.
+
+    All streams share the device list, device IDs and error handling
+    of the RtAudio instance, so devices are not probed again for each
+    stream.  Each stream runs on the callback thread provided by its
+    API.  Streams opened without a callback function can all be
+    serviced from a single application thread with writeFrames() and
+    readFrames().  Streams should be opened and closed from one
+    thread.  Some APIs, such as ASIO, cannot open more than one stream
+    at a time.
+  */
+  RtAudioErrorType openStream( unsigned int *streamId,
+                               RtAudio::StreamParameters *outputParameters,
+                               RtAudio::StreamParameters *inputParameters,
+                               RtAudioFormat format, unsigned int sampleRate,
+                               unsigned int *bufferFrames, RtAudioCallback callback,
+                               void *userData = NULL, RtAudio::StreamOptions *options = NULL );
+
+  //! Open one of several simultaneous streams with a planar callback function (see above).
+  RtAudioErrorType openStream( unsigned int *streamId,
+                               RtAudio::StreamParameters *outputParameters,
+                               RtAudio::StreamParameters *inputParameters,
+                               unsigned int sampleRate, unsigned int *bufferFrames,
+                               RtAudioPlanarCallback callback,
+                               void *userData = NULL, RtAudio::StreamOptions *options = NULL );
+
+  //! Close the stream with the given ID (see closeStream()).
+  void closeStream( unsigned int streamId );
+
+  //! Start the stream with the given ID (see startStream()).
+  RtAudioErrorType startStream( unsigned int streamId );
+
+  //! Stop the stream with the given ID (see stopStream()).
+  RtAudioErrorType stopStream( unsigned int streamId );
+
+  //! Abort the stream with the given ID (see abortStream()).
+  RtAudioErrorType abortStream( unsigned int streamId );
+
+  //! Retrieve the last error message of the stream with the given ID (see getErrorText()).
+  const std::string getErrorText( unsigned int streamId );
+
+  //! Returns true if the stream with the given ID is open and false if not.
+  bool isStreamOpen( unsigned int streamId );
+
+  //! Returns true if the stream with the given ID is running and false if not.
+  bool isStreamRunning( unsigned int streamId );
+
+  //! Returns the stream time of the stream with the given ID (see getStreamTime()).
+  double getStreamTime( unsigned int streamId );
+
+  //! Set the stream time of the stream with the given ID (see setStreamTime()).
+  void setStreamTime( unsigned int streamId, double time );
+
+  //! Returns the latency of the stream with the given ID (see getStreamLatency()).
+  long getStreamLatency( unsigned int streamId );
+
+  //! Returns the latencies of the stream with the given ID (see getStreamLatencies()).
+  RtAudio::StreamLatency getStreamLatencies( unsigned int streamId );
+
+  //! Returns the sample rate of the stream with the given ID (see getStreamSampleRate()).
+  unsigned int getStreamSampleRate( unsigned int streamId );
+
+  //! Queue output data for the stream with the given ID (see writeFrames()).
+  unsigned int writeFrames( unsigned int streamId, const void *buffer, unsigned int frames, bool wait = true );
+
+  //! Retrieve input data from the stream with the given ID (see readFrames()).
+  unsigned int readFrames( unsigned int streamId, void *buffer, unsigned int frames, bool wait = true );
+
+  //! Returns the frames that writeFrames() can queue without blocking for the stream with the given ID.
+  unsigned int getWriteAvailable( unsigned int streamId );
+
+  //! Returns the frames that readFrames() can return without blocking for the stream with the given ID.
+  unsigned int getReadAvailable( unsigned int streamId );
+
+  //! Returns and clears the status of the stream with the given ID (see getStreamStatus()).
+  RtAudioStreamStatus getStreamStatus( unsigned int streamId );
+
+  //! Returns the statistics of the stream with the given ID (see getStreamStats()).
+  RtAudio::StreamStats getStreamStats( unsigned int streamId );
+
+  //! Clears the statistics of the stream with the given ID (see resetStreamStats()).
+  void resetStreamStats( unsigned int streamId );
+
+  //! Returns the clock of the stream with the given ID (see getStreamClock()).
+  RtAudio::StreamClock getStreamClock( unsigned int streamId );
+
+  //! Processes the next period of the stream with the given ID (see processOnce()).
+  int processOnce( unsigned int streamId, int timeout );
+
+  //! Returns the poll descriptor of the stream with the given ID (see getStreamPollDescriptor()).
+  int getStreamPollDescriptor( unsigned int streamId );
+
   //! Set a client-defined function that will be invoked when an error or warning occurs.
   void setErrorCallback( RtAudioErrorCallback errorCallback );
 
@@ -643,7 +1178,11 @@ class RTAUDIO_DLL_PUBLIC RtAudio
  protected:
 
   void openRtApi( RtAudio::Api api );
+  static RtApi *newRtApi( RtAudio::Api api );
+  RtApi *streamApi( unsigned int streamId );
+  RtApi *newStreamApi( unsigned int *streamId );
   RtApi *rtapi_;
+  std::vector<RtApi *> streams_; // The streams with IDs 1 and up.
 };
 
 // Operating system dependent thread functionality.
@@ -672,7 +1211,7 @@ class RTAUDIO_DLL_PUBLIC RtAudio
 // Setup for "dummy" behavior if no apis specified.
 #if !(defined(__WINDOWS_DS__) || defined(__WINDOWS_ASIO__) || defined(__WINDOWS_WASAPI__) \
       || defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__UNIX_JACK__) \
-      || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__))
+      || defined(__LINUX_PIPEWIRE__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__))
 
   #define __RTAUDIO_DUMMY__
 
@@ -690,6 +1229,10 @@ struct CallbackInfo {
   bool isRunning{false};
   bool doRealtime{false};
   int priority{};
+  int policy{};      // RtAudio::SchedulingPolicy, used with doRealtime.
+  double deadlineRuntime{}; // Fraction of the period, with SCHEDULE_DEADLINE.
+  std::vector<unsigned int> cpuAffinity;
+  bool lockMemory{false};
   bool deviceDisconnected{false};
 };
 
@@ -760,12 +1303,18 @@ public:
                                  RtAudioFormat format, unsigned int sampleRate,
                                  unsigned int *bufferFrames, RtAudioCallback callback,
                                  void *userData, RtAudio::StreamOptions *options );
+  RtAudioErrorType openStream( RtAudio::StreamParameters *outputParameters,
+                               RtAudio::StreamParameters *inputParameters,
+                               unsigned int sampleRate, unsigned int *bufferFrames,
+                               RtAudioPlanarCallback callback,
+                               void *userData, RtAudio::StreamOptions *options );
   virtual void closeStream( void );
   virtual RtAudioErrorType startStream( void ) = 0;
   virtual RtAudioErrorType stopStream( void ) = 0;
   virtual RtAudioErrorType abortStream( void ) = 0;
   const std::string getErrorText( void ) const { return errorText_; }
   long getStreamLatency( void );
+  RtAudio::StreamLatency getStreamLatencies( void );
   unsigned int getStreamSampleRate( void );
   virtual double getStreamTime( void ) const { return stream_.streamTime; }
   virtual void setStreamTime( double time );
@@ -773,6 +1322,19 @@ public:
   bool isStreamRunning( void ) const { return stream_.state == STREAM_RUNNING; }
   void setErrorCallback( RtAudioErrorCallback errorCallback ) { errorCallback_ = errorCallback; }
   void showWarnings( bool value ) { showWarnings_ = value; }
+  unsigned int writeFrames( const void *buffer, unsigned int frames, bool wait );
+  unsigned int readFrames( void *buffer, unsigned int frames, bool wait );
+  unsigned int getWriteAvailable( void );
+  unsigned int getReadAvailable( void );
+  RtAudioStreamStatus getStreamStatus( void );
+  RtAudio::StreamStats getStreamStats( void );
+  void resetStreamStats( void );
+  RtAudio::StreamClock getStreamClock( void );
+  int processOnce( int timeout );
+  int getStreamPollDescriptor( void ) const { return stream_.pollDescriptor; }
+  void shareDevices( RtApi *source );
+  RtAudioErrorType reportError( RtAudioErrorType type, const std::string &message );
+  bool configureCallbackThread( void );
 
 
 protected:
@@ -796,6 +1358,74 @@ protected:
     UNINITIALIZED = -75
   };
 
+  struct ConvertInfo;
+
+  // A single-producer/single-consumer ring buffer used by
+  // writeFrames() and readFrames() (see RtAudio.cpp).
+  class RingBuffer;
+
+  // A variable-ratio resampler for interleaved FLOAT32 frames and a
+  // delay-locked loop steering its ratio from buffer levels, used to
+  // follow the clock of another device (see RtAudio.cpp).
+  class Resampler;
+  class DriftLoop;
+
+  // Input resampling of duplex streams across two devices
+  // (RTAUDIO_DRIFT_COMPENSATION, see RtAudio.cpp).
+  struct DriftCompensation;
+
+  // Resampling between the device and the callback sample rates
+  // (RTAUDIO_CONVERT_SAMPLE_RATE, see RtAudio.cpp).
+  struct RateConversion;
+
+  // The user callback and channel pointers of a stream opened with an
+  // RtAudioPlanarCallback (see RtAudio.cpp).
+  struct PlanarCallback;
+
+  // Stream statistics (RTAUDIO_COLLECT_STATS).  They are only written
+  // by the audio thread (or by another thread holding the stream mutex
+  // while the stream is not running), which makes the sequence count
+  // odd while it does so, allowing other threads to take a consistent
+  // copy without locking.  Times are in nanoseconds.
+  struct StatsData {
+    std::atomic<bool> enabled;  // Set after some backends have started their audio thread.
+    std::atomic<bool> resetRequested;
+    std::atomic<unsigned int> sequence;
+    long long lastWakeup;      // Audio thread only.
+    long long callbackStart;   // Audio thread only.
+    std::atomic<unsigned long long> callbacks;
+    std::atomic<unsigned long long> histogram[RtAudio::StreamStats::HISTOGRAM_BINS];
+    std::atomic<unsigned long long> callbackTime, maxCallbackTime;
+    std::atomic<unsigned long long> wakeups, jitter, maxJitter;
+    std::atomic<unsigned long long> converts, convertTime, maxConvertTime;
+    std::atomic<unsigned long long> xruns[2];  // Output underflows and input overflows.
+    std::atomic<unsigned long long> mutexTime;
+    unsigned int nDrift;       // Aggregate device clock drift in ppm, written outside of the sequence.
+    std::atomic<double> drift[RtAudio::StreamStats::MAX_DRIFT_DEVICES];
+
+    StatsData() : enabled(false), resetRequested(false), sequence(0), nDrift(0) {}
+  };
+
+  // The stream clock and latencies of the current period (see
+  // getStreamClock() and getStreamLatencies()), published by the audio
+  // thread with a sequence count like the statistics.  Times are in
+  // nanoseconds of the monotonic clock.
+  struct ClockData {
+    long long pending[2];      // Audio thread only: device times of the coming period, or 0.
+    std::atomic<unsigned int> sequence;
+    std::atomic<bool> published;             // Set at the first period.
+    std::atomic<unsigned long long> framePosition;
+    std::atomic<long long> time[2];          // Playback and record, respectively.
+    std::atomic<bool> timestamped[2];
+    std::atomic<long long> latency[2];
+
+    ClockData() : sequence(0), published(false), framePosition(0) { pending[0] = pending[1] = 0; time[0] = time[1] = 0; timestamped[0] = timestamped[1] = false; latency[0] = latency[1] = 0; }
+  };
+
+  // Conversion plans and vectorized kernels used by convertBuffer().
+  typedef void (*ConvertFunction)( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames );
+  typedef void (*ConvertKernel)( void *outBuffer, const void *inBuffer, size_t samples );
+
   // A protected structure used for buffer conversion.
   struct ConvertInfo {
     int channels;
@@ -803,6 +1433,9 @@ protected:
     RtAudioFormat inFormat, outFormat;
     std::vector<int> inOffset;
     std::vector<int> outOffset;
+    ConvertFunction convert;   // Plan selected by setConvertInfo().
+    ConvertKernel kernel;      // Vectorized kernel used by some plans, if any.
+    bool clearOutput;          // Zero the (shared duplex) device buffer first.
   };
 
   // A protected structure for audio streams.
@@ -810,7 +1443,7 @@ protected:
     unsigned int deviceId[2];  // Playback and record, respectively.
     void *apiHandle;           // void pointer for API specific stream handle information
     StreamMode mode;           // OUTPUT, INPUT, or DUPLEX.
-    StreamState state;         // STOPPED, RUNNING, or CLOSED
+    std::atomic<StreamState> state; // STOPPED, STOPPING, RUNNING, or CLOSED
     char *userBuffer[2];       // Playback and record, respectively.
     char *deviceBuffer;
     bool doConvertBuffer[2];   // Playback and record, respectively.
@@ -830,13 +1463,25 @@ protected:
     CallbackInfo callbackInfo;
     ConvertInfo convertInfo[2];
     double streamTime;         // Number of elapsed seconds since the stream started.
+    unsigned long long framePosition; // Number of elapsed frames (at the device rate), like streamTime.
+    ClockData clock;
+    RingBuffer *ringBuffer[2]; // Playback and record, when opened without a callback.
+    std::atomic<RtAudioStreamStatus> ringStatus; // Status collected for getStreamStatus().
+    StatsData stats;
+    DriftCompensation *driftCompensation; // Set for RTAUDIO_DRIFT_COMPENSATION.
+    RateConversion *rateConversion;       // Set when the device rate differs (RTAUDIO_CONVERT_SAMPLE_RATE).
+    PlanarCallback *planar;               // Set when opened with an RtAudioPlanarCallback.
+    bool external;             // No callback thread, driven by processOnce() (RTAUDIO_EXTERNAL_THREAD).
+    int pollDescriptor;        // Returned by getStreamPollDescriptor(), or -1.
+    StreamMutex processMutex;  // Held by processOnce().
+    std::atomic<std::thread::id> processThread; // The thread in processOnce(), if any.
 
 #if defined(HAVE_GETTIMEOFDAY)
     struct timeval lastTickTimestamp;
 #endif
 
     RtApiStream()
-    :apiHandle(0), deviceBuffer(0) {} // { device[0] = std::string(); device[1] = std::string(); }
+    :apiHandle(0), deviceBuffer(0), framePosition(0), driftCompensation(0), rateConversion(0), planar(0), external(false), pollDescriptor(-1), processThread( std::thread::id() ) { ringBuffer[0] = 0; ringBuffer[1] = 0; } // { device[0] = std::string(); device[1] = std::string(); }
   };
 
   typedef S24 Int24;
@@ -875,12 +1520,109 @@ protected:
                                 RtAudioFormat format, unsigned int *bufferSize,
                                 RtAudio::StreamOptions *options );
 
+  /*!
+    Protected, api-specific method that copies any device data kept
+    in addition to deviceList_ from another instance of the same API,
+    so that both can open streams on the same probed devices.  This
+    function MUST be implemented by subclasses that keep such data.
+  */
+  virtual void copyDevices( RtApi * /*source*/ ) {}
+
+  /*!
+    Protected, api-specific method that completes the DeviceInfo of a
+    device listed by probeDevices(), for APIs that defer probing the
+    device capabilities until they are requested by getDeviceInfo().
+  */
+  virtual void probeDeviceCapabilities( RtAudio::DeviceInfo & /*info*/ ) {}
+
   //! A protected function used to increment the stream time.
   void tickStreamTime( void );
 
   //! Protected common method to clear an RtApiStream structure.
   void clearStreamInfo();
 
+  //! Callback installed for streams opened without a user callback, which moves data through the ring buffers.
+  static int ringBufferCallback( void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                                 double streamTime, RtAudioStreamStatus status, void *userData );
+
+  //! Sleeps for a fraction of a stream buffer while waiting on a ring buffer.
+  void waitForRingBuffer( void );
+
+  //! Protected method that saves the callback thread options applied by configureCallbackThread().
+  void setCallbackThreadOptions( RtAudio::StreamOptions *options );
+
+  //! Protected method that writes to every page of the stream buffers (StreamOptions::lockMemory).
+  void prefaultStreamBuffers( void );
+
+  /*!
+    Protected, api-specific method that waits for up to \c timeout
+    milliseconds and processes the next period of a stream opened with
+    the RTAUDIO_EXTERNAL_THREAD flag, on behalf of processOnce().  It
+    returns the number of periods processed, or -1 on error.
+  */
+  virtual int processExternal( int /*timeout*/ ) { return 0; }
+
+  //! Protected method that returns true if the calling thread is running processOnce() for the stream.
+  bool inProcessOnce( void ) const { return stream_.processThread.load() == std::this_thread::get_id(); }
+
+  //! Protected methods called around the user callback, which publish the stream clock and record statistics, when enabled.
+  void beginCallback( void ) { publishStreamClock(); if ( stream_.stats.enabled ) recordCallbackStart(); }
+  void endCallback( RtAudioStreamStatus status ) { if ( stream_.stats.enabled ) recordCallbackEnd( status ); }
+  void recordCallbackStart( void );
+  void recordCallbackEnd( RtAudioStreamStatus status );
+  void recordConvertTime( long long nanoseconds );
+
+  //! Protected method to lock the stream mutex from the audio thread, recording the time spent blocked.
+  void lockStreamMutex( void );
+
+  //! Protected method that clears the statistics (only called when the audio thread is not recording).
+  void clearStreamStats( void );
+
+  //! Protected method for the backends to give the device time (in monotonic nanoseconds) of the first frame of the coming period.
+  void setStreamClock( StreamMode mode, long long time ) { stream_.clock.pending[mode] = time; }
+
+  //! Protected method that publishes the stream clock and latencies of the coming period, estimating the times not given by setStreamClock().
+  void publishStreamClock( void );
+
+  //! Protected methods that resample the input of a duplex stream to the output device clock (RTAUDIO_DRIFT_COMPENSATION).
+  void setupDriftCompensation( void );
+  void resetDriftCompensation( void );
+  bool bufferDriftInput( char *buffer );
+  bool resampleDriftInput( double pendingFrames );
+
+  /*!
+    Protected method called by probeDeviceOpen() when the device runs at
+    \c deviceRate instead of the requested \c sampleRate.  If the
+    RTAUDIO_CONVERT_SAMPLE_RATE flag is set and the stream has no other
+    direction open yet, it records the requested rate and buffer size
+    for the callback, scales \c *bufferSize to a device period of the
+    same duration and returns true.
+  */
+  bool convertStreamRate( unsigned int sampleRate, unsigned int deviceRate,
+                          unsigned int *bufferSize, RtAudio::StreamOptions *options );
+
+  //! Protected methods that resample between the device periods and the user callback (RTAUDIO_CONVERT_SAMPLE_RATE).
+  void setupRateConversion( RtAudioCallback callback, void *userData );
+  void resetRateConversion( void );
+  bool fillConvertedInput( void );
+  int invokeConvertedCallback( double streamTime );
+  static int rateConversionCallback( void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                                     double streamTime, RtAudioStreamStatus status, void *userData );
+
+  //! Callback installed for streams opened with an RtAudioPlanarCallback, which passes the channels of the non-interleaved user buffers.
+  static int planarCallback( void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                             double streamTime, RtAudioStreamStatus status, void *userData );
+
+  /*!
+    Protected methods for backends that pass their own channel buffers
+    to a planar callback.  The backend sets the channel pointers of
+    stream_.planar for each direction, or points them into a
+    non-interleaved FLOAT32 period with setPlanarChannels(), and then
+    invokes the user callback with invokePlanarCallback().
+  */
+  void setPlanarChannels( StreamMode mode, char *buffer, unsigned int nFrames );
+  int invokePlanarCallback( unsigned int nFrames, double streamTime, RtAudioStreamStatus status );
+
   //! Protected common error method to allow global control over error handling.
   RtAudioErrorType error( RtAudioErrorType type );
 
@@ -898,6 +1640,24 @@ protected:
 
   //! Protected common method that sets up the parameters for buffer conversion.
   void setConvertInfo( StreamMode mode, unsigned int firstChannel );
+
+  //! Protected common method that selects the conversion plan for a ConvertInfo structure.
+  static void setConvertPlan( ConvertInfo &info );
+
+  // Conversion plans, specialized on the sample types and channel count.
+  template <typename OutType, typename InType>
+  static ConvertFunction findConvertPlan( const ConvertInfo &info );
+  template <typename OutType>
+  static ConvertFunction findConvertPlan( const ConvertInfo &info );
+  template <typename OutType, typename InType, int CHANNELS>
+  static void convertFrames( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames );
+  template <typename OutType, typename InType>
+  static void convertChannels( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames );
+  template <typename OutType, typename InType>
+  static void convertSamples( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames );
+  template <typename OutType, typename InType>
+  static void convertChannelsWithKernel( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames );
+  static void convertWithKernel( char *outBuffer, char *inBuffer, const ConvertInfo &info, unsigned int frames );
 };
 
 // **************************************************************** //
@@ -921,11 +1681,42 @@ inline const std::string RtAudio :: getErrorText( void ) { return rtapi_->getErr
 inline bool RtAudio :: isStreamOpen( void ) const { return rtapi_->isStreamOpen(); }
 inline bool RtAudio :: isStreamRunning( void ) const { return rtapi_->isStreamRunning(); }
 inline long RtAudio :: getStreamLatency( void ) { return rtapi_->getStreamLatency(); }
+inline RtAudio::StreamLatency RtAudio :: getStreamLatencies( void ) { return rtapi_->getStreamLatencies(); }
 inline unsigned int RtAudio :: getStreamSampleRate( void ) { return rtapi_->getStreamSampleRate(); }
 inline double RtAudio :: getStreamTime( void ) { return rtapi_->getStreamTime(); }
 inline void RtAudio :: setStreamTime( double time ) { return rtapi_->setStreamTime( time ); }
-inline void RtAudio :: setErrorCallback( RtAudioErrorCallback errorCallback ) { rtapi_->setErrorCallback( errorCallback ); }
-inline void RtAudio :: showWarnings( bool value ) { rtapi_->showWarnings( value ); }
+inline unsigned int RtAudio :: writeFrames( const void *buffer, unsigned int frames, bool wait ) { return rtapi_->writeFrames( buffer, frames, wait ); }
+inline unsigned int RtAudio :: readFrames( void *buffer, unsigned int frames, bool wait ) { return rtapi_->readFrames( buffer, frames, wait ); }
+inline unsigned int RtAudio :: getWriteAvailable( void ) { return rtapi_->getWriteAvailable(); }
+inline unsigned int RtAudio :: getReadAvailable( void ) { return rtapi_->getReadAvailable(); }
+inline RtAudioStreamStatus RtAudio :: getStreamStatus( void ) { return rtapi_->getStreamStatus(); }
+inline RtAudio::StreamStats RtAudio :: getStreamStats( void ) { return rtapi_->getStreamStats(); }
+inline void RtAudio :: resetStreamStats( void ) { rtapi_->resetStreamStats(); }
+inline RtAudio::StreamClock RtAudio :: getStreamClock( void ) { return rtapi_->getStreamClock(); }
+inline int RtAudio :: processOnce( int timeout ) { return rtapi_->processOnce( timeout ); }
+inline int RtAudio :: getStreamPollDescriptor( void ) { return rtapi_->getStreamPollDescriptor(); }
+inline void RtAudio :: closeStream( unsigned int streamId ) { RtApi *api = streamApi( streamId ); if ( api ) api->closeStream(); }
+inline RtAudioErrorType RtAudio :: startStream( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->startStream() : RTAUDIO_INVALID_USE; }
+inline RtAudioErrorType RtAudio :: stopStream( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->stopStream() : RTAUDIO_INVALID_USE; }
+inline RtAudioErrorType RtAudio :: abortStream( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->abortStream() : RTAUDIO_INVALID_USE; }
+inline const std::string RtAudio :: getErrorText( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getErrorText() : rtapi_->getErrorText(); }
+inline bool RtAudio :: isStreamOpen( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->isStreamOpen() : false; }
+inline bool RtAudio :: isStreamRunning( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->isStreamRunning() : false; }
+inline double RtAudio :: getStreamTime( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamTime() : 0.0; }
+inline void RtAudio :: setStreamTime( unsigned int streamId, double time ) { RtApi *api = streamApi( streamId ); if ( api ) api->setStreamTime( time ); }
+inline long RtAudio :: getStreamLatency( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamLatency() : 0; }
+inline RtAudio::StreamLatency RtAudio :: getStreamLatencies( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamLatencies() : RtAudio::StreamLatency(); }
+inline unsigned int RtAudio :: getStreamSampleRate( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamSampleRate() : 0; }
+inline unsigned int RtAudio :: writeFrames( unsigned int streamId, const void *buffer, unsigned int frames, bool wait ) { RtApi *api = streamApi( streamId ); return api ? api->writeFrames( buffer, frames, wait ) : 0; }
+inline unsigned int RtAudio :: readFrames( unsigned int streamId, void *buffer, unsigned int frames, bool wait ) { RtApi *api = streamApi( streamId ); return api ? api->readFrames( buffer, frames, wait ) : 0; }
+inline unsigned int RtAudio :: getWriteAvailable( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getWriteAvailable() : 0; }
+inline unsigned int RtAudio :: getReadAvailable( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getReadAvailable() : 0; }
+inline RtAudioStreamStatus RtAudio :: getStreamStatus( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamStatus() : 0; }
+inline RtAudio::StreamStats RtAudio :: getStreamStats( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamStats() : RtAudio::StreamStats(); }
+inline void RtAudio :: resetStreamStats( unsigned int streamId ) { RtApi *api = streamApi( streamId ); if ( api ) api->resetStreamStats(); }
+inline RtAudio::StreamClock RtAudio :: getStreamClock( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamClock() : RtAudio::StreamClock(); }
+inline int RtAudio :: processOnce( unsigned int streamId, int timeout ) { RtApi *api = streamApi( streamId ); return api ? api->processOnce( timeout ) : -1; }
+inline int RtAudio :: getStreamPollDescriptor( unsigned int streamId ) { RtApi *api = streamApi( streamId ); return api ? api->getStreamPollDescriptor() : -1; }
 
 #endif
 
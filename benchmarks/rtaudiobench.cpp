@@ -0,0 +1,287 @@
+/******************************************/
+/*
+  rtaudiobench.cpp
+
+  This program measures the cost of RtAudio's
+  sample conversions and of running a stream
+  period.  It reports one CSV row per case on
+  standard output, so that results can be
+  compared between builds and releases.
+
+  - convert:  RtApi::convertBuffer() for every
+    pair of sample formats, in both directions,
+    for interleaved and non-interleaved user
+    buffers.
+  - byteswap: RtApi::byteSwapBuffer() for each
+    multi-byte format.
+  - period:   the time per period of a free-running
+    stream on the null API (if compiled), from the
+    device through the callback and back.
+*/
+/******************************************/
+
+#include "RtAudio.h"
+#include "../tests/testapi.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+struct FormatName {
+  RtAudioFormat format;
+  const char *name;
+};
+
+static const FormatName FORMATS[] = {
+  { RTAUDIO_SINT8, "SINT8" },
+  { RTAUDIO_SINT16, "SINT16" },
+  { RTAUDIO_SINT24, "SINT24" },
+  { RTAUDIO_SINT32, "SINT32" },
+  { RTAUDIO_FLOAT32, "FLOAT32" },
+  { RTAUDIO_FLOAT64, "FLOAT64" },
+};
+static const unsigned int N_FORMATS = sizeof( FORMATS ) / sizeof( FORMATS[0] );
+
+struct Settings {
+  std::vector<unsigned int> channels;
+  unsigned int frames;
+  double trialTime;     // seconds per timing trial
+  unsigned int trials;  // the fastest trial is reported
+  unsigned int periods; // periods per stream run
+};
+
+void usage( void ) {
+  // Error function in case of incorrect command-line
+  // argument specifications
+  std::cout << "\nuseage: rtaudiobench <options> <benchmarks>\n";
+  std::cout << "    where benchmarks = any of 'convert', 'byteswap' and 'period' (default = all),\n";
+  std::cout << "    and options are:\n";
+  std::cout << "      --channels N,N,...  channel counts (default = 1,2,4,6,8,16,32,64,128),\n";
+  std::cout << "      --frames N          frames per buffer (default = 512),\n";
+  std::cout << "      --time MS           milliseconds per timing trial (default = 2),\n";
+  std::cout << "      --trials N          trials per case, the fastest is reported (default = 5),\n";
+  std::cout << "      --periods N         periods per stream run (default = 2000).\n\n";
+  exit( 0 );
+}
+
+void printRow( const char *benchmark, const char *direction, const char *userFormat,
+               const char *deviceFormat, unsigned int channels, const char *layout,
+               unsigned int frames, double seconds )
+{
+  double nanoseconds = seconds * 1e9;
+  std::cout << benchmark << ',' << direction << ',' << userFormat << ',' << deviceFormat << ','
+            << channels << ',' << layout << ',' << frames << ',' << nanoseconds << ','
+            << nanoseconds / ( (double) frames * channels ) << std::endl;
+}
+
+// Returns the fastest time per call of a function, over several
+// trials each running for (at least) the trial time.
+template <typename Function>
+double timeCalls( const Settings &settings, Function function )
+{
+  unsigned long calls = 1;
+  for ( ;; ) { // calibrate
+    Clock::time_point start = Clock::now();
+    for ( unsigned long i=0; i<calls; i++ ) function();
+    if ( std::chrono::duration<double>( Clock::now() - start ).count() >= settings.trialTime / 4 ) break;
+    calls *= 2;
+  }
+  calls *= 4;
+
+  double best = 0.0;
+  for ( unsigned int t=0; t<settings.trials; t++ ) {
+    Clock::time_point start = Clock::now();
+    for ( unsigned long i=0; i<calls; i++ ) function();
+    double time = std::chrono::duration<double>( Clock::now() - start ).count() / calls;
+    if ( t == 0 || time < best ) best = time;
+  }
+  return best;
+}
+
+// Times the conversions of the library on a device-less stream.
+class BenchApi : public TestApi
+{
+public:
+
+  void runConvert( const Settings &settings )
+  {
+    const char *layouts[2] = { "interleaved", "noninterleaved" };
+    for ( int mode=OUTPUT; mode<=INPUT; mode++ ) {
+      for ( unsigned int u=0; u<N_FORMATS; u++ ) {
+        for ( unsigned int d=0; d<N_FORMATS; d++ ) {
+          for ( unsigned int c=0; c<settings.channels.size(); c++ ) {
+            for ( int layout=0; layout<2; layout++ ) {
+              unsigned int channels = settings.channels[c];
+              if ( layout == 1 && channels == 1 ) continue; // same as interleaved
+              closeTestStream();
+              openTestStream( (StreamMode) mode, 48000, settings.frames, FORMATS[u].format,
+                              FORMATS[d].format, channels, layout == 0 );
+              ConvertInfo &info = stream_.convertInfo[mode];
+              char *out = ( mode == OUTPUT ) ? stream_.deviceBuffer : stream_.userBuffer[mode];
+              char *in = ( mode == OUTPUT ) ? stream_.userBuffer[mode] : stream_.deviceBuffer;
+              double time = timeCalls( settings, [&]() { convertBuffer( out, in, info ); } );
+              printRow( "convert", mode == OUTPUT ? "output" : "input", FORMATS[u].name,
+                        FORMATS[d].name, channels, layouts[layout], settings.frames, time );
+            }
+          }
+        }
+      }
+    }
+    closeTestStream();
+  }
+
+  void runByteSwap( const Settings &settings )
+  {
+    for ( unsigned int f=0; f<N_FORMATS; f++ ) {
+      RtAudioFormat format = FORMATS[f].format;
+      if ( format == RTAUDIO_SINT8 ) continue;
+      for ( unsigned int c=0; c<settings.channels.size(); c++ ) {
+        unsigned int channels = settings.channels[c];
+        unsigned int samples = settings.frames * channels;
+        std::vector<char> buffer( samples * formatBytes( format ) );
+        double time = timeCalls( settings, [&]() { byteSwapBuffer( &buffer[0], samples, format ); } );
+        printRow( "byteswap", "", FORMATS[f].name, FORMATS[f].name, channels, "interleaved",
+                  settings.frames, time );
+      }
+    }
+  }
+
+};
+
+struct PeriodData {
+  unsigned int periods;
+  unsigned int callbacks;
+};
+
+int period( void * /*outputBuffer*/, void * /*inputBuffer*/, unsigned int /*nBufferFrames*/,
+            double /*streamTime*/, RtAudioStreamStatus /*status*/, void *userData )
+{
+  PeriodData *data = (PeriodData *) userData;
+  if ( ++data->callbacks == data->periods ) return 1;
+  return 0;
+}
+
+void runPeriod( const Settings &settings )
+{
+  std::vector<RtAudio::Api> apis;
+  RtAudio::getCompiledApi( apis );
+  bool found = false;
+  for ( unsigned int i=0; i<apis.size(); i++ )
+    if ( apis[i] == RtAudio::RTAUDIO_NULL ) found = true;
+  if ( !found ) {
+    std::cerr << "rtaudiobench: the null API is not compiled, skipping the period benchmark.\n";
+    return;
+  }
+
+  RtAudio audio( RtAudio::RTAUDIO_NULL );
+  audio.showWarnings( false );
+  std::vector<unsigned int> deviceIds = audio.getDeviceIds();
+  for ( unsigned int n=0; n<deviceIds.size(); n++ ) {
+    RtAudio::DeviceInfo info = audio.getDeviceInfo( deviceIds[n] );
+    const char *deviceFormat = info.name.c_str();
+    for ( unsigned int f=0; f<N_FORMATS; f++ )
+      if ( info.nativeFormats == FORMATS[f].format ) deviceFormat = FORMATS[f].name;
+    bool swapped = ( info.name.find( "byte-swapped" ) != std::string::npos );
+
+    // Only a few devices are of interest: the FLOAT32 one (no
+    // conversion), the SINT16 one and its byte-swapped twin.
+    if ( info.nativeFormats != RTAUDIO_FLOAT32 && info.nativeFormats != RTAUDIO_SINT16 ) continue;
+    if ( swapped && info.nativeFormats != RTAUDIO_SINT16 ) continue;
+
+    for ( unsigned int c=0; c<settings.channels.size(); c++ ) {
+      for ( int duplex=0; duplex<2; duplex++ ) {
+        RtAudio::StreamParameters parameters;
+        parameters.deviceId = deviceIds[n];
+        parameters.nChannels = settings.channels[c];
+        RtAudio::StreamOptions options;
+        options.flags = RTAUDIO_NULL_FREE_RUN;
+        unsigned int frames = settings.frames;
+        PeriodData data;
+        data.periods = settings.periods;
+
+        double best = 0.0;
+        for ( unsigned int t=0; t<settings.trials; t++ ) {
+          data.callbacks = 0;
+          if ( audio.openStream( &parameters, duplex ? &parameters : NULL, RTAUDIO_FLOAT32,
+                                 48000, &frames, &period, (void *) &data, &options ) )
+            return;
+          Clock::time_point start = Clock::now();
+          audio.startStream();
+          while ( audio.isStreamRunning() )
+            std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+          double time = std::chrono::duration<double>( Clock::now() - start ).count() / data.callbacks;
+          audio.closeStream();
+          if ( t == 0 || time < best ) best = time;
+        }
+
+        std::string name = std::string( deviceFormat ) + ( swapped ? "_SWAPPED" : "" );
+        printRow( "period", duplex ? "duplex" : "output", "FLOAT32", name.c_str(),
+                  settings.channels[c], "interleaved", frames, best );
+      }
+    }
+  }
+}
+
+std::vector<unsigned int> parseList( const char *text )
+{
+  std::vector<unsigned int> values;
+  while ( *text ) {
+    char *end;
+    unsigned long value = strtoul( text, &end, 10 );
+    if ( end == text || value == 0 ) usage();
+    values.push_back( (unsigned int) value );
+    text = ( *end == ',' ) ? end + 1 : end;
+    if ( *end && *end != ',' ) usage();
+  }
+  return values;
+}
+
+int main( int argc, char *argv[] )
+{
+  Settings settings;
+  const unsigned int channels[] = { 1, 2, 4, 6, 8, 16, 32, 64, 128 };
+  settings.channels.assign( channels, channels + sizeof( channels ) / sizeof( channels[0] ) );
+  settings.frames = 512;
+  settings.trialTime = 0.002;
+  settings.trials = 5;
+  settings.periods = 2000;
+
+  bool runAll = true, convert = false, byteswap = false, periods = false;
+  for ( int i=1; i<argc; i++ ) {
+    std::string arg( argv[i] );
+    bool hasValue = ( i + 1 < argc );
+    if ( arg == "--channels" && hasValue ) settings.channels = parseList( argv[++i] );
+    else if ( arg == "--frames" && hasValue ) settings.frames = (unsigned int) atoi( argv[++i] );
+    else if ( arg == "--time" && hasValue ) settings.trialTime = atof( argv[++i] ) / 1000.0;
+    else if ( arg == "--trials" && hasValue ) settings.trials = (unsigned int) atoi( argv[++i] );
+    else if ( arg == "--periods" && hasValue ) settings.periods = (unsigned int) atoi( argv[++i] );
+    else if ( arg == "convert" ) { convert = true; runAll = false; }
+    else if ( arg == "byteswap" ) { byteswap = true; runAll = false; }
+    else if ( arg == "period" ) { periods = true; runAll = false; }
+    else usage();
+  }
+  if ( settings.channels.empty() || settings.frames == 0 || settings.trialTime <= 0.0 ||
+       settings.trials == 0 || settings.periods == 0 )
+    usage();
+
+  std::cout << "# RtAudio " << RtAudio::getVersion() << '\n';
+  std::cout << "benchmark,direction,user_format,device_format,channels,layout,frames,ns_per_period,ns_per_sample" << std::endl;
+
+  if ( runAll || convert ) {
+    BenchApi api;
+    api.runConvert( settings );
+  }
+  if ( runAll || byteswap ) {
+    BenchApi api;
+    api.runByteSwap( settings );
+  }
+  if ( runAll || periods )
+    runPeriod( settings );
+
+  return 0;
+}
@@ -9,6 +9,7 @@ struct rtaudio {
   RtAudio *audio;
 
   rtaudio_cb_t cb;
+  rtaudio_planar_cb_t planar_cb;
   void *userdata;
 
   rtaudio_error_t errtype;
@@ -130,23 +131,34 @@ static int proxy_cb_func(void *out, void *in, unsigned int nframes, double time,
                    audio->userdata);
 }
 
-rtaudio_error_t rtaudio_open_stream(rtaudio_t audio,
-                        rtaudio_stream_parameters_t *output_params,
-                        rtaudio_stream_parameters_t *input_params,
-                        rtaudio_format_t format, unsigned int sample_rate,
-                        unsigned int *buffer_frames, rtaudio_cb_t cb,
-                        void *userdata, rtaudio_stream_options_t *options,
-                        rtaudio_error_cb_t /*errcb*/)
-{
-  audio->errtype = RTAUDIO_ERROR_NONE;
-  RtAudio::StreamParameters *in = NULL;
-  RtAudio::StreamParameters *out = NULL;
-  RtAudio::StreamOptions *opts = NULL;
+static int proxy_planar_cb_func(float *const *out, const float *const *in,
+                                unsigned int nframes, double time,
+                                RtAudioStreamStatus status, void *userdata) {
+  rtaudio_t audio = (rtaudio_t)userdata;
+  return audio->planar_cb(out, in, nframes, time,
+                          (rtaudio_stream_status_t)status, audio->userdata);
+}
+
+// The stream parameters and options of rtaudio_open_stream() and
+// rtaudio_open_stream_planar(), converted for RtAudio::openStream().
+struct stream_setup {
+  RtAudio::StreamParameters *in;
+  RtAudio::StreamParameters *out;
+  RtAudio::StreamOptions *opts;
 
   RtAudio::StreamParameters inparams;
   RtAudio::StreamParameters outparams;
   RtAudio::StreamOptions stream_opts;
 
+  stream_setup(rtaudio_stream_parameters_t *output_params,
+               rtaudio_stream_parameters_t *input_params,
+               rtaudio_stream_options_t *options);
+};
+
+stream_setup::stream_setup(rtaudio_stream_parameters_t *output_params,
+                           rtaudio_stream_parameters_t *input_params,
+                           rtaudio_stream_options_t *options)
+    : in(NULL), out(NULL), opts(NULL) {
   if (input_params != NULL) {
     inparams.deviceId = input_params->device_id;
     inparams.nChannels = input_params->num_channels;
@@ -167,12 +179,74 @@ rtaudio_error_t rtaudio_open_stream(rtaudio_t audio,
     if (strlen(options->name) > 0) {
       stream_opts.streamName = std::string(options->name);
     }
+    stream_opts.ringBufferFrames = options->ring_buffer_frames;
+    if (options->output_file)
+      stream_opts.outputFile = std::string(options->output_file);
+    if (options->input_file)
+      stream_opts.inputFile = std::string(options->input_file);
+    for (unsigned int i = 0; i < options->num_aggregate_outputs; i++) {
+      const rtaudio_stream_parameters_t &p = options->aggregate_outputs[i];
+      RtAudio::StreamParameters params;
+      params.deviceId = p.device_id;
+      params.nChannels = p.num_channels;
+      params.firstChannel = p.first_channel;
+      stream_opts.aggregateOutputs.push_back(params);
+    }
+    for (unsigned int i = 0; i < options->num_aggregate_inputs; i++) {
+      const rtaudio_stream_parameters_t &p = options->aggregate_inputs[i];
+      RtAudio::StreamParameters params;
+      params.deviceId = p.device_id;
+      params.nChannels = p.num_channels;
+      params.firstChannel = p.first_channel;
+      stream_opts.aggregateInputs.push_back(params);
+    }
+    stream_opts.schedulingPolicy = (RtAudio::SchedulingPolicy)options->scheduling_policy;
+    for (unsigned int i = 0; i < options->num_cpu_affinity; i++)
+      stream_opts.cpuAffinity.push_back(options->cpu_affinity[i]);
+    stream_opts.lockMemory = options->lock_memory != 0;
+    if (options->deadline_runtime > 0)
+      stream_opts.deadlineRuntime = options->deadline_runtime;
     opts = &stream_opts;
   }
+}
+
+void rtaudio_stream_options_init(rtaudio_stream_options_t *options) {
+  std::memset(options, 0, sizeof(*options));
+}
+
+rtaudio_error_t rtaudio_open_stream(rtaudio_t audio,
+                        rtaudio_stream_parameters_t *output_params,
+                        rtaudio_stream_parameters_t *input_params,
+                        rtaudio_format_t format, unsigned int sample_rate,
+                        unsigned int *buffer_frames, rtaudio_cb_t cb,
+                        void *userdata, rtaudio_stream_options_t *options,
+                        rtaudio_error_cb_t /*errcb*/)
+{
+  audio->errtype = RTAUDIO_ERROR_NONE;
+  stream_setup setup(output_params, input_params, options);
   audio->cb = cb;
   audio->userdata = userdata;
-  audio->audio->openStream(out, in, (RtAudioFormat)format, sample_rate,
-                           buffer_frames, proxy_cb_func, (void *)audio, opts); //,  NULL);
+  audio->audio->openStream(setup.out, setup.in, (RtAudioFormat)format, sample_rate,
+                           buffer_frames, cb ? proxy_cb_func : NULL, (void *)audio, setup.opts); //,  NULL);
+  if (options != NULL)
+    options->ring_buffer_frames = setup.stream_opts.ringBufferFrames;
+  return audio->errtype;
+}
+
+rtaudio_error_t rtaudio_open_stream_planar(rtaudio_t audio,
+                        rtaudio_stream_parameters_t *output_params,
+                        rtaudio_stream_parameters_t *input_params,
+                        unsigned int sample_rate, unsigned int *buffer_frames,
+                        rtaudio_planar_cb_t cb, void *userdata,
+                        rtaudio_stream_options_t *options)
+{
+  audio->errtype = RTAUDIO_ERROR_NONE;
+  stream_setup setup(output_params, input_params, options);
+  audio->planar_cb = cb;
+  audio->userdata = userdata;
+  RtAudioPlanarCallback callback = cb ? proxy_planar_cb_func : NULL;
+  audio->audio->openStream(setup.out, setup.in, sample_rate, buffer_frames,
+                           callback, (void *)audio, setup.opts);
   return audio->errtype;
 }
 
@@ -219,6 +293,18 @@ long rtaudio_get_stream_latency(rtaudio_t audio) {
   return audio->audio->getStreamLatency();
 }
 
+rtaudio_stream_latency_t rtaudio_get_stream_latencies(rtaudio_t audio) {
+  RtAudio::StreamLatency latency = audio->audio->getStreamLatencies();
+  rtaudio_stream_latency_t result;
+  result.output_frames = latency.outputFrames;
+  result.input_frames = latency.inputFrames;
+  result.round_trip_frames = latency.roundTripFrames;
+  result.output_nanos = latency.outputNanos;
+  result.input_nanos = latency.inputNanos;
+  result.round_trip_nanos = latency.roundTripNanos;
+  return result;
+}
+
 unsigned int rtaudio_get_stream_sample_rate(rtaudio_t audio) {
   audio->errtype = RTAUDIO_ERROR_NONE;
   return audio->audio->getStreamSampleRate();
@@ -227,3 +313,63 @@ unsigned int rtaudio_get_stream_sample_rate(rtaudio_t audio) {
 void rtaudio_show_warnings(rtaudio_t audio, int show) {
   audio->audio->showWarnings(!!show);
 }
+
+unsigned int rtaudio_write_frames(rtaudio_t audio, const void *buffer,
+                                  unsigned int frames, int wait) {
+  audio->errtype = RTAUDIO_ERROR_NONE;
+  return audio->audio->writeFrames(buffer, frames, !!wait);
+}
+
+unsigned int rtaudio_read_frames(rtaudio_t audio, void *buffer,
+                                 unsigned int frames, int wait) {
+  audio->errtype = RTAUDIO_ERROR_NONE;
+  return audio->audio->readFrames(buffer, frames, !!wait);
+}
+
+rtaudio_stream_status_t rtaudio_get_stream_status(rtaudio_t audio) {
+  return (rtaudio_stream_status_t)audio->audio->getStreamStatus();
+}
+
+rtaudio_stream_stats_t rtaudio_get_stream_stats(rtaudio_t audio) {
+  RtAudio::StreamStats stats = audio->audio->getStreamStats();
+  rtaudio_stream_stats_t result;
+  result.callbacks = stats.callbacks;
+  for (unsigned int i = 0; i < RTAUDIO_STATS_HISTOGRAM_BINS; i++)
+    result.duration_histogram[i] = stats.durationHistogram[i];
+  result.mean_callback_time = stats.meanCallbackTime;
+  result.max_callback_time = stats.maxCallbackTime;
+  result.mean_wakeup_jitter = stats.meanWakeupJitter;
+  result.max_wakeup_jitter = stats.maxWakeupJitter;
+  result.mean_convert_time = stats.meanConvertTime;
+  result.max_convert_time = stats.maxConvertTime;
+  result.output_underflows = stats.outputUnderflows;
+  result.input_overflows = stats.inputOverflows;
+  result.mutex_blocked_time = stats.mutexBlockedTime;
+  result.drift_devices = stats.driftDevices;
+  for (unsigned int i = 0; i < RTAUDIO_STATS_MAX_DRIFT_DEVICES; i++)
+    result.drift[i] = stats.drift[i];
+  return result;
+}
+
+void rtaudio_reset_stream_stats(rtaudio_t audio) {
+  audio->audio->resetStreamStats();
+}
+
+rtaudio_stream_clock_t rtaudio_get_stream_clock(rtaudio_t audio) {
+  RtAudio::StreamClock clock = audio->audio->getStreamClock();
+  rtaudio_stream_clock_t result;
+  result.frame_position = clock.framePosition;
+  result.output_time = clock.outputTime;
+  result.input_time = clock.inputTime;
+  result.output_timestamped = clock.outputTimestamped;
+  result.input_timestamped = clock.inputTimestamped;
+  return result;
+}
+
+int rtaudio_process_once(rtaudio_t audio, int timeout) {
+  return audio->audio->processOnce(timeout);
+}
+
+int rtaudio_get_stream_poll_descriptor(rtaudio_t audio) {
+  return audio->audio->getStreamPollDescriptor();
+}
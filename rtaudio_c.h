@@ -65,6 +65,14 @@ typedef unsigned long rtaudio_format_t;
     - \e RTAUDIO_FLAGS_HOG_DEVICE:       Attempt grab device for exclusive use.
     - \e RTAUDIO_FLAGS_ALSA_USE_DEFAULT: Use the "default" PCM device (ALSA only).
     - \e RTAUDIO_FLAGS_JACK_DONT_CONNECT: Do not automatically connect ports (JACK only).
+    - \e RTAUDIO_FLAGS_ALSA_USE_MMAP:   Use mmap access to the device buffers (ALSA only).
+    - \e RTAUDIO_FLAGS_ALSA_USE_POLL:   Wait for periods with poll() (ALSA only).
+    - \e RTAUDIO_FLAGS_COLLECT_STATS:   Collect callback timing statistics.
+    - \e RTAUDIO_FLAGS_NULL_FREE_RUN:   Process periods as fast as possible (null API only).
+    - \e RTAUDIO_FLAGS_DRIFT_COMPENSATION: Resample duplex input to the output device clock (ALSA and OSS only).
+    - \e RTAUDIO_FLAGS_CONVERT_SAMPLE_RATE: Resample when the device cannot run at the stream rate (ALSA, JACK and PulseAudio only).
+    - \e RTAUDIO_FLAGS_OSS_USE_MMAP:   Use mmap access to the device buffers, with poll() wakeups (OSS only).
+    - \e RTAUDIO_FLAGS_EXTERNAL_THREAD: Drive the stream with rtaudio_process_once() instead of a callback thread (ALSA, OSS and PulseAudio only).
 
     See \ref RtAudioStreamFlags.
 */
@@ -76,6 +84,14 @@ typedef unsigned int rtaudio_stream_flags_t;
 #define RTAUDIO_FLAGS_SCHEDULE_REALTIME 0x8
 #define RTAUDIO_FLAGS_ALSA_USE_DEFAULT 0x10
 #define RTAUDIO_FLAGS_JACK_DONT_CONNECT 0x20
+#define RTAUDIO_FLAGS_ALSA_USE_MMAP 0x40
+#define RTAUDIO_FLAGS_ALSA_USE_POLL 0x80
+#define RTAUDIO_FLAGS_COLLECT_STATS 0x100
+#define RTAUDIO_FLAGS_NULL_FREE_RUN 0x200
+#define RTAUDIO_FLAGS_DRIFT_COMPENSATION 0x400
+#define RTAUDIO_FLAGS_CONVERT_SAMPLE_RATE 0x800
+#define RTAUDIO_FLAGS_OSS_USE_MMAP 0x1000
+#define RTAUDIO_FLAGS_EXTERNAL_THREAD 0x2000
 
 /*! \typedef typedef unsigned long rtaudio_stream_status_t;
     \brief RtAudio stream status (over- or underflow) flags.
@@ -108,6 +124,18 @@ typedef int (*rtaudio_cb_t)(void *out, void *in, unsigned int nFrames,
                             double stream_time, rtaudio_stream_status_t status,
                             void *userdata);
 
+//! RtAudio planar callback function prototype.
+/*!
+   A callback of this type receives a pointer to the FLOAT32 samples
+   of each channel.
+
+   See \ref RtAudioPlanarCallback.
+ */
+typedef int (*rtaudio_planar_cb_t)(float *const *out, const float *const *in,
+                                   unsigned int nFrames, double stream_time,
+                                   rtaudio_stream_status_t status,
+                                   void *userdata);
+
 /*! \brief Error codes for RtAudio.
 
     See \ref RtAudioError.
@@ -149,10 +177,20 @@ enum rtaudio_api {
   RTAUDIO_API_WINDOWS_WASAPI, /*!< The Microsoft WASAPI API. */
   RTAUDIO_API_WINDOWS_DS,     /*!< The Microsoft DirectSound API. */
   RTAUDIO_API_DUMMY,          /*!< A compilable but non-functional API. */
+  RTAUDIO_API_NULL,           /*!< A device-less API that reads and writes files. */
+  RTAUDIO_API_LINUX_PIPEWIRE, /*!< The Linux PipeWire API. */
   RTAUDIO_API_NUM,            /*!< Number of values in this enum. */
 };
 typedef int rtaudio_api_t;
 
+//! Realtime scheduling policy of the callback thread.  See \ref RtAudio::SchedulingPolicy.
+enum rtaudio_scheduling_policy {
+  RTAUDIO_SCHEDULE_RR,        /*!< Round-robin realtime scheduling (SCHED_RR). */
+  RTAUDIO_SCHEDULE_FIFO,      /*!< First-in first-out realtime scheduling (SCHED_FIFO). */
+  RTAUDIO_SCHEDULE_DEADLINE,  /*!< Earliest deadline first scheduling (SCHED_DEADLINE, Linux only). */
+};
+typedef int rtaudio_scheduling_policy_t;
+
 #define NUM_SAMPLE_RATES 16
 #define MAX_NAME_LENGTH 512
 
@@ -184,14 +222,74 @@ typedef struct rtaudio_stream_parameters {
 } rtaudio_stream_parameters_t;
 
 //! The structure for specifying stream options.
-//! See \ref RtAudio::StreamOptions.
+//! See \ref RtAudio::StreamOptions.  Members are added to this
+//! structure as the library grows, so it must be zero-initialized
+//! (or set up with rtaudio_stream_options_init()) before the members
+//! in use are filled in; a zero member keeps its default.
 typedef struct rtaudio_stream_options {
   rtaudio_stream_flags_t flags;
   unsigned int num_buffers;
   int priority;
   char name[MAX_NAME_LENGTH];
+  unsigned int ring_buffer_frames;
+  const char *output_file;
+  const char *input_file;
+  const rtaudio_stream_parameters_t *aggregate_outputs;
+  unsigned int num_aggregate_outputs;
+  const rtaudio_stream_parameters_t *aggregate_inputs;
+  unsigned int num_aggregate_inputs;
+  rtaudio_scheduling_policy_t scheduling_policy;
+  const unsigned int *cpu_affinity;
+  unsigned int num_cpu_affinity;
+  int lock_memory;
+  double deadline_runtime;
 } rtaudio_stream_options_t;
 
+//! The number of bins in the callback duration histogram.
+#define RTAUDIO_STATS_HISTOGRAM_BINS 12
+
+//! The largest number of aggregate devices with a drift estimate.
+#define RTAUDIO_STATS_MAX_DRIFT_DEVICES 8
+
+//! The structure returned by rtaudio_get_stream_stats().  Times are
+//! in seconds.  See \ref RtAudio::StreamStats.
+typedef struct rtaudio_stream_stats {
+  unsigned long long callbacks;
+  unsigned long long duration_histogram[RTAUDIO_STATS_HISTOGRAM_BINS];
+  double mean_callback_time;
+  double max_callback_time;
+  double mean_wakeup_jitter;
+  double max_wakeup_jitter;
+  double mean_convert_time;
+  double max_convert_time;
+  unsigned long long output_underflows;
+  unsigned long long input_overflows;
+  double mutex_blocked_time;
+  unsigned int drift_devices;
+  double drift[RTAUDIO_STATS_MAX_DRIFT_DEVICES];
+} rtaudio_stream_stats_t;
+
+//! The structure returned by rtaudio_get_stream_clock().  Times are
+//! in nanoseconds of the monotonic clock.  See \ref RtAudio::StreamClock.
+typedef struct rtaudio_stream_clock {
+  unsigned long long frame_position;
+  long long output_time;
+  long long input_time;
+  int output_timestamped;
+  int input_timestamped;
+} rtaudio_stream_clock_t;
+
+//! The structure returned by rtaudio_get_stream_latencies().  See
+//! \ref RtAudio::StreamLatency.
+typedef struct rtaudio_stream_latency {
+  unsigned long output_frames;
+  unsigned long input_frames;
+  unsigned long round_trip_frames;
+  long long output_nanos;
+  long long input_nanos;
+  long long round_trip_nanos;
+} rtaudio_stream_latency_t;
+
 typedef struct rtaudio *rtaudio_t;
 
 //! Determine the current RtAudio version.  See \ref RtAudio::getVersion().
@@ -259,7 +357,13 @@ RTAUDIOAPI unsigned int rtaudio_get_default_output_device(rtaudio_t audio);
 //! RtAudio::getDefaultInputDevice().
 RTAUDIOAPI unsigned int rtaudio_get_default_input_device(rtaudio_t audio);
 
+//! Sets all members of a stream options structure to their defaults
+//! (zero).
+RTAUDIOAPI void rtaudio_stream_options_init(rtaudio_stream_options_t *options);
+
 //! Opens a stream with the specified parameters.  See \ref RtAudio::openStream().
+//! If \c cb is NULL, audio data is exchanged with rtaudio_write_frames()
+//! and rtaudio_read_frames() instead.
 //! \return an \ref rtaudio_error.
 RTAUDIOAPI rtaudio_error_t
 rtaudio_open_stream(rtaudio_t audio, rtaudio_stream_parameters_t *output_params,
@@ -269,6 +373,16 @@ rtaudio_open_stream(rtaudio_t audio, rtaudio_stream_parameters_t *output_params,
                     void *userdata, rtaudio_stream_options_t *options,
                     rtaudio_error_cb_t errcb);
 
+//! Opens a non-interleaved FLOAT32 stream with a planar callback,
+//! which cannot be NULL.  See \ref RtAudio::openStream().
+//! \return an \ref rtaudio_error.
+RTAUDIOAPI rtaudio_error_t
+rtaudio_open_stream_planar(rtaudio_t audio, rtaudio_stream_parameters_t *output_params,
+                           rtaudio_stream_parameters_t *input_params,
+                           unsigned int sample_rate, unsigned int *buffer_frames,
+                           rtaudio_planar_cb_t cb, void *userdata,
+                           rtaudio_stream_options_t *options);
+
 //! Closes a stream and frees any associated stream memory.  See \ref RtAudio::closeStream().
 RTAUDIOAPI void rtaudio_close_stream(rtaudio_t audio);
 
@@ -302,6 +416,10 @@ RTAUDIOAPI void rtaudio_set_stream_time(rtaudio_t audio, double time);
 //! RtAudio::getStreamLatency().
 RTAUDIOAPI long rtaudio_get_stream_latency(rtaudio_t audio);
 
+//! Returns the input, output and round-trip latencies of the stream.
+//! See \ref RtAudio::getStreamLatencies().
+RTAUDIOAPI rtaudio_stream_latency_t rtaudio_get_stream_latencies(rtaudio_t audio);
+
 //! Returns actual sample rate in use by the stream.  See \ref
 //! RtAudio::getStreamSampleRate().
 RTAUDIOAPI unsigned int rtaudio_get_stream_sample_rate(rtaudio_t audio);
@@ -310,6 +428,43 @@ RTAUDIOAPI unsigned int rtaudio_get_stream_sample_rate(rtaudio_t audio);
 //! \ref RtAudio::showWarnings().
 RTAUDIOAPI void rtaudio_show_warnings(rtaudio_t audio, int show);
 
+//! Queue output frames for a stream opened without a callback,
+//! waiting for space if \c wait is non-zero.  Returns the number of
+//! frames queued.  See \ref RtAudio::writeFrames().
+RTAUDIOAPI unsigned int rtaudio_write_frames(rtaudio_t audio, const void *buffer,
+                                             unsigned int frames, int wait);
+
+//! Retrieve input frames from a stream opened without a callback,
+//! waiting for data if \c wait is non-zero.  Returns the number of
+//! frames read.  See \ref RtAudio::readFrames().
+RTAUDIOAPI unsigned int rtaudio_read_frames(rtaudio_t audio, void *buffer,
+                                            unsigned int frames, int wait);
+
+//! Returns and clears the stream status collected since the last
+//! call.  See \ref RtAudio::getStreamStatus().
+RTAUDIOAPI rtaudio_stream_status_t rtaudio_get_stream_status(rtaudio_t audio);
+
+//! Returns a snapshot of the statistics collected for a stream opened
+//! with RTAUDIO_FLAGS_COLLECT_STATS.  See \ref RtAudio::getStreamStats().
+RTAUDIOAPI rtaudio_stream_stats_t rtaudio_get_stream_stats(rtaudio_t audio);
+
+//! Clears the statistics collected for the stream.  See \ref
+//! RtAudio::resetStreamStats().
+RTAUDIOAPI void rtaudio_reset_stream_stats(rtaudio_t audio);
+
+//! Returns the clock of the current or last buffer period of the
+//! stream.  See \ref RtAudio::getStreamClock().
+RTAUDIOAPI rtaudio_stream_clock_t rtaudio_get_stream_clock(rtaudio_t audio);
+
+//! Processes the next period of a stream opened with
+//! RTAUDIO_FLAGS_EXTERNAL_THREAD, waiting up to \c timeout
+//! milliseconds.  See \ref RtAudio::processOnce().
+RTAUDIOAPI int rtaudio_process_once(rtaudio_t audio, int timeout);
+
+//! Returns a descriptor that polls readable when the stream has a
+//! period to process, or -1.  See \ref RtAudio::getStreamPollDescriptor().
+RTAUDIOAPI int rtaudio_get_stream_poll_descriptor(rtaudio_t audio);
+
 #ifdef __cplusplus
 }
 #endif
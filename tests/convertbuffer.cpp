@@ -0,0 +1,195 @@
+/******************************************/
+/*
+  convertbuffer.cpp
+
+  This program checks the vectorized sample
+  conversions of RtApi::convertBuffer() against
+  the scalar reference conversions, for every
+  conversion that has a kernel (FLOAT32 to and
+  from SINT16, SINT24, SINT32 and FLOAT64), in
+  both directions, for interleaved and
+  non-interleaved user buffers, and for channel
+  and frame counts that leave partial vectors.
+  The results must be identical.
+
+  The kernels used are those of the machine,
+  unless limited with the RTAUDIO_SIMD
+  environment variable ("none", "sse2" or
+  "avx2"), so that each instruction set is
+  tested by running the program once per value.
+*/
+/******************************************/
+
+#include "testapi.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+static const RtAudioFormat FORMATS[] = { RTAUDIO_SINT16, RTAUDIO_SINT24, RTAUDIO_SINT32, RTAUDIO_FLOAT64 };
+static const char *FORMAT_NAMES[] = { "SINT16", "SINT24", "SINT32", "FLOAT64" };
+static const unsigned int CHANNELS[] = { 1, 2, 3, 6, 8 };
+static const unsigned int FRAMES[] = { 1, 3, 7, 16, 31, 257 };
+
+// The scalar conversions of RtAudio, which define the results.
+static long long clampRound( double x, long long lo, long long hi )
+{
+  return std::max( std::min( std::llround( x ), hi ), lo );
+}
+
+static void referenceConvert( RtAudioFormat outFormat, char *out, RtAudioFormat inFormat, const char *in )
+{
+  if ( inFormat == RTAUDIO_FLOAT32 ) {
+    float x;
+    memcpy( &x, in, sizeof( x ) );
+    if ( outFormat == RTAUDIO_SINT16 ) {
+      short y = (short) clampRound( x * 32768.f, -32768LL, 32767LL );
+      memcpy( out, &y, sizeof( y ) );
+    }
+    else if ( outFormat == RTAUDIO_SINT24 ) {
+      int y = (int) clampRound( x * 8388608.f, -8388608LL, 8388607LL );
+      for ( int i=0; i<3; i++ ) out[i] = (char) ( ( y >> ( 8 * i ) ) & 0xff );
+    }
+    else if ( outFormat == RTAUDIO_SINT32 ) {
+      int y = (int) clampRound( x * 2147483648.f, -2147483648LL, 2147483647LL );
+      memcpy( out, &y, sizeof( y ) );
+    }
+    else {
+      double y = (double) x;
+      memcpy( out, &y, sizeof( y ) );
+    }
+    return;
+  }
+
+  float y;
+  if ( inFormat == RTAUDIO_SINT16 ) {
+    short x;
+    memcpy( &x, in, sizeof( x ) );
+    y = (float) x / 32768.f;
+  }
+  else if ( inFormat == RTAUDIO_SINT24 ) {
+    // The pad byte is ignored.
+    int x = (unsigned char) in[0] | ( (unsigned char) in[1] << 8 ) | ( (signed char) in[2] * 65536 );
+    y = (float) x / 8388608.f;
+  }
+  else if ( inFormat == RTAUDIO_SINT32 ) {
+    int x;
+    memcpy( &x, in, sizeof( x ) );
+    y = (float) x / 2147483648.f;
+  }
+  else {
+    double x;
+    memcpy( &x, in, sizeof( x ) );
+    y = (float) x;
+  }
+  memcpy( out, &y, sizeof( y ) );
+}
+
+// Runs the conversions of the library on a device-less stream.
+class ConvertApi : public TestApi
+{
+public:
+
+  // Converts between a user buffer and an interleaved device buffer,
+  // and compares every sample with the reference conversion.
+  bool check( bool input, RtAudioFormat userFormat, RtAudioFormat deviceFormat,
+              unsigned int channels, unsigned int frames, bool interleaved )
+  {
+    StreamMode mode = input ? INPUT : OUTPUT;
+    closeTestStream();
+    openTestStream( mode, 48000, frames, userFormat, deviceFormat, channels, interleaved );
+    RtAudioFormat inFormat = ( mode == OUTPUT ) ? userFormat : deviceFormat;
+    RtAudioFormat outFormat = ( mode == OUTPUT ) ? deviceFormat : userFormat;
+    char *in = ( mode == OUTPUT ) ? stream_.userBuffer[mode] : stream_.deviceBuffer;
+    char *out = ( mode == OUTPUT ) ? stream_.deviceBuffer : stream_.userBuffer[mode];
+    unsigned int inBytes = formatBytes( inFormat );
+    unsigned int outBytes = formatBytes( outFormat );
+    fillSamples( inFormat, in, frames * channels );
+    convertBuffer( out, in, stream_.convertInfo[mode] );
+
+    // SINT24 output is compared without its pad byte.
+    unsigned int compareBytes = ( outFormat == RTAUDIO_SINT24 ) ? 3 : outBytes;
+    for ( unsigned int i=0; i<frames; i++ ) {
+      for ( unsigned int j=0; j<channels; j++ ) {
+        unsigned int user = interleaved ? i * channels + j : j * frames + i;
+        unsigned int device = i * channels + j;
+        unsigned int inIndex = ( mode == OUTPUT ) ? user : device;
+        unsigned int outIndex = ( mode == OUTPUT ) ? device : user;
+        char expected[8];
+        referenceConvert( outFormat, expected, inFormat, in + inIndex * inBytes );
+        if ( memcmp( expected, out + outIndex * outBytes, compareBytes ) != 0 ) return false;
+      }
+    }
+    return true;
+  }
+
+private:
+
+  // Fills a buffer with test samples: random values, values exactly
+  // halfway between two integers after scaling (to check the rounding),
+  // and values out of range (to check the clamping).
+  void fillSamples( RtAudioFormat format, char *buffer, unsigned int samples )
+  {
+    for ( unsigned int i=0; i<samples; i++ ) {
+      char *sample = buffer + i * formatBytes( format );
+      double r = (double) rand() / RAND_MAX;
+      if ( format == RTAUDIO_FLOAT32 || format == RTAUDIO_FLOAT64 ) {
+        double x;
+        switch ( i % 4 ) {
+        case 0: x = 2.4 * r - 1.2; break;
+        case 1: x = ( std::floor( 65536.0 * r - 32768.0 ) + 0.5 ) / 32768.0; break;
+        case 2: x = ( std::floor( 16777216.0 * r - 8388608.0 ) + 0.5 ) / 8388608.0; break;
+        default: x = ( i & 4 ) ? 1.0 : -1.0; break;
+        }
+        if ( format == RTAUDIO_FLOAT32 ) {
+          float f = (float) x;
+          memcpy( sample, &f, sizeof( f ) );
+        }
+        else
+          memcpy( sample, &x, sizeof( x ) );
+      }
+      else {
+        // All bytes random, including the SINT24 pad byte.
+        for ( unsigned int j=0; j<formatBytes( format ); j++ )
+          sample[j] = (char) ( rand() & 0xff );
+      }
+    }
+  }
+};
+
+int main( void )
+{
+  const char *simd = getenv( "RTAUDIO_SIMD" );
+  std::cout << "\nKernels limited to: " << ( simd ? simd : "(none set)" ) << "\n";
+
+  srand( 1 );
+  ConvertApi api;
+  int failures = 0;
+  for ( unsigned int f=0; f<sizeof( FORMATS ) / sizeof( FORMATS[0] ); f++ ) {
+    for ( int mode=0; mode<2; mode++ ) {
+      for ( int direction=0; direction<2; direction++ ) {
+        // FLOAT32 on the user side, then on the device side.
+        RtAudioFormat userFormat = direction ? FORMATS[f] : RTAUDIO_FLOAT32;
+        RtAudioFormat deviceFormat = direction ? RTAUDIO_FLOAT32 : FORMATS[f];
+        for ( int layout=0; layout<2; layout++ ) {
+          bool ok = true;
+          for ( unsigned int c=0; ok && c<sizeof( CHANNELS ) / sizeof( CHANNELS[0] ); c++ )
+            for ( unsigned int n=0; ok && n<sizeof( FRAMES ) / sizeof( FRAMES[0] ); n++ )
+              ok = api.check( mode == 1, userFormat, deviceFormat,
+                              CHANNELS[c], FRAMES[n], layout == 0 );
+
+          const char *userName = direction ? FORMAT_NAMES[f] : "FLOAT32";
+          const char *deviceName = direction ? "FLOAT32" : FORMAT_NAMES[f];
+          std::cout << ( ok ? "ok   " : "FAIL " ) << ( mode ? "input  " : "output " )
+                    << userName << " user, " << deviceName << " device, "
+                    << ( layout == 0 ? "interleaved" : "non-interleaved" ) << '\n';
+          if ( !ok ) failures++;
+        }
+      }
+    }
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+/******************************************/
+/*
+  driftloop.cpp
+
+  This program checks the drift compensation
+  stage of duplex streams opened with
+  RTAUDIO_DRIFT_COMPENSATION, by feeding it a
+  sine from a simulated input device whose
+  clock runs faster or slower than the output
+  clock pacing the callbacks.  Periods must be
+  silent until the stage holds its target
+  level, and continuous from then on, the
+  drift must be followed without losing input,
+  and a stalled input must be reported and
+  recovered from.  The delay-locked loop
+  steering the resampler must settle at the
+  rate set by its gains, and its corrections
+  be limited to 0.5%.
+*/
+/******************************************/
+
+#include "testapi.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+const unsigned int SAMPLE_RATE = 48000;
+const unsigned int BUFFER_FRAMES = 256;
+const double PERIOD_RATE = (double) SAMPLE_RATE / BUFFER_FRAMES;
+const double FREQUENCY = 1000.0;
+
+// Runs the drift compensation stage of the library on a device-less
+// stream.
+class DriftApi : public TestApi
+{
+public:
+
+  // For each period: the drift estimated, in parts per million,
+  // whether the period was complete, whether it was silent, and the
+  // largest deviation of its samples from the sine recurrence (which
+  // only holds for a continuous sine).
+  std::vector<double> drift;
+  std::vector<bool> complete;
+  std::vector<bool> silent;
+  std::vector<double> deviation;
+  unsigned int overflows;
+
+  // Runs the stage for the given number of output periods, with the
+  // input device running ppm parts per million faster, and capturing
+  // nothing for stallPeriods periods from stallAt.  The input is read
+  // in whole periods, as the backends do, and the frames left in the
+  // device are passed along with each resampled period.
+  void run( double ppm, unsigned int periods, unsigned int stallAt = 0, unsigned int stallPeriods = 0 )
+  {
+    closeTestStream();
+    openTestStream( DUPLEX, SAMPLE_RATE, BUFFER_FRAMES, RTAUDIO_FLOAT32, RTAUDIO_FLOAT32, 1, true, 4 );
+    setupDriftCompensation();
+    resetDriftCompensation();
+    drift.clear();
+    complete.clear();
+    silent.clear();
+    deviation.clear();
+    overflows = 0;
+    double captured = 0.0;
+    unsigned long long read = 0;
+    float *input = (float *) stream_.deviceBuffer;
+    float *output = (float *) stream_.userBuffer[1];
+    double w = 2.0 * 3.14159265358979323846 * FREQUENCY / SAMPLE_RATE;
+    double cosine = 2.0 * std::cos( w * ( 1.0 + ppm * 1e-6 ) );
+    float last[2] = { 0.0f, 0.0f };
+    for ( unsigned int i=0; i<periods; i++ ) {
+      if ( i < stallAt || i >= stallAt + stallPeriods )
+        captured += BUFFER_FRAMES * ( 1.0 + ppm * 1e-6 );
+      while ( captured - read >= BUFFER_FRAMES ) {
+        for ( unsigned int j=0; j<BUFFER_FRAMES; j++ )
+          input[j] = (float) ( 0.5 * std::sin( w * (double) ( read + j ) ) );
+        if ( !bufferDriftInput( stream_.deviceBuffer ) ) overflows++;
+        read += BUFFER_FRAMES;
+      }
+      complete.push_back( resampleDriftInput( captured - read ) );
+      drift.push_back( stream_.stats.drift[0].load() );
+
+      bool quiet = true;
+      double d = 0.0;
+      for ( unsigned int j=0; j<BUFFER_FRAMES; j++ ) {
+        if ( output[j] != 0.0f ) quiet = false;
+        d = std::max( d, std::fabs( output[j] - cosine * last[1] + last[0] ) );
+        last[0] = last[1];
+        last[1] = output[j];
+      }
+      silent.push_back( quiet );
+      deviation.push_back( d );
+    }
+  }
+
+};
+
+static unsigned int periods( double seconds )
+{
+  return (unsigned int) ( seconds * PERIOD_RATE );
+}
+
+static size_t countIf( const std::vector<bool> &values, bool value, size_t first, size_t last )
+{
+  return std::count( values.begin() + first, values.begin() + last, value );
+}
+
+static double largest( const std::vector<double> &values, size_t first, size_t last )
+{
+  return *std::max_element( values.begin() + first, values.begin() + last );
+}
+
+static bool report( bool ok, const char *check )
+{
+  std::cout << ( ok ? "ok   " : "FAIL " ) << check << '\n';
+  return ok;
+}
+
+int main( void )
+{
+  DriftApi api;
+  int failures = 0;
+
+  // The target level is three periods, so the first three are silent.
+  // The first period with sound starts from the silent history of the
+  // filter, after which the sine must be continuous.
+  api.run( 200, periods( 5 ) );
+  size_t start = std::find( api.silent.begin(), api.silent.end(), false ) - api.silent.begin();
+  bool ok = start == 3 && countIf( api.silent, true, start, api.silent.size() ) == 0;
+  ok = ok && largest( api.deviation, start + 1, api.deviation.size() ) < 1e-4;
+  if ( !report( ok, "silent until primed, then continuous" ) ) failures++;
+
+  // Matching clocks: the stage starts at its target level, so nothing
+  // needs to be corrected.
+  api.run( 0, periods( 60 ) );
+  ok = countIf( api.complete, false, 0, api.complete.size() ) == 0;
+  for ( size_t i=0; i<api.drift.size(); i++ )
+    if ( std::fabs( api.drift[i] ) > 1.0 ) ok = false;
+  if ( !report( ok, "no drift estimated for matching clocks" ) ) failures++;
+
+  // Drift of either sign, up to several times the tolerance of audio
+  // clocks, is followed without losing input or continuity.
+  const double PPM[] = { 1000, -1000 };
+  for ( int i=0; i<2; i++ ) {
+    api.run( PPM[i], periods( 60 ) );
+    double expected = PPM[i] / ( 1.0 + PPM[i] * 1e-6 );
+    ok = api.overflows == 0 && countIf( api.complete, false, 0, api.complete.size() ) == 0;
+    ok = ok && std::fabs( api.drift.back() - expected ) < 0.5;
+    ok = ok && largest( api.deviation, periods( 1 ), api.deviation.size() ) < 1e-4;
+    if ( !report( ok, PPM[i] > 0 ? "input 1000 ppm fast followed" : "input 1000 ppm slow followed" ) ) failures++;
+  }
+
+  // The delay-locked loop, shared with the ALSA aggregate devices, has
+  // a bandwidth of 0.05 Hz and a damping of 0.7, so that the estimate
+  // of a 200 ppm drift settles within 5% in about 9 seconds, after an
+  // overshoot of about 4%.  Different gains would change either.
+  api.run( 200, periods( 60 ) );
+  double expected = 200 / ( 1.0 + 200e-6 );
+  size_t settled = 0;
+  for ( size_t i=0; i<api.drift.size(); i++ )
+    if ( std::fabs( api.drift[i] - expected ) > 0.05 * expected ) settled = i + 1;
+  double overshoot = largest( api.drift, 0, api.drift.size() ) / expected - 1.0;
+  std::cout << "     settled in " << settled / PERIOD_RATE << " s, overshoot "
+            << overshoot * 100 << "%\n";
+  ok = settled > periods( 7 ) && settled < periods( 12 ) && overshoot > 0.02 && overshoot < 0.08;
+  ok = ok && std::fabs( api.drift.back() - expected ) < 0.1;
+  if ( !report( ok, "200 ppm drift estimated at the loop bandwidth" ) ) failures++;
+
+  // Corrections are limited to 0.5%, beyond which the stage overflows
+  // or runs dry.
+  const double FAR[] = { 8000, -8000 };
+  for ( int i=0; i<2; i++ ) {
+    api.run( FAR[i], periods( 30 ) );
+    double peak = 0.0;
+    for ( size_t j=0; j<api.drift.size(); j++ )
+      peak = std::max( peak, std::fabs( api.drift[j] ) );
+    ok = peak == 5000.0 && std::fabs( api.drift.back() ) == 5000.0;
+    ok = ok && ( api.drift.back() > 0 ) == ( FAR[i] > 0 );
+    if ( FAR[i] > 0 ) ok = ok && api.overflows > 0;
+    else ok = ok && countIf( api.complete, false, 0, api.complete.size() ) > 0;
+    if ( !report( ok, FAR[i] > 0 ? "correction limited, input overflows" : "correction limited, input runs dry" ) ) failures++;
+  }
+
+  // A stalled input is reported once the stage runs dry, after which
+  // it is silent until primed again.
+  unsigned int stallAt = periods( 10 );
+  api.run( 200, periods( 20 ), stallAt, 4 );
+  size_t first = std::find( api.complete.begin(), api.complete.end(), false ) - api.complete.begin();
+  ok = first > stallAt && first <= stallAt + 4;
+  ok = ok && countIf( api.complete, false, first + 1, api.complete.size() ) == 0;
+  ok = ok && !api.silent.back() && largest( api.deviation, stallAt + periods( 1 ), api.deviation.size() ) < 1e-4;
+  if ( !report( ok, "stalled input reported and recovered" ) ) failures++;
+
+  return failures ? 1 : 0;
+}
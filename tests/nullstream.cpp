@@ -0,0 +1,387 @@
+/******************************************/
+/*
+  nullstream.cpp
+
+  This program runs streams on the devices of
+  the null API.  Each test signal is written to
+  a raw or WAV file through one device and read
+  back through the same device, which exercises
+  the sample format, byte order, interleaving
+  and channel offset conversions without any
+  audio hardware, with interleaved,
+  non-interleaved and planar callbacks.
+  Several output streams are also run at the
+  same time on one RtAudio instance.  It exits
+  with status 77 (skipped) if the null API is
+  not compiled.
+*/
+/******************************************/
+
+#include "RtAudio.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+typedef signed short MY_TYPE;
+
+const unsigned int CHANNELS = 2;
+const unsigned int OFFSET = 1;
+const unsigned int BUFFERS = 5;
+const unsigned int SAMPLE_RATE = 48000;
+
+struct TestData {
+  unsigned int bufferFrames;
+  unsigned int callbacks;
+  bool interleaved;
+  std::vector<MY_TYPE> samples;    // interleaved frames written or read
+  std::vector<std::chrono::steady_clock::time_point> times;
+};
+
+// Multiples of 256 survive the round trip through an 8-bit device.
+MY_TYPE testSample( unsigned int frame, unsigned int channel )
+{
+  return (MY_TYPE) ( ( ( frame * 3 + channel * 50 ) % 256 ) * 256 - 32768 );
+}
+
+int output( void *outputBuffer, void * /*inputBuffer*/, unsigned int nBufferFrames,
+            double /*streamTime*/, RtAudioStreamStatus /*status*/, void *data )
+{
+  TestData *test = (TestData *) data;
+  MY_TYPE *buffer = (MY_TYPE *) outputBuffer;
+  for ( unsigned int i=0; i<nBufferFrames; i++ ) {
+    unsigned int frame = test->callbacks * nBufferFrames + i;
+    for ( unsigned int j=0; j<CHANNELS; j++ ) {
+      if ( test->interleaved )
+        buffer[i * CHANNELS + j] = testSample( frame, j );
+      else
+        buffer[j * nBufferFrames + i] = testSample( frame, j );
+    }
+  }
+
+  test->times.push_back( std::chrono::steady_clock::now() );
+  if ( ++test->callbacks == BUFFERS ) return 1;
+  return 0;
+}
+
+int input( void * /*outputBuffer*/, void *inputBuffer, unsigned int nBufferFrames,
+           double /*streamTime*/, RtAudioStreamStatus /*status*/, void *data )
+{
+  TestData *test = (TestData *) data;
+  MY_TYPE *buffer = (MY_TYPE *) inputBuffer;
+  for ( unsigned int i=0; i<nBufferFrames; i++ ) {
+    for ( unsigned int j=0; j<CHANNELS; j++ ) {
+      if ( test->interleaved )
+        test->samples.push_back( buffer[i * CHANNELS + j] );
+      else
+        test->samples.push_back( buffer[j * nBufferFrames + i] );
+    }
+  }
+
+  // Read one buffer past the end of the file, which must be silent.
+  if ( ++test->callbacks == BUFFERS + 1 ) return 1;
+  return 0;
+}
+
+// The planar callbacks pass the same samples as 32-bit floats, with a
+// buffer per channel.
+int planarOutput( float * const *outputChannels, const float * const * /*inputChannels*/,
+                  unsigned int nBufferFrames, double /*streamTime*/,
+                  RtAudioStreamStatus /*status*/, void *data )
+{
+  TestData *test = (TestData *) data;
+  for ( unsigned int i=0; i<nBufferFrames; i++ ) {
+    unsigned int frame = test->callbacks * nBufferFrames + i;
+    for ( unsigned int j=0; j<CHANNELS; j++ )
+      outputChannels[j][i] = testSample( frame, j ) / 32768.0f;
+  }
+
+  if ( ++test->callbacks == BUFFERS ) return 1;
+  return 0;
+}
+
+int planarInput( float * const * /*outputChannels*/, const float * const *inputChannels,
+                 unsigned int nBufferFrames, double /*streamTime*/,
+                 RtAudioStreamStatus /*status*/, void *data )
+{
+  TestData *test = (TestData *) data;
+  for ( unsigned int i=0; i<nBufferFrames; i++ )
+    for ( unsigned int j=0; j<CHANNELS; j++ )
+      test->samples.push_back( (MY_TYPE) std::lrint( inputChannels[j][i] * 32768.0f ) );
+
+  if ( ++test->callbacks == BUFFERS + 1 ) return 1;
+  return 0;
+}
+
+// A duplex stream that plays silence and records the stream clock and
+// latencies of each period.
+struct ClockTest {
+  RtAudio *audio;
+  unsigned int callbacks;
+  std::vector<RtAudio::StreamClock> clocks;
+  std::vector<RtAudio::StreamLatency> latencies;
+};
+
+int duplexClock( void *outputBuffer, void * /*inputBuffer*/, unsigned int nBufferFrames,
+                 double /*streamTime*/, RtAudioStreamStatus /*status*/, void *data )
+{
+  ClockTest *test = (ClockTest *) data;
+  memset( outputBuffer, 0, nBufferFrames * CHANNELS * sizeof( MY_TYPE ) );
+  test->clocks.push_back( test->audio->getStreamClock() );
+  test->latencies.push_back( test->audio->getStreamLatencies() );
+  if ( ++test->callbacks == 4 * BUFFERS ) return 1;
+  return 0;
+}
+
+// Latencies are never negative, the round trip is the sum of the
+// output and input latencies, and the input latency includes at least
+// the period being processed.
+bool checkLatencies( const RtAudio::StreamLatency &latency, unsigned int bufferFrames )
+{
+  if ( latency.outputNanos < 0 || latency.inputNanos < 0 ) return false;
+  if ( latency.roundTripNanos != latency.outputNanos + latency.inputNanos ) return false;
+  if ( latency.inputFrames < bufferFrames ) return false;
+  long frames = (long) latency.outputFrames + (long) latency.inputFrames;
+  return labs( (long) latency.roundTripFrames - frames ) <= 1;
+}
+
+bool checkSamples( const TestData &test )
+{
+  unsigned int frames = BUFFERS * test.bufferFrames;
+  if ( test.samples.size() != ( frames + test.bufferFrames ) * CHANNELS ) return false;
+  for ( unsigned int i=0; i<test.samples.size(); i++ ) {
+    unsigned int frame = i / CHANNELS;
+    int expected = ( frame < frames ) ? testSample( frame, i % CHANNELS ) : 0;
+    if ( abs( test.samples[i] - expected ) > 1 ) return false;
+  }
+  return true;
+}
+
+bool runStream( RtAudio &audio, unsigned int deviceId, bool isInput,
+                RtAudio::StreamOptions &options, TestData &test, bool planar = false )
+{
+  RtAudio::StreamParameters parameters;
+  parameters.deviceId = deviceId;
+  parameters.nChannels = CHANNELS;
+  parameters.firstChannel = OFFSET;
+  test.callbacks = 0;
+  test.samples.clear();
+  test.times.clear();
+
+  RtAudioErrorType result;
+  if ( planar )
+    result = audio.openStream( isInput ? NULL : &parameters, isInput ? &parameters : NULL,
+                               SAMPLE_RATE, &test.bufferFrames,
+                               isInput ? &planarInput : &planarOutput, (void *)&test, &options );
+  else
+    result = audio.openStream( isInput ? NULL : &parameters, isInput ? &parameters : NULL,
+                               RTAUDIO_SINT16, SAMPLE_RATE, &test.bufferFrames,
+                               isInput ? &input : &output, (void *)&test, &options );
+  if ( result ) return false;
+  if ( audio.startStream() ) {
+    audio.closeStream();
+    return false;
+  }
+  while ( audio.isStreamRunning() )
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  audio.closeStream();
+  return true;
+}
+
+// Runs a stream without a callback function, which exchanges its
+// samples through writeFrames() or readFrames().  The ring buffers
+// hold the whole test signal, so that no output underflows before it
+// is queued and no input is discarded before it is read.
+bool runRingStream( RtAudio &audio, unsigned int deviceId, bool isInput,
+                    RtAudio::StreamOptions &options, TestData &test )
+{
+  RtAudio::StreamParameters parameters;
+  parameters.deviceId = deviceId;
+  parameters.nChannels = CHANNELS;
+  parameters.firstChannel = OFFSET;
+  unsigned int frames = BUFFERS * test.bufferFrames;
+  options.ringBufferFrames = frames;
+
+  if ( audio.openStream( isInput ? NULL : &parameters, isInput ? &parameters : NULL,
+                         RTAUDIO_SINT16, SAMPLE_RATE, &test.bufferFrames,
+                         NULL, NULL, &options ) )
+    return false;
+
+  bool ok = true;
+  if ( isInput ) {
+    test.samples.assign( frames * CHANNELS, 0 );
+    ok = !audio.startStream() && audio.readFrames( &test.samples[0], frames ) == frames;
+  }
+  else {
+    // Output queued before the stream starts begins the file.
+    test.samples.clear();
+    for ( unsigned int i=0; i<frames; i++ )
+      for ( unsigned int j=0; j<CHANNELS; j++ )
+        test.samples.push_back( testSample( i, j ) );
+    ok = audio.writeFrames( &test.samples[0], frames, false ) == frames && !audio.startStream();
+    while ( ok && audio.getWriteAvailable() < options.ringBufferFrames )
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  if ( audio.isStreamRunning() ) audio.stopStream();
+  audio.closeStream();
+  return ok;
+}
+
+int main( void )
+{
+  std::vector<RtAudio::Api> apis;
+  RtAudio::getCompiledApi( apis );
+  bool found = false;
+  for ( unsigned int i=0; i<apis.size(); i++ )
+    if ( apis[i] == RtAudio::RTAUDIO_NULL ) found = true;
+  if ( !found ) {
+    std::cout << "\nThe null API is not compiled, skipping.\n";
+    return 77;
+  }
+
+  RtAudio audio( RtAudio::RTAUDIO_NULL );
+  std::vector<unsigned int> deviceIds = audio.getDeviceIds();
+  std::vector<std::string> deviceNames = audio.getDeviceNames();
+  int failures = 0;
+
+  for ( unsigned int n=0; n<deviceIds.size(); n++ ) {
+    // Interleaved, non-interleaved and planar callbacks.
+    for ( unsigned int k=0; k<3; k++ ) {
+      TestData test;
+      test.bufferFrames = 64;
+      test.interleaved = ( k == 0 );
+      bool planar = ( k == 2 );
+      std::string file = ( k == 0 ) ? "nullstream.wav" : "nullstream.raw";
+
+      RtAudio::StreamOptions options;
+      options.flags = RTAUDIO_NULL_FREE_RUN;
+      if ( !test.interleaved ) options.flags |= RTAUDIO_NONINTERLEAVED;
+      options.outputFile = file;
+
+      bool ok = runStream( audio, deviceIds[n], false, options, test, planar );
+      options.outputFile.clear();
+      options.inputFile = file;
+      ok = ok && runStream( audio, deviceIds[n], true, options, test, planar );
+      remove( file.c_str() );
+
+      ok = ok && checkSamples( test );
+
+      std::cout << ( ok ? "ok   " : "FAIL " ) << deviceNames[n] << ", " << file
+                << ( planar ? ", planar" : test.interleaved ? ", interleaved" : ", non-interleaved" ) << '\n';
+      if ( !ok ) failures++;
+    }
+  }
+
+  // Run one output stream per device at the same time, each writing
+  // its own file, then read the files back.
+  std::vector<TestData> tests( deviceIds.size() );
+  std::vector<unsigned int> streamIds( deviceIds.size() );
+  bool ok = true;
+  for ( unsigned int n=0; ok && n<deviceIds.size(); n++ ) {
+    RtAudio::StreamParameters parameters;
+    parameters.deviceId = deviceIds[n];
+    parameters.nChannels = CHANNELS;
+    parameters.firstChannel = OFFSET;
+    RtAudio::StreamOptions options;
+    options.outputFile = "nullstream" + std::to_string( n ) + ".raw";
+    tests[n].bufferFrames = 64;
+    tests[n].callbacks = 0;
+    tests[n].interleaved = true;
+    ok = !audio.openStream( &streamIds[n], &parameters, NULL, RTAUDIO_SINT16, SAMPLE_RATE,
+                            &tests[n].bufferFrames, &output, (void *)&tests[n], &options );
+    if ( ok && streamIds[n] != n ) ok = false;
+  }
+  for ( unsigned int n=0; ok && n<deviceIds.size(); n++ )
+    ok = !audio.startStream( streamIds[n] );
+  for ( unsigned int n=0; n<deviceIds.size(); n++ ) {
+    while ( audio.isStreamRunning( streamIds[n] ) )
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    if ( audio.isStreamOpen( streamIds[n] ) ) audio.closeStream( streamIds[n] );
+  }
+  for ( unsigned int n=0; n<deviceIds.size(); n++ ) {
+    RtAudio::StreamOptions options;
+    options.flags = RTAUDIO_NULL_FREE_RUN;
+    options.inputFile = "nullstream" + std::to_string( n ) + ".raw";
+    ok = ok && runStream( audio, deviceIds[n], true, options, tests[n] );
+    ok = ok && checkSamples( tests[n] );
+    remove( options.inputFile.c_str() );
+  }
+  std::cout << ( ok ? "ok   " : "FAIL " ) << deviceIds.size() << " simultaneous streams\n";
+  if ( !ok ) failures++;
+
+  // A paced stream cannot run its periods faster than the sample rate.
+  TestData test;
+  test.bufferFrames = 480;
+  test.interleaved = true;
+  RtAudio::StreamOptions options;
+  ok = runStream( audio, audio.getDefaultOutputDevice(), false, options, test );
+  if ( ok && test.times.size() == BUFFERS ) {
+    double elapsed = std::chrono::duration<double>( test.times.back() - test.times.front() ).count();
+    ok = elapsed >= 0.99 * ( BUFFERS - 1 ) * test.bufferFrames / SAMPLE_RATE;
+  }
+  else ok = false;
+  std::cout << ( ok ? "ok   " : "FAIL " ) << "paced stream timing\n";
+  if ( !ok ) failures++;
+
+  // The clock of a paced duplex stream advances by one period at each
+  // callback, and is never seen going backwards by another thread.
+  // The null API has no device timestamps, so that the times are
+  // estimated, with the input captured before the output is played.
+  // The latencies are checked before the stream starts, when they are
+  // estimated from its buffering, as well as in each callback and by
+  // another thread.
+  ClockTest clockTest;
+  clockTest.audio = &audio;
+  clockTest.callbacks = 0;
+  unsigned int bufferFrames = 480;
+  RtAudio::StreamParameters outputParameters, inputParameters;
+  outputParameters.deviceId = audio.getDefaultOutputDevice();
+  outputParameters.nChannels = CHANNELS;
+  inputParameters.deviceId = audio.getDefaultInputDevice();
+  inputParameters.nChannels = CHANNELS;
+  ok = !audio.openStream( &outputParameters, &inputParameters, RTAUDIO_SINT16, SAMPLE_RATE,
+                          &bufferFrames, &duplexClock, (void *)&clockTest );
+  ok = ok && checkLatencies( audio.getStreamLatencies(), bufferFrames ) && !audio.startStream();
+  unsigned long long position = 0;
+  while ( ok && audio.isStreamRunning() ) {
+    RtAudio::StreamClock clock = audio.getStreamClock();
+    if ( clock.framePosition < position || clock.framePosition % bufferFrames ) ok = false;
+    if ( !checkLatencies( audio.getStreamLatencies(), bufferFrames ) ) ok = false;
+    position = clock.framePosition;
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  if ( audio.isStreamOpen() ) audio.closeStream();
+  ok = ok && clockTest.clocks.size() == 4 * BUFFERS;
+  for ( unsigned int i=0; ok && i<clockTest.clocks.size(); i++ ) {
+    const RtAudio::StreamClock &clock = clockTest.clocks[i];
+    ok = clock.framePosition == (unsigned long long) i * bufferFrames;
+    ok = ok && !clock.outputTimestamped && !clock.inputTimestamped && clock.inputTime < clock.outputTime;
+    ok = ok && checkLatencies( clockTest.latencies[i], bufferFrames );
+    if ( i > 0 ) {
+      const RtAudio::StreamClock &last = clockTest.clocks[i - 1];
+      ok = ok && clock.outputTime > last.outputTime && clock.inputTime > last.inputTime;
+    }
+  }
+  std::cout << ( ok ? "ok   " : "FAIL " ) << "stream clock and latencies\n";
+  if ( !ok ) failures++;
+
+  // Write a file with writeFrames() and read it back with readFrames().
+  test.bufferFrames = 64;
+  options.outputFile = "nullstream.raw";
+  ok = runRingStream( audio, audio.getDefaultOutputDevice(), false, options, test );
+  options.outputFile.clear();
+  options.inputFile = "nullstream.raw";
+  options.flags = RTAUDIO_NULL_FREE_RUN;
+  ok = ok && runRingStream( audio, audio.getDefaultInputDevice(), true, options, test );
+  remove( "nullstream.raw" );
+  for ( unsigned int i=0; ok && i<test.samples.size(); i++ )
+    ok = abs( test.samples[i] - testSample( i / CHANNELS, i % CHANNELS ) ) <= 1;
+  std::cout << ( ok ? "ok   " : "FAIL " ) << "writeFrames() and readFrames()\n";
+  if ( !ok ) failures++;
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,354 @@
+/******************************************/
+/*
+  pulsestream.cpp
+
+  This program runs streams on a PulseAudio
+  null sink ("Null Output", as loaded with
+  "pactl load-module module-null-sink") and
+  on its monitor source, which captures what
+  is played on the sink.  It checks that the
+  played samples arrive in order (including
+  those drained when the stream stops), that
+  output starts paced by the prefilled silence,
+  that underflows and overflows are reported,
+  that duplex streams follow their input, and
+  that streams stop from within the callback
+  and from another thread while processOnce()
+  waits.  It exits with status 77 (skipped) if
+  the PulseAudio API is not compiled or the
+  null sink is not found.
+*/
+/******************************************/
+
+#include "RtAudio.h"
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+const unsigned int CHANNELS = 2;
+const unsigned int SAMPLE_RATE = 48000;
+const unsigned int BUFFER_FRAMES = 256;
+const unsigned int PERIODS = 40;
+
+struct TestData {
+  std::atomic<unsigned int> callbacks;
+  unsigned int stopAt;    // The callback after which the stream stops, or 0.
+  int stopMode;           // 1 or 2: return it, 3: call stopStream(), 4: call abortStream().
+  unsigned int stallAt;   // A callback that sleeps for stallTime milliseconds, or 0.
+  unsigned int stallTime;
+  RtAudio *audio;
+  std::vector<float> input;   // Interleaved input frames.
+  std::vector<RtAudioStreamStatus> status;
+  std::vector<std::chrono::steady_clock::time_point> times;
+  TestData() : callbacks( 0 ), stopAt( 0 ), stopMode( 1 ), stallAt( 0 ), stallTime( 0 ), audio( 0 ) {}
+};
+
+// Exactly representable values that count the frames.
+float testSample( unsigned int frame, unsigned int channel )
+{
+  float value = (float) ( frame % 4096 + 1 ) / 8192.0f;
+  return channel ? -value : value;
+}
+
+int callback( void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
+              double /*streamTime*/, RtAudioStreamStatus status, void *data )
+{
+  TestData *test = (TestData *) data;
+  unsigned int count = test->callbacks;
+  test->times.push_back( std::chrono::steady_clock::now() );
+  test->status.push_back( status );
+
+  float *buffer = (float *) inputBuffer;
+  if ( buffer ) test->input.insert( test->input.end(), buffer, buffer + nBufferFrames * CHANNELS );
+  buffer = (float *) outputBuffer;
+  for ( unsigned int i=0; buffer && i<nBufferFrames; i++ )
+    for ( unsigned int j=0; j<CHANNELS; j++ )
+      buffer[i * CHANNELS + j] = testSample( count * nBufferFrames + i, j );
+
+  if ( test->stallAt && count == test->stallAt )
+    std::this_thread::sleep_for( std::chrono::milliseconds( test->stallTime ) );
+
+  test->callbacks = count + 1;
+  if ( count + 1 != test->stopAt ) return 0;
+  if ( test->stopMode == 3 ) test->audio->stopStream();
+  else if ( test->stopMode == 4 ) test->audio->abortStream();
+  else return test->stopMode;
+  return 0;
+}
+
+// Checks that the input holds at least the given number of frames of
+// the test signal, in order after leading silence.
+bool checkSignal( const std::vector<float> &input, unsigned int frames )
+{
+  unsigned int first = 0;
+  while ( first * CHANNELS < input.size() && input[first * CHANNELS] == 0.0f ) first++;
+  if ( ( first + frames ) * CHANNELS > input.size() ) return false;
+  for ( unsigned int i=0; i<frames; i++ )
+    for ( unsigned int j=0; j<CHANNELS; j++ )
+      if ( std::fabs( input[( first + i ) * CHANNELS + j] - testSample( i, j ) ) > 1e-4f ) return false;
+  return true;
+}
+
+// Returns the first callback, from the given one, with the given
+// status flag set, or the number of callbacks if there is none.
+unsigned int findStatus( const TestData &test, unsigned int from, RtAudioStreamStatus flag )
+{
+  for ( unsigned int i=from; i<test.status.size(); i++ )
+    if ( test.status[i] & flag ) return i;
+  return test.status.size();
+}
+
+bool openStream( RtAudio &audio, unsigned int *streamId, unsigned int outputId, unsigned int inputId,
+                 TestData &test, RtAudioStreamFlags flags = 0 )
+{
+  RtAudio::StreamParameters outputParameters, inputParameters;
+  outputParameters.deviceId = outputId;
+  outputParameters.nChannels = CHANNELS;
+  inputParameters.deviceId = inputId;
+  inputParameters.nChannels = CHANNELS;
+  RtAudio::StreamOptions options;
+  options.flags = flags;
+  unsigned int bufferFrames = BUFFER_FRAMES;
+  test.audio = &audio;
+  if ( audio.openStream( streamId, outputId ? &outputParameters : NULL, inputId ? &inputParameters : NULL,
+                         RTAUDIO_FLOAT32, SAMPLE_RATE, &bufferFrames, &callback, (void *)&test, &options ) )
+    return false;
+  if ( bufferFrames != BUFFER_FRAMES || audio.startStream( *streamId ) ) {
+    audio.closeStream( *streamId );
+    return false;
+  }
+  return true;
+}
+
+void waitForStop( RtAudio &audio, unsigned int streamId )
+{
+  while ( audio.isStreamRunning( streamId ) )
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+}
+
+// Kills the program if a test does not finish in time.
+class Watchdog
+{
+public:
+  Watchdog( const char *name, int seconds )
+    : done_( false ), thread_( [this, name, seconds]() {
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds( seconds );
+        while ( !done_ && std::chrono::steady_clock::now() < end )
+          std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        if ( !done_ ) {
+          std::cout << "FAIL " << name << " (timed out)" << std::endl;
+          std::_Exit( 1 );
+        }
+      } ) {}
+  ~Watchdog() { done_ = true; thread_.join(); }
+
+private:
+  std::atomic<bool> done_;
+  std::thread thread_;
+};
+
+// Plays the test signal on the sink, while the monitor captures it,
+// and stops the output by returning 1 from the callback.  All of the
+// periods must be played, including those queued when it stops.
+bool testPlayback( RtAudio &audio, unsigned int sinkId, unsigned int monitorId )
+{
+  Watchdog watchdog( "playback", 10 );
+  TestData capture, play;
+  play.stopAt = PERIODS;
+  unsigned int captureId, playId;
+  if ( !openStream( audio, &captureId, 0, monitorId, capture ) ) return false;
+  bool ok = openStream( audio, &playId, sinkId, 0, play );
+  if ( ok ) {
+    waitForStop( audio, playId );
+    audio.closeStream( playId );
+  }
+  std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+  audio.stopStream( captureId );
+  audio.closeStream( captureId );
+  return ok && play.callbacks == PERIODS && checkSignal( capture.input, PERIODS * BUFFER_FRAMES ) &&
+    findStatus( play, 0, RTAUDIO_OUTPUT_UNDERFLOW ) == PERIODS;
+}
+
+// The silence queued when the stream starts makes the server request
+// each period as one is played, rather than all of them at once.
+bool testPrefill( RtAudio &audio, unsigned int sinkId )
+{
+  Watchdog watchdog( "prefill", 10 );
+  TestData test;
+  test.stopAt = PERIODS;
+  test.stopMode = 2;
+  unsigned int streamId;
+  auto start = std::chrono::steady_clock::now();
+  if ( !openStream( audio, &streamId, sinkId, 0, test ) ) return false;
+  waitForStop( audio, streamId );
+  audio.closeStream( streamId );
+
+  double period = (double) BUFFER_FRAMES / SAMPLE_RATE;
+  bool ok = test.callbacks == PERIODS;
+  for ( unsigned int i=2; ok && i<8; i++ )
+    ok = std::chrono::duration<double>( test.times[i] - start ).count() >= ( i - 1 ) * period;
+  return ok && findStatus( test, 0, RTAUDIO_OUTPUT_UNDERFLOW ) == PERIODS;
+}
+
+// A callback taking longer than the queued periods must be followed
+// by an underflow (output) or overflow (input), and not preceded by one.
+bool testXrun( RtAudio &audio, unsigned int sinkId, unsigned int monitorId, bool input )
+{
+  Watchdog watchdog( input ? "overflow" : "underflow", 10 );
+  TestData test;
+  test.stopAt = PERIODS;
+  test.stopMode = 2;
+  test.stallAt = PERIODS / 2;
+  test.stallTime = 200;
+  unsigned int streamId;
+  if ( !openStream( audio, &streamId, input ? 0 : sinkId, input ? monitorId : 0, test ) ) return false;
+  waitForStop( audio, streamId );
+  audio.closeStream( streamId );
+
+  RtAudioStreamStatus flag = input ? RTAUDIO_INPUT_OVERFLOW : RTAUDIO_OUTPUT_UNDERFLOW;
+  return test.callbacks == PERIODS && findStatus( test, 0, flag ) > test.stallAt &&
+    findStatus( test, 0, flag ) < PERIODS;
+}
+
+// A duplex stream runs one callback per input period, with its output
+// looped back to its input through the monitor.
+bool testDuplex( RtAudio &audio, unsigned int sinkId, unsigned int monitorId )
+{
+  Watchdog watchdog( "duplex", 10 );
+  const unsigned int periods = 4 * PERIODS;
+  TestData test;
+  test.stopAt = periods;
+  test.stopMode = 2;
+  unsigned int streamId;
+  if ( !openStream( audio, &streamId, sinkId, monitorId, test ) ) return false;
+  waitForStop( audio, streamId );
+  audio.closeStream( streamId );
+
+  if ( test.callbacks != periods ) return false;
+  double elapsed = std::chrono::duration<double>( test.times.back() - test.times.front() ).count();
+  double expected = (double) ( periods - 1 ) * BUFFER_FRAMES / SAMPLE_RATE;
+  return std::fabs( elapsed - expected ) < 4.0 * BUFFER_FRAMES / SAMPLE_RATE &&
+    checkSignal( test.input, periods / 2 * BUFFER_FRAMES ) &&
+    findStatus( test, 1, RTAUDIO_OUTPUT_UNDERFLOW | RTAUDIO_INPUT_OVERFLOW ) == periods;
+}
+
+// Stops the stream from within the callback, with the given stop mode
+// (see TestData).  No further callback must follow.
+bool testCallbackStop( RtAudio &audio, unsigned int sinkId, int stopMode )
+{
+  Watchdog watchdog( "stop from the callback", 10 );
+  TestData test;
+  test.stopAt = 10;
+  test.stopMode = stopMode;
+  unsigned int streamId;
+  if ( !openStream( audio, &streamId, sinkId, 0, test ) ) return false;
+  waitForStop( audio, streamId );
+  std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+  audio.closeStream( streamId );
+  return test.callbacks == 10;
+}
+
+// Stops (if stop is true) and closes a stream driven by processOnce()
+// from another thread while processOnce() waits without a timeout,
+// which must then return.
+bool testExternalStop( RtAudio &audio, unsigned int sinkId, bool stop )
+{
+  Watchdog watchdog( "external stop and close", 10 );
+  RtAudio::StreamParameters parameters;
+  parameters.deviceId = sinkId;
+  parameters.nChannels = CHANNELS;
+  RtAudio::StreamOptions options;
+  options.flags = RTAUDIO_EXTERNAL_THREAD;
+  unsigned int bufferFrames = BUFFER_FRAMES;
+  TestData test;
+  if ( audio.openStream( &parameters, NULL, RTAUDIO_FLOAT32, SAMPLE_RATE, &bufferFrames,
+                         &callback, (void *)&test, &options ) )
+    return false;
+  if ( audio.startStream() ) {
+    audio.closeStream();
+    return false;
+  }
+
+  std::thread process( [&audio]() {
+    while ( audio.isStreamRunning() )
+      audio.processOnce( -1 );
+  } );
+
+  // Let the stream run, then stop or close it while processOnce() is
+  // waiting for the next period.
+  while ( test.callbacks < 10 )
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+  bool ok = true;
+  if ( stop ) ok = !audio.stopStream();
+  unsigned int callbacks = test.callbacks;
+  audio.closeStream();
+  process.join();
+  return ok && test.callbacks == callbacks;
+}
+
+int main( void )
+{
+  std::vector<RtAudio::Api> apis;
+  RtAudio::getCompiledApi( apis );
+  bool found = false;
+  for ( unsigned int i=0; i<apis.size(); i++ )
+    if ( apis[i] == RtAudio::LINUX_PULSE ) found = true;
+  if ( !found ) {
+    std::cout << "\nThe PulseAudio API is not compiled, skipping.\n";
+    return 77;
+  }
+
+  RtAudio audio( RtAudio::LINUX_PULSE );
+  audio.showWarnings( false );
+  unsigned int sinkId = 0, monitorId = 0;
+  std::vector<unsigned int> deviceIds = audio.getDeviceIds();
+  for ( unsigned int n=0; n<deviceIds.size(); n++ ) {
+    RtAudio::DeviceInfo info = audio.getDeviceInfo( deviceIds[n] );
+    if ( info.name == "Null Output" && info.outputChannels >= CHANNELS ) sinkId = deviceIds[n];
+    if ( info.name == "Monitor of Null Output" && info.inputChannels >= CHANNELS ) monitorId = deviceIds[n];
+  }
+  if ( sinkId == 0 || monitorId == 0 ) {
+    std::cout << "\nNo PulseAudio null sink found, skipping.\n";
+    return 77;
+  }
+
+  int failures = 0;
+  bool ok = testPlayback( audio, sinkId, monitorId );
+  std::cout << ( ok ? "ok   " : "FAIL " ) << "playback, drained on stop\n";
+  if ( !ok ) failures++;
+
+  ok = testPrefill( audio, sinkId );
+  std::cout << ( ok ? "ok   " : "FAIL " ) << "output paced from the start\n";
+  if ( !ok ) failures++;
+
+  for ( int k=0; k<2; k++ ) {
+    ok = testXrun( audio, sinkId, monitorId, k == 1 );
+    std::cout << ( ok ? "ok   " : "FAIL " ) << ( k == 0 ? "output underflow" : "input overflow" ) << " reported\n";
+    if ( !ok ) failures++;
+  }
+
+  ok = testDuplex( audio, sinkId, monitorId );
+  std::cout << ( ok ? "ok   " : "FAIL " ) << "duplex clocked by input\n";
+  if ( !ok ) failures++;
+
+  const char *stopNames[] = { "returning 1", "returning 2", "stopStream()", "abortStream()" };
+  for ( int k=1; k<=4; k++ ) {
+    ok = testCallbackStop( audio, sinkId, k );
+    std::cout << ( ok ? "ok   " : "FAIL " ) << "stop from the callback by " << stopNames[k - 1] << '\n';
+    if ( !ok ) failures++;
+  }
+
+  for ( int k=0; k<2; k++ ) {
+    ok = testExternalStop( audio, sinkId, k == 0 );
+    std::cout << ( ok ? "ok   " : "FAIL " ) << "external " << ( k == 0 ? "stop and close" : "close while running" )
+              << " during processOnce()\n";
+    if ( !ok ) failures++;
+  }
+
+  return failures ? 1 : 0;
+}
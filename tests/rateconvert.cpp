@@ -0,0 +1,174 @@
+/******************************************/
+/*
+  rateconvert.cpp
+
+  This program checks the sample rate
+  conversion of streams opened with
+  RTAUDIO_CONVERT_SAMPLE_RATE, by running
+  its callback as a backend would, with
+  device periods at the device rate.  The
+  user callback must be invoked once per
+  device period when the periods last as
+  long, and at the requested rate otherwise,
+  and a sine must keep its frequency through
+  the conversion, with an error below -65 dB
+  (in playback, in capture, and looped back
+  through both in a duplex stream).
+*/
+/******************************************/
+
+#include "testapi.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+
+const double PI = 3.14159265358979323846;
+const double FREQUENCY = 1000.0;
+const double AMPLITUDE = 0.5;
+
+// The user side of the stream: its callback plays a sine, or the
+// input when looping back, and records the input.
+struct UserData {
+  unsigned int sampleRate;
+  unsigned int callbacks;
+  bool loopback;
+  unsigned long long frames;
+  std::vector<float> input;
+};
+
+int userCallback( void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                  double /*streamTime*/, RtAudioStreamStatus /*status*/, void *data )
+{
+  UserData *user = (UserData *) data;
+  float *out = (float *) outputBuffer;
+  float *in = (float *) inputBuffer;
+  for ( unsigned int i=0; i<nFrames; i++ ) {
+    if ( in ) user->input.push_back( in[i] );
+    if ( out )
+      out[i] = user->loopback ? in[i] : (float) ( AMPLITUDE * std::sin( 2.0 * PI * FREQUENCY * ( user->frames + i ) / user->sampleRate ) );
+  }
+  user->frames += nFrames;
+  user->callbacks++;
+  return 0;
+}
+
+// Error of a signal from the sine of the given frequency that fits it
+// best, relative to that sine, in dB.
+static double sineError( const std::vector<float> &signal, size_t first, size_t last, double frequency )
+{
+  // Least squares fit of a * sin + b * cos.
+  double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+  for ( size_t i=first; i<last; i++ ) {
+    double s = std::sin( 2.0 * PI * frequency * i ), c = std::cos( 2.0 * PI * frequency * i );
+    ss += s * s; cc += c * c; sc += s * c;
+    ys += signal[i] * s; yc += signal[i] * c;
+  }
+  double det = ss * cc - sc * sc;
+  double a = ( ys * cc - yc * sc ) / det, b = ( yc * ss - ys * sc ) / det;
+  double error = 0, power = 0;
+  for ( size_t i=first; i<last; i++ ) {
+    double fit = a * std::sin( 2.0 * PI * frequency * i ) + b * std::cos( 2.0 * PI * frequency * i );
+    error += ( signal[i] - fit ) * ( signal[i] - fit );
+    power += fit * fit;
+  }
+  return 10.0 * std::log10( error / power );
+}
+
+// Runs the rate conversion of the library on a device-less stream.
+class ConvertApi : public TestApi
+{
+public:
+
+  // The device side of the stream: the user callbacks run in each
+  // device period, and the output played.
+  std::vector<unsigned int> callbacks;
+  std::vector<float> output;
+
+  // Runs a mono FLOAT32 stream (0 for output, 1 for input and 2 for
+  // duplex) at the user rate and buffer size on a device at the device
+  // rate, for the given number of device periods, with a sine as device
+  // input.  Returns the device buffer size.
+  unsigned int run( int mode, UserData &user, unsigned int bufferFrames,
+                    unsigned int deviceRate, unsigned int periods )
+  {
+    closeTestStream();
+    RtAudio::StreamOptions options;
+    options.flags = RTAUDIO_CONVERT_SAMPLE_RATE;
+    unsigned int deviceFrames = bufferFrames;
+    convertStreamRate( user.sampleRate, deviceRate, &deviceFrames, &options );
+    openTestStream( (StreamMode) mode, deviceRate, deviceFrames, RTAUDIO_FLOAT32, RTAUDIO_FLOAT32, 1 );
+    setupRateConversion( userCallback, &user );
+
+    callbacks.clear();
+    output.clear();
+    std::vector<float> in( deviceFrames ), out( deviceFrames );
+    for ( unsigned int i=0; i<periods; i++ ) {
+      for ( unsigned int j=0; j<deviceFrames; j++ )
+        in[j] = (float) ( AMPLITUDE * std::sin( 2.0 * PI * FREQUENCY * ( (double) i * deviceFrames + j ) / deviceRate ) );
+      unsigned int count = user.callbacks;
+      rateConversionCallback( ( mode != INPUT ) ? &out[0] : 0, ( mode != OUTPUT ) ? &in[0] : 0,
+                              deviceFrames, 0.0, 0, this );
+      callbacks.push_back( user.callbacks - count );
+      if ( mode != INPUT ) output.insert( output.end(), out.begin(), out.end() );
+    }
+    return deviceFrames;
+  }
+};
+
+static bool report( bool ok, const std::string &check )
+{
+  std::cout << ( ok ? "ok   " : "FAIL " ) << check << '\n';
+  return ok;
+}
+
+int main( void )
+{
+  ConvertApi api;
+  int failures = 0;
+
+  // 48 kHz callbacks on a 44.1 kHz device and the other way around.
+  // Periods of 480 frames last exactly as long as device periods of
+  // 441 frames, and those of 256 frames don't.
+  const unsigned int RATES[][2] = { { 48000, 44100 }, { 44100, 48000 } };
+  const char *MODE_NAMES[] = { "output", "input ", "duplex" };
+  for ( int r=0; r<2; r++ ) {
+    for ( int m=0; m<3; m++ ) {
+      unsigned int userRate = RATES[r][0], deviceRate = RATES[r][1];
+      std::string name = std::string( MODE_NAMES[m] ) + ", " + std::to_string( userRate ) +
+        " Hz on " + std::to_string( deviceRate ) + " Hz";
+
+      UserData user = { userRate, 0, m == 2, 0, std::vector<float>() };
+      unsigned int frames = ( r == 0 ) ? 480 : 441;
+      unsigned int periods = 2 * deviceRate / ( ( r == 0 ) ? 441 : 480 );
+      unsigned int deviceFrames = api.run( m, user, frames, deviceRate, periods );
+      bool ok = deviceFrames == ( ( r == 0 ) ? 441u : 480u );
+      for ( size_t i=1; i<api.callbacks.size(); i++ )
+        if ( api.callbacks[i] != 1 ) ok = false;
+      if ( !report( ok, name + ": one callback per device period" ) ) failures++;
+
+      user = UserData{ userRate, 0, m == 2, 0, std::vector<float>() };
+      deviceFrames = api.run( m, user, 256, deviceRate, periods );
+      double expected = (double) periods * deviceFrames / deviceRate * userRate / 256;
+      ok = std::fabs( user.callbacks - expected ) <= 2.0;
+      for ( size_t i=0; i<api.callbacks.size(); i++ )
+        if ( api.callbacks[i] > 2 ) ok = false;
+      if ( !report( ok, name + ": callbacks at the requested rate" ) ) failures++;
+
+      // The sine must come out at the same frequency, which checks the
+      // conversion ratio.  It is measured from the second half second,
+      // after the filter delays.
+      double error;
+      if ( m == 1 )
+        error = sineError( user.input, userRate / 2, user.input.size(), FREQUENCY / userRate );
+      else
+        error = sineError( api.output, deviceRate / 2, api.output.size(), FREQUENCY / deviceRate );
+      std::cout << "     sine error " << error << " dB\n";
+      if ( !report( error < -65.0, name + ": sine converted" ) ) failures++;
+    }
+  }
+
+  return failures ? 1 : 0;
+}
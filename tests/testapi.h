@@ -0,0 +1,72 @@
+/******************************************/
+/*
+  testapi.h
+
+  An RtApi with no devices, shared by the
+  programs that check the stages of the
+  library below its public API (and by the
+  benchmark).  A program derives from it to
+  reach the protected functions, and opens a
+  stream with openTestStream(), which sets up
+  the stream structure as a backend would in
+  probeDeviceOpen().
+*/
+/******************************************/
+
+#ifndef RTAUDIO_TESTAPI_H
+#define RTAUDIO_TESTAPI_H
+
+#include "RtAudio.h"
+#include <cstdlib>
+
+class TestApi : public RtApi
+{
+public:
+
+  TestApi() { showWarnings( false ); }
+  ~TestApi() { closeTestStream(); }
+  RtAudio::Api getCurrentApi( void ) override { return RtAudio::UNSPECIFIED; }
+  RtAudioErrorType startStream( void ) override { return RTAUDIO_NO_ERROR; }
+  RtAudioErrorType stopStream( void ) override { return RTAUDIO_NO_ERROR; }
+  RtAudioErrorType abortStream( void ) override { return RTAUDIO_NO_ERROR; }
+
+protected:
+
+  // Sets up a stream with the same number of user and device channels
+  // in each of its directions, an interleaved device buffer, and the
+  // buffer conversions selected.  The stream must be closed, although
+  // a rate conversion may have been started with convertStreamRate().
+  void openTestStream( StreamMode mode, unsigned int sampleRate, unsigned int bufferSize,
+                       RtAudioFormat userFormat, RtAudioFormat deviceFormat,
+                       unsigned int channels, bool interleaved = true,
+                       unsigned int nBuffers = 2 )
+  {
+    stream_.mode = mode;
+    stream_.sampleRate = sampleRate;
+    stream_.bufferSize = bufferSize;
+    stream_.nBuffers = nBuffers;
+    stream_.userFormat = userFormat;
+    stream_.userInterleaved = interleaved;
+    stream_.deviceBuffer = (char *) calloc( bufferSize * channels, formatBytes( deviceFormat ) );
+    for ( int i=0; i<2; i++ ) {
+      if ( mode != DUPLEX && mode != i ) continue;
+      stream_.deviceFormat[i] = deviceFormat;
+      stream_.nUserChannels[i] = channels;
+      stream_.nDeviceChannels[i] = channels;
+      stream_.deviceInterleaved[i] = true;
+      stream_.userBuffer[i] = (char *) calloc( bufferSize * channels, formatBytes( userFormat ) );
+      setConvertInfo( (StreamMode) i, 0 );
+    }
+  }
+
+  // Frees the buffers of the stream and clears its structure.
+  void closeTestStream( void )
+  {
+    for ( int i=0; i<2; i++ )
+      free( stream_.userBuffer[i] );
+    free( stream_.deviceBuffer );
+    clearStreamInfo();
+  }
+};
+
+#endif